@@ -0,0 +1,44 @@
+/*
+** BENCHUTL.C  - timing helpers for the NICOF benchmark programs
+**
+** This file is part of NICOF (Non-Invasive COmmunication Facility)
+** for VM/370 R6 "SixPack".
+**
+** Implementation of the benchmark timing helpers (see BENCHUTL.H).
+**
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+ 
+#include "benchutl.h"
+ 
+#include <stdio.h>
+ 
+_dblw vcpuTime() {
+  _dblw timer[4]; /* date, time, virtual CPU, total CPU */
+  diagx0c((char*)timer);
+  return timer[2];
+}
+ 
+void benchStart(BENCHCLOCK *timing) {
+  time(&timing->start);
+  timing->vcpuStart = vcpuTime();
+}
+ 
+void benchReport(
+    char *what, unsigned int totalBytes, BENCHCLOCK *timing) {
+  time_t end;
+  time(&end);
+  unsigned int vcpu = (unsigned int)(vcpuTime() - timing->vcpuStart);
+  unsigned int secs = (unsigned int)(end - timing->start);
+  unsigned int kbytes = (totalBytes + 1023) / 1024;
+  printf(".. %s: %d bytes in %d secs => %d bytes/sec, vcpu %d ms (%d us/KB)\n",
+    what, totalBytes, secs, (secs > 0) ? totalBytes / secs : totalBytes,
+    vcpu / 1000, (kbytes > 0) ? vcpu / kbytes : vcpu);
+}
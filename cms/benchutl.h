@@ -0,0 +1,50 @@
+/*
+** BENCHUTL.H  - timing helpers for the NICOF benchmark programs
+**
+** This file is part of NICOF (Non-Invasive COmmunication Facility)
+** for VM/370 R6 "SixPack".
+**
+** The test programs measuring the throughput of NICOF components (TSTBULKS,
+** TSTRECIO) take the elapsed time and the virtual CPU time of a benchmark
+** run and report both in the same format through these functions.
+**
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+ 
+#ifndef __BENCHUTL_included
+#define __BENCHUTL_included
+ 
+#include <time.h>
+ 
+#include "intrapi.h"
+ 
+/* the start times of a benchmark run */
+typedef struct _benchclock {
+  time_t start;     /* elapsed time at start */
+  _dblw vcpuStart;  /* virtual CPU time at start (microseconds) */
+  } BENCHCLOCK;
+ 
+/* get the virtual CPU time used so far in microseconds.
+*/
+extern _dblw vcpuTime();
+ 
+/* remember the current elapsed and virtual CPU time in 'timing' as start of
+** a benchmark run.
+*/
+extern void benchStart(BENCHCLOCK *timing);
+ 
+/* print the throughput and virtual CPU usage of the benchmark run started
+** with 'timing' which transferred 'totalBytes', with 'what' describing the
+** run.
+*/
+extern void benchReport(
+    char *what, unsigned int totalBytes, BENCHCLOCK *timing);
+ 
+#endif
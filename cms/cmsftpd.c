@@ -4,15 +4,25 @@
 ** This file is part of NICOF (Non-Invasive COmmunication Facility)
 ** for VM/370 R6 "SixPack".
 **
-** This module implements a simple single-session CMS FTP server simulating
-** a hierarchical file system,
+** This module implements a simple CMS FTP server simulating a hierarchical
+** file system,
 ** with "simple" meaning:
 **   => the control connection is raw TCP/IP, not TELNET
 **   => not all FTP protocol commands of RFC-959 are implemented
 **      (however most file related commands are available)
 **   => login can be made required by specifying the password on the command
 **      line (the username must then be the VM user running CMSFTPD)
-**   => the program automatically terminates after the first client session
+**   => the program automatically terminates after the last client session
+**   => several client sessions can transfer files at the same time, as
+**      transfers are advanced packet by packet in the main select loop
+**   => the file listings of whole minidisks are cached, so repeated LIST
+**      resp. NLST commands only send the cached lines until the disk changes
+**      (files rewritten in place by others may show the old date and size
+**      for up to LIST_MAXAGE seconds)
+**   => binary transfers can be resumed with REST (for STOR only with RECFM F
+**      files), SIZE and MDTM allow clients to skip unchanged files
+**   => the throughput statistics of a transfer are sent with the 226 reply,
+**      the statistics of all transfers since the start with SITE STATS
 ** with "hierarchical file system" meaning:
 **   => the accessed disks and files of the current CMS user are serviced
 **   => the virtual root of the file system is identified by the / symbol
@@ -59,9 +69,27 @@
 #define SRV_LISTEN_ADDR "0.0.0.0"
 #define SRV_LISTEN_PORT 21
  
-/* the size for a transmission packet server(CMS) <=> client(outside) */
+/* the size for a control message packet server(CMS) <=> client(outside) */
 #define PACKETLEN 1400
  
+/* the size for a data packet server(CMS) <=> client(outside), this is the
+** max. data transported by a single NICOF send or recv request */
+#define DATAPACKETLEN 2048
+ 
+/* the number of data packets of a RETR transfer: while one packet is sent,
+** the next packets are filled with the following records of the file */
+#define TRF_PACKETS 2
+ 
+/* the send buffer of the data connection of a RETR transfer, allowing this
+** many bytes (in DATAPACKETLEN send requests) to be in flight to the proxy */
+#define TRF_SNDBUF (8 * DATAPACKETLEN)
+ 
+/* the max. age (seconds) of a cached minidisk listing: changes to the disk
+** not done through CMSFTPD are detected only if they change the file or
+** block counts of the disk, so files rewritten in place by others appear
+** with the new date and size at the latest after this time */
+#define LIST_MAXAGE 30
+ 
 /* CMS commands used when option -useCmsCmds was specified */
 #define CMS_GET_DISKS_CMD  "QUERY DISK ( FIFO"
 #define CMS_LIST_FILES_CMD "LISTFILE %s %s %s ( FIFO LABEL NOHEADER"
@@ -73,6 +101,7 @@
 #include <time.h>
  
 #include "cmssys.h"
+#include "cmsrecio.h"
  
 /* utility functions borrowed from MECAFF */
 #include "eeutil.h"
@@ -89,6 +118,26 @@ typedef char bool;
 #define false 0
 #endif
  
+/* states of the file transfer of a session */
+#define TRF_NONE 0 /* no transfer in progress */
+#define TRF_RETR 1 /* sending a file to the client */
+#define TRF_STOR 2 /* receiving a file from the client (STOR, APPE) */
+ 
+/* throughput statistics for a single transfer resp. all transfers, with
+** the times in microseconds */
+typedef struct _trfStats {
+  unsigned int transfers;  /* transfers completed successfully */
+  unsigned int failed;     /* transfers aborted */
+  unsigned int bytes;      /* bytes sent resp. received on data connections */
+  unsigned int records;    /* records read resp. written */
+  unsigned int netCalls;   /* send/recv calls transferring data */
+  unsigned int fileCalls;  /* FSREAD/FSWRITE calls */
+  _dblw elapsed;           /* time from opening the data connection to end */
+  _dblw netTime;           /* time spent in send/recv */
+  _dblw fileTime;          /* time spent in CMS file I/O */
+  _dblw vcpu;              /* virtual CPU used (by all sessions) */
+} TRFSTATS;
+ 
 /*
 ** Control data for a single FTP client session
 */
@@ -112,6 +161,9 @@ typedef struct _ftpSession {
   /* is the state currently TYPE I ? */
   bool ftpTrfBinary;
  
+  /* byte offset where the next RETR or STOR restarts (REST cmd) */
+  int restartPos;
+ 
   /* "current directory", with -1 => / */
   int currDisk;
  
@@ -119,6 +171,35 @@ typedef struct _ftpSession {
   char renameFromFid[20];
   int renameDiskIdx;
  
+  /* the file transfer in progress, advanced by the main select loop */
+  int trfState;          /* TRF_NONE, TRF_RETR or TRF_STOR */
+  SOCKET dataSocket;     /* data connection of the transfer */
+  bool trfBinary;        /* is the transfer binary (else ASCII lines) ? */
+  char trfPkt[TRF_PACKETS][DATAPACKETLEN]; /* packets sent resp. received */
+  int trfLen[TRF_PACKETS];/* RETR: used count of the packets in 'trfPkt' */
+  int trfHead;           /* RETR: index of the packet to send next */
+  int trfFilled;         /* RETR: count of packets filled but not yet sent */
+  int trfSent;           /* RETR: bytes of the head packet already sent */
+  bool trfEof;           /* RETR: all records read from the file ? */
+  int pendPos;           /* RETR: start of the record rest in 'ioBuffer' */
+  int pendLen;           /* RETR: length of the record rest in 'ioBuffer' */
+  int trfSkip;           /* RETR: bytes to skip up to the restart position */
+  char recfm;            /* STOR: RECFM for the file */
+  int lrecl;             /* STOR: LRECL for the file */
+  bool doAppend;         /* STOR: appending to the file (APPE) ? */
+  int recFilled;         /* STOR: bytes of the current record in 'ioBuffer' */
+  int recsWritten;       /* STOR: records written so far */
+  int restartRecord;     /* STOR: first record written if restarted, else 0 */
+  TRFSTATS stats;        /* statistics of the transfer */
+  _dblw trfStart;        /* TOD clock (microseconds) at transfer start */
+  _dblw trfVcpuStart;    /* virtual CPU time at transfer start */
+ 
+  /* the CMS file transferred */
+  char filename[20];
+  RECFILE recfile;
+  RECFILE *f;
+  char ioBuffer[544]; /* 512 bytes buffer + 32 spare */
+ 
   /* session management: simple linked list */
   struct _ftpSession *next;
 } HANDLE, *H;
@@ -135,24 +216,36 @@ static bool disksReadonly = false; /* treat all R/W disks as R/O */
 static bool autoOverwrite = false; /* do not need ! modifier to replace */
 static bool ignoreDashArgs = false;/* skip 1. parameter if begins with - ? */
 static bool useCmsCommands = false;/* do LISTFILE / CP DISK ? */
-static bool trfBinary = false;     /* is the current transfer binary mode ? */
+static int blockSize = RECIO_DEFAULT_BLOCKSIZE; /* bytes per CMS file I/O */
  
 /* client socket and session management */
 static fd_set clientSocksSet; /* socket set wot watch, incl. our srvSocket */
 static fd_set *clientSocks = &clientSocksSet;
+static fd_set writeSocksSet;  /* data sockets of running RETR transfers */
+static fd_set *writeSocks = &writeSocksSet;
 static int clientSockCount = 0;
 static int lastSockPlus1 = 0;
  
 static H sessions = NULL; /* list of current client sessions */
  
+/* statistics of all transfers since the start of CMSFTPD */
+static TRFSTATS totalStats;
+ 
 /* initialize session management, putting the server socket into the set */
 static void initClientSocks() {
   FD_ZERO(clientSocks);
+  FD_ZERO(writeSocks);
   FD_SET(srvSocket, clientSocks);
   lastSockPlus1 = srvSocket + 1;
   clientSockCount = 0;
 }
  
+/* put a data socket into the set of sockets to watch */
+static void watchSocket(SOCKET sock, fd_set *set) {
+  FD_SET(sock, set);
+  if (sock >= lastSockPlus1) { lastSockPlus1 = sock + 1; }
+}
+ 
 /* create and initialize the client session for a new client socket
 */
 static H addClientSock(SOCKET sock) {
@@ -169,12 +262,18 @@ static H addClientSock(SOCKET sock) {
   h->ftpTrfBinary = false;
   h->currDisk = -1;
   h->renameDiskIdx = -1;
+  h->trfState = TRF_NONE;
+  h->dataSocket = -1;
+  h->f = NULL;
   h->next = sessions;
   sessions = h;
  
   return h;
 }
  
+/* forward declaration: abort the file transfer of a session */
+static void endTransfer(H h, char *msg);
+ 
 /* remove the session for the given socket
 ** returns 'true' if this was the last client session
 */
@@ -187,6 +286,7 @@ static bool dropClientSock(SOCKET sock) {
   }
   if (h) {
     if (prev) { prev->next = h->next; } else { sessions = h->next; }
+    endTransfer(h, NULL);
     if (h->psvSocket >= 0) { closesocket(h->psvSocket); }
     if (h->ctlSocket >= 0) { closesocket(h->ctlSocket); }
     free(h);
@@ -427,16 +527,35 @@ static char* getNextToken(char *s) {
 ** simulation of a simple hierarchical file system over CMS minidisks
 */
  
+/* a packet of a cached minidisk listing (ASCII lines ready to be sent) */
+typedef struct __listpacket {
+  struct __listpacket *next;
+  int len;
+  char data[DATAPACKETLEN];
+} ListPacket;
+ 
 /* known infos about a minidisk */
 typedef struct __minidisk {
   char letter;
   bool readonly;
   int blocksize;
+  char stamp[48];          /* file/block counts, to detect disk changes */
+  bool listValid[2];       /* cached listing valid? [0] short, [1] long */
+  ListPacket *listing[2];  /* cached listing: [0] short, [1] long format */
+  _dblw listTime[2];       /* TOD clock (microseconds) when cached */
 } Minidisk;
  
 static Minidisk disks[26]; /* 26 letters -> max. 26 minidisks */
 static int diskCount = 0;  /* used entries in 'disks' */
  
+/* copy the file and block counts of a disk enumeration line starting at
+** 'tok' (the token following the block size) as change stamp to 'stamp'
+*/
+static void copyStamp(char *stamp, char *tok) {
+  memset(stamp, '\0', sizeof(disks[0].stamp));
+  if (tok) { strncpy(stamp, tok, sizeof(disks[0].stamp) - 1); }
+}
+ 
 /* disk enumeration callback: add an entry to 'disks' */
 static void disklistCB(char *line, void *cbdata) {
   char *tok = line;         /* label */
@@ -449,13 +568,13 @@ static void disklistCB(char *line, void *cbdata) {
   tok = getNextToken(tok);  /* dev type */
   tok = getNextToken(tok);  /* block size */
   disks[diskCount].blocksize = getLineInt(tok);
+  copyStamp(disks[diskCount].stamp, getNextToken(tok));
  
   diskCount++;
 }
  
-/* initialize 'disks' with the currently accessed minidisks */
-static void initDisks() {
-  memset((char*)disks, '\0', sizeof(disks));
+/* enumerate the currently accessed minidisks, calling 'cb' for each disk */
+static void enumerateDisks(void (*cb)(char *line, void *cbdata)) {
   if (useCmsCommands) {
     char line[133];
     /* drain stack (remove any user input present, like TERMINATE) */
@@ -467,13 +586,19 @@ static void initDisks() {
     while(CMSstackQuery()) {
       int len = CMSconsoleRead(line);
       line[len] = '\0';
-      disklistCB(line, NULL);
+      cb(line, NULL);
     }
   } else {
-    getDiskList(&disklistCB, NULL);
+    getDiskList(cb, NULL);
   }
 }
  
+/* initialize 'disks' with the currently accessed minidisks */
+static void initDisks() {
+  memset((char*)disks, '\0', sizeof(disks));
+  enumerateDisks(&disklistCB);
+}
+ 
 /* get the index in 'disks' for the "minidisk directory" (disk letter) */
 static int getDiskIdx(char disk) {
   int i;
@@ -484,6 +609,60 @@ static int getDiskIdx(char disk) {
   return -1;
 }
  
+/* free the packets of a cached listing */
+static void freeListing(ListPacket *pkt) {
+  while (pkt) {
+    ListPacket *next = pkt->next;
+    free(pkt);
+    pkt = next;
+  }
+}
+ 
+/* drop the cached listings of the disk 'diskIdx', so the next listing of
+** the disk enumerates the files again
+*/
+static void dropListing(int diskIdx) {
+  if (diskIdx < 0 || diskIdx >= diskCount) { return; }
+  int i;
+  for (i = 0; i < 2; i++) {
+    freeListing(disks[diskIdx].listing[i]);
+    disks[diskIdx].listing[i] = NULL;
+    disks[diskIdx].listValid[i] = false;
+  }
+}
+ 
+/* disk enumeration callback: drop the cached listings of a disk if its file
+** or block counts changed since the last check
+** (this does not see files changed in place without changing the block
+** count, these changes are covered by the age limit LIST_MAXAGE, changes
+** done by CMSFTPD itself (STOR, APPE, DELE, RNTO) drop the listings at once)
+*/
+static void diskcheckCB(char *line, void *cbdata) {
+  char stamp[sizeof(disks[0].stamp)];
+  char *tok = line;         /* label */
+  tok = getNextToken(tok);  /* dev */
+  if (tok) { tok = getNextToken(tok); } /* letter */
+  if (!tok) { return; }
+  int idx = getDiskIdx(*tok);
+  int i;
+  for (i = 0; i < 4 && tok; i++) { /* R/O, cyls, dev type, block size */
+    tok = getNextToken(tok);
+  }
+  if (!tok || idx < 0) { return; }
+  copyStamp(stamp, getNextToken(tok));
+  if (strcmp(stamp, disks[idx].stamp)) {
+    dropListing(idx);
+    strcpy(disks[idx].stamp, stamp);
+  }
+}
+ 
+/* check the accessed disks for file changes not done through CMSFTPD,
+** dropping the cached listings of the changed disks
+*/
+static void checkDiskChanges() {
+  enumerateDisks(&diskcheckCB);
+}
+ 
 /* interpret a path spec (including "." and ".." components)
 ** returns false if: invalid path, minidisk not accessed ...
 */
@@ -687,27 +866,117 @@ static bool parseFullPath(
 */
  
 static char bufCtrl[PACKETLEN]; /* control data server <-> client */
-static char bufData[PACKETLEN]; /* data transmission server <-> client */
-static int  bufUsed; /* used count in 'bufData' */
+ 
+/* data transmission server <-> client: one packet is filled while the other
+** is still being sent through the socket in non-blocking mode */
+static char bufData[2][DATAPACKETLEN];
+static int  bufCurr;     /* index of the packet being filled in 'bufData' */
+static int  bufUsed;     /* used count in the packet being filled */
+static bool bufPending;  /* is the other packet still being sent ? */
+static char *bufPendData;/* start of the data still being sent */
+static int  bufPendLen;  /* length of the data still being sent */
+static bool bufFailed;   /* did the transmission fail ? (nothing more sent) */
+ 
+/* send 'len' bytes at 'data' via 'trg' without waiting for the completion,
+** sending the rest again if the proxy took only a part of the data
+** rc : true if transmission via 'trg' failed (=> errno has the reason)
+*/
+static bool transmitSend(SOCKET trg, char *data, int len) {
+  while (len > 0) {
+    int rc = send(trg, data, len, 0);
+    if (rc < 0 && errno == EWOULDBLOCK) {
+      bufPending = true;
+      bufPendData = data;
+      bufPendLen = len;
+      return false;
+    } else if (rc < 0) {
+      bufFailed = true;
+      return true;
+    }
+    data += rc;
+    len -= rc;
+  }
+  return false;
+}
+ 
+/* wait until the data sent last via 'trg' is transmitted, sending the rest
+** of the data again if its send completed with a partial length
+** rc : true if transmission via 'trg' failed (=> errno has the reason)
+*/
+static bool transmitWait(SOCKET trg) {
+  fd_set wrSet;
+  fd_set wrOut;
+  while (bufPending) {
+    bufPending = false;
+    int rc = send(trg, bufPendData, 0, 0);
+    while (rc < 0 && errno == EALREADY) {
+      FD_ZERO(&wrSet);
+      FD_SET(trg, &wrSet);
+      selectX(trg + 1, NULL, &wrSet, NULL, NULL, &wrOut, NULL, NULL);
+      rc = send(trg, bufPendData, 0, 0);
+    }
+    if (rc < 0) {
+      bufFailed = true;
+      return true;
+    }
+    if (rc < bufPendLen && transmitSend(trg, bufPendData + rc, bufPendLen - rc)) {
+      return true;
+    }
+  }
+  return bufFailed;
+}
+ 
+/* start sending 'len' bytes at 'data' via 'trg' after the packet sent
+** before is transmitted
+** rc : true if transmission via 'trg' failed (=> errno has the reason)
+*/
+static bool transmitStart(SOCKET trg, char *data, int len) {
+  if (transmitWait(trg)) { return true; }
+  return transmitSend(trg, data, len);
+}
+ 
+/* start sending the packet filled so far via 'trg' and switch to the other
+** packet for the following data
+** rc : true if transmission via 'trg' failed (=> errno has the reason)
+*/
+static bool transmitPacket(SOCKET trg) {
+  if (bufUsed <= 0) { return false; }
+  if (transmitStart(trg, bufData[bufCurr], bufUsed)) { return true; }
+  bufCurr = 1 - bufCurr;
+  bufUsed = 0;
+  return false;
+}
  
 /* add 'data' with 'datalen' unchanged to the buffer, transmitting the buffer
 ** content via 'trg' if necessary.
 ** rc : true if transmission via 'trg' failed (=> errno has the reason)
-** requirement: 'dataLen' MUST be < PACKETLEN, or transmission is truncated!
+** requirement: 'dataLen' MUST be < DATAPACKETLEN, or transmission is
+**              truncated!
 */
 static bool transmitUnit(SOCKET trg, char *data, int dataLen) {
   if (!data || dataLen < 1) { return false; }
-  if ((bufUsed + dataLen) > PACKETLEN && bufUsed > 0) {
-    int rc = send(trg, bufData, bufUsed, 0);
-    if (rc < 0) { return true; }
-    bufUsed = 0;
+  if ((bufUsed + dataLen) > DATAPACKETLEN && bufUsed > 0) {
+    if (transmitPacket(trg)) { return true; }
   }
-  if (dataLen > PACKETLEN) { dataLen = PACKETLEN; }
-  memcpy(&bufData[bufUsed], data, dataLen);
+  if (dataLen > DATAPACKETLEN) { dataLen = DATAPACKETLEN; }
+  memcpy(&bufData[bufCurr][bufUsed], data, dataLen);
   bufUsed += dataLen;
   return false;
 }
  
+/* send the packets of a cached listing via 'trg' after the data buffered
+** so far
+** rc : true if transmission via 'trg' failed (=> errno has the reason)
+*/
+static bool transmitListing(SOCKET trg, ListPacket *pkt) {
+  if (transmitPacket(trg)) { return true; }
+  while (pkt) {
+    if (transmitStart(trg, pkt->data, pkt->len)) { return true; }
+    pkt = pkt->next;
+  }
+  return false;
+}
+ 
 /* add an EBCDIC string as a new line to the buffer (i.e. translating to ASCII
 ** and adding the ASCII line separator), transmmitting the buffer to 'sock'
 ** if necessary)
@@ -721,22 +990,30 @@ static bool transmitAsciiLine(SOCKET trg, char *outline) {
   return transmitUnit(trg, outline, len + 2);
 }
  
-/* initialize transmission via buffer
+/* initialize transmission via buffer, switching 'trg' to non-blocking mode
+** for sending a packet while the next one is filled
 */
-static void transmitBegin() {
+static void transmitBegin(SOCKET trg) {
+  ncs_uint nonBlocking = 1;
+  ioctlsocket(trg, FIONBIO, &nonBlocking);
+  bufCurr = 0;
   bufUsed = 0;
+  bufPending = false;
+  bufFailed = false;
 }
  
 /* finalize transmission, sending the buffer's via 'trg' current content
-** if required
+** if required and waiting for all packets to be transmitted before switching
+** 'trg' back to blocking mode
 ** rc : true if transmission via 'trg' failed (=> errno has the reason)
 */
 static bool transmitEnd(SOCKET trg) {
-  if (bufUsed <= 0) { return false; }
-  int rc = send(trg, bufData, bufUsed, 0);
-  if (rc < 0) { return true; }
+  bool failed = transmitPacket(trg);
+  if (transmitWait(trg)) { failed = true; }
+  ncs_uint nonBlocking = 0;
+  ioctlsocket(trg, FIONBIO, &nonBlocking);
   bufUsed = 0;
-  return false;
+  return failed;
 }
  
 /* send a FTP state response via the control channel
@@ -795,14 +1072,15 @@ static SOCKET openDataConnection(H h) {
  
 /*
 ** functionality for transfering CMS files (RECV, STOR, APPE)
+**
+** a file transfer is not done in one go, but advanced by one data packet
+** each time the data connection shows activity in the main select loop, so
+** the other client sessions are served while files are transferred:
+**  -> RETR sends a packet asynchronously (non-blocking socket) and fills
+**     the next packet from the file when the send has completed
+**  -> STOR resp. APPE write the records of a packet when it has arrived
 */
  
-static char filename[128];
-static CMSFILE cmsfile;
-static CMSFILE *f = NULL;
-static char io_buffer[544]; /* 512 bytes buffer + 32 spare */
-static int recordNum = 1;
- 
 /* build a FID string from the components fn ft fm */
 static void buildFid(char *fid, char *fn, char *ft, char *fm) {
   strcpy(fid, "                  ");
@@ -820,8 +1098,8 @@ static void buildFid(char *fid, char *fn, char *ft, char *fm) {
 }
  
 /* try to open the file and:
-   - set global variable 'f' and return true if successfull
-   - send an error status and return false if the file cannot be opened
+   - set the session's file 'f' and return 0 if successfull
+   - send an error status and return the CMS rc if the file cannot be opened
 */
 static int openFile(
     H h,
@@ -831,22 +1109,22 @@ static int openFile(
     bool doAppend) {
   char msg[80];
  
-  memset(io_buffer, '\0', sizeof(io_buffer));
+  memset(h->ioBuffer, '\0', sizeof(h->ioBuffer));
  
-  memset(filename, '\0', sizeof(filename));
-  char *fid = filename;
+  memset(h->filename, '\0', sizeof(h->filename));
+  char *fid = h->filename;
   buildFid(fid, fn, ft, fm);
  
   CMSFILEINFO *fInfo;
   int rc = CMSfileState(fid, &fInfo);
   if (rc == 28) {
     if (openForRead) {
-      f = NULL;
+      h->f = NULL;
       sendCtrlMsg(h, "550 File not found, file transfer canceled");
       return rc;
     }
   } else if (rc != 0) {
-    f = NULL;
+    h->f = NULL;
     sprintf(msg,
       "550 Error opening file (rc = %d), file transfer canceled", rc);
     sendCtrlMsg(h, msg);
@@ -865,30 +1143,20 @@ static int openFile(
     return 4;
   }
  
-  int firstLine = 1;
-  if (!openForRead && doAppend) { firstLine = 0; }
-  rc = CMSfileOpen(
-         fid,
-         io_buffer,
-         (openForRead) ? sizeof(io_buffer)-1 : lrecl,
-         recfm,
-         1,         /* number of lines read/written per operation */
-         firstLine, /* first line to read/write */
-         &cmsfile);
-  if (rc == 0 || rc == 28) {
-    f = &cmsfile;
-    if (openForRead) {
-      recordNum = 0;
-    } else {
-      recordNum = (doAppend) ? 0 : 1;
-    }
+  rc = recOpen(&h->recfile, fid, openForRead, recfm, lrecl, doAppend, blockSize);
+  if (rc == 0) {
+    h->f = &h->recfile;
     return 0;
+  } else if (rc == RECIO_NOMEM) {
+    h->f = NULL;
+    sendCtrlMsg(h, "451 Not enough memory, file transfer canceled");
+    return rc;
   } else if (rc == 20) {
-    f = NULL;
+    h->f = NULL;
     sendCtrlMsg(h, "550 Invalid file name, file transfer canceled");
     return rc;
   } else {
-    f = NULL;
+    h->f = NULL;
     sprintf(msg,
       "550 Error accessing file (RC = %d), file transfer canceled", rc);
     sendCtrlMsg(h, msg);
@@ -898,22 +1166,186 @@ static int openFile(
   return 2;
 }
  
-/* close the CMS file */
-static void closeFile() {
-  if (f) { CMSfileClose(f); }
-  f = NULL;
+/*
+** transfer statistics
+*/
+ 
+/* get the TOD clock in microseconds */
+static _dblw usecs() {
+  _dblw tod;
+  stck(&tod);
+  return tod >> 12;
+}
+ 
+/* get the virtual CPU time used so far in microseconds */
+static _dblw vcpuTime() {
+  _dblw timer[4]; /* date, time, virtual CPU, total CPU */
+  diagx0c((char*)timer);
+  return timer[2];
+}
+ 
+/* start collecting the statistics for the transfer of the session */
+static void startStats(H h) {
+  memset(&h->stats, '\0', sizeof(h->stats));
+  h->trfStart = usecs();
+  h->trfVcpuStart = vcpuTime();
+}
+ 
+/* end the statistics of the transfer of the session (successful or not)
+** and add them to the statistics of all transfers
+*/
+static void stopStats(H h, bool failed) {
+  TRFSTATS *s = &h->stats;
+  s->elapsed = usecs() - h->trfStart;
+  s->vcpu = vcpuTime() - h->trfVcpuStart;
+  s->fileCalls = h->recfile.calls;
+  if (failed) { s->failed = 1; } else { s->transfers = 1; }
+ 
+  TRFSTATS *t = &totalStats;
+  t->transfers += s->transfers;
+  t->failed += s->failed;
+  t->bytes += s->bytes;
+  t->records += s->records;
+  t->netCalls += s->netCalls;
+  t->fileCalls += s->fileCalls;
+  t->elapsed += s->elapsed;
+  t->netTime += s->netTime;
+  t->fileTime += s->fileTime;
+  t->vcpu += s->vcpu;
+}
+ 
+/* format the microseconds 'us' as seconds with 3 decimals */
+static char* fmtSecs(char *buf, _dblw us) {
+  unsigned int ms = (unsigned int)(us / 1000);
+  sprintf(buf, "%u.%03u", ms / 1000, ms % 1000);
+  return buf;
+}
+ 
+/* send the statistics 's' as lines of a multi-line reply with 'code' */
+static void sendStats(H h, char *code, TRFSTATS *s) {
+  char msg[100];
+  char t1[16];
+  char t2[16];
+  unsigned int ms = (unsigned int)(s->elapsed / 1000);
+  unsigned int rate = (ms > 0)
+                    ? (unsigned int)(((_dblw)s->bytes * 1000) / ms)
+                    : s->bytes;
+  _dblw busy = s->netTime + s->fileTime;
+  _dblw other = (busy < s->elapsed) ? s->elapsed - busy : 0;
+ 
+  sprintf(msg, "%s-%u bytes, %u records in %s secs => %u bytes/sec",
+    code, s->bytes, s->records, fmtSecs(t1, s->elapsed), rate);
+  sendCtrlMsg(h, msg);
+  sprintf(msg, "%s-NICOF: %u send/recv calls in %s secs",
+    code, s->netCalls, fmtSecs(t1, s->netTime));
+  sendCtrlMsg(h, msg);
+  sprintf(msg, "%s-CMS file I/O: %u FSREAD/FSWRITE calls in %s secs",
+    code, s->fileCalls, fmtSecs(t1, s->fileTime));
+  sendCtrlMsg(h, msg);
+  sprintf(msg, "%s-waiting/converting: %s secs, virtual CPU: %s secs",
+    code, fmtSecs(t1, other), fmtSecs(t2, s->vcpu));
+  sendCtrlMsg(h, msg);
+}
+ 
+/* send data of the transfer of the session, timing the NICOF round trip
+** (only sends passing data are counted, not the checks for completed sends
+** or the sends refused because the send window is full)
+*/
+static int dataSend(H h, char *buf, int len) {
+  _dblw start = usecs();
+  int rc = send(h->dataSocket, buf, len, 0);
+  h->stats.netTime += usecs() - start;
+  if (rc > 0) { h->stats.netCalls++; }
+  return rc;
+}
+ 
+/* receive data of the transfer of the session, timing the NICOF round trip */
+static int dataRecv(H h, char *buf, int len) {
+  _dblw start = usecs();
+  int rc = recv(h->dataSocket, buf, len, 0);
+  h->stats.netTime += usecs() - start;
+  if (rc > 0) {
+    h->stats.netCalls++;
+    h->stats.bytes += rc;
+  }
+  return rc;
+}
+ 
+/* send the error message for the CMS return code 'rc' of a failed write */
+static void writeFailed(H h, int rc) {
+  if (rc == 4 || rc == 5 || rc == 20 || rc == 21) {
+    sendCtrlMsg(h, "550 Invalid CMS filename, transfer canceled");
+  } else if (rc == 10 || rc == 13 || rc == 19) {
+    sendCtrlMsg(h, "550 CMS disk is full, transfer canceled");
+  } else if (rc == 12) {
+    sendCtrlMsg(h, "550 CMS disk is read-only, transfer canceled");
+  } else {
+    char msg[80];
+    sprintf(msg,
+      "550 Error writing CMS file (RC = %d), transfer canceled", rc);
+    sendCtrlMsg(h, msg);
+  }
 }
  
-/* read a record of the file into 'io_buffer',
+/* close the CMS file, writing the records still buffered,
+   return true if writing failed
+*/
+static bool closeFile(H h) {
+  int rc = 0;
+  _dblw start = usecs();
+  if (h->f) { rc = recClose(h->f); }
+  h->stats.fileTime += usecs() - start;
+  h->f = NULL;
+  if (rc != 0) {
+    writeFailed(h, rc);
+    return true;
+  }
+  return false;
+}
+ 
+/* the EBCDIC line end characters of text transfers */
+#define EBCDIC_CR ((char)0x0D)
+#define EBCDIC_LF ((char)0x25)
+ 
+/* the EBCDIC chars relevant for line end detection (TRT-like scan table) */
+static const char lineEndChars[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, /* 00 .. 0F : CR */
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 10 .. 1F */
+  0, 0, 0, 0, 0, 1                                /* 20 .. 25 : LF */
+  /* rest is 0 */
+};
+ 
+/* get the length of the record 'rec' with 'len' bytes without the trailing
+** blanks (leaving at least 1 char), comparing 4 blanks at once where the
+** record is word aligned
+*/
+static int stripBlanks(char *rec, int len) {
+  unsigned int blankWord = (unsigned int)((unsigned char)' ') * 0x01010101;
+  char *limit = rec + 1;
+  char *end = rec + len;
+  while (end > limit && ((unsigned long)end & 3) != 0) {
+    if (end[-1] != ' ') { return end - rec; }
+    end--;
+  }
+  while ((end - limit) >= 4 && *((unsigned int*)(end - 4)) == blankWord) {
+    end -= 4;
+  }
+  while (end > limit && end[-1] == ' ') { end--; }
+  return (len > 0) ? end - rec : 0;
+}
+ 
+/* read a record of the file into 'rec' (with space for LRECL + 2 bytes),
    set 'eof' to true if no more records are available,
    return the length of the record just read.
 */
-static int readRecord(H h, bool *eof) {
+static int readRecord(H h, char *rec, bool *eof) {
   int len = 0;
   *eof = false;
   char msg[80];
-  int rc = CMSfileRead(f, recordNum, &len);
-  recordNum = 0;
+  _dblw start = usecs();
+  int rc = recRead(h->f, rec, &len);
+  h->stats.fileTime += usecs() - start;
+  if (rc == 0) { h->stats.records++; }
   if (rc == 12) {
     *eof = true;
     len = 0;
@@ -924,61 +1356,334 @@ static int readRecord(H h, bool *eof) {
     sendCtrlMsg(h, "550 Invalid CMS file name, transfer canceled");
     len = -1;
   } else if (rc != 0) {
-    printf(msg,
+    sprintf(msg,
       "550 Error reading file (RC = %d), file transfer canceled", rc);
     sendCtrlMsg(h, msg);
     len = -1;
-  } else if (!trfBinary) {
-    char *p = &io_buffer[len-1];
-    while (p > io_buffer && *p == ' ') { len--; p--; } /* drop blanks at end */
-    io_buffer[len] = '\0';
+  } else if (!h->trfBinary) {
+    len = stripBlanks(rec, len); /* drop blanks at end */
+    rec[len] = '\0';
   }
   return len;
 }
  
-/* write a record from 'io_buffer' with the specified record len,
+/* write a record from 'ioBuffer' with the specified record len,
    return true if writing failed
 */
 static bool writeRecord(H h, int len, char recfm, int lrecl) {
-  char fillChar = (trfBinary) ? '\0' : ' ';
+  char fillChar = (h->trfBinary) ? '\0' : ' ';
  
   if (len < 1) { /* avoid a "non-write" for empty records */
-    io_buffer[0] = fillChar;
+    h->ioBuffer[0] = fillChar;
     len = 1;
   }
   if (recfm == 'F' && len < lrecl) { /* fill fixed length records to LRECL */
-    char *tail = &io_buffer[len];
-    while(len < lrecl) {
-      *tail++ = fillChar;
-      len++;
-    }
+    memset(&h->ioBuffer[len], fillChar, lrecl - len);
+    len = lrecl;
   }
  
-  int rc = CMSfileWrite(f, recordNum, len);
-  recordNum = 0;
-  if (rc == 4 || rc == 5 || rc == 20 || rc == 21) {
-    sendCtrlMsg(h, "550 Invalid CMS filename, transfer canceled");
+  _dblw start = usecs();
+  int rc = recWrite(h->f, h->ioBuffer, len);
+  h->stats.fileTime += usecs() - start;
+  if (rc != 0) {
+    writeFailed(h, rc);
     return true;
-  } else if (rc == 10 || rc == 13 || rc == 19) {
-    sendCtrlMsg(h, "550 CMS disk is full, transfer canceled");
-    return true;
-  } else if (rc == 12) {
-    sendCtrlMsg(h, "550 CMS disk is read-only, transfer canceled");
-    return true;
-  } else if (rc != 0) {
-    char msg[80];
-    sprintf(msg,
-      "550 Error writing CMS file (RC = %d), transfer canceled", rc);
-    sendCtrlMsg(h, msg);
+  }
+  h->stats.records++;
+  return false;
+}
+ 
+/* end the file transfer of the session, dropping the file and the data
+** connection, and send 'msg' (if not NULL) to the client
+*/
+static void endTransfer(H h, char *msg) {
+  if (h->trfState != TRF_NONE && h->stats.transfers == 0) {
+    stopStats(h, true); /* not ended by transferDone() => aborted */
+  }
+  if (h->trfState == TRF_STOR) { dropListing(getDiskIdx(h->filename[16])); }
+  if (h->f) { /* transfer aborted: simply drop the file */
+    recClose(h->f);
+    h->f = NULL;
+  }
+  if (h->dataSocket >= 0) {
+    FD_CLR(h->dataSocket, clientSocks);
+    FD_CLR(h->dataSocket, writeSocks);
+    closesocket(h->dataSocket);
+    h->dataSocket = -1;
+  }
+  h->trfState = TRF_NONE;
+  if (msg) { sendCtrlMsg(h, msg); }
+}
+ 
+/* end the file transfer of the session successfully, sending the statistics
+** of the transfer with the 226 reply
+*/
+static void transferDone(H h) {
+  stopStats(h, false);
+  sendStats(h, "226", &h->stats);
+  endTransfer(h, "226 Closing data connection");
+}
+ 
+/* fill the next free data packet of the session with the next records of
+** the file; for text transfers, the records are collected as EBCDIC lines
+** (blanks at end removed, CR/LF appended) and the packet is translated to
+** ASCII in one pass when complete
+** rc : true if reading the file failed (the message is already sent)
+*/
+static bool fillRetrPacket(H h) {
+  int idx = (h->trfHead + h->trfFilled) % TRF_PACKETS;
+  char *pkt = h->trfPkt[idx];
+  int used = 0;
+  int maxRecLen = h->f->lrecl + 2;
+  while (used < DATAPACKETLEN) {
+    if (h->pendLen == 0) {
+      /* current record completely in a packet => get the next record */
+      if (h->trfEof) { break; }
+      bool eof;
+      bool direct = (h->trfSkip == 0 && (DATAPACKETLEN - used) >= maxRecLen);
+      char *rec = (direct) ? &pkt[used] : h->ioBuffer;
+      int len = readRecord(h, rec, &eof);
+      if (len < 0) { return true; }
+      if (eof) {
+        h->trfEof = true;
+        break;
+      }
+      if (!h->trfBinary) {
+        rec[len++] = EBCDIC_CR;
+        rec[len++] = EBCDIC_LF;
+      }
+      if (direct) { /* record read into the packet: nothing to copy */
+        used += len;
+        continue;
+      }
+      h->pendPos = 0;
+      h->pendLen = len;
+      if (h->trfSkip > 0) { /* restarted: skip data before restart position */
+        int skip = (h->trfSkip < len) ? h->trfSkip : len;
+        h->pendPos = skip;
+        h->pendLen -= skip;
+        h->trfSkip -= skip;
+      }
+    }
+    int chunk = DATAPACKETLEN - used;
+    if (chunk > h->pendLen) { chunk = h->pendLen; }
+    memcpy(&pkt[used], &h->ioBuffer[h->pendPos], chunk);
+    used += chunk;
+    h->pendPos += chunk;
+    h->pendLen -= chunk;
+  }
+  if (used > 0) {
+    if (!h->trfBinary) { nicofclt_ebcdic2ascii(pkt, used, pkt); }
+    h->trfLen[idx] = used;
+    h->trfFilled++;
+  }
+  return false;
+}
+ 
+/* account 'count' bytes of the head packet as sent, switching to the next
+** packet if the head packet is completely sent
+*/
+static void retrPacketSent(H h, int count) {
+  h->stats.bytes += count;
+  h->trfSent += count;
+  if (h->trfSent < h->trfLen[h->trfHead]) { return; }
+  h->trfHead = (h->trfHead + 1) % TRF_PACKETS;
+  h->trfFilled--;
+  h->trfSent = 0;
+}
+ 
+/* advance the RETR transfer of the session: queue the filled data packets
+** into the send window of the data connection until the window is full
+** resp. end the transfer when the file has been sent completely and all
+** queued sends are confirmed; while packets are in flight, the free packets
+** are filled with the next records of the file, so reading the file
+** overlaps with the transmission to the client
+*/
+static void retrStep(H h) {
+  int rc;
+  while(1) {
+    if (h->trfFilled == 0) {
+      if (fillRetrPacket(h)) {
+        endTransfer(h, NULL);
+        return;
+      }
+      if (h->trfFilled == 0) {
+        rc = dataSend(h, NULL, 0); /* all sent => check the queued sends */
+        if (rc < 0 && errno == EALREADY) { break; } /* still in flight */
+        if (rc < 0) {
+          endTransfer(h, "426 Connection closed; transfer aborted");
+          return;
+        }
+        closeFile(h);
+        transferDone(h);
+        return;
+      }
+    }
+    rc = dataSend(
+      h,
+      &h->trfPkt[h->trfHead][h->trfSent],
+      h->trfLen[h->trfHead] - h->trfSent);
+    if (rc < 0 && errno == EWOULDBLOCK) {
+      break; /* send window full: wait for a completion in the select loop */
+    } else if (rc < 0) {
+      endTransfer(h, "426 Connection closed; transfer aborted");
+      return;
+    }
+    retrPacketSent(h, rc);
+  }
+ 
+  /* prepare the next packets while the current one is in flight */
+  while (h->trfFilled < TRF_PACKETS && (h->pendLen > 0 || !h->trfEof)) {
+    if (fillRetrPacket(h)) {
+      endTransfer(h, NULL);
+      return;
+    }
+  }
+}
+ 
+/* append 'len' bytes at 'span' to the current record in 'ioBuffer', writing
+** the record each time it reaches LRECL
+** rc : true if writing the file failed (the message is already sent)
+*/
+static bool storSpan(H h, char *span, int len) {
+  while (len > 0) {
+    int chunk = h->lrecl - h->recFilled;
+    if (chunk > len) { chunk = len; }
+    memcpy(&h->ioBuffer[h->recFilled], span, chunk);
+    h->recFilled += chunk;
+    span += chunk;
+    len -= chunk;
+    if (h->recFilled >= h->lrecl) {
+      if (writeRecord(h, h->recFilled, h->recfm, h->lrecl)) { return true; }
+      h->recsWritten++;
+      h->recFilled = 0;
+    }
+  }
+  return false;
+}
+ 
+/* write the records in the data packet received for the STOR transfer; for
+** text transfers, the packet is translated to EBCDIC in one pass and the
+** lines are located with a TRT-like scan for the line end characters
+** rc : true if writing the file failed (the message is already sent)
+*/
+static bool storPacket(H h, int count) {
+  char *p = h->trfPkt[0];
+  char *bound = &h->trfPkt[0][count];
+  if (h->trfBinary) { return storSpan(h, p, count); }
+ 
+  nicofclt_ascii2ebcdic(p, count, p);
+  while (p < bound) {
+    char *span = p;
+    while (p < bound && !lineEndChars[(unsigned char)*p]) { p++; }
+    if (storSpan(h, span, p - span)) { return true; }
+    if (p >= bound) { break; }
+    if (*p++ == EBCDIC_LF) { /* end of line (LF) => write record */
+      if (writeRecord(h, h->recFilled, h->recfm, h->lrecl)) { return true; }
+      h->recsWritten++;
+      h->recFilled = 0;
+    } /* else: ignore CR */
+  }
+  return false;
+}
+ 
+/* cut the file of the session (already closed) after the record 'records',
+** dropping the records left behind by a restarted STOR shorter than the
+** file: as CMS files cannot be truncated, the records are copied to a work
+** file replacing the file
+** rc : true if failed (the message is already sent)
+*/
+static bool truncateFile(H h, int records) {
+  CMSFILEINFO *fInfo;
+  RECFILE src;
+  RECFILE trg;
+  char workFid[20];
+  char rec[256]; /* restart only for LRECL <= 255 */
+  int len;
+  int i;
+ 
+  if (CMSfileState(h->filename, &fInfo) != 0) { return false; }
+  if (fInfo->recordCount <= records) { return false; } /* no stale tail */
+ 
+  strcpy(workFid, h->filename);
+  memcpy(&workFid[8], "$RESTART", 8);
+  CMSfileErase(workFid); /* left over by a previous failure? */
+ 
+  _dblw start = usecs();
+  int rc = recOpen(&src, h->filename, true, ' ', 0, false, blockSize);
+  if (rc == 0) {
+    rc = recOpen(
+      &trg, workFid, false, fInfo->recordFormat, fInfo->lrecl, false, blockSize);
+    for (i = 0; i < records && rc == 0; i++) {
+      rc = recRead(&src, rec, &len);
+      if (rc == 0) { rc = recWrite(&trg, rec, len); }
+    }
+    int rc2 = recClose(&trg);
+    if (rc == 0) { rc = rc2; }
+  }
+  recClose(&src);
+  if (rc == 0) { rc = CMSfileErase(h->filename); }
+  if (rc != 0) { /* the file is unchanged, only the work file is dropped */
+    CMSfileErase(workFid);
+  } else {
+    rc = CMSfileRename(workFid, h->filename);
+  }
+  h->stats.fileTime += usecs() - start;
+  if (rc != 0) {
+    writeFailed(h, rc);
     return true;
   }
   return false;
 }
  
-/* implementation for the file transfer server => client (RETR)
+/* advance the STOR transfer of the session: write the data packet arrived
+** resp. end the transfer when the client closed the data connection
+*/
+static void storStep(H h) {
+  int count = dataRecv(h, h->trfPkt[0], DATAPACKETLEN);
+  if (count > 0) {
+    if (storPacket(h, count)) { endTransfer(h, NULL); }
+    return;
+  } else if (count < 0) {
+    endTransfer(h, "426 Connection closed; transfer aborted");
+    return;
+  }
+ 
+  /* end of data: write the last record and close the file */
+  bool failed = false;
+  if (h->recFilled > 0) {
+    failed = writeRecord(h, h->recFilled, h->recfm, h->lrecl);
+    h->recsWritten++;
+  }
+  if (!failed && h->recsWritten == 0 && !h->doAppend) {
+    /* ensure the file exists */
+    failed = writeRecord(h, 0, h->recfm, h->lrecl);
+  }
+  if (!failed) { failed = closeFile(h); }
+  if (!failed && h->restartRecord > 0) {
+    failed = truncateFile(h, h->restartRecord - 1 + h->recsWritten);
+  }
+  if (failed) {
+    endTransfer(h, NULL);
+  } else {
+    transferDone(h);
+  }
+}
+ 
+/* check if the session has a file transfer in progress, telling the client
+** that the command cannot be accepted
+*/
+static bool transferBusy(H h) {
+  if (h->trfState == TRF_NONE) { return false; }
+  sendCtrlMsg(h, "450 File transfer in progress, command not accepted");
+  return true;
+}
+ 
+/* implementation for the file transfer server => client (RETR), starting
+** at byte offset 'restart' of the file (binary mode only)
 ** returns true is failed (the message is alredy sent to the client)
 */
-static bool cmdRETR(H h, char *param) {
+static bool cmdRETR(H h, char *param, int restart) {
   char fn[9];
   char ft[9];
   int diskIdx;
@@ -1003,39 +1708,105 @@ static bool cmdRETR(H h, char *param) {
   int rc = openFile(h, fn, ft, fm, true, recfm, lrecl, false);
   if (rc != 0) { return true; }
  
+  /* position a restarted transfer, directly to the record for RECFM F,
+  ** else by skipping the record data up to the restart position */
+  if (restart > 0 && !bin) {
+    closeFile(h);
+    sendCtrlMsg(h, "554 Restart only possible in binary mode (TYPE I)");
+    return true;
+  } else if (restart > 0 && h->f->recfm == 'F') {
+    if (restart > h->f->remaining * h->f->lrecl) {
+      closeFile(h);
+      sendCtrlMsg(h, "554 Restart position beyond end of file");
+      return true;
+    }
+    recSeek(h->f, (restart / h->f->lrecl) + 1);
+    restart %= h->f->lrecl;
+  }
+ 
   /* get the target socket */
   sendCtrlMsg(h, "150 Opening data connection");
   SOCKET trgSock = openDataConnection(h);
-  if (trgSock < 0) { return true; }
- 
-  /* transfer the file content */
-  trfBinary = bin;
-  transmitBegin();
-  bool eof;
-  int len = readRecord(h, &eof);
-  while(!eof) {
-    if (trfBinary) {
-      transmitUnit(trgSock, io_buffer, len);
-    } else {
-      transmitAsciiLine(trgSock, io_buffer);
-    }
-    len = readRecord(h, &eof);
+  if (trgSock < 0) {
+    closeFile(h);
+    return true;
   }
-  transmitEnd(trgSock);
  
-  /* close the file and the target socket */
-  closeFile();
-  sendCtrlMsg(h, "226 Closing data connection");
-  closesocket(trgSock);
+  /* start the transfer, which is continued by the main select loop */
+  ncs_uint nonBlocking = 1;
+  ioctlsocket(trgSock, FIONBIO, &nonBlocking);
+  ncs_int sndBuf = TRF_SNDBUF;
+  setsockopt(trgSock, SOL_SOCKET, SO_SNDBUF, (ncs_char*)&sndBuf, sizeof(sndBuf));
+  h->dataSocket = trgSock;
+  h->trfState = TRF_RETR;
+  h->trfBinary = bin;
+  h->trfEof = false;
+  h->trfHead = 0;
+  h->trfFilled = 0;
+  h->trfSent = 0;
+  h->pendLen = 0;
+  h->trfSkip = restart;
+  startStats(h);
+  watchSocket(trgSock, writeSocks);
+  retrStep(h);
+ 
+  /* successfully started */
+  return false;
+}
+ 
+/* check if the STOR of the file 'fn ft fm' can restart at byte offset
+** 'restart', getting the RECFM and LRECL of the file, the record number
+** where writing restarts and the bytes of this record before the restart
+** position in 'part' (with at least 256 bytes)
+** returns true if not possible (the message is already sent to the client)
+*/
+static bool getStorRestart(
+    H h,
+    char *fn, char *ft, char *fm,
+    int restart,
+    char *recfm, int *lrecl,
+    int *restartRecord,
+    char *part) {
+  char fid[20];
+  CMSFILEINFO *fInfo;
+  RECFILE rf;
  
-  /* successfully done */
+  buildFid(fid, fn, ft, fm);
+  if (CMSfileState(fid, &fInfo) != 0) {
+    sendCtrlMsg(h, "554 Restart not possible (file not found)");
+    return true;
+  }
+  if (fInfo->recordFormat != 'F' || fInfo->lrecl > 255) {
+    sendCtrlMsg(h, "554 Restart only possible for RECFM F with LRECL <= 255");
+    return true;
+  }
+  *recfm = 'F';
+  *lrecl = fInfo->lrecl;
+  if (restart > fInfo->recordCount * fInfo->lrecl) {
+    sendCtrlMsg(h, "554 Restart position beyond end of file");
+    return true;
+  }
+  *restartRecord = (restart / *lrecl) + 1;
+  if ((restart % *lrecl) == 0) { return false; }
+ 
+  /* get the start of the record partially transferred */
+  int len = 0;
+  int rc = recOpen(&rf, fid, true, ' ', 0, false, *lrecl);
+  if (rc == 0) { rc = recSeek(&rf, *restartRecord); }
+  if (rc == 0) { rc = recRead(&rf, part, &len); }
+  recClose(&rf);
+  if (rc != 0) {
+    sendCtrlMsg(h, "554 Restart not possible (error reading file)");
+    return true;
+  }
   return false;
 }
  
-/* implementation for the file transfer client => server (STOR, APPE)
+/* implementation for the file transfer client => server (STOR, APPE), with
+** STOR restarting at byte offset 'restart' of the file (binary mode only)
 ** returns true is failed (the message is alredy sent to the client)
 */
-static bool cmdSTOR(H h, char *param, bool doAppend) {
+static bool cmdSTOR(H h, char *param, bool doAppend, int restart) {
   char fn[9];
   char ft[9];
   char fm[2];
@@ -1062,79 +1833,62 @@ static bool cmdSTOR(H h, char *param, bool doAppend) {
     sendCtrlMsg(h, "553 Permission denied (disk read-only)");
     return true;
   }
-  if (f_exists(fn, ft, fm) && !doAppend && !autoOverwrite && !repl) {
+ 
+  /* a restarted STOR replaces the records from the restart position on,
+  ** the records beyond the end of the upload are dropped when it is done */
+  int restartRecord = 0;
+  int partLen = 0;
+  char part[256];
+  if (restart > 0 && !doAppend) {
+    if (!bin) {
+      sendCtrlMsg(h, "554 Restart only possible in binary mode (TYPE I)");
+      return true;
+    }
+    if (getStorRestart(
+          h, fn, ft, fm, restart, &recfm, &lrecl, &restartRecord, part)) {
+      return true;
+    }
+    partLen = restart % lrecl;
+  }
+ 
+  if (restartRecord == 0
+      && f_exists(fn, ft, fm) && !doAppend && !autoOverwrite && !repl) {
     sendCtrlMsg(h, "553 Permission denied (file exists)");
     return true;
   }
  
-  /* open the file to write */
-  int rc = openFile(h, fn, ft, fm, false, recfm, lrecl, doAppend);
+  /* open the file to write, the disk content changes from now on */
+  dropListing(diskIdx);
+  bool keepRecords = doAppend || restartRecord > 0;
+  int rc = openFile(h, fn, ft, fm, false, recfm, lrecl, keepRecords);
   if (rc != 0) { return true; }
+  if (restartRecord > 0) {
+    recSeek(h->f, restartRecord); /* nothing written yet => cannot fail */
+    memcpy(h->ioBuffer, part, partLen);
+  }
  
-  /* get the target socket */
+  /* get the source socket */
   sendCtrlMsg(h, "150 Opening data connection");
-  trfSocket = openDataConnection(h);
-  if (trfSocket < 0) { return true; }
- 
-  /* receive the file content */
-  int recsWritten = 0;
-  int recFilled = 0;
-  trfBinary = bin;
-  bufUsed = recv(trfSocket, bufData, PACKETLEN, 0);
-  while (bufUsed > 0) {
-    char *p = bufData;
-    char *bound = &bufData[bufUsed];
-    if (trfBinary) {
-      while (p < bound) {
-        io_buffer[recFilled] = *p++;
-        recFilled++;
-        if (recFilled >= lrecl) {
-          writeRecord(h, recFilled, recfm, lrecl);
-          recsWritten++;
-          recFilled = 0;
-        }
-      }
-    } else {
-      while (p < bound) {
-        char c = *p++;
-        if (c == (char)0x0A) {
-          /* end of line (LF) => write record */
-          nicofclt_ascii2ebcdic(io_buffer, recFilled, io_buffer);
-          writeRecord(h, recFilled, recfm, lrecl);
-          recsWritten++;
-          recFilled = 0;
-        } else if (c != (char)0x0D) { /* ignore CR */
-          io_buffer[recFilled] = c;
-          recFilled++;
-          if (recFilled >= lrecl) {
-            nicofclt_ascii2ebcdic(io_buffer, recFilled, io_buffer);
-            writeRecord(h, recFilled, recfm, lrecl);
-            recsWritten++;
-            recFilled = 0;
-          }
-        }
-      }
-    }
-    bufUsed = recv(trfSocket, bufData, PACKETLEN, 0);
-  }
-  if (recFilled > 0) {
-    if (!trfBinary) {
-      nicofclt_ascii2ebcdic(io_buffer, recFilled, io_buffer);
-    }
-    writeRecord(h, recFilled, recfm, lrecl);
-    recsWritten++;
-  }
-  if (recsWritten == 0 && !doAppend) {
-    /* ensure the file exists */
-    writeRecord(h, 0, recfm, lrecl);
+  SOCKET srcSock = openDataConnection(h);
+  if (srcSock < 0) {
+    closeFile(h);
+    return true;
   }
  
-  /* close the file and the target socket */
-  closeFile();
-  sendCtrlMsg(h, "226 Closing data connection");
-  closesocket(trfSocket);
- 
-  /* successfully done */
+  /* start the transfer, the data packets are processed by the main loop */
+  h->dataSocket = srcSock;
+  h->trfState = TRF_STOR;
+  h->trfBinary = bin;
+  h->recfm = recfm;
+  h->lrecl = lrecl;
+  h->doAppend = keepRecords;
+  h->recFilled = partLen;
+  h->recsWritten = 0;
+  h->restartRecord = restartRecord;
+  startStats(h);
+  watchSocket(srcSock, clientSocks);
+ 
+  /* successfully started */
   return false;
 }
  
@@ -1151,8 +1905,6 @@ static bool listRootDir(SOCKET trg, char* pattern, bool longFormat) {
   char line[90];
   int i;
  
-  transmitBegin();
- 
   if (pattern) {
     int patLen = strlen(pattern);
     if (patLen > 1) { pat = ' '; }
@@ -1174,11 +1926,51 @@ static bool listRootDir(SOCKET trg, char* pattern, bool longFormat) {
     if (transmitAsciiLine(trg, line)) { return true; }
   }
  
-  transmitEnd(trg);
- 
   return false; /* no error */
 }
  
+/* target of the file enumeration callbacks: while 'listToCache' is true,
+** the lines are appended to the packets starting at 'listFirst' instead of
+** being sent via 'trfSocket'
+*/
+static bool listToCache = false;
+static bool listNoMem = false;
+static ListPacket *listFirst = NULL;
+static ListPacket *listLast = NULL;
+ 
+/* send a listing line or append it to the listing being cached
+*/
+static void emitListLine(char *outline) {
+  if (!listToCache) {
+    transmitAsciiLine(trfSocket, outline);
+    return;
+  }
+  int len = strlen(outline);
+  nicofclt_ebcdic2ascii(outline, len, outline);
+  outline[len++] = (char)0x0D;
+  outline[len++] = (char)0x0A;
+  char *p = outline;
+  while (len > 0 && !listNoMem) {
+    if (!listLast || listLast->len >= DATAPACKETLEN) {
+      ListPacket *pkt = (ListPacket*)malloc(sizeof(ListPacket));
+      if (!pkt) {
+        listNoMem = true;
+        return;
+      }
+      pkt->next = NULL;
+      pkt->len = 0;
+      if (listLast) { listLast->next = pkt; } else { listFirst = pkt; }
+      listLast = pkt;
+    }
+    int chunk = DATAPACKETLEN - listLast->len;
+    if (chunk > len) { chunk = len; }
+    memcpy(&listLast->data[listLast->len], p, chunk);
+    listLast->len += chunk;
+    p += chunk;
+    len -= chunk;
+  }
+}
+ 
 /* callback for minidisk enumeration to create a long format (LIST) line
 ** for a single file, extracting the fileid components, timestamp and size
 ** information for reformatting to a 'ls -l' like format.
@@ -1234,7 +2026,7 @@ static void filelistLongCB(char *line, void *cbdata) {
   strcat(outline, ".");
   memcpy(&outline[strlen(outline)], ft, getLen(ft));
   s_lower(outline, outline);
-  transmitAsciiLine(trfSocket, outline);
+  emitListLine(outline);
 }
  
 /* callback for minidisk enumeration to create a short format (LIST) line
@@ -1250,7 +2042,87 @@ static void filelistShortCB(char *line, void *cbdata) {
   strcat(outline, ".");
   memcpy(&outline[strlen(outline)], ft, getLen(ft));
   s_lower(outline, outline);
-  transmitAsciiLine(trfSocket, outline);
+  emitListLine(outline);
+}
+ 
+/* enumerate the files of the disk 'diskIdx' matching the patterns, passing
+** the lines in the NLST (short) or LIST (long) format to emitListLine()
+*/
+static void enumerateFiles(
+    int diskIdx,
+    char *fnPat,
+    char *ftPat,
+    bool longFormat) {
+  char fmPat[2];
+  fmPat[0] = disks[diskIdx].letter;
+  fmPat[1] = '\0';
+  if (useCmsCommands) {
+    char line[133];
+    /* drain stack (remove any user input present, like TERMINATE) */
+    while(CMSstackQuery()) { CMSconsoleRead(line); }
+    /* execute command */
+    char cmd[80];
+    sprintf(cmd,
+        CMS_LIST_FILES_CMD,
+        fnPat, ftPat, fmPat);
+    int rc = CMScommand(cmd, CMS_FUNCTION);
+    /* get and process the lines stacked */
+    if (CMSstackQuery()) { CMSconsoleRead(line); } /* skip header */
+    while(CMSstackQuery()) {
+      int len = CMSconsoleRead(line);
+      line[len] = '\0';
+      if (longFormat) {
+        filelistLongCB(line, (void*)diskIdx);
+      } else {
+        filelistShortCB(line, (void*)diskIdx);
+      }
+    }
+  } else {
+    getFileList(
+      (longFormat) ? &filelistLongCB : &filelistShortCB,
+      (void*)diskIdx,
+      fnPat,
+      ftPat,
+      fmPat);
+  }
+}
+ 
+/* get the cached listing of all files of the disk 'diskIdx' in the short
+** or long format, enumerating the files if the listing is not yet cached
+** rc : the listing or NULL if not enough memory to cache the listing
+**      (an empty disk has a valid listing with no packets, so the validity
+**      must be checked with 'disks[diskIdx].listValid[]')
+*/
+static ListPacket* getListing(int diskIdx, bool longFormat) {
+  int fmt = (longFormat) ? 1 : 0;
+  _dblw now = usecs();
+  if (disks[diskIdx].listValid[fmt]
+      && now - disks[diskIdx].listTime[fmt] < (_dblw)LIST_MAXAGE * 1000000) {
+    return disks[diskIdx].listing[fmt];
+  }
+  if (disks[diskIdx].listValid[fmt]) { /* too old => enumerate again */
+    freeListing(disks[diskIdx].listing[fmt]);
+    disks[diskIdx].listing[fmt] = NULL;
+    disks[diskIdx].listValid[fmt] = false;
+  }
+ 
+  listToCache = true;
+  listNoMem = false;
+  listFirst = NULL;
+  listLast = NULL;
+  char fnPat[2] = { '*', '\0' };
+  char ftPat[2] = { '*', '\0' };
+  enumerateFiles(diskIdx, fnPat, ftPat, longFormat);
+  listToCache = false;
+ 
+  if (listNoMem) {
+    freeListing(listFirst);
+    return NULL;
+  }
+  disks[diskIdx].listing[fmt] = listFirst;
+  disks[diskIdx].listValid[fmt] = true;
+  disks[diskIdx].listTime[fmt] = now;
+  return listFirst;
 }
  
 /* enumerate CMS files based on the 'param'-spec, either in the NSLT (short)
@@ -1270,6 +2142,7 @@ static bool cmdList(H h, char *param, bool longFormat, bool useCtlSocket) {
   bool repl;
   bool bin;
   bool listRoot = false;
+  bool wholeDisk = false;
  
   /* get the enumeration parameters */
   if (!param || !*param) {
@@ -1278,6 +2151,7 @@ static bool cmdList(H h, char *param, bool longFormat, bool useCtlSocket) {
       listRoot = true;
     } else {
       diskIdx = h->currDisk;
+      wholeDisk = true;
       strcpy(fnPat, "*");
       strcpy(ftPat, "*");
     }
@@ -1290,6 +2164,7 @@ static bool cmdList(H h, char *param, bool longFormat, bool useCtlSocket) {
       } else {
         /* list a root directory => content of this minidisk */
         listRoot = false;
+        wholeDisk = true;
         strcpy(fnPat, "*");
         strcpy(ftPat, "*");
       }
@@ -1321,47 +2196,30 @@ static bool cmdList(H h, char *param, bool longFormat, bool useCtlSocket) {
   /* transfer the enumeration data */
   bool result;
   char fmPat[2] = { 'A', '\0' };
-  transmitBegin();
+  transmitBegin(trfSocket);
   if (listRoot) {
     fmPat[0] = '*'; /*rootPattern;*/
     result = listRootDir(trfSocket, fmPat, longFormat);
   } else {
-    fmPat[0] = disks[diskIdx].letter;
-    if (useCmsCommands) {
-      char line[133];
-      /* drain stack (remove any user input present, like TERMINATE) */
-      while(CMSstackQuery()) { CMSconsoleRead(line); }
-      /* execute command */
-      char cmd[80];
-      sprintf(cmd,
-          CMS_LIST_FILES_CMD,
-          fnPat, ftPat, fmPat);
-      int rc = CMScommand(cmd, CMS_FUNCTION);
-      /* get and process the lines stacked */
-      if (CMSstackQuery()) { CMSconsoleRead(line); } /* skip header */
-      while(CMSstackQuery()) {
-        int len = CMSconsoleRead(line);
-        line[len] = '\0';
-        if (longFormat) {
-          filelistLongCB(line, (void*)diskIdx);
-        } else {
-          filelistShortCB(line, (void*)diskIdx);
-        }
+    /* whole disks are listed from the cache, built if not yet present */
+    bool sent = false;
+    if (wholeDisk) {
+      checkDiskChanges();
+      ListPacket *listing = getListing(diskIdx, longFormat);
+      if (listing || disks[diskIdx].listValid[(longFormat) ? 1 : 0]) {
+        transmitListing(trfSocket, listing);
+        sent = true;
       }
-    } else {
-      getFileList(
-        (longFormat) ? &filelistLongCB : &filelistShortCB,
-        (void*)diskIdx,
-        fnPat,
-        ftPat,
-        fmPat);
     }
+    if (!sent) { enumerateFiles(diskIdx, fnPat, ftPat, longFormat); }
     result = false;
   }
-  transmitEnd(trfSocket);
- 
-  /* done */
-  sendCtrlMsg(h, "226 Closing data connection");
+  if (transmitEnd(trfSocket)) {
+    sendCtrlMsg(h, "426 Connection closed; transfer aborted");
+    result = true;
+  } else {
+    sendCtrlMsg(h, "226 Closing data connection");
+  }
   if (!useCtlSocket) { closesocket(trfSocket); }
   trfSocket = -1;
   return result;
@@ -1606,6 +2464,7 @@ static bool cmdRNTO(H h, char *param) {
   if (checkInvalidFid(h, toFid)) { return true; }
   int rc = CMSfileRename(h->renameFromFid, toFid);
   if (rc == 0) {
+    dropListing(diskIdx);
     sendCtrlMsg(h, "250 RNTO command successful");
     return false;
   } else {
@@ -1652,6 +2511,7 @@ static bool cmdDELE(H h, char *param) {
  
   int rc = CMSfileErase(fid);
   if (rc == 0) {
+    dropListing(diskIdx);
     sendCtrlMsg(h, "250 DELE command successful");
     return false;
   } else {
@@ -1660,6 +2520,161 @@ static bool cmdDELE(H h, char *param) {
   }
 }
  
+/* implementation of the SITE command, with the only subcommand STATS
+** sending the statistics of all transfers since the start of CMSFTPD
+*/
+static bool cmdSITE(H h, char *param) {
+  if (!param || sncmp(param, "STATS")) {
+    sendCtrlMsg(h, "504 SITE command not implemented for that parameter");
+    return true;
+  }
+  char msg[80];
+  sprintf(msg, "211-%u transfers completed, %u aborted",
+    totalStats.transfers, totalStats.failed);
+  sendCtrlMsg(h, msg);
+  sendStats(h, "211", &totalStats);
+  sendCtrlMsg(h, "211 End");
+  return false;
+}
+ 
+/* set the restart position for the next RETR or STOR (REST)
+*/
+static bool cmdREST(H h, char *param) {
+  char msg[80];
+  char *p = param;
+  int pos = 0;
+ 
+  if (!p || !*p) { p = "?"; }
+  while (*p >= '0' && *p <= '9' && pos < 100000000) {
+    pos = (pos * 10) + (*p++ - '0');
+  }
+  if (*p) {
+    sendCtrlMsg(h, "501 Syntax error in REST command (byte offset expected)");
+    return true;
+  }
+ 
+  h->restartPos = pos;
+  sprintf(msg, "350 Restarting at %d, send RETR or STOR to transfer", pos);
+  sendCtrlMsg(h, msg);
+  return false;
+}
+ 
+/* get the CMS state of the file specified by 'param' for SIZE or MDTM,
+** building the fid of the file in 'fid'
+** rc : the file info or NULL if not possible (the message is already sent)
+*/
+static CMSFILEINFO* getFileInfo(H h, char *param, char *fid, bool *binary) {
+  int diskIdx;
+  char fn[9];
+  char ft[9];
+  char fm[2];
+  char recfm;
+  int lrecl;
+  bool repl;
+  CMSFILEINFO *fInfo;
+ 
+  if (!param || !*param) {
+    sendCtrlMsg(h, "501 Syntax error (no parameters)");
+    return NULL;
+  }
+  if (!parseFullPath(
+         h, param, &diskIdx, fn, ft, &recfm, &lrecl, &repl, binary)) {
+    return NULL;
+  }
+  fm[0] = disks[diskIdx].letter;
+  fm[1] = '\0';
+  buildFid(fid, fn, ft, fm);
+  int rc = CMSfileState(fid, &fInfo);
+  if (rc == 28) {
+    sendCtrlMsg(h, "550 File not found");
+    return NULL;
+  } else if (rc != 0) {
+    char msg[80];
+    sprintf(msg, "550 Error accessing file (RC = %d)", rc);
+    sendCtrlMsg(h, msg);
+    return NULL;
+  }
+  return fInfo;
+}
+ 
+/* get the transfer size of a file in binary mode (SIZE), reading the
+** record lengths of a RECFM V file
+*/
+static bool cmdSIZE(H h, char *param) {
+  char fid[20];
+  char msg[80];
+  bool bin;
+  RECFILE rf;
+ 
+  CMSFILEINFO *fInfo = getFileInfo(h, param, fid, &bin);
+  if (!fInfo) { return true; }
+  if (!bin) {
+    sendCtrlMsg(h, "550 SIZE only available in binary mode (TYPE I)");
+    return true;
+  }
+ 
+  int size = 0;
+  int rc = 0;
+  if (fInfo->recordFormat == 'F') {
+    size = fInfo->recordCount * fInfo->lrecl;
+  } else if (fInfo->lrecl > 255) {
+    rc = 4;
+  } else {
+    char rec[256];
+    int len;
+    rc = recOpen(&rf, fid, true, ' ', 0, false, blockSize);
+    if (rc == 0) {
+      while ((rc = recRead(&rf, rec, &len)) == 0) { size += len; }
+      recClose(&rf);
+      if (rc == 12) { rc = 0; }
+    }
+  }
+  if (rc != 0) {
+    sprintf(msg, "550 Cannot compute file size (RC = %d)", rc);
+    sendCtrlMsg(h, msg);
+    return true;
+  }
+ 
+  sprintf(msg, "213 %d", size);
+  sendCtrlMsg(h, msg);
+  return false;
+}
+ 
+/* get the value of the 2 decimal digits packed in the byte 'b' */
+static int packedDigits(unsigned int b) {
+  return (((b >> 4) & 0x0F) * 10) + (b & 0x0F);
+}
+ 
+/* get the last modification time of a file (MDTM) from the file status,
+** which has the date as packed MMDD, the time as packed HHMM and the year
+** as 2 EBCDIC or packed digits
+*/
+static bool cmdMDTM(H h, char *param) {
+  char fid[20];
+  char msg[80];
+  bool bin;
+ 
+  CMSFILEINFO *fInfo = getFileInfo(h, param, fid, &bin);
+  if (!fInfo) { return true; }
+ 
+  unsigned int fstDate = (unsigned short)fInfo->filedate;
+  unsigned int fstTime = (unsigned short)fInfo->filetime;
+  unsigned int fstYear = (unsigned short)fInfo->fileYear;
+  int year = ((fstYear & 0xF0F0) == 0xF0F0)
+           ? (((fstYear >> 8) & 0x0F) * 10) + (fstYear & 0x0F)
+           : packedDigits(fstYear & 0xFF);
+  sprintf(msg,
+    "213 %s%02d%02d%02d%02d%02d00",
+    (year < 60) ? "20" : "19",
+    year,
+    packedDigits(fstDate >> 8),
+    packedDigits(fstDate & 0xFF),
+    packedDigits(fstTime >> 8),
+    packedDigits(fstTime & 0xFF));
+  sendCtrlMsg(h, msg);
+  return false;
+}
+ 
 /*
 ** main FTP interpreter
 */
@@ -1701,11 +2716,11 @@ static void splitCtlLine(char *s, char **cmd, char **param) {
   *param = paramStart;
 }
  
-/* wait for the socket to show activity or for the user to have entered
+/* wait for the sockets to show activity or for the user to have entered
 ** the 'terminate' command (user input is checked at 1 second intervals)
 ** returns 'true' if the user entered the 'terminate' command
 */
-static bool waitForSocket(fd_set *activeSet) {
+static bool waitForSocket(fd_set *activeSet, fd_set *activeWrSet) {
   char consoleBuffer[133];
   struct timeval tv;
  
@@ -1713,8 +2728,8 @@ static bool waitForSocket(fd_set *activeSet) {
   tv.tv_usec = 0;
   int count = selectX(
                  lastSockPlus1,
-                 clientSocks, NULL, NULL,
-                 activeSet, NULL, NULL,
+                 clientSocks, writeSocks, NULL,
+                 activeSet, activeWrSet, NULL,
                  &tv);
   while (count == 0) {
     while(CMSstackQuery()) {
@@ -1728,8 +2743,8 @@ static bool waitForSocket(fd_set *activeSet) {
     }
     count = selectX(
                  lastSockPlus1,
-                 clientSocks, NULL, NULL,
-                 activeSet, NULL, NULL,
+                 clientSocks, writeSocks, NULL,
+                 activeSet, activeWrSet, NULL,
                  &tv);
   }
   return (count < 0);
@@ -1784,6 +2799,8 @@ static char* usage(char *pname) {
   printf(" -override       -> use filetype dep. defaults instead of V80\n");
   printf(" -ignoredashargs -> ignore 1. param to FTP cmds starting with -\n");
   printf(" -usecmscmds     -> use LISTFILE and Q DISK instead of builtins\n");
+  printf(" -block <bytes>  -> bytes read/written per CMS call (%d)\n",
+    RECIO_DEFAULT_BLOCKSIZE);
   printf(" -v              -> print commands and responses on console\n");
   printf("(enter TERMINATE to stop CMSFTPD while waiting for the client\n");
   printf("connection or for a FTP command from the client)\n");
@@ -1824,6 +2841,10 @@ static bool processSingleCmd(
   /* no command? (~ empty line) => implicitely done */
   if (!cmd) { return true; }
  
+  /* a restart position only applies to the command following the REST */
+  int restart = h->restartPos;
+  h->restartPos = 0;
+ 
   _select(cmd);
  
     _when("USER")
@@ -1856,6 +2877,13 @@ static bool processSingleCmd(
     _when("SYST")
       sendCtrlMsg(h, "215 VM/370 CMSFTPD V0.1");
  
+    _when("FEAT")
+      sendCtrlMsg(h, "211-Features:");
+      sendCtrlMsg(h, " MDTM");
+      sendCtrlMsg(h, " REST STREAM");
+      sendCtrlMsg(h, " SIZE");
+      sendCtrlMsg(h, "211 End");
+ 
     _when("PORT")
       cmdPORT(h, param);
  
@@ -1879,28 +2907,48 @@ static bool processSingleCmd(
  
     _when("LIST")
       param = skipSpuriousOptions(param);
-      cmdList(h, param, true, false);
+      if (!transferBusy(h)) { cmdList(h, param, true, false); }
  
     _when("NLST")
       param = skipSpuriousOptions(param);
-      cmdList(h, param, false, false);
+      if (!transferBusy(h)) { cmdList(h, param, false, false); }
  
     _when("STAT")
       param = skipSpuriousOptions(param);
       cmdList(h, param, true, true);
  
     _when("RETR")
-      cmdRETR(h, param);
+      if (!transferBusy(h)) { cmdRETR(h, param, restart); }
  
     _when("STOR")
-      cmdSTOR(h, param, false);
+      if (!transferBusy(h)) { cmdSTOR(h, param, false, restart); }
  
     _when("APPE")
-      cmdSTOR(h, param, true);
+      if (!transferBusy(h)) { cmdSTOR(h, param, true, 0); }
+ 
+    _when("ABOR")
+      if (h->trfState != TRF_NONE) {
+        endTransfer(h, "426 Transfer aborted");
+        sendCtrlMsg(h, "226 ABOR command successful");
+      } else {
+        sendCtrlMsg(h, "225 ABOR command successful");
+      }
+ 
+    _when("REST")
+      cmdREST(h, param);
+ 
+    _when("SIZE")
+      cmdSIZE(h, param);
+ 
+    _when("MDTM")
+      cmdMDTM(h, param);
  
     _when("TYPE")
       cmdTYPE(h, param);
  
+    _when("SITE")
+      cmdSITE(h, param);
+ 
     _when("DELE")
       cmdDELE(h, param);
  
@@ -1968,6 +3016,12 @@ int main(int argc, char **argv) {
       ignoreDashArgs = true;
     } else if (_is("-usecmscmds")) {
       useCmsCommands = true;
+    } else if (_is("-block")) {
+      blockSize = atoi(_getvalue());
+      if (blockSize < 1 || blockSize > RECIO_MAX_BLOCKSIZE) {
+        printf("** invalid block size specified\n");
+        return 4;
+      }
     } else {
       usage(argv[0]);
     }
@@ -2050,7 +3104,8 @@ int main(int argc, char **argv) {
  
   /* wait for client to connect and send commands */
   fd_set activeSet;
-  bool done = waitForSocket(&activeSet);
+  fd_set activeWrSet;
+  bool done = waitForSocket(&activeSet, &activeWrSet);
   while (!done) {
     if (FD_ISSET(srvSocket, &activeSet)) {
       struct sockaddr clientAddr;
@@ -2078,21 +3133,28 @@ int main(int argc, char **argv) {
  
     H h = sessions;
     while (h) {
+      H next = h->next;
+ 
+      /* advance the file transfer of the session by one data packet */
+      if (h->trfState == TRF_RETR && FD_ISSET(h->dataSocket, &activeWrSet)) {
+        retrStep(h);
+      } else if (h->trfState == TRF_STOR
+                 && FD_ISSET(h->dataSocket, &activeSet)) {
+        storStep(h);
+      }
+ 
+      /* process a command on the control connection */
       if (FD_ISSET(h->ctlSocket, &activeSet)) {
         bool doneWithSession = processSingleCmd(h, reqUser, reqPwd);
         if (doneWithSession) {
-          SOCKET sock = h->ctlSocket;
-          h = h->next;
-          done |= dropClientSock(sock);
-        } else {
-          h = h->next;
+          done |= dropClientSock(h->ctlSocket);
         }
-      } else {
-        h = h->next;
       }
+ 
+      h = next;
     }
  
-    if (!done) { done = waitForSocket(&activeSet); }
+    if (!done) { done = waitForSocket(&activeSet, &activeWrSet); }
   }
  
   /* done */
@@ -0,0 +1,196 @@
+/*
+** CMSRECIO.C  - blocked record I/O for CMS files
+**
+** This file is part of NICOF (Non-Invasive COmmunication Facility)
+** for VM/370 R6 "SixPack".
+**
+** Implementation of the blocked record I/O (see CMSRECIO.H).
+**
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+ 
+#include "cmsrecio.h"
+ 
+#include <stdlib.h>
+#include <string.h>
+ 
+unsigned int recioCalls = 0;
+ 
+/* (re)open the file for transferring 'recs' records per CMS call, starting
+   with record 'firstRecord'.
+   CMS fixes the number of records per FSREAD/FSWRITE when opening the file,
+   so a partial block at the file end requires to reopen the file.
+*/
+static int openBlock(RECFILE *rf, int recs, int firstRecord) {
+  if (rf->isOpen) {
+    CMSfileClose(&rf->cmsfile);
+    rf->isOpen = false;
+  }
+  int rc = CMSfileOpen(
+             rf->fid,
+             rf->block,
+             (rf->recfm == 'F') ? recs * rf->lrecl : rf->lrecl,
+             rf->recfm,
+             recs,        /* number of lines read/written per operation */
+             firstRecord, /* first line to read/write */
+             &rf->cmsfile);
+  if (rc != 0 && rc != 28) { return rc; }
+  rf->isOpen = true;
+  rf->callRecs = recs;
+  rf->recordNum = firstRecord;
+  return 0;
+}
+ 
+/* write the records in the block buffer with one FSWRITE */
+static int flushBlock(RECFILE *rf) {
+  if (rf->blockCount == 0) { return 0; }
+  if (rf->blockCount != rf->callRecs) {
+    int rc = openBlock(rf, rf->blockCount, rf->nextRecord);
+    if (rc != 0) { return rc; }
+  }
+  int rc = CMSfileWrite(&rf->cmsfile, rf->recordNum, rf->blockLen);
+  rf->recordNum = 0;
+  rf->calls++;
+  recioCalls++;
+  rf->nextRecord += rf->blockCount;
+  rf->blockLen = 0;
+  rf->blockCount = 0;
+  return rc;
+}
+ 
+int recOpen(
+    RECFILE *rf,
+    char *fid,
+    bool forRead,
+    char recfm,
+    int lrecl,
+    bool append,
+    int blockSize) {
+  memset(rf, '\0', sizeof(RECFILE));
+  memcpy(rf->fid, fid, 18);
+  rf->forRead = forRead;
+ 
+  CMSFILEINFO *fInfo;
+  int rc = CMSfileState(rf->fid, &fInfo);
+  if (forRead) {
+    if (rc != 0) { return rc; }
+    recfm = fInfo->recordFormat;
+    lrecl = fInfo->lrecl;
+    rf->remaining = fInfo->recordCount;
+    rf->nextRecord = 1;
+  } else {
+    rf->nextRecord = (append && rc == 0) ? fInfo->recordCount + 1 : 1;
+  }
+  rf->recfm = recfm;
+  rf->lrecl = (lrecl < 1) ? 1 : lrecl;
+ 
+  if (blockSize > RECIO_MAX_BLOCKSIZE) { blockSize = RECIO_MAX_BLOCKSIZE; }
+  rf->blockRecs = (rf->recfm == 'F') ? blockSize / rf->lrecl : 1;
+  if (rf->blockRecs < 1) { rf->blockRecs = 1; }
+  rf->block = (char*)malloc(rf->blockRecs * rf->lrecl + 1);
+  if (!rf->block) { return RECIO_NOMEM; }
+ 
+  int recs = rf->blockRecs;
+  if (forRead && rf->remaining < recs) {
+    recs = (rf->remaining > 0) ? rf->remaining : 1;
+  }
+  rc = openBlock(rf, recs, rf->nextRecord);
+  if (rc != 0) {
+    free(rf->block);
+    rf->block = NULL;
+  }
+  return rc;
+}
+ 
+int recRead(RECFILE *rf, char *rec, int *len) {
+  *len = 0;
+  if (rf->blockPos >= rf->blockLen) {
+    /* block consumed => read the next block, reopening for the last one */
+    if (rf->remaining <= 0) { return 12; }
+    if (rf->remaining < rf->callRecs) {
+      int rc = openBlock(rf, rf->remaining, rf->nextRecord);
+      if (rc != 0) { return rc; }
+    }
+    int recs = rf->callRecs;
+    int blockLen = 0;
+    int rc = CMSfileRead(&rf->cmsfile, rf->recordNum, &blockLen);
+    rf->recordNum = 0;
+    rf->calls++;
+    recioCalls++;
+    if (rc != 0) { return rc; }
+    rf->blockLen = blockLen;
+    rf->blockPos = 0;
+    rf->remaining -= recs;
+    rf->nextRecord += recs;
+  }
+ 
+  int recLen = (rf->recfm == 'F') ? rf->lrecl : rf->blockLen;
+  if (recLen > rf->blockLen - rf->blockPos) {
+    recLen = rf->blockLen - rf->blockPos;
+  }
+  memcpy(rec, &rf->block[rf->blockPos], recLen);
+  rf->blockPos += recLen;
+  *len = recLen;
+  return 0;
+}
+ 
+int recWrite(RECFILE *rf, char *rec, int len) {
+  if (len > rf->lrecl) { len = rf->lrecl; }
+  if (rf->recfm != 'F') {
+    /* variable records are written one by one */
+    memcpy(rf->block, rec, len);
+    int rc = CMSfileWrite(&rf->cmsfile, rf->recordNum, len);
+    rf->recordNum = 0;
+    rf->calls++;
+    recioCalls++;
+    rf->nextRecord++;
+    return rc;
+  }
+ 
+  memcpy(&rf->block[rf->blockLen], rec, len);
+  if (len < rf->lrecl) {
+    memset(&rf->block[rf->blockLen + len], '\0', rf->lrecl - len);
+  }
+  rf->blockLen += rf->lrecl;
+  rf->blockCount++;
+  if (rf->blockCount >= rf->callRecs) { return flushBlock(rf); }
+  return 0;
+}
+ 
+int recSeek(RECFILE *rf, int recordNum) {
+  if (recordNum < 1) { recordNum = 1; }
+  if (!rf->forRead) {
+    int rc = flushBlock(rf);
+    if (rc != 0) { return rc; }
+    rf->nextRecord = recordNum;
+    rf->recordNum = recordNum;
+    return 0;
+  }
+ 
+  /* drop the block buffer and read the next block at the new position */
+  int recordCount = rf->nextRecord - 1 + rf->remaining;
+  if (recordNum > recordCount + 1) { recordNum = recordCount + 1; }
+  rf->remaining = recordCount - (recordNum - 1);
+  rf->nextRecord = recordNum;
+  rf->recordNum = recordNum;
+  rf->blockLen = 0;
+  rf->blockPos = 0;
+  return 0;
+}
+ 
+int recClose(RECFILE *rf) {
+  int rc = 0;
+  if (rf->isOpen && !rf->forRead) { rc = flushBlock(rf); }
+  if (rf->isOpen) { CMSfileClose(&rf->cmsfile); }
+  rf->isOpen = false;
+  if (rf->block) { free(rf->block); }
+  rf->block = NULL;
+  return rc;
+}
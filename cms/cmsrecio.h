@@ -0,0 +1,130 @@
+/*
+** CMSRECIO.H  - blocked record I/O for CMS files
+**
+** This file is part of NICOF (Non-Invasive COmmunication Facility)
+** for VM/370 R6 "SixPack".
+**
+** This module reads and writes the records of a CMS file through a block
+** buffer, so that a single FSREAD resp. FSWRITE transfers as many records
+** as fit into the block instead of one record per call, saving the SVC and
+** the CMS file system overhead for all other records of the block.
+**
+** CMS can transfer several records with one call only for RECFM F files, so
+** the records of RECFM V files are still read and written one at a time
+** (but through the same interface).
+**
+** The functions return the CMS return codes of the underlying file system
+** calls, leaving it to the caller to report errors in the appropriate way.
+** As records of a F file are written when the block is full, an error
+** writing a record may be returned by a later recWrite() or by recClose().
+**
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+ 
+#ifndef __CMSRECIO_included
+#define __CMSRECIO_included
+ 
+#include "cmssys.h"
+ 
+#ifndef true
+typedef char bool;
+#define true ((bool)1)
+#define false ((bool)0)
+#endif
+ 
+/* default size of the block buffer in bytes */
+#define RECIO_DEFAULT_BLOCKSIZE 4096
+ 
+/* max. size of the block buffer in bytes */
+#define RECIO_MAX_BLOCKSIZE 32768
+ 
+/* the return code for "no memory for the block buffer" */
+#define RECIO_NOMEM 41
+ 
+/* the state of a CMS file opened for blocked record I/O */
+typedef struct _recfile {
+  char fid[19];       /* the file id as "fn(8)ft(8)fm(2)" */
+  CMSFILE cmsfile;    /* the CMS file control block */
+  bool isOpen;        /* is 'cmsfile' currently open? */
+  bool forRead;       /* opened for reading (else writing) */
+  char recfm;         /* RECFM of the file (F or V) */
+  int lrecl;          /* LRECL of the file */
+  int blockRecs;      /* max. records per FSREAD/FSWRITE */
+  int callRecs;       /* records per FSREAD/FSWRITE of current open */
+  char *block;        /* the block buffer (allocated with malloc) */
+  int blockLen;       /* bytes in the block buffer */
+  int blockPos;       /* read: position of the next record in the block */
+  int blockCount;     /* write: records in the block buffer */
+  int nextRecord;     /* record number of the next record to transfer */
+  int recordNum;      /* record number for the next CMS call (0 = next) */
+  int remaining;      /* read: records of the file not yet read */
+  unsigned int calls; /* number of FSREAD/FSWRITE calls done */
+  } RECFILE;
+ 
+/* total number of FSREAD/FSWRITE calls done for all files since the program
+** start.
+*/
+extern unsigned int recioCalls;
+ 
+/* Open the CMS file 'fid' (18 chars "fn(8)ft(8)fm(2)") for reading or
+** writing records through a block buffer of 'blockSize' bytes (at least one
+** record).
+** For reading, the RECFM and LRECL are taken from the file, 'recfm', 'lrecl'
+** and 'append' are ignored.
+** For writing, the file is created with 'recfm' and 'lrecl' if it does not
+** exist, new records are appended if 'append' is true, else the records are
+** written from the start of the file (an existing file should be erased
+** before).
+**
+** Returns 0 if successful or the CMS return code of the failed operation.
+*/
+extern int recOpen(
+    RECFILE *rf,
+    char *fid,
+    bool forRead,
+    char recfm,
+    int lrecl,
+    bool append,
+    int blockSize);
+ 
+/* Read the next record into 'rec' (with space for LRECL bytes), storing the
+** record length in 'len'.
+**
+** Returns 0 if successful, 12 at end of file or the CMS return code of the
+** failed FSREAD.
+*/
+extern int recRead(RECFILE *rf, char *rec, int *len);
+ 
+/* Write the record 'rec' with 'len' bytes, which must be LRECL for RECFM F.
+**
+** Returns 0 if successful or the CMS return code of the failed FSWRITE
+** (possibly for a record written before).
+*/
+extern int recWrite(RECFILE *rf, char *rec, int len);
+ 
+/* Position the file to the record 'recordNum' (1 = first record) for the
+** following recRead() resp. recWrite(), allowing to resume a transfer in
+** the middle of a file. When reading, a position beyond the last record is
+** the end of file. When writing, the records still in the block buffer are
+** written first and the following records replace the existing records
+** starting at 'recordNum'.
+**
+** Returns 0 if successful or the CMS return code of the failed FSWRITE.
+*/
+extern int recSeek(RECFILE *rf, int recordNum);
+ 
+/* Write the records still in the block buffer (if opened for writing), close
+** the file and release the block buffer.
+**
+** Returns 0 if successful or the CMS return code of the failed FSWRITE.
+*/
+extern int recClose(RECFILE *rf);
+ 
+#endif
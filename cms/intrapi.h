@@ -20,7 +20,7 @@
 **  - register a handling routine for interrupts from one or more devices
 **  - create/modify CCWs and perform SIOs for a device
 **
-**  - invoke selected DIAG functions (X'00' and X'08')
+**  - invoke selected DIAG functions (X'00', X'08' and X'0C')
 **
 ** All routines named __intrXX defined in the header file are implemented
 ** in the accompanying assembler module INTRAPI, where these routines are
@@ -79,6 +79,24 @@ extern void __intr00(char *outbuf, int buflen);
 extern void __intrff(char *cpcmd, int cpcmdlen);
  
  
+/* DIAG-x0C : Pseudo Timer
+   () <- diagx0c(outbuf)
+   (outbuf: 32 bytes, doubleword aligned, receiving date, time of day,
+    virtual and total CPU time in microseconds (2 x _dblw at offset 16))
+*/
+#define diagx0c(outbuf) __intr0c(outbuf)
+extern void __intr0c(char *outbuf);
+ 
+ 
+/* STCK : Store Clock (not a DIAG, but also a timer facility)
+   () <- stck(outbuf)
+   (outbuf: doubleword receiving the TOD clock, with bit 51 counting
+    microseconds, so (*outbuf >> 12) is the clock in microseconds)
+*/
+#define stck(outbuf) __intr0d(outbuf)
+extern void __intr0d(_dblw *outbuf);
+ 
+ 
 /*
 ** ***** Interrupt handling
 */
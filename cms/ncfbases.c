@@ -27,6 +27,85 @@
 #include "ncfbases.h"
 #include "ncfio.h"
  
+/* how does the platform where the outside proxy runs represent line ends ? */
+static int lineEndMode = -1; /* 0 = LF-CR ; 1 = LF ; 2 = CR ; 3 = CR-LF */
+ 
+/* the service table of the outside proxy, loaded once with the discover
+** command, so resolving service names needs no round trip
+*/
+#define SVCCACHE_MAX 32
+ 
+typedef struct _svccache_entry {
+  short svcId;
+  uint  nameLen;
+  char  name[SERVICENAME_MAXLEN]; /* ASCII, lowercase */
+  } SVCCACHE_ENTRY;
+ 
+static int svcCacheState = 0; /* 0 = not loaded ; 1 = loaded ; -1 = unavailable */
+static bool svcCacheComplete = false; /* all services of the proxy are cached */
+static int baseCapabilities = -1; /* -1 = unknown */
+static uint svcCacheCount = 0;
+static SVCCACHE_ENTRY svcCache[SVCCACHE_MAX];
+ 
+#define DISCOVER_TRUNCATED 0x0001
+ 
+/* load the service table and the environment information with a single
+** request to the base service (cmd 2), if the outside proxy supports it.
+*/
+static void ndiscover() {
+  if (svcCacheState != 0) { return; }
+ 
+  unsigned char buffer[2048];
+  int ctlWord = 0;
+  uint len = 0;
+  int rc = ncfbasesvc_invoke_sync(
+             0,         /* svcId : base services */
+             2,         /* svcCmd : discover */
+             0,         /* inCtlWord : ignored */
+             NULL,      /* inData : no data */
+             0,         /* inDataLen : no data */
+             &ctlWord,  /* outCtlWord : the env data */
+             buffer,    /* outData : the service table */
+             &len,      /* outDataLen : length of the service table */
+             DATA_BINARY); /* dataFlags : no translation */
+  if (rc != 0 || len < 6) {
+    svcCacheState = -1; /* older proxy: resolve each service separately */
+    return;
+  }
+ 
+  lineEndMode = (ctlWord & 0x00000300) >> 8;
+  baseCapabilities = (buffer[0] << 8) | buffer[1];
+  uint flags = (buffer[2] << 8) | buffer[3];
+  uint count = (buffer[4] << 8) | buffer[5];
+  svcCacheComplete = ((flags & DISCOVER_TRUNCATED) == 0);
+ 
+  uint pos = 6;
+  while (count-- > 0 && (pos + 3) <= len) {
+    uint nameLen = buffer[pos + 2];
+    if ((pos + 3 + nameLen) > len) { break; }
+    if (svcCacheCount >= SVCCACHE_MAX || nameLen > SERVICENAME_MAXLEN) {
+      svcCacheComplete = false;
+    } else {
+      SVCCACHE_ENTRY *e = &svcCache[svcCacheCount++];
+      e->svcId = (short)((buffer[pos] << 8) | buffer[pos + 1]);
+      e->nameLen = nameLen;
+      memcpy(e->name, &buffer[pos + 3], nameLen);
+    }
+    pos += 3 + nameLen;
+  }
+  svcCacheState = 1;
+}
+ 
+/*
+** caps <- ncfbasesvc_capabilities()
+**
+** get the capabilities of the base service on the external process
+*/
+int ncfb_002() {
+  ndiscover();
+  return baseCapabilities;
+}
+ 
 /*
 ** rc <- ncfbasesvc_resolve(serviceName, (out) serviceId)
 **
@@ -40,6 +119,26 @@ int ncfb_001(const char *serviceName, short *serviceId) {
  
   *serviceId = -1;
  
+  /* try to resolve the name locally from the service table */
+  ndiscover();
+  if (svcCacheState > 0) {
+    char lowerName[SERVICENAME_MAXLEN];
+    uint i;
+    for (i = 0; i < svcNameLen; i++) {
+      char c = svcNameAscii[i];
+      lowerName[i] = (c >= 0x41 && c <= 0x5A) ? c + 0x20 : c;
+    }
+    for (i = 0; i < svcCacheCount; i++) {
+      SVCCACHE_ENTRY *e = &svcCache[i];
+      if (e->nameLen == svcNameLen
+          && memcmp(e->name, lowerName, svcNameLen) == 0) {
+        *serviceId = e->svcId;
+        return 0;
+      }
+    }
+    if (svcCacheComplete) { return ERR_INVALID_SERVICE; }
+  }
+ 
   request_handle h = nicofclt_createRequest(0, 0); /* uw1: svc = 0, cmd = 0 */
   int dataRc = nicofclt_setRequestData(h, svcNameLen, svcNameAscii);
   if (dataRc != 0) {
@@ -74,6 +173,14 @@ int ncfb_001(const char *serviceName, short *serviceId) {
 #define CHAR_CR ((unsigned char)0x0D)
 #define CHAR_LF ((unsigned char)0x25)
  
+#define ASCII_CR ((unsigned char)0x0D)
+#define ASCII_LF ((unsigned char)0x0A)
+ 
+/* the ASCII chars relevant for line end detection (TRT-like scan table) */
+static const char lineEndChars[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0 /* rest is 0 */
+};
+ 
  
 /*
 ** RC <- ncfbasesvc_invoke_sync(
@@ -211,12 +318,24 @@ typedef struct _ncfb_bulkstream_private {
   bool isText;
   bool isSourceStream;
   bool lastLineWasBufferEnd;
+  bool isRecMode;  /* text stream transferring EBCDIC records */
+  uint recRest;    /* record mode source: bytes of the last record not yet
+                      returned by ngetstr() (at the end of the record) */
+  bool recOpen;    /* record mode sink: the last record is still open for
+                      nputstr() without newline */
+  uint recStart;   /* record mode sink: buffer position of the length
+                      prefix of the open record */
   uint streamState;
   int  nerr;
   int  commrc;
   uint bufLen;
   uint bufPos;
-  char buffer[STREAM_BUFFER_LEN];
+  char buffer[STREAM_BUFFER_LEN * 2]; /* room for a partial record + a block */
+  uint window;     /* max. number of requests in flight (read-ahead or
+                      write-behind) */
+  uint pendCount;  /* number of requests currently in flight */
+  uint pendFirst;  /* index of the oldest request in flight in 'pend' */
+  request_handle pend[NCFIO_MAXWINDOW]; /* ring of requests in flight */
   } BULKSTREAMSTRUCTPRIV, *BULKSTREAMPRIV;
  
 /* states of the remote stream */
@@ -233,9 +352,6 @@ typedef struct _ncfb_bulkstream_private {
  
 #define NERR_COMMERROR        1
  
-/* how does the platform where the outside proxy runs represent line ends ? */
-static int lineEndMode = -1; /* 0 = LF-CR ; 1 = LF ; 2 = CR ; 3 = CR-LF */
- 
 /* convert a streamId of the outside proxy in a bulk stream
 */
 BULKSTREAM ncfbid2s(int streamId, bool isSourceStream, bool isText) {
@@ -249,7 +365,15 @@ BULKSTREAM ncfbid2s(int streamId, bool isSourceStream, bool isText) {
   str->commrc = 0;
   str->bufLen = (isSourceStream) ? 0 : STREAM_BUFFER_LEN;
   str->bufPos = 0;
- 
+  str->window = 1;
+  str->isRecMode = false;
+  str->recRest = 0;
+  str->recOpen = false;
+  str->recStart = 0;
+  str->pendCount = 0;
+  str->pendFirst = 0;
+ 
+  if (isText && lineEndMode < 0) { ndiscover(); }
   if (isText && lineEndMode < 0) {
     int ctlWord;
     int rc = ncfbasesvc_invoke_sync(
@@ -269,6 +393,135 @@ BULKSTREAM ncfbid2s(int streamId, bool isSourceStream, bool isText) {
 }
  
  
+/* Set the number of read or write requests kept in flight for a stream.
+*/
+uint nsetwindow(BULKSTREAM stream, uint windowSize) {
+  BULKSTREAMPRIV str = (BULKSTREAMPRIV)stream;
+  if (windowSize < 1) { windowSize = 1; }
+  if (windowSize > NCFIO_MAXWINDOW) { windowSize = NCFIO_MAXWINDOW; }
+  str->window = windowSize;
+  return windowSize;
+}
+ 
+ 
+/* issue BULKSRC_READ requests for the source stream until the read-ahead
+** window is filled, as long as the stream did not report a final state.
+*/
+static void nreadahead(BULKSTREAMPRIV str, byte dataFlags) {
+  while (str->pendCount < str->window && str->streamState == STATE_OK) {
+    uint idx = (str->pendFirst + str->pendCount) % NCFIO_MAXWINDOW;
+    int rc = ncfbasesvc_invoke_begin(
+               &str->pend[idx],
+               0, /* svcId = base services */
+               101, /* svcCmd = BULKSRC_READ */
+               str->streamId, /* inCtlWord */
+               NULL, /* inData, irrelevant for source streams */
+               0, /* inDataLen, irrelevant for source streams */
+               dataFlags /* dataFlags, irrelevant for source streams */
+               );
+    if (rc != 0) {
+      str->commrc = rc;
+      str->nerr = NERR_COMMERROR;
+      return;
+    }
+    str->pendCount++;
+  }
+}
+ 
+ 
+/* wait for all read requests still in flight for the source stream,
+** dropping the data they possibly transport.
+*/
+static void ndrain(BULKSTREAMPRIV str) {
+  while (str->pendCount > 0) {
+    request_handle h = str->pend[str->pendFirst];
+    str->pendFirst = (str->pendFirst + 1) % NCFIO_MAXWINDOW;
+    str->pendCount--;
+    ncfbasesvc_invoke_end(h, NULL, NULL, NULL, DATA_BINARY);
+  }
+}
+ 
+ 
+/* load the next block from the remote source stream into the stream's buffer,
+** either from the oldest read-ahead request or with a synchronous read
+** operation 'cmd' (BULKSRC_READ or BULKSRC_READNOWAIT).
+** The data not yet consumed (at most STREAM_BUFFER_LEN bytes) is moved to the
+** begin of the buffer and the new block is appended to it.
+*/
+static void nfetch(BULKSTREAMPRIV str, short cmd, byte dataFlags) {
+  bool readAhead = (str->window > 1 && cmd == 101);
+  if (readAhead) { nreadahead(str, dataFlags); }
+ 
+  uint rest = str->bufLen - str->bufPos;
+  if (rest > 0 && str->bufPos > 0) {
+    memmove(str->buffer, &str->buffer[str->bufPos], rest);
+  }
+  str->bufPos = 0;
+  str->bufLen = rest;
+  uint blockLen = 0;
+  if (str->pendCount > 0) {
+    request_handle h = str->pend[str->pendFirst];
+    str->pendFirst = (str->pendFirst + 1) % NCFIO_MAXWINDOW;
+    str->pendCount--;
+    str->commrc = ncfbasesvc_invoke_end(
+               h,
+               &str->streamState, /* outCtlWord = state of the stream */
+               &str->buffer[rest], /* outData = our read buffer */
+               &blockLen, /* outDataLen = transferred bytes */
+               dataFlags /* dataFlags */
+               );
+  } else {
+    str->commrc = ncfbasesvc_invoke_sync(
+               0, /* svcId = base services */
+               cmd, /* svcCmd */
+               str->streamId, /* inCtlWord */
+               NULL, /* inData, irrelevant for source streams */
+               0, /* inDataLen, irrelevant for source streams */
+               &str->streamState, /* putCtlWord = state of the stream */
+               &str->buffer[rest], /* outData = our read buffer */
+               &blockLen, /* outDataLen = transferred bytes */
+               dataFlags /* dataFlags */
+               );
+  }
+  if (str->commrc != 0) { str->nerr = NERR_COMMERROR; }
+  str->bufLen += blockLen;
+ 
+  if (str->streamState != STATE_OK || str->commrc != 0) {
+    ndrain(str); /* the blocks requested in advance will be empty anyway */
+  } else if (readAhead) {
+    nreadahead(str, dataFlags); /* keep the window filled while we work */
+  }
+}
+ 
+ 
+/* get the next record of a source stream in record mode: the remote side
+** sends only complete records, each prefixed with its length (2 bytes), so a
+** block starts at a record boundary and no scanning is needed.
+*/
+static char* nnextrec(BULKSTREAMPRIV str, uint *recLen) {
+  if (str->recRest > 0) { /* the rest of a record too long for ngetstr() */
+    *recLen = str->recRest;
+    str->recRest = 0;
+    return &str->buffer[str->bufPos - *recLen];
+  }
+  if (str->bufPos >= str->bufLen) {
+    if (str->streamState != STATE_OK) { return NULL; }
+    nfetch(str, 101, DATA_BINARY);
+    if (str->bufPos >= str->bufLen) { return NULL; }
+  }
+  unsigned char *rec = (unsigned char*)&str->buffer[str->bufPos];
+  uint len = (rec[0] << 8) | rec[1];
+  if ((str->bufPos + 2 + len) > str->bufLen) {
+    str->nerr = NERR_READERROR; /* the remote side broke the protocol */
+    str->bufPos = str->bufLen;
+    return NULL;
+  }
+  str->bufPos += 2 + len;
+  *recLen = len;
+  return (char*)&rec[2];
+}
+ 
+ 
 /* Read up to 'bufferLen - 1' text bytes from the stream up to a line end,
 ** leaving or removing the line end on the string depending in 'keepNL' and
 ** terminating the string with a null char.
@@ -289,7 +542,8 @@ char* ngetstr(
     return NULL;
   }
   if (str->nerr == NERR_EOF) { return NULL; }
-  if (str->bufPos >= str->bufLen && str->streamState == STATE_SOURCE_ENDED) {
+  if (str->bufPos >= str->bufLen && str->recRest == 0
+      && str->streamState == STATE_SOURCE_ENDED) {
     str->nerr == NERR_EOF;
     return NULL;
   }
@@ -309,6 +563,25 @@ char* ngetstr(
     return buffer;
   }
  
+  if (str->isRecMode) {
+    uint recLen;
+    char *rec = nnextrec(str, &recLen);
+    if (rec == NULL) { return NULL; }
+    uint maxLen = bufferLen - ((keepNL) ? 2 : 1);
+    if (recLen > maxLen) {
+      /* return the record like an overlong line: the part fitting into the
+      ** buffer (without line end) now, the rest with the next call(s) */
+      str->recRest = recLen - maxLen;
+      memcpy(buffer, rec, maxLen);
+      buffer[maxLen] = '\0';
+      return buffer;
+    }
+    memcpy(buffer, rec, recLen);
+    if (keepNL) { buffer[recLen++] = CHAR_LF; }
+    buffer[recLen] = '\0';
+    return buffer;
+  }
+ 
   char *limit = &buffer[bufferLen - 1];
   char *curr = buffer;
   while (curr < limit) {
@@ -317,19 +590,10 @@ char* ngetstr(
         limit = curr;
         continue;
       }
-      str->commrc = ncfbasesvc_invoke_sync(
-               0, /* svcId = base services */
-               101, /* svcCmd = BULKSRC_READ */
-               str->streamId, /* inCtlWord */
-               NULL, /* inData, irrelevant for source streams */
-               0, /* inDataLen, irrelevant for source streams */
-               &str->streamState, /* putCtlWord = state of the stream */
-               str->buffer, /* outData = our read buffer */
-               &str->bufLen, /* outDataLen = transferred bytes */
-               OUTDATA_TEXT /* dataFlags = do ASCII->EBCDIC translation */
-               );
-      if (str->commrc != 0) { str->nerr = NERR_COMMERROR; }
-      str->bufPos = 0;
+      nfetch(str,
+             101, /* svcCmd = BULKSRC_READ */
+             DATA_BINARY /* dataFlags = ASCII->EBCDIC is done when scanning */
+             );
       if (str->bufLen == 0) {
         if (curr == buffer && str->streamState != 0) { return NULL; }
         limit = curr;
@@ -337,24 +601,32 @@ char* ngetstr(
       }
     }
  
+    /* translate the run of plain chars up to the next line end character,
+    ** the end of the block or the end of the target buffer in one pass */
+    unsigned char *src = (unsigned char*)&str->buffer[str->bufPos];
+    unsigned char *end = (unsigned char*)&str->buffer[str->bufLen];
+    if ((end - src) > (limit - curr)) { end = src + (limit - curr); }
+    unsigned char *run = src;
+    while (src < end && !lineEndChars[*src]) { *curr++ = (char)a2e[*src++]; }
+    str->bufPos += (src - run);
+    if (src != run) { skipLineEnd = false; }
+    if (src >= end) { continue; }
+ 
     unsigned char c = str->buffer[str->bufPos++];
-    if (c == CHAR_LF && lineEndMode != 2 && skipLineEnd) {
+    if (c == ASCII_LF && lineEndMode != 2 && skipLineEnd) {
       skipLineEnd = false;
-    } else if (c == CHAR_CR && lineEndMode == 2 && skipLineEnd) {
+    } else if (c == ASCII_CR && lineEndMode == 2 && skipLineEnd) {
       skipLineEnd = false;
-    } else if (c == CHAR_LF) {
+    } else if (c == ASCII_LF) {
       if (lineEndMode != 2) {
-        if (keepNL) { *curr++ = (char)c; }
+        if (keepNL) { *curr++ = CHAR_LF; }
         limit = curr;
       }
-    } else if (c == CHAR_CR) {
+    } else if (c == ASCII_CR) {
       if (lineEndMode == 2) {
         if (keepNL) { *curr++ = CHAR_LF; }
         limit = curr;
       }
-    } else {
-      *curr++ = (char)c;
-      skipLineEnd = false;
     }
   }
   *curr = '\0';
@@ -401,33 +673,423 @@ uint nread(
     if (str->bufPos >= str->bufLen) {
       if (str->streamState != 0) { break; } /* last read's state in this loop */
       short cmd = (noWait) ? 102 : 101; /* READNOWAIT vs. READ */
-      str->commrc = ncfbasesvc_invoke_sync(
-               0, /* svcId = base services */
-               cmd, /* svcCmd */
-               str->streamId, /* inCtlWord */
-               NULL, /* inData, irrelevant for source streams */
-               0, /* inDataLen, irrelevant for source streams */
-               &str->streamState, /* putCtlWord = state of the stream */
-               str->buffer, /* outData = our read buffer */
-               &str->bufLen, /* outDataLen = transferred bytes */
-               DATA_BINARY /* dataFlags = no translation */
-               );
-      if (str->commrc != 0) { str->nerr = NERR_COMMERROR; }
-      str->bufPos = 0;
+      nfetch(str, cmd, DATA_BINARY /* dataFlags = no translation */);
       if (str->bufLen == 0) {
         break; /* the reason should be in streamState */
       }
     }
-    *dest++ = str->buffer[str->bufPos++];
-    count++;
+    uint chunk = str->bufLen - str->bufPos;
+    if (chunk > (bufferLen - count)) { chunk = bufferLen - count; }
+    memcpy(dest, &str->buffer[str->bufPos], chunk);
+    dest += chunk;
+    str->bufPos += chunk;
+    count += chunk;
   }
  
   return count;
 }
  
+ 
+/* Read up to 'bufferLen' bytes of a binary source stream starting at byte
+** 'offset', independently of the sequential read position of the stream.
+*/
+uint nreadat(
+    void *buffer,
+    uint bufferLen,
+    uint offset,
+    BULKSTREAM stream) {
+  BULKSTREAMPRIV str = (BULKSTREAMPRIV)stream;
+ 
+  if (!str->isSourceStream) {
+    str->nerr = NERR_NOT_SOURCE;
+    return 0;
+  }
+  if (str->isText) {
+    str->nerr = NERR_NOTBINSTREAM;
+    return 0;
+  }
+ 
+  str->nerr = NERR_NOERROR;
+ 
+  /* the ranges requested in parallel, answered in the order requested */
+  request_handle pend[NCFIO_MAXWINDOW];
+  uint pendPos[NCFIO_MAXWINDOW];
+  uint pendFirst = 0;
+  uint pendCount = 0;
+ 
+  char block[STREAM_BUFFER_LEN]; /* for ranges too near to the buffer end */
+  char *dest = (char*)buffer;
+  uint requested = 0; /* bytes requested so far */
+  uint count = 0; /* bytes received contiguously from the begin */
+  bool done = false; /* end of data reached or failure */
+ 
+  while ((requested < bufferLen && !done) || pendCount > 0) {
+    while (requested < bufferLen && !done && pendCount < str->window) {
+      uint len = bufferLen - requested;
+      if (len > STREAM_BUFFER_LEN) { len = STREAM_BUFFER_LEN; }
+      uint pos = offset + requested;
+      unsigned char req[12]; /* position (8 bytes) + length (4 bytes) */
+      memset(req, 0, 4);
+      req[4] = (pos >> 24) & 0xFF;
+      req[5] = (pos >> 16) & 0xFF;
+      req[6] = (pos >> 8) & 0xFF;
+      req[7] = pos & 0xFF;
+      req[8] = (len >> 24) & 0xFF;
+      req[9] = (len >> 16) & 0xFF;
+      req[10] = (len >> 8) & 0xFF;
+      req[11] = len & 0xFF;
+      uint idx = (pendFirst + pendCount) % NCFIO_MAXWINDOW;
+      int rc = ncfbasesvc_invoke_begin(
+                 &pend[idx],
+                 0, /* svcId = base services */
+                 104, /* svcCmd = BULKSRC_READAT */
+                 str->streamId, /* inCtlWord */
+                 req, /* inData = the range to read */
+                 sizeof(req), /* inDataLen */
+                 DATA_BINARY /* dataFlags = no translation */
+                 );
+      if (rc != 0) {
+        str->commrc = rc;
+        str->nerr = NERR_COMMERROR;
+        done = true;
+        break;
+      }
+      pendPos[idx] = requested;
+      pendCount++;
+      requested += len;
+    }
+    if (pendCount == 0) { break; }
+ 
+    request_handle h = pend[pendFirst];
+    uint pos = pendPos[pendFirst];
+    pendFirst = (pendFirst + 1) % NCFIO_MAXWINDOW;
+    pendCount--;
+    if (done) { /* drop the ranges behind the end or a failure */
+      ncfbasesvc_invoke_end(h, NULL, NULL, NULL, DATA_BINARY);
+      continue;
+    }
+ 
+    /* receive directly into the client's buffer if a full block fits */
+    bool direct = (bufferLen - pos >= STREAM_BUFFER_LEN);
+    int state = STATE_OK;
+    uint len = 0;
+    int rc = ncfbasesvc_invoke_end(
+               h,
+               &state, /* outCtlWord = state for the range */
+               (direct) ? &dest[pos] : block, /* outData */
+               &len, /* outDataLen = transferred bytes */
+               DATA_BINARY /* dataFlags = no translation */
+               );
+    if (rc != 0) {
+      str->commrc = rc;
+      str->nerr = NERR_COMMERROR;
+      done = true;
+      continue;
+    }
+    if (!direct && len > 0) { memcpy(&dest[pos], block, len); }
+    count = pos + len;
+    if (state == STATE_SOURCE_READ_ERROR) {
+      str->nerr = NERR_READERROR;
+      done = true;
+    } else if (state != STATE_OK) {
+      done = true; /* end of data */
+    }
+  }
+ 
+  return count;
+}
+ 
+ 
+/* Read binary data from several source streams with a single request to the
+** remote side for all streams needing a new block.
+*/
+uint nreadv(NREADVEC *vec, uint vecCount, bool noWait) {
+  unsigned char req[2 + (NCFIO_MAXREADV * 6)];
+  unsigned char resp[STREAM_BUFFER_LEN];
+  NREADVEC *batch[NCFIO_MAXREADV];
+  uint batchCount = 0;
+  uint total = 0;
+  uint i;
+ 
+  /* serve the streams from the data already buffered locally and collect
+     the streams requiring a remote read */
+  for (i = 0; i < vecCount; i++) {
+    NREADVEC *v = &vec[i];
+    BULKSTREAMPRIV str = (BULKSTREAMPRIV)v->stream;
+    v->count = 0;
+    if (!str->isSourceStream) {
+      str->nerr = NERR_NOT_SOURCE;
+      continue;
+    }
+    if (str->isText) {
+      str->nerr = NERR_NOTBINSTREAM;
+      continue;
+    }
+    if (str->nerr == NERR_EOF || v->bufferLen == 0) { continue; }
+    str->nerr = NERR_NOERROR;
+    if (str->bufPos < str->bufLen || str->pendCount > 0
+        || batchCount >= NCFIO_MAXREADV) {
+      /* buffered data or read-ahead blocks must be consumed first */
+      v->count = nread(v->buffer, v->bufferLen, noWait, v->stream);
+      total += v->count;
+      continue;
+    }
+    if (str->streamState != STATE_OK) { continue; }
+    batch[batchCount++] = v;
+  }
+  if (batchCount == 0) { return total; }
+ 
+  /* read the streams one by one if the remote side cannot do it at once
+     or is too old to report its capabilities */
+  int caps = ncfbasesvc_capabilities();
+  if (batchCount == 1 || caps < 0 || (caps & BASECAP_READMULTI) == 0) {
+    for (i = 0; i < batchCount; i++) {
+      NREADVEC *v = batch[i];
+      v->count = nread(v->buffer, v->bufferLen, noWait, v->stream);
+      total += v->count;
+    }
+    return total;
+  }
+ 
+  /* request: flags (1 byte), count (1 byte), per stream: streamId (4 bytes),
+     max. length (2 bytes) ; the response has a header of 4 bytes per stream,
+     so the length is limited to an equal share of the response packet */
+  uint share = (STREAM_BUFFER_LEN / batchCount) - 4;
+  uint reqLen = 2;
+  req[0] = (noWait) ? 0x01 : 0x00;
+  req[1] = batchCount;
+  for (i = 0; i < batchCount; i++) {
+    NREADVEC *v = batch[i];
+    BULKSTREAMPRIV str = (BULKSTREAMPRIV)v->stream;
+    uint len = (v->bufferLen < share) ? v->bufferLen : share;
+    req[reqLen++] = (str->streamId >> 24) & 0xFF;
+    req[reqLen++] = (str->streamId >> 16) & 0xFF;
+    req[reqLen++] = (str->streamId >> 8) & 0xFF;
+    req[reqLen++] = str->streamId & 0xFF;
+    req[reqLen++] = (len >> 8) & 0xFF;
+    req[reqLen++] = len & 0xFF;
+  }
+  int ctlWord = 0;
+  uint respLen = 0;
+  int rc = ncfbasesvc_invoke_sync(
+             0, /* svcId = base services */
+             3, /* svcCmd = READ_MULTI */
+             0, /* inCtlWord = irrelevant */
+             req, /* inData = the streams to read */
+             reqLen, /* inDataLen */
+             &ctlWord, /* outCtlWord = irrelevant */
+             resp, /* outData = the blocks for the streams */
+             &respLen, /* outDataLen */
+             DATA_BINARY /* dataFlags = no translation */
+             );
+ 
+  /* response: per stream: state (2 bytes), length (2 bytes), data */
+  uint pos = 0;
+  for (i = 0; i < batchCount; i++) {
+    NREADVEC *v = batch[i];
+    BULKSTREAMPRIV str = (BULKSTREAMPRIV)v->stream;
+    if (rc != 0 || (pos + 4) > respLen) {
+      str->commrc = (rc != 0) ? rc : ERR_SVC_INVALIDRESULT;
+      str->nerr = NERR_COMMERROR;
+      continue;
+    }
+    short state = (short)((resp[pos] << 8) | resp[pos + 1]);
+    uint len = (resp[pos + 2] << 8) | resp[pos + 3];
+    pos += 4;
+    if ((pos + len) > respLen || len > v->bufferLen) {
+      str->commrc = ERR_SVC_INVALIDRESULT;
+      str->nerr = NERR_COMMERROR;
+      pos = respLen;
+      continue;
+    }
+    memcpy(v->buffer, &resp[pos], len);
+    pos += len;
+    v->count = len;
+    total += len;
+    if (state == ERR_BULK_SOURCE_INVALID) {
+      str->streamState = STATE_SOURCE_CLOSED;
+      str->nerr = NERR_READERROR;
+    } else {
+      str->streamState = state;
+      if (state == STATE_SOURCE_READ_ERROR) { str->nerr = NERR_READERROR; }
+    }
+  }
+ 
+  return total;
+}
+ 
+ 
+/* Get the next record from the source stream directly from the stream's
+** internal buffer, without copying the data to a client buffer.
+*/
+char* ngetrec(uint maxLen, uint *recLen, BULKSTREAM stream) {
+  BULKSTREAMPRIV str = (BULKSTREAMPRIV)stream;
+  *recLen = 0;
+ 
+  if (!str->isSourceStream) {
+    str->nerr = NERR_NOT_SOURCE;
+    return NULL;
+  }
+  if (str->nerr == NERR_EOF) { return NULL; }
+  if (str->bufPos >= str->bufLen && str->recRest == 0
+      && str->streamState == STATE_SOURCE_ENDED) {
+    str->nerr = NERR_EOF;
+    return NULL;
+  }
+ 
+  str->nerr = NERR_NOERROR;
+ 
+  if (maxLen == 0 || maxLen > STREAM_BUFFER_LEN) {
+    maxLen = STREAM_BUFFER_LEN;
+  }
+ 
+  if (str->isRecMode) { return nnextrec(str, recLen); }
+ 
+  if (!str->isText) {
+    /* collect 'maxLen' bytes behind each other in the buffer */
+    while ((str->bufLen - str->bufPos) < maxLen
+           && str->streamState == STATE_OK) {
+      uint had = str->bufLen - str->bufPos;
+      nfetch(str, 101, DATA_BINARY);
+      if (str->bufLen == had) { break; } /* no more data came in */
+    }
+    uint len = str->bufLen - str->bufPos;
+    if (len > maxLen) { len = maxLen; }
+    if (len == 0) { return NULL; }
+    char *rec = &str->buffer[str->bufPos];
+    str->bufPos += len;
+    *recLen = len;
+    return rec;
+  }
+ 
+  /* text stream: translate the line in place (dropping the line end) */
+  bool skipLineEnd = str->lastLineWasBufferEnd;
+  str->lastLineWasBufferEnd = false;
+  unsigned char *buf = (unsigned char*)str->buffer;
+  uint recStart = str->bufPos;
+  uint recEnd = str->bufPos;
+  bool lineEndFound = false;
+  while (!lineEndFound) {
+    if (str->bufPos >= str->bufLen) {
+      if (str->streamState != STATE_OK) { break; }
+      /* keep the record's part translated so far as data to be kept */
+      uint partLen = recEnd - recStart;
+      str->bufPos = recStart;
+      str->bufLen = recEnd;
+      nfetch(str, 101, DATA_BINARY);
+      recStart = 0;
+      recEnd = partLen;
+      str->bufPos = partLen;
+      if (str->bufLen == partLen) { break; } /* no more data came in */
+    }
+ 
+    unsigned char *src = &buf[str->bufPos];
+    unsigned char *end = &buf[str->bufLen];
+    unsigned char *dst = &buf[recEnd];
+    if ((end - src) > (recStart + maxLen - recEnd)) {
+      end = src + (recStart + maxLen - recEnd);
+    }
+    unsigned char *run = src;
+    while (src < end && !lineEndChars[*src]) { *dst++ = a2e[*src++]; }
+    str->bufPos += (src - run);
+    recEnd += (src - run);
+    if (src != run) { skipLineEnd = false; }
+    if ((recEnd - recStart) >= maxLen) {
+      str->lastLineWasBufferEnd = true;
+      break;
+    }
+    if (src >= end) { continue; }
+ 
+    unsigned char c = buf[str->bufPos++];
+    if (c == ASCII_LF && lineEndMode != 2 && skipLineEnd) {
+      skipLineEnd = false;
+    } else if (c == ASCII_CR && lineEndMode == 2 && skipLineEnd) {
+      skipLineEnd = false;
+    } else if (c == ASCII_LF && lineEndMode != 2) {
+      lineEndFound = true;
+    } else if (c == ASCII_CR && lineEndMode == 2) {
+      lineEndFound = true;
+    }
+  }
+  if (!lineEndFound && recEnd == recStart) { return NULL; }
+  *recLen = recEnd - recStart;
+  return &str->buffer[recStart];
+}
+ 
+/* receive the response for the oldest write request in flight for the sink
+** stream, the stream state becomes the state reported by the remote service
+** unless an earlier write already reported a problem.
+*/
+static void nwritten(BULKSTREAMPRIV str) {
+  request_handle h = str->pend[str->pendFirst];
+  str->pendFirst = (str->pendFirst + 1) % NCFIO_MAXWINDOW;
+  str->pendCount--;
+  int state = STATE_OK;
+  int rc = ncfbasesvc_invoke_end(
+             h,
+             &state, /* outCtlWord = state of the stream */
+             NULL, /* outData, irrelevant for writing */
+             NULL, /* outDataLen, irrelevant for writing */
+             DATA_BINARY /* dataFlags, irrelevant for writing */
+             );
+  if (rc != 0) {
+    str->commrc = rc;
+    str->nerr = NERR_COMMERROR;
+  }
+  if (str->streamState == STATE_OK) { str->streamState = state; }
+}
+ 
+ 
+/* receive the responses already arrived for the write requests in flight
+** for the sink stream (without waiting for the others).
+*/
+static void ncollect(BULKSTREAMPRIV str) {
+  while (str->pendCount > 0
+         && nicofclt_isAvailable(str->pend[str->pendFirst])) {
+    nwritten(str);
+  }
+}
+ 
+ 
+/* wait for all write requests in flight for the sink stream.
+*/
+static void nsettle(BULKSTREAMPRIV str) {
+  while (str->pendCount > 0) { nwritten(str); }
+}
+ 
+ 
+/* transmit the stream's buffer content to the remote sink, either waiting
+** for the write to complete or (write-behind) leaving the request in flight
+** if the stream's window allows it, in which case the buffer can be reused
+** at once, as the request has its own copy of the data.
+*/
 static nflush_inner(BULKSTREAMPRIV str) {
   if (str->bufPos == 0) { return; }
-  uint flags = (str->isText) ? INDATA_TEXT : DATA_BINARY;
+  str->recOpen = false; /* an open record is sent as is */
+  uint flags = (str->isText && !str->isRecMode) ? INDATA_TEXT : DATA_BINARY;
+  if (str->window > 1) {
+    ncollect(str);
+    if (str->pendCount >= str->window) { nwritten(str); }
+    uint idx = (str->pendFirst + str->pendCount) % NCFIO_MAXWINDOW;
+    int rc = ncfbasesvc_invoke_begin(
+               &str->pend[idx],
+               0, /* svcId = base services */
+               201, /* svcCmd : BULKSINK_WRITE */
+               str->streamId, /* inCtlWord */
+               str->buffer, /* inData = our write buffer */
+               str->bufPos, /* inDataLen = used buffer length */
+               flags /* dataFlags */
+               );
+    if (rc == 0) {
+      str->pendCount++;
+    } else {
+      str->commrc = rc;
+      str->nerr = NERR_COMMERROR;
+    }
+    str->bufPos = 0;
+    str->bufLen = STREAM_BUFFER_LEN;
+    return;
+  }
   str->commrc = ncfbasesvc_invoke_sync(
            0, /* svcId = base services */
            201, /* svcCmd : BULKSINK_WRITE */
@@ -444,12 +1106,43 @@ static nflush_inner(BULKSTREAMPRIV str) {
   str->bufLen = STREAM_BUFFER_LEN;
 }
  
-#define _putc(str,c,errval) \
-  str->buffer[str->bufPos++] = c; \
-  if (str->bufPos == str->bufLen) { \
-    nflush_inner(str); \
-  } \
-  if (str->streamState != STATE_OK) { return errval; }
+/* append 'len' bytes to the sink stream's buffer, transmitting the buffer
+** each time it gets full; returns the number of bytes taken over before the
+** stream's state forbids further writing.
+*/
+static uint nputblock(BULKSTREAMPRIV str, const char *src, uint len) {
+  uint done = 0;
+  if (str->bufPos >= str->bufLen) { nflush_inner(str); } /* see nputrec() */
+  while (done < len && str->streamState == STATE_OK) {
+    uint chunk = str->bufLen - str->bufPos;
+    if (chunk > (len - done)) { chunk = len - done; }
+    memcpy(&str->buffer[str->bufPos], &src[done], chunk);
+    str->bufPos += chunk;
+    done += chunk;
+    if (str->bufPos >= str->bufLen) { nflush_inner(str); }
+  }
+  return done;
+}
+ 
+/* put the line end sequence for the outside platform into 'nl' (EBCDIC,
+** translated when sending), returning its length.
+*/
+static uint nlineend(char *nl) {
+  if (lineEndMode == 1) {
+    nl[0] = CHAR_LF;
+    return 1;
+  } else if (lineEndMode == 2) {
+    nl[0] = CHAR_CR;
+    return 1;
+  } else if (lineEndMode == 3) {
+    nl[0] = CHAR_CR;
+    nl[1] = CHAR_LF;
+  } else {
+    nl[0] = CHAR_LF;
+    nl[1] = CHAR_CR;
+  }
+  return 2;
+}
  
  
 /* Write a text string to the stream, converting the local EBCDIC bytes to
@@ -469,6 +1162,7 @@ bool nputstr(
     return false;
   }
   if (str->nerr != NERR_NOERROR) { return false; }
+  ncollect(str);
   if (str->streamState != STATE_OK) {
     str->nerr == NERR_WRITEERROR;
     return false;
@@ -481,23 +1175,50 @@ bool nputstr(
  
   str->nerr = NERR_NOERROR;
  
-  char *s = string;
-  while (*s) {
-    _putc(str, *s++, false);
+  if (str->isRecMode) {
+    uint len = strlen(string);
+    if (!str->recOpen) {
+      char *rec = nputrec(len, false, stream);
+      if (rec == NULL) { return false; }
+      memcpy(rec, string, len);
+      str->recOpen = !appendNewline;
+      str->recStart = (rec - str->buffer) - 2;
+      return true;
+    }
+ 
+    /* append to the record left open by the last call without newline */
+    uint recLen = str->bufPos - str->recStart - 2;
+    if ((recLen + len + 2) > STREAM_BUFFER_LEN) {
+      str->nerr = NERR_RECTOOLONG;
+      return false;
+    }
+    if ((str->bufPos + len) > str->bufLen) {
+      /* send the complete records before, then move the open record to
+      ** the start of the buffer (the request has its own copy of the data) */
+      uint start = str->recStart;
+      str->bufPos = start;
+      nflush_inner(str);
+      if (str->streamState != STATE_OK) { return false; }
+      memmove(str->buffer, &str->buffer[start], recLen + 2);
+      str->bufPos = recLen + 2;
+      str->recStart = 0;
+    }
+    memcpy(&str->buffer[str->bufPos], string, len);
+    str->bufPos += len;
+    recLen += len;
+    str->buffer[str->recStart] = (recLen >> 8) & 0xFF;
+    str->buffer[str->recStart + 1] = recLen & 0xFF;
+    str->recOpen = !appendNewline;
+    return true;
   }
  
+  nputblock(str, string, strlen(string));
+  if (str->streamState != STATE_OK) { return false; }
+ 
   if (appendNewline) {
-    if (lineEndMode == 1) {
-      _putc(str, CHAR_LF, false);
-    } else if (lineEndMode == 2) {
-      _putc(str, CHAR_CR, false);
-    } else if (lineEndMode == 3) {
-      _putc(str, CHAR_CR, false);
-      _putc(str, CHAR_LF, false);
-    } else {
-      _putc(str, CHAR_LF, false);
-      _putc(str, CHAR_CR, false);
-    }
+    char nl[2];
+    nputblock(str, nl, nlineend(nl));
+    if (str->streamState != STATE_OK) { return false; }
   }
  
   return true;
@@ -517,6 +1238,7 @@ uint nwrite(void *buffer, uint bufLen, BULKSTREAM stream) {
     return 0;
   }
   if (str->nerr != NERR_NOERROR) { return 0; }
+  ncollect(str);
   if (str->streamState != STATE_OK) {
     str->nerr == NERR_WRITEERROR;
     return 0;
@@ -529,23 +1251,76 @@ uint nwrite(void *buffer, uint bufLen, BULKSTREAM stream) {
  
   str->nerr = NERR_NOERROR;
  
-  char *s = (char*)buffer;
-  int i;
-  for (i = 0; i < bufLen; i++) {
-    _putc(str, *s++, i);
-  }
+  uint done = nputblock(str, (char*)buffer, bufLen);
+  if (str->streamState != STATE_OK) { return done; }
  
   return bufLen;
 }
  
  
+/* Reserve space for a record of 'recLen' bytes in the sink stream's internal
+** buffer, to be filled directly by the client.
+*/
+char* nputrec(uint recLen, bool appendNewline, BULKSTREAM stream) {
+  BULKSTREAMPRIV str = (BULKSTREAMPRIV)stream;
+ 
+  if (str->isSourceStream) {
+    str->nerr = NERR_NOT_SINK;
+    return NULL;
+  }
+  if (str->nerr != NERR_NOERROR) { return NULL; }
+  ncollect(str);
+  if (str->streamState != STATE_OK) {
+    str->nerr = NERR_WRITEERROR;
+    return NULL;
+  }
+ 
+  if (appendNewline && !str->isText) {
+    str->nerr = NERR_NOTTEXTSTREAM;
+    return NULL;
+  }
+ 
+  str->recOpen = false; /* an open record ends before the new one */
+  char nl[2];
+  uint nlLen = (appendNewline) ? nlineend(nl) : 0;
+  if (str->isRecMode) {
+    /* the length prefix takes the place of the line end */
+    nl[0] = (recLen >> 8) & 0xFF;
+    nl[1] = recLen & 0xFF;
+    nlLen = 2;
+  }
+  if ((recLen + nlLen) > STREAM_BUFFER_LEN) {
+    str->nerr = NERR_RECTOOLONG;
+    return NULL;
+  }
+ 
+  if ((str->bufPos + recLen + nlLen) > str->bufLen) {
+    nflush_inner(str);
+    if (str->streamState != STATE_OK) { return NULL; }
+  }
+ 
+  if (str->isRecMode) {
+    memcpy(&str->buffer[str->bufPos], nl, 2);
+    str->bufPos += 2;
+    nlLen = 0;
+  }
+  char *rec = &str->buffer[str->bufPos];
+  str->bufPos += recLen;
+  if (nlLen > 0) {
+    memcpy(&str->buffer[str->bufPos], nl, nlLen);
+    str->bufPos += nlLen;
+  }
+  return rec;
+}
+ 
+ 
 /* Check if a source stream has reached the end of stream and has no more
 ** data to read.
 */
 bool neof(BULKSTREAM stream) {
   BULKSTREAMPRIV str = (BULKSTREAMPRIV)stream;
   if (!str->isSourceStream) { return false; }
-  if (str->bufPos < str->bufLen) { return false; }
+  if (str->bufPos < str->bufLen || str->recRest > 0) { return false; }
   /*if (str->nerr != NERR_NOERROR) { return true; }*/
   return (str->streamState == STATE_SOURCE_ENDED
           || str->streamState == STATE_SOURCE_CLOSED);
@@ -568,43 +1343,138 @@ void nflush(BULKSTREAM stream) {
     return;
   }
   nflush_inner(str);
+  nsettle(str);
 }
  
  
-/* Close the stream.
+/* get the final error of the stream when closing: a communication error,
+** a read error or (for a sink stream) a write refused by the remote side.
 */
-void nclose(BULKSTREAM stream) {
+static int nfinalerror(BULKSTREAMPRIV str) {
+  if (str->nerr == NERR_COMMERROR) { return str->commrc; }
+  if (str->nerr == NERR_READERROR || str->nerr == NERR_WRITEERROR) {
+    return str->nerr;
+  }
+  if (!str->isSourceStream && str->streamState != STATE_OK) {
+    return NERR_WRITEERROR;
+  }
+  return NERR_NOERROR;
+}
+ 
+/* Close the stream, returning the final error of the stream.
+*/
+int nclose(BULKSTREAM stream) {
   BULKSTREAMPRIV str = (BULKSTREAMPRIV)stream;
  
   if ((str->isSourceStream && str->streamState == STATE_SOURCE_CLOSED)
       || (!str->isSourceStream && str->streamState == STATE_SINK_CLOSED)) {
-    return;
+    int err = nfinalerror(str); /* closed by the remote side */
+    free(stream);
+    return err;
   }
  
-  if (!str->isSourceStream) {
+  if (str->isSourceStream) {
+    ndrain(str);
+  } else {
     nflush_inner(str);
+    nsettle(str); /* the last write-behind requests may still fail */
   }
+  int err = nfinalerror(str);
  
   int cmd = (str->isSourceStream) ? 100 : 200;
+  int state = STATE_OK;
   int rc = ncfbasesvc_invoke_sync(
               0, /* svcId = base services */
               cmd, /* svcCmd = BULKSRC_CLOSE or BULKSINK_CLOSE */
               str->streamId, /* inCtlWord = stream id */
               NULL, /* inData, irrelevant  */
               0, /* inDataLen, irrelevant */
-              &str->streamState, /* putCtlWord = state of the stream after op */
+              &state, /* putCtlWord = state of the stream after op */
               NULL, /* outData = irrelevant */
               NULL, /* outDataLen = irrelevant */
               DATA_BINARY /* dataFlags = irrelevant */
               );
+  bool isSink = !str->isSourceStream;
   free(stream);
+ 
+  /* the remote sink may still fail when writing its buffered data on close */
+  if (isSink && err == NERR_NOERROR) {
+    if (rc != 0) {
+      err = rc;
+    } else if (state == STATE_SINK_MEDIA_FULL
+               || state == STATE_SINK_WRITE_ERROR) {
+      err = NERR_WRITEERROR;
+    }
+  }
+  return err;
+}
+ 
+ 
+/* Switch a text stream to record mode, with the remote side doing the
+** character set conversion and line end handling.
+*/
+bool nrecmode(BULKSTREAM stream, uint lrecl, byte flags) {
+  BULKSTREAMPRIV str = (BULKSTREAMPRIV)stream;
+ 
+  if (!str->isText) {
+    str->nerr = NERR_NOTTEXTSTREAM;
+    return false;
+  }
+  if (str->isRecMode) { return true; }
+  if (baseCapabilities >= 0 && (baseCapabilities & BASECAP_RECORDMODE) == 0) {
+    return false; /* older proxy: the stream simply stays in text mode */
+  }
+  if (str->isSourceStream) {
+    if (str->bufLen > 0 || str->pendCount > 0) {
+      str->nerr = NERR_STREAMINUSE; /* text data already transferred */
+      return false;
+    }
+  } else {
+    nflush_inner(str);
+    nsettle(str);
+  }
+ 
+  char req[3];
+  uint reqLen;
+  if (str->isSourceStream) {
+    if (lrecl < 1 || lrecl > NCFIO_MAXLRECL) { lrecl = NCFIO_MAXLRECL; }
+    req[0] = (lrecl >> 8) & 0xFF;
+    req[1] = lrecl & 0xFF;
+    req[2] = flags;
+    reqLen = 3;
+  } else {
+    req[0] = flags;
+    reqLen = 1;
+  }
+  int state = STATE_OK;
+  int rc = ncfbasesvc_invoke_sync(
+             0, /* svcId = base services */
+             (str->isSourceStream) ? 105 : 202, /* svcCmd = xx_RECORDMODE */
+             str->streamId, /* inCtlWord */
+             req, /* inData = the record mode parameters */
+             reqLen, /* inDataLen */
+             &state, /* outCtlWord = state of the stream */
+             NULL, /* outData = irrelevant */
+             NULL, /* outDataLen = irrelevant */
+             DATA_BINARY /* dataFlags = no translation */
+             );
+  if (rc == ERR_BASESVC_INVCMD) {
+    return false; /* older proxy: the stream simply stays in text mode */
+  } else if (rc != 0) {
+    str->commrc = rc;
+    str->nerr = NERR_COMMERROR;
+    return false;
+  }
+  str->streamState = state;
+  str->isRecMode = true;
+  return true;
 }
  
  
 /* get the error message text for the passed return/error code
 */
 char* ncfb_000(int rc) {
-  if (rc <= -1000000 || rc >= 0) { return nicofclt_errmsg(rc); }
+  if (rc <= -1000000 || rc == 0) { return nicofclt_errmsg(rc); }
  
   switch(rc) {
     case ERR_INVALID_SERVICE :
@@ -620,11 +1490,32 @@ char* ncfb_000(int rc) {
       return "new bulk source available";
     case ERR_BULK_SOURCE_INVALID :
       return "invalid bulk source";
+    case ERR_BULK_SOURCE_NOT_POSITIONAL :
+      return "bulk source does not support positional reads";
  
     case NEW_BULK_SINK :
       return "new bulk sink available";
     case ERR_BULK_SINK_INVALID :
       return "invalid sink source";
+ 
+    case NERR_NOT_SOURCE :
+      return "stream is not a source stream";
+    case NERR_NOT_SINK :
+      return "stream is not a sink stream";
+    case NERR_EOF :
+      return "end of stream reached";
+    case NERR_READERROR :
+      return "error reading from the remote source";
+    case NERR_WRITEERROR :
+      return "error writing to the remote sink (data lost)";
+    case NERR_NOTTEXTSTREAM :
+      return "stream is not a text stream";
+    case NERR_NOTBINSTREAM :
+      return "stream is not a binary stream";
+    case NERR_RECTOOLONG :
+      return "record too long";
+    case NERR_STREAMINUSE :
+      return "stream already in use";
     default:
       return nicofclt_errmsg(rc);
   }
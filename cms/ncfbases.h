@@ -35,6 +35,7 @@
  
 #define NEW_BULK_SOURCE -32
 #define ERR_BULK_SOURCE_INVALID -33
+#define ERR_BULK_SOURCE_NOT_POSITIONAL -34
  
 #define NEW_BULK_SINK -64
 #define ERR_BULK_SINK_INVALID -65
@@ -43,11 +44,30 @@
 ** rc <- ncfbasesvc_resolve(serviceName, (out) svcId)
 **
 ** resolve the service name to its ID on the external process
+** (the first call loads the complete service table of the external process,
+** so resolving further services is done locally)
 */
 #define ncfbasesvc_resolve(name,id) \
   ncfb_001(name,id)
 extern int ncfb_001(const char *serviceName, short *serviceId);
  
+/*
+** caps <- ncfbasesvc_capabilities()
+**
+** get the capabilities of the base service on the external process, as
+** combination of the BASECAP_* flags (-1 if the external process is too old
+** to report its capabilities).
+** The capabilities are fetched together with the service table used by
+** ncfbasesvc_resolve(), so this costs at most one round trip per program.
+*/
+#define ncfbasesvc_capabilities() \
+  ncfb_002()
+extern int ncfb_002();
+ 
+#define BASECAP_READAT     0x0001
+#define BASECAP_RECORDMODE 0x0002
+#define BASECAP_READMULTI  0x0004
+ 
 #define INDATA_TEXT  0x01
 #define OUTDATA_TEXT 0x02
 #define DATA_BINARY  0x00
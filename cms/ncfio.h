@@ -78,6 +78,83 @@ extern uint nread(
     bool noWait,
     BULKSTREAM stream);
  
+/* Read up to 'bufferLen' bytes of a binary source stream starting at byte
+** 'offset' of the stream data (without any character set conversion). This
+** does not change the sequential read position or the end of stream state of
+** the stream, allowing to fetch several ranges of the same data or to restart
+** an interrupted transfer from a known position.
+** Data longer than one block is requested with several requests kept in
+** flight in parallel, limited by the stream's window size (see nsetwindow()).
+** Positional reads are only possible for streams whose remote service
+** supports them (for example files).
+**
+** Returns the number of bytes copied to 'buffer', which is less than
+** 'bufferLen' only if the end of the stream data was reached or an error
+** occured (see nerror()).
+*/
+extern uint nreadat(
+    void *buffer,
+    uint bufferLen,
+    uint offset,
+    BULKSTREAM stream);
+ 
+/* one element of a vectored read (see nreadv()).
+*/
+typedef struct _nreadvec {
+  BULKSTREAM stream;  /* the binary source stream to read from */
+  void *buffer;       /* where to put the data read */
+  uint bufferLen;     /* max. number of bytes to read from the stream */
+  uint count;         /* (out) number of bytes read from the stream */
+  } NREADVEC;
+ 
+/* max. number of streams read with a single request by nreadv().
+*/
+#define NCFIO_MAXREADV 16
+ 
+/* Read binary data from several source streams at once: for each element of
+** 'vec', up to 'bufferLen' bytes are read from 'stream' into 'buffer', with
+** 'count' receiving the number of bytes read.
+** Instead of one round trip per stream, the data for all streams needing a
+** new block is requested with a single request to the remote side, which
+** returns one block for each stream in the response. As the data for all
+** streams must fit into one response packet, the data returned for a stream
+** may be shorter than 'bufferLen' (down to about 2048/'vecCount' bytes), even
+** if the stream has not yet ended, so nreadv() is usually called in a loop
+** until neof() is true for all streams.
+** 'noWait' has the same meaning as for nread(). Streams with data buffered
+** locally (e.g. by read-ahead) are served from this data first.
+** The element count 'vecCount' is not limited, but only NCFIO_MAXREADV
+** streams are read with the common request, further streams are read
+** separately.
+**
+** Returns the total number of bytes read for all streams, errors are
+** reported by nerror() for the individual streams.
+*/
+extern uint nreadv(
+    NREADVEC *vec,
+    uint vecCount,
+    bool noWait);
+ 
+/* Get the next record from the source stream without copying it: the
+** returned pointer addresses the record data inside the stream's internal
+** buffer and stays valid only up to the next operation on the stream.
+** For a text stream, a record is the next line translated to EBCDIC, without
+** the line end and *not* terminated with a null char; a line longer than
+** 'maxLen' bytes is returned as several records.
+** For a binary stream, a record has 'maxLen' bytes, except for the last
+** record before the end of the stream, which may be shorter.
+** 'maxLen' is limited to 2048 bytes, 0 also means 2048 bytes.
+** For a text stream in record mode (see nrecmode()), a record is the next
+** record as built by the remote side and 'maxLen' is ignored.
+**
+** Returns the pointer to the record, with its length stored in 'recLen', or
+** NULL if the stream ended (EOF or the like).
+*/
+extern char* ngetrec(
+    uint maxLen,
+    uint *recLen,
+    BULKSTREAM stream);
+ 
 /* Write a text string to the stream, converting the local EBCDIC bytes to
 ** ASCII.
 **
@@ -117,19 +194,105 @@ extern uint nwrite(
     uint bufLen,
     BULKSTREAM stream);
  
+/* Reserve space for a record of 'recLen' bytes in the internal buffer of
+** the sink stream, returning the pointer where the client must place the
+** record data (local EBCDIC for text streams) before the next operation on
+** the stream, thus avoiding to copy the data. For text streams, a newline is
+** appended to the record if 'appendNewLine == true'.
+** A record (including the newline) is limited to 2048 bytes.
+** For a text stream in record mode (see nrecmode()), the record is passed
+** as is to the remote side, which adds the line end, so 'appendNewLine' is
+** ignored and a record is limited to 2046 bytes.
+**
+** Returns the pointer to the record space or NULL if the stream was in a
+** state forbidding a write or the record is too long.
+*/
+extern char* nputrec(
+    uint recLen,
+    bool appendNewline,
+    BULKSTREAM stream);
+ 
 /* Check if a source stream has reached the end of stream and has no more
 ** data to read.
 */
 extern bool neof(BULKSTREAM stream);
  
 /* Transmit all data currently buffered in a sink stream to the remote
-** service.
+** service, waiting for all writes still in flight to complete.
 */
 extern void nflush(BULKSTREAM stream);
  
-/* Close the stream.
+/* Close the stream, waiting for the writes still in flight for a sink
+** stream, and release it.
+** As writes may be left in flight (see nsetwindow()) and the remote side may
+** fail writing its buffered data when closing, a sink stream must be checked
+** for the result of nclose() to be sure all data was stored.
+**
+** Returns the final error of the stream (NERR_NOERROR if all data written
+** was accepted by the remote side, else NERR_WRITEERROR, NERR_READERROR or
+** the code of a communication error), with the message text being available
+** through ncfbasesvc_errmsg() (see ncfbases.h).
+*/
+extern int nclose(BULKSTREAM stream);
+ 
+/* max. number of requests a stream can keep in flight (see nsetwindow()).
+*/
+#define NCFIO_MAXWINDOW 8
+ 
+/* Set the number of requests kept in flight for a stream.
+** With the default window size of 1, each block costs a complete round trip
+** to the remote service: a source stream requests the next block only when
+** the data buffered so far is consumed and a sink stream waits until a full
+** buffer is written before accepting more data.
+** A larger window makes a source stream request the following blocks in
+** advance (read-ahead), these are then delivered in the original order when
+** reading from the stream. For a sink stream, a larger window allows to go
+** on filling the buffer while the previous blocks are still being written
+** (write-behind); a write error is then reported by the next write operation
+** following the response or at the latest by nflush() resp. nclose().
+** The window size is limited to NCFIO_MAXWINDOW.
+**
+** Returns the window size in effect for the stream.
+*/
+extern uint nsetwindow(BULKSTREAM stream, uint windowSize);
+ 
+/* max. record length for text streams in record mode (see nrecmode()).
+*/
+#define NCFIO_MAXLRECL 2046
+ 
+/* record mode flags for a source stream: pad the records to 'lrecl' with
+** blanks.
+*/
+#define NREC_PAD   0x01
+ 
+/* record mode flags for a sink stream: remove trailing blanks from the
+** records before converting them into lines.
+*/
+#define NREC_STRIP 0x01
+ 
+/* Switch a text stream to record mode, where the remote side does the work
+** of converting between ASCII lines and EBCDIC records: a source stream
+** delivers records of at most 'lrecl' bytes (longer lines are split into
+** several records, 0 means NCFIO_MAXLRECL), which are returned by ngetrec()
+** or ngetstr(); each record written to a sink stream by nputrec() or
+** nputstr() becomes one line on the remote side. This avoids scanning for
+** line ends and translating the character set on the VM/370 side.
+** As with lines, ngetstr() returns a record longer than its buffer in parts
+** over several calls (only the last part gets the line end), and the strings
+** written by nputstr() without newline are collected into one record, which
+** is complete with the next nputstr() with newline (resp. when the next
+** nputrec() or nflush() is done).
+** The 'flags' are NREC_PAD for source streams resp. NREC_STRIP for sink
+** streams.
+** The record mode must be set before the first data is read from a source
+** stream, data already written to a sink stream is flushed before switching.
+**
+** Returns true if the stream is now in record mode, false if the record
+** mode is not possible for the stream (see nerror()). If the remote side
+** does not support the record mode, false is returned but the stream stays
+** usable as normal text stream (with nerror() being NERR_NOERROR).
 */
-extern void nclose(BULKSTREAM stream);
+extern bool nrecmode(BULKSTREAM stream, uint lrecl, byte flags);
  
 #define NERR_NOERROR          0
 #define NERR_NOT_SOURCE      20
@@ -139,6 +302,8 @@ extern void nclose(BULKSTREAM stream);
 #define NERR_WRITEERROR    1002
 #define NERR_NOTTEXTSTREAM 1011
 #define NERR_NOTBINSTREAM  1012
+#define NERR_RECTOOLONG    1013
+#define NERR_STREAMINUSE   1014
  
 /* Return the error code of the last failed operation for the stream. The
 ** stream specified state codes are the NERR_* constants, but other codes (for
@@ -51,6 +51,13 @@ static const char *proxy_userid = "TCPIPPXY";
  
    userword2 = (any) as options for SEND, RECV, SENDTO, RECVFROM
  
+   SELECT (socket fileno 0) is the event channel for selectX(), with the
+   request data being 2 fd_set bitmaps: the sockets to watch for recv() resp.
+   accept() and the sockets to watch for send(); the response is returned
+   as soon as one of the sockets is ready (or when a new SELECT request
+   arrives) with 4 fd_set bitmaps: the readable, writable, acceptable and
+   failed sockets.
+ 
 */
  
 /* commands to the external TCP/IP proxy */
@@ -71,6 +78,7 @@ static const char *proxy_userid = "TCPIPPXY";
 #define CMD_RECVFROM 49
 #define CMD_SEND 50
 #define CMD_SENDTO 51
+#define CMD_SELECT 52
  
 /*
 ** global data
@@ -90,6 +98,9 @@ static char* hostent_pointers[HOSTENT_MAX_POINTERS];
 ** socket management
 */
  
+/* max. number of send requests queued for a stream socket (send window) */
+#define SEND_WINDOW_MAX 8
+ 
 /* internal representation of a socket */
 typedef struct __sock {
   uint flags;
@@ -97,6 +108,12 @@ typedef struct __sock {
   ushort recvRemaining;      /* recv(): byte count remaining to deliver */
   request_handle recvHandle; /* for: all socket management and receive ops */
   request_handle sendHandle; /* for: send/sendto ops */
+  ushort sendWindow;         /* send(): max. queued sends (0 = no window) */
+  ushort sendFirst;          /* send(): index of oldest send in sendQueue */
+  ushort sendCount;          /* send(): number of sends in sendQueue */
+  int sendError;             /* send(): errno of a failed queued send */
+  request_handle sendQueue[SEND_WINDOW_MAX]; /* for: queued send ops */
+  ushort sendLen[SEND_WINDOW_MAX];           /* byte counts of queued sends */
 } SOCKENTRY, *SOCK;
  
  
@@ -169,6 +186,84 @@ static request_handle newSockRequest(_full cmd, _full sockNo, _full w2) {
   return nicofclt_createRequest(w1, w2);
 }
  
+/* collect the responses of the sends queued in the send window in the order
+** the sends were issued, freeing the requests of completed sends; if 'wait',
+** the oldest sends are waited for until at most 'maxQueued' sends remain
+** in the window
+** a send the proxy transmitted only partially counts as failed with
+** ECONNABORTED: its caller was told that all bytes were sent and the sends
+** queued after it are already on their way, so the missing bytes cannot be
+** sent again without reordering the stream data
+** returns 0 if all sends collected so far succeeded, else -1 with errno
+** set to the error of the first failed send (which is reported only once)
+*/
+static int collectSends(SOCK sock, int maxQueued, int wait) {
+  while (sock->sendCount > 0) {
+    request_handle h = sock->sendQueue[sock->sendFirst];
+    if (!nicofclt_isAvailable(h)) {
+      if (!wait || sock->sendCount <= maxQueued) { break; }
+      int rc = nicofclt_waitForResponse(h);
+      if (rc != 0 && sock->sendError == 0) { sock->sendError = rc; }
+    }
+    uint uw1, uw2;
+    int rc = nicofclt_getResponseUserWords(h, &uw1, &uw2);
+    if (rc == 0) { rc = (int)uw1 & 0xFFFF0000; }
+    if (rc == EOK && (uw1 & 0xFFFF) < sock->sendLen[sock->sendFirst]) {
+      rc = ECONNABORTED; /* short send: bytes of the stream lost */
+    }
+    if (rc != EOK && sock->sendError == 0) { sock->sendError = rc; }
+    nicofclt_freeRequest(h);
+    sock->sendQueue[sock->sendFirst] = NULL_REQUEST;
+    sock->sendFirst = (sock->sendFirst + 1) % SEND_WINDOW_MAX;
+    sock->sendCount--;
+  }
+  if (sock->sendError != 0) {
+    errno = sock->sendError;
+    sock->sendError = 0;
+    return -1;
+  }
+  return 0;
+}
+ 
+/* send() through the send window of a stream socket: the data is passed to
+** the proxy and the call returns without waiting for the proxy to confirm
+** the transmission as long as the window is not full; errors are reported
+** by a later send(), closesocket() or shutdown()
+** sending 0 bytes waits for (non-blocking: checks for) the completion of
+** all queued sends
+*/
+static int sendWindowed(
+    SOCK sock,
+    SOCKET sockfd,
+    const ncs_char *buf,
+    ncs_int buflen,
+    ncs_uint flags) {
+  int nonBlocking = SOCK_ISSET(F_NBSELECT) || SOCK_ISSET(F_NONBLOCK);
+  int maxQueued = (buflen < 1) ? 0 : sock->sendWindow - 1;
+  if (collectSends(sock, maxQueued, !nonBlocking) != 0) { return -1; }
+  if (buflen < 1) {
+    if (sock->sendCount > 0) { RET_WITH_ERR(EALREADY); }
+    return 0;
+  }
+  if (sock->sendCount >= sock->sendWindow) { RET_WITH_ERR(EWOULDBLOCK); }
+ 
+  Printf("... send() : getting windowed request\n");
+  request_handle h = newSockRequest(CMD_SEND, sockfd, flags);
+  if (h == NULL) { RET_WITH_ERR(NO_RECOVERY); }
+ 
+  errno = nicofclt_setRequestData(h, buflen, (char*)buf);
+  if (errno != 0) { nicofclt_freeRequest(h); return -1; }
+ 
+  errno = nicofclt_sendRequestTo(h, proxy_userid);
+  if (errno != 0) { nicofclt_freeRequest(h); return -1; }
+ 
+  int idx = (sock->sendFirst + sock->sendCount) % SEND_WINDOW_MAX;
+  sock->sendQueue[idx] = h;
+  sock->sendLen[idx] = (ushort)buflen;
+  sock->sendCount++;
+  return buflen;
+}
+ 
 static int closeproxysocket(int sockNo) {
   Printf("... closeproxysocket(%d) : getting request\n", sockNo);
   request_handle h = newSockRequest(CMD_CLOSE, sockNo, 0);
@@ -440,8 +535,14 @@ int closesocket(SOCKET sockfd) {
     return -1;
   }
  
+  /* let the queued sends complete before closing the connection */
+  int sendRc = collectSends(sock, 0, 1);
+  int sendErr = errno;
+ 
   sockets[sockfd].flags = 0;
-  return closeproxysocket(sockfd);
+  if (closeproxysocket(sockfd) != 0) { return -1; }
+  if (sendRc != 0) { errno = sendErr; return -1; }
+  return 0;
 }
  
 int shutdown(SOCKET sockfd, int how) {
@@ -458,6 +559,9 @@ int shutdown(SOCKET sockfd, int how) {
     return -1;
   }
  
+  /* the queued sends must reach the proxy before the connection is shut */
+  if (collectSends(sock, 0, 1) != 0) { return -1; }
+ 
   Printf("... shutdown() : getting request\n");
   request_handle h = newSockRequest(CMD_SHUTDOWN, sockfd, 0);
   if (h == NULL) {
@@ -602,6 +706,10 @@ int send(
   if (buflen > 2048) { buflen = 2048; }
   request_handle h = sock->sendHandle;
  
+  if (h == NULL_REQUEST && sock->sendWindow > 0) {
+    return sendWindowed(sock, sockfd, buf, buflen, flags);
+  }
+ 
   if (h == NULL_REQUEST) {
     if (buflen < 1) { return 0; } /* no bytes to send => done */
  
@@ -1074,6 +1182,7 @@ SOCKET accept(
     errno = EMFILE;
     return -1;
   }
+  memset(&sockets[newSockNo], '\0', sizeof(SOCKENTRY));
   sockets[newSockNo].flags = F_ACTIVE | F_CLIENT;
   return newSockNo;
 }
@@ -1135,57 +1244,104 @@ int getpeername(
   return getSockInfo(CMD_GETPEERNAME, "getpeername", sockfd, addr, addrlen);
 }
  
-static fd_set dummyFdSet;
- 
 /* unique filter value      each select[X]() to filter relevant requests */
 static currFilterTag = 0;
  
-int selectX(
-    ncs_int num_fds,
-    fd_set *rd_fds_in,
-    fd_set *wr_fds_in,
-    fd_set *ex_fds_in,   /* ignored */
-    fd_set *rd_fds_out,
-    fd_set *wr_fds_out,
-    fd_set *ex_fds_out,
-    const struct timeval *timeout) {
+/* the pending SELECT request of the event channel and the sockets it watches,
+** (the request remains pending if pollSockets() returns by timeout, so the
+** next call watching the same sockets simply waits for it again)
+*/
+static request_handle selectHandle = NULL_REQUEST;
+static fd_set selectRdInterest;
+static fd_set selectWrInterest;
  
-  initSockets(); /* should not be necessary when selectX() is called... */
+/* start a SELECT request watching the sockets in the interest sets, ending
+** the pending SELECT request if it watches other sockets
+** returns 0 if successful or the NICOFCLT error code
+*/
+static int watchEvents(fd_set *rdInterest, fd_set *wrInterest) {
+  if (selectHandle != NULL_REQUEST
+      && memcmp(rdInterest, &selectRdInterest, FD_BYTES) == 0
+      && memcmp(wrInterest, &selectWrInterest, FD_BYTES) == 0) {
+    return 0; /* the pending request watches the same sockets */
+  }
+ 
+  Printf("... pollSockets() : getting event request\n");
+  request_handle h = newSockRequest(CMD_SELECT, 0, 0);
+  if (h == NULL) { return NO_RECOVERY; }
+ 
+  int rc = nicofclt_setRequestDataX(
+              h, FD_BYTES, (char*)rdInterest, FD_BYTES, (char*)wrInterest);
+  if (rc == 0) { rc = nicofclt_sendRequestTo(h, proxy_userid); }
+  if (rc != 0) { nicofclt_freeRequest(h); return rc; }
+ 
+  /* the new request ends the previous one, which is answered immediately */
+  if (selectHandle != NULL_REQUEST) {
+    nicofclt_waitForResponse(selectHandle);
+    nicofclt_freeRequest(selectHandle);
+  }
+  selectHandle = h;
+  memcpy(&selectRdInterest, rdInterest, FD_BYTES);
+  memcpy(&selectWrInterest, wrInterest, FD_BYTES);
+  return 0;
+}
  
-  Printf("## selectX() num_fds=%d\n",  num_fds);
+/* check if the request 'h' was tagged for the current wait and has its
+** response available
+*/
+#define isTaggedAvailable(h) \
+  ((h) && nicofclt_getFilterTag(h) == currFilterTag && nicofclt_isAvailable(h))
+ 
+/* common implementation of poll() and selectX(): watch the sockets in the
+** 'nfds' entries of 'fds' for the 'events' POLLIN resp. POLLOUT and wait up
+** to 'timeout10ms' for one of them to become ready, setting the 'revents' of
+** each entry (POLLIN, POLLOUT, POLLERR or POLLNVAL, also POLLOUT for
+** a completed non-blocking connect() watched with POLLIN)
+** the work done is proportional to the number of entries, not to the
+** highest socket number
+** returns 0 if successful or -1 with errno set
+*/
+static int pollSockets(struct pollfd *fds, int nfds, uint timeout10ms) {
  
-  /* prepare */
-  currFilterTag++;
-  FD_ZERO(&dummyFdSet);
-  if (!rd_fds_in) { rd_fds_in = &dummyFdSet; }
-  if (!wr_fds_in) { wr_fds_in = &dummyFdSet; }
-  if (!rd_fds_out) { rd_fds_out = &dummyFdSet; }
-  if (!wr_fds_out) { wr_fds_out = &dummyFdSet; }
-  if (!ex_fds_out) { ex_fds_out = &dummyFdSet; }
-  if (num_fds < 1) { num_fds = 0; }
-  if (num_fds >= FD_SETSIZE) { num_fds = FD_SETSIZE; }
+  initSockets(); /* should not be necessary when polling... */
  
-  /* interpret the input fd-sets */
+  Printf("## pollSockets() nfds=%d\n",  nfds);
+ 
+  /* interpret the entries: stream sockets without a pending operation are
+  ** watched through the event channel, whereas datagram sockets and
+  ** sockets with an operation underway are watched through the request of
+  ** the operation */
+  currFilterTag++;
+  fd_set rdInterest;
+  fd_set wrInterest;
+  FD_ZERO(&rdInterest);
+  FD_ZERO(&wrInterest);
+  int useEvents = 0; /* will be 1 if some socket is watched by the channel */
   int activeHandles = 0;
   int noWait = 0; /* will be 1 if some socket is already ready */
-  int i;
+  int k;
   int rc;
-  for (i = 0; i < num_fds; i++) {
+  for (k = 0; k < nfds; k++) {
+    struct pollfd *p = &fds[k];
+    int i = p->fd;
+    p->revents = 0;
+    if (i < 0) { continue; }
     SOCK sock = getSOCK(i);
-    if (!sock) { continue; }
-    if (FD_ISSET(i, rd_fds_in)) {
-      if (!sock->recvHandle) {
+    if (!sock) {
+      p->revents = POLLNVAL;
+      noWait = 1;
+      continue;
+    }
+    if (p->events & POLLIN) {
+      if (!sock->recvHandle && SOCK_ISNOTSET(F_DGRAM)
+          && (SOCK_ISSET(F_SERVER) || SOCK_ISSET(F_CLIENT))) {
+        FD_SET(i, &rdInterest);
+        useEvents = 1;
+      } else if (!sock->recvHandle && SOCK_ISSET(F_CLIENT)) {
         SOCK_SET(F_NBSELECT);
-        if (SOCK_ISSET(F_SERVER)) {
-          rc = accept(i, NULL, NULL);
-          Printf("  ... accept(%d, NULL, NULL) -> %d\n", i, rc);
-          /* rc should be -1 and errno = EWOULDBLOCK */
-        } else if (SOCK_ISSET(F_CLIENT)) {
-          SOCK_SET(F_NBSELECT);
-          rc = recv(i, NULL, 2048, 0);
-          Printf("  ... recv(%d, 2048) -> %d\n", i, rc);
-          /* rc should be -1 and errno = EWOULDBLOCK */
-        }
+        rc = recv(i, NULL, 2048, 0);
+        Printf("  ... recv(%d, 2048) -> %d\n", i, rc);
+        /* rc should be -1 and errno = EWOULDBLOCK */
         SOCK_UNSET(F_NBSELECT);
         errno = 0;
       }
@@ -1199,44 +1355,49 @@ int selectX(
         }
       }
     } else if (sock->recvHandle
-               && FD_ISSET(i, wr_fds_in)
+               && (p->events & POLLOUT)
                && SOCK_ISSET(F_PENDCONN)) {
       nicofclt_setFilterTag(sock->recvHandle, currFilterTag);
       activeHandles++;
       if (nicofclt_isAvailable(sock->recvHandle)) { noWait = 1; }
     }
-    if (FD_ISSET(i, wr_fds_in) && sock->sendHandle) {
+    if ((p->events & POLLOUT) && sock->sendHandle) {
       nicofclt_setFilterTag(sock->sendHandle, currFilterTag);
       activeHandles++;
-      if (nicofclt_isAvailable(sock->recvHandle)) { noWait = 1; }
+      if (nicofclt_isAvailable(sock->sendHandle)) { noWait = 1; }
+    } else if ((p->events & POLLOUT) && sock->sendCount > 0) {
+      request_handle oldest = sock->sendQueue[sock->sendFirst];
+      nicofclt_setFilterTag(oldest, currFilterTag);
+      activeHandles++;
+      if (nicofclt_isAvailable(oldest)) { noWait = 1; }
+    } else if ((p->events & POLLOUT)
+               && SOCK_ISNOTSET(F_DGRAM) && SOCK_ISSET(F_CLIENT)) {
+      FD_SET(i, &wrInterest);
+      useEvents = 1;
     }
   }
  
-  /* interpret the timeout */
-  uint timeout10ms = NO_TIMEOUT;
-  if (timeout && timeout->tv_sec == 0 && timeout->tv_usec == 0) {
-    timeout10ms = 0;
-  } else if (timeout) {
-    timeout10ms = timeout->tv_sec * 100;
-    timeout10ms += (timeout->tv_usec + 9999) / 10000;
-    if (timeout10ms == 0) { timeout10ms = 1; }
+  /* watch the stream sockets through a single event request */
+  if (useEvents) {
+    errno = watchEvents(&rdInterest, &wrInterest);
+    if (errno != 0) { return -1; }
+    nicofclt_setFilterTag(selectHandle, currFilterTag);
+    activeHandles++;
+    if (nicofclt_isAvailable(selectHandle)) { noWait = 1; }
   }
  
-  Printf("## selectX() filter=%d activeHandles=%d noWait=%d timeout10ms=%d\n",
+  Printf("## pollSockets() filter=%d activeHandles=%d noWait=%d timeout10ms=%d\n",
     currFilterTag, activeHandles, noWait, timeout10ms);
  
   if (activeHandles == 0) { /* effectively nothing to watch */
     /* some misuse select() as sub-second timer, so wait for timeout ... */
-    if (timeout10ms > 0 && timeout10ms != NO_TIMEOUT) {
+    if (!noWait && timeout10ms > 0 && timeout10ms != NO_TIMEOUT) {
       _full timer_ecb = 0;
       set_timer(timeout10ms, &timer_ecb);
       wait_ecb(&timer_ecb);
     }
  
-    /* ... and return 'nothing' */
-    FD_ZERO(rd_fds_out);
-    FD_ZERO(wr_fds_out);
-    FD_ZERO(ex_fds_out);
+    /* ... and return 'nothing' (except for invalid sockets) */
     return 0;
   } else if (noWait) {
     timeout10ms = 0;
@@ -1258,39 +1419,159 @@ int selectX(
   }
   errno = 0;
  
-  /* record the ingone responses in the output fd-sets */
-  int activeSockets = 0;
-  FD_ZERO(rd_fds_out);
-  FD_ZERO(wr_fds_out);
-  FD_ZERO(ex_fds_out);
-  for (i = 0; i < num_fds; i++) {
+  /* get the socket states delivered by the event channel */
+  char events[4 * FD_BYTES];
+  fd_set *evReadable = (fd_set*)&events[0];
+  fd_set *evWritable = (fd_set*)&events[FD_BYTES];
+  fd_set *evAcceptable = (fd_set*)&events[2 * FD_BYTES];
+  fd_set *evFailed = (fd_set*)&events[3 * FD_BYTES];
+  memset(events, '\0', sizeof(events));
+  if (useEvents && nicofclt_isAvailable(selectHandle)) {
+    int eventsLen;
+    nicofclt_getResponseData(selectHandle, sizeof(events), events, &eventsLen);
+    nicofclt_freeRequest(selectHandle);
+    selectHandle = NULL_REQUEST;
+  }
+ 
+  /* record the ingone responses in the entries */
+  for (k = 0; k < nfds; k++) {
+    struct pollfd *p = &fds[k];
+    int i = p->fd;
     SOCK sock = getSOCK(i);
-    int isSet = 0;
     if (!sock) { continue; }
     Printf("  ... checking fd %d\n", i);
-    if (sock->recvHandle) {
-      Printf("      -> filterTag=%d isAvailable=%d\n",
-        nicofclt_getFilterTag(sock->recvHandle),
-        nicofclt_isAvailable(sock->recvHandle));
-    }
-    if (sock->recvHandle
-        && nicofclt_getFilterTag(sock->recvHandle) == currFilterTag
-        && nicofclt_isAvailable(sock->recvHandle)) {
+    if (isTaggedAvailable(sock->recvHandle)) {
       Printf("  ... recv-activity on fd %d\n", i);
-      if (SOCK_ISSET(F_PENDCONN)) {
-        FD_SET(i, wr_fds_out);
-      } else {
-        FD_SET(i, rd_fds_out);
+      p->revents |= (SOCK_ISSET(F_PENDCONN)) ? POLLOUT : POLLIN;
+    }
+    if (isTaggedAvailable(sock->sendHandle)) {
+      Printf("  ... send-activity on fd %d\n", i);
+      p->revents |= POLLOUT;
+    }
+    if (sock->sendCount > 0
+        && isTaggedAvailable(sock->sendQueue[sock->sendFirst])) {
+      Printf("  ... send-window-activity on fd %d\n", i);
+      p->revents |= POLLOUT;
+    }
+    if (FD_ISSET(i, &rdInterest)) {
+      if (FD_ISSET(i, evReadable) || FD_ISSET(i, evAcceptable)) {
+        p->revents |= POLLIN;
       }
+      if (FD_ISSET(i, evFailed)) { p->revents |= POLLERR; }
+    }
+    if (FD_ISSET(i, &wrInterest)) {
+      if (FD_ISSET(i, evWritable)) { p->revents |= POLLOUT; }
+      if (FD_ISSET(i, evFailed)) { p->revents |= POLLERR; }
+    }
+  }
+ 
+  return 0;
+}
+ 
+/* convert a select() timeout to the 1/100 seconds used by NICOFCLT */
+static uint timevalTo10ms(const struct timeval *timeout) {
+  if (!timeout) { return NO_TIMEOUT; }
+  if (timeout->tv_sec == 0 && timeout->tv_usec == 0) { return 0; }
+  uint timeout10ms = timeout->tv_sec * 100;
+  timeout10ms += (timeout->tv_usec + 9999) / 10000;
+  return (timeout10ms == 0) ? 1 : timeout10ms;
+}
+ 
+int poll(struct pollfd *fds, ncs_uint nfds, ncs_int timeout) {
+  if (nfds > 0 && !fds) { RET_WITH_ERR(EINVAL); }
+ 
+  uint timeout10ms = NO_TIMEOUT;
+  if (timeout == 0) {
+    timeout10ms = 0;
+  } else if (timeout > 0) {
+    timeout10ms = (timeout + 9) / 10;
+  }
+ 
+  if (pollSockets(fds, nfds, timeout10ms) != 0) { return -1; }
+ 
+  /* report only the requested events besides the error conditions */
+  int count = 0;
+  int k;
+  for (k = 0; k < nfds; k++) {
+    fds[k].revents &= (fds[k].events | POLLERR | POLLHUP | POLLNVAL);
+    if (fds[k].revents) { count++; }
+  }
+  return count;
+}
+ 
+/* the poll entries for the sockets of a selectX() call */
+static struct pollfd selectFds[FD_SETSIZE];
+ 
+int selectX(
+    ncs_int num_fds,
+    fd_set *rd_fds_in,
+    fd_set *wr_fds_in,
+    fd_set *ex_fds_in,   /* failed stream sockets are reported */
+    fd_set *rd_fds_out,
+    fd_set *wr_fds_out,
+    fd_set *ex_fds_out,
+    const struct timeval *timeout) {
+ 
+  initSockets(); /* should not be necessary when selectX() is called... */
+ 
+  Printf("## selectX() num_fds=%d\n",  num_fds);
+ 
+  if (num_fds < 1) { num_fds = 0; }
+  if (num_fds >= FD_SETSIZE) { num_fds = FD_SETSIZE; }
+ 
+  /* collect the valid sockets of the input sets as poll entries, skipping
+  ** the empty bytes of the sets (invalid sockets are silently ignored)
+  */
+  int nfds = 0;
+  int byteCount = (num_fds + 7) / 8;
+  int b;
+  for (b = 0; b < byteCount; b++) {
+    ncs_uchar rdBits = (rd_fds_in) ? rd_fds_in->fd_bytes[b] : 0;
+    ncs_uchar wrBits = (wr_fds_in) ? wr_fds_in->fd_bytes[b] : 0;
+    ncs_uchar exBits = (ex_fds_in) ? ex_fds_in->fd_bytes[b] : 0;
+    ncs_uchar bits = rdBits | wrBits | exBits;
+    int i;
+    for (i = b * 8; bits && i < num_fds; i++, bits <<= 1) {
+      if (!(bits & 0x80) || !getSOCK(i)) { continue; }
+      struct pollfd *p = &selectFds[nfds++];
+      p->fd = i;
+      p->events = 0;
+      if (rd_fds_in && FD_ISSET(i, rd_fds_in)) { p->events |= POLLIN; }
+      if (wr_fds_in && FD_ISSET(i, wr_fds_in)) { p->events |= POLLOUT; }
+      if (ex_fds_in && FD_ISSET(i, ex_fds_in)) { p->events |= POLLPRI; }
+    }
+  }
+ 
+  if (pollSockets(selectFds, nfds, timevalTo10ms(timeout)) != 0) {
+    return -1;
+  }
+ 
+  /* record the ready sockets in the output fd-sets (which may be the input
+  ** sets for select(), so the interests are taken from the entries) */
+  if (rd_fds_out) { FD_ZERO(rd_fds_out); }
+  if (wr_fds_out) { FD_ZERO(wr_fds_out); }
+  if (ex_fds_out) { FD_ZERO(ex_fds_out); }
+  int activeSockets = 0;
+  int k;
+  for (k = 0; k < nfds; k++) {
+    struct pollfd *p = &selectFds[k];
+    int i = p->fd;
+    int failed = (p->revents & POLLERR);
+    int isSet = 0;
+    if (rd_fds_out
+        && ((p->revents & POLLIN) || (failed && (p->events & POLLIN)))) {
+      FD_SET(i, rd_fds_out);
       isSet = 1;
     }
-    if (sock->sendHandle
-        && nicofclt_getFilterTag(sock->sendHandle) == currFilterTag
-        && nicofclt_isAvailable(sock->sendHandle)) {
-      Printf("  ... send-activity on fd %d\n", i);
+    if (wr_fds_out
+        && ((p->revents & POLLOUT) || (failed && (p->events & POLLOUT)))) {
       FD_SET(i, wr_fds_out);
       isSet = 1;
     }
+    if (ex_fds_out && failed && (p->events & POLLPRI)) {
+      FD_SET(i, ex_fds_out);
+      isSet = 1;
+    }
     if (isSet) { activeSockets++; }
   }
  
@@ -1326,6 +1607,47 @@ int ioctlsocket(SOCKET sockfd, long flag, ncs_uint *value) {
   return -1;
 }
  
+int setsockopt(
+    SOCKET sockfd,
+    ncs_int level,
+    ncs_int optname,
+    const ncs_char *optval,
+    ncs_int optlen) {
+  initSockets(); /* initialize if needed */
+ 
+  GETSOCK(sockfd);
+  if (level != SOL_SOCKET || optname != SO_SNDBUF) { RET_WITH_ERR(EINVAL); }
+  if (!optval || optlen < (ncs_int)sizeof(ncs_int)) { RET_WITH_ERR(EINVAL); }
+  if (SOCK_ISSET(F_DGRAM)) { RET_WITH_ERR(EOPNOTSUPP); }
+ 
+  /* shrinking the window requires the queued sends to be completed */
+  if (collectSends(sock, 0, 1) != 0) { return -1; }
+ 
+  ncs_int bytes = *((ncs_int*)optval);
+  int window = (bytes + 2047) / 2048;
+  if (window > SEND_WINDOW_MAX) { window = SEND_WINDOW_MAX; }
+  sock->sendWindow = (window > 1) ? window : 0;
+  return 0;
+}
+ 
+int getsockopt(
+    SOCKET sockfd,
+    ncs_int level,
+    ncs_int optname,
+    ncs_char *optval,
+    ncs_int *optlen) {
+  initSockets(); /* initialize if needed */
+ 
+  GETSOCK(sockfd);
+  if (level != SOL_SOCKET || optname != SO_SNDBUF) { RET_WITH_ERR(EINVAL); }
+  if (!optval || !optlen || *optlen < (ncs_int)sizeof(ncs_int)) { RET_WITH_ERR(EINVAL); }
+ 
+  int window = (sock->sendWindow > 1) ? sock->sendWindow : 1;
+  *((ncs_int*)optval) = window * 2048;
+  *optlen = sizeof(ncs_int);
+  return 0;
+}
+ 
 void dumpSocket(int sockfd) {
   printf("-- socket[%d]:", sockfd);
   SOCK sock = getSOCK(sockfd);
@@ -1352,4 +1674,8 @@ void dumpSocket(int sockfd) {
     printf("   -> sendHandle( %s )\n",
       nicofclt_getStateString(sock->sendHandle));
   }
+  if (sock->sendWindow > 0) {
+    printf("   -> sendWindow %d, queued sends %d\n",
+      sock->sendWindow, sock->sendCount);
+  }
 }
@@ -39,11 +39,62 @@
 **        The file content is transferred in binary mode, no conversion is made.
 **        If the file exists, REPLACE must be given to overwrite it.
 **
+**   NHFS PUTIMG fn ft [ dir1 [ ...] ] [ ( [ REPLACE ] [ UNPACK ] ]
+**     -> copy the CMS file 'fn ft A' as CMS file image to the file fn.ft in
+**        the user's area (resp. the subdirectory), keeping the RECFM, LRECL
+**        and the record boundaries without any conversion.
+**        With UNPACK, the records are converted to ASCII text lines on the
+**        host side and stored as text file instead of the image.
+**        If the file exists, REPLACE must be given to overwrite it.
+**
+**   NHFS GETIMG fn ft [ dir1 [ ...] ] [ ( [ REPLACE ] ]
+**     -> recreate the CMS file 'fn ft A' with the RECFM, LRECL and records of
+**        the CMS file image fn.ft in the user's area (resp. subdirectory).
+**        If the file exists, REPLACE must be given to overwrite it.
+**
+**   NHFS MPUT fnpat ftpat [ dir1 [ ...] ] [ ( [ REPLACE ] ]
+**   NHFS MPUTBIN fnpat ftpat [ dir1 [ ...] ] [ ( [ REPLACE ] ]
+**     -> copy all CMS files on disk A matching 'fnpat ftpat' (with the CMS
+**        wildcards '*' and '%') like PUT resp. PUTBIN, all in one session
+**        with up to STREAMS files at once, and print a summary with the
+**        throughput.
+**
+**   NHFS MGET fnpat ftpat [ dir1 [ ...] ] [ ( [ REPLACE ] [ RECFM x ] [ LRECL x ] ]
+**   NHFS MGETBIN fnpat ftpat [ dir1 [ ...] ] [ ( [ REPLACE ] [ RECFM x ] [ LRECL x ] ]
+**     -> copy all files in the user's area (subdirectory) matching 'fnpat ftpat'
+**        like GET resp. GETBIN, all in one session with up to STREAMS files
+**        at once, and print a summary with the throughput.
+**
+**   NHFS SYNC fnpat ftpat [ dir1 [ ...] ] [ ( [ TOHOST | TOCMS ] [ HASH ]
+**                                          [ MANIFEST fn ] ]
+**   NHFS SYNCBIN fnpat ftpat [ dir1 [ ...] ] [ ( [ TOHOST | TOCMS ] [ HASH ]
+**                                          [ MANIFEST fn ] ]
+**     -> transfer only the files matching 'fnpat ftpat' that are new or were
+**        changed since the last sync from the CMS disk A to the user's area
+**        (subdirectory) with TOHOST (default) resp. in the other direction
+**        with TOCMS, in text resp. binary mode.
+**        The state of the files (CMS date/time and record count, host size
+**        and timestamp) after the last sync is kept in the manifest file
+**        'fn MANIFEST A' (default: NHFSSYNC), a file is transferred if it is
+**        missing or its state differs on either side.
+**        With HASH, the checksum of host files is kept in the manifest, so
+**        host files with a new timestamp but unchanged content are not
+**        transferred again.
+**
 **   NHFS MKDIR dirname [ dir1 [ dir2 [...] ] ]
 **     -> create a new subdirectory 'dirname' in the user's area resp. in the
 **        subdirectory given.
 **
 ** When transferring files, the CMS file LRECL is limited to 255 characters.
+** The option WINDOW n (1..8, default 4) gives the number of block requests
+** kept in flight for each file transferred, overlapping the CMS disk I/O with
+** the transfer of the next blocks.
+** The option STREAMS n (1..8, default 4) gives the number of files
+** transferred at once by MPUT and MGET, each with its own bulk stream, so
+** the block requests of all these streams are in flight together.
+** The option BLOCK n (default 4096) gives the number of bytes read resp.
+** written with one CMS call for RECFM F files, so several records are
+** transferred per FSREAD/FSWRITE.
 **
 **
 ** This software is provided "as is" in the hope that it will be useful, with
@@ -62,6 +113,7 @@
  
 #include "nhfscomn.h"
 #include "svc_nhfs.h"
+#include "ncfbases.h"
  
 /*
 ** MAIN CODE
@@ -103,10 +155,49 @@ static int interpretOptions(int argc, char *argv[], bool paramsEndOnly) {
         printf("Command option incomplete (missing/invalid LRECL value)\n");
         return -1;
       }
+    } else if (strequiv(p, "window")) {
+      i++;
+      if (i < argc) { p = argv[i]; }
+      window = atoi(p);
+      if (window < 1 || window > NCFIO_MAXWINDOW) {
+        printf("Command option incomplete (missing/invalid WINDOW value)\n");
+        return -1;
+      }
+    } else if (strequiv(p, "streams")) {
+      i++;
+      if (i < argc) { p = argv[i]; }
+      streams = atoi(p);
+      if (streams < 1 || streams > XFER_MAXSTREAMS) {
+        printf("Command option incomplete (missing/invalid STREAMS value)\n");
+        return -1;
+      }
+    } else if (strequiv(p, "block")) {
+      i++;
+      if (i < argc) { p = argv[i]; }
+      blockSize = atoi(p);
+      if (blockSize < 1 || blockSize > RECIO_MAX_BLOCKSIZE) {
+        printf("Command option incomplete (missing/invalid BLOCK value)\n");
+        return -1;
+      }
+    } else if (strequiv(p, "tohost")) {
+      syncToHost = true;
+    } else if (strequiv(p, "tocms")) {
+      syncToHost = false;
+    } else if (strequiv(p, "hash")) {
+      syncHash = true;
+    } else if (strequiv(p, "manifest")) {
+      i++;
+      if (i >= argc || strlen(argv[i]) > 8) {
+        printf("Command option incomplete (missing/invalid MANIFEST filename)\n");
+        return -1;
+      }
+      strcpy(syncManifest, argv[i]);
     } else if (strequiv(p, "append")) {
       doAppend = true;
     } else if (strequiv(p, "replace")) {
       doReplace = true;
+    } else if (strequiv(p, "unpack")) {
+      doUnpack = true;
     } else {
       printf("Invalid option '%s'\n", p);
       return -1;
@@ -121,6 +212,192 @@ static int interpretOptions(int argc, char *argv[], bool paramsEndOnly) {
  
 #define DONE(rc) { nicofclt_deinit(); return rc; }
  
+/* open the CMS file 'fn ft A' and the host file fn.ft in the directory given
+   by the path elements for the transfer 'x' to the host, as image or in text
+   or binary mode depending on 'doImage' and 'doText', returning 0 if
+   successful or the return code for the command
+*/
+static int startPut(
+    CMSXFER *x,
+    char *fn, char *ft,
+    char **pathElems, int pathCount) {
+  int rc = openFile(x, fn, ft, "A", true);
+  if (rc != 0) { return rc; }
+  BULKSTREAM stream = (doImage)
+                    ? hostfs_putimage(
+                        fn, ft,
+                        doReplace, doUnpack,
+                        pathElems, pathCount)
+                    : hostfs_putfile(
+                        fn, ft,
+                        doReplace,
+                        pathElems, pathCount,
+                        doText);
+  if (stream == NULL) {
+    printf("** error accessing host file\n");
+    printf("** reason: %s\n", hostfs_lastErrmsg());
+    closeFile(x);
+    return 24;
+  }
+  if (doImage) { /* the CMS file is sent with writeImage() */
+    x->stream = stream;
+    nsetwindow(stream, window);
+    return 0;
+  }
+  transferStart(x, stream, true);
+  return 0;
+}
+ 
+/* open the host file fn.ft in the directory given by the path elements and
+   the CMS file 'fn ft A' for the transfer 'x' to CMS, as image or in text or
+   binary mode depending on 'doImage' and 'doText', returning 0 if
+   successful or the return code for the command
+*/
+static int startGet(
+    CMSXFER *x,
+    char *fn, char *ft,
+    char **pathElems, int pathCount) {
+  if (f_exists(fn, ft, "A") && !doReplace) {
+    printf("** CMS file already exists, transfer aborted\n");
+    return 24;
+  }
+  BULKSTREAM stream = hostfs_getfile(
+                        fn, ft,
+                        pathElems, pathCount,
+                        doText && !doImage);
+  if (stream == NULL) {
+    printf("** unable to access host file, aborting\n");
+    printf("** reason: %s\n", hostfs_lastErrmsg());
+    return 24;
+  }
+  if (doImage) { /* the CMS file is created by readImage() */
+    x->stream = stream;
+    nsetwindow(stream, window);
+    return 0;
+  }
+  int rc = openFile(x, fn, ft, "A", false);
+  if (rc != 0) {
+    nclose(stream);
+    return rc;
+  }
+  transferStart(x, stream, false);
+  return 0;
+}
+ 
+/* the single file transferred with putFile() resp. getFile() */
+static CMSXFER xfer;
+ 
+/* copy the CMS file 'fn ft A' to the host file fn.ft in the directory given
+   by the path elements, as image or in text or binary mode depending on
+   'doImage' and 'doText', returning 0 if successful or the return code
+   for the command
+*/
+static int putFile(char *fn, char *ft, char **pathElems, int pathCount) {
+  int rc = startPut(&xfer, fn, ft, pathElems, pathCount);
+  if (rc != 0) { return rc; }
+  if (!doImage) { return transferFile(&xfer); }
+ 
+  rc = writeImage(&xfer, fn, ft, "A", xfer.stream);
+  closeFile(&xfer);
+  int err = nclose(xfer.stream);
+  if (rc == 0 && err != NERR_NOERROR) {
+    printf("** error writing to host file, transfer aborted\n");
+    printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+    rc = 24;
+  }
+  return rc;
+}
+ 
+/* copy the host file fn.ft in the directory given by the path elements to
+   the CMS file 'fn ft A', as image or in text or binary mode depending on
+   'doImage' and 'doText', returning 0 if successful or the return code
+   for the command
+*/
+static int getFile(char *fn, char *ft, char **pathElems, int pathCount) {
+  int rc = startGet(&xfer, fn, ft, pathElems, pathCount);
+  if (rc != 0) { return rc; }
+  if (!doImage) { return transferFile(&xfer); }
+ 
+  rc = readImage(&xfer, fn, ft, "A", xfer.stream);
+  int err = nclose(xfer.stream);
+  if (rc == 0 && err != NERR_NOERROR) {
+    printf("** error reading from host file\n");
+    printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+    rc = 24;
+  }
+  return rc;
+}
+ 
+/* the directory path for the multi-file transfers and the sync operations */
+static char **xferPath = NULL;
+static int xferPathCount = 0;
+ 
+/* start the transfer of a file for MPUT[BIN] */
+static int startMput(CMSXFER *x, CMSFILEID *id) {
+  printf("%s %s -> host\n", id->fn, id->ft);
+  return startPut(x, id->fn, id->ft, xferPath, xferPathCount);
+}
+ 
+/* start the transfer of a file for MGET[BIN] */
+static int startMget(CMSXFER *x, CMSFILEID *id) {
+  printf("host -> %s %s A\n", id->fn, id->ft);
+  return startGet(x, id->fn, id->ft, xferPath, xferPathCount);
+}
+ 
+/* get the files in the host directory for the sync: "F fn ft size timestamp" */
+static int syncListHost(HOSTFILE **files) {
+  *files = NULL;
+  BULKSTREAM stream = hostfs_list(xferPath, xferPathCount);
+  if (stream == NULL) {
+    printf("** error listing host directory\n");
+    printf("** reason: %s\n", hostfs_lastErrmsg());
+    return -1;
+  }
+  int count = 0;
+  int capacity = 0;
+  char lineBuffer[81];
+  char *line;
+  while(line = ngetline(lineBuffer, 81, stream)) {
+    if (*line != 'F' || strlen(line) < 48) { continue; }
+    char *size = &line[20];
+    while (*size == ' ') { size++; }
+    char *stamp = size;
+    while (*stamp && *stamp != ' ') { stamp++; }
+    while (*stamp == ' ') { stamp++; }
+    line[10] = '\0';
+    line[19] = '\0';
+    addHostFile(
+      files, &count, &capacity,
+      &line[2], &line[11],
+      (unsigned int)atoi(size), stamp);
+  }
+  int err = nclose(stream);
+  if (err != NERR_NOERROR) { /* an incomplete listing would mislead the sync */
+    printf("** error listing host directory\n");
+    printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+    if (*files) { free(*files); }
+    *files = NULL;
+    return -1;
+  }
+  return count;
+}
+ 
+static int syncPutFile(char *fn, char *ft, char *fm) {
+  return putFile(fn, ft, xferPath, xferPathCount);
+}
+ 
+static int syncGetFile(char *fn, char *ft, char *fm) {
+  return getFile(fn, ft, xferPath, xferPathCount);
+}
+ 
+static bool syncChecksum(char *fn, char *ft, unsigned int *crc) {
+  return (hostfs_checksum(fn, ft, xferPath, xferPathCount, crc) == 0);
+}
+ 
+static SYNCOPS syncOps = {
+  &syncListHost, &syncPutFile, &syncGetFile, &syncChecksum
+  };
+ 
 int main(int argc, char *argv[]) {
   if (argc < 2) {
     printf("\nUsage:\n");
@@ -131,11 +408,33 @@ int main(int argc, char *argv[]) {
     printf("   %s putbin fn ft [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
     printf("   %s get fn ft [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
     printf("   %s getbin fn ft [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s putimg fn ft [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s getimg fn ft [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s mput fnpat ftpat [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s mputbin fnpat ftpat [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s mget fnpat ftpat [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s mgetbin fnpat ftpat [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s sync fnpat ftpat [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
+    printf("   %s syncbin fnpat ftpat [ dir1 [ dir2 ... ] ] [ ( options ]\n", argv[0]);
     printf("\n");
     printf("Options:\n");
-    printf("  REPLACE           (for: PUT, PUTBIN, GET, GETBIN)\n");
-    printf("  LRECL len         (for: GET, GETBIN; with len in 1..255)\n");
-    printf("  RECFM x           (for: GET, GETBIN; with x in V or F)\n");
+    printf("  REPLACE           (for: [M]PUT[BIN], [M]GET[BIN], PUTIMG, GETIMG)\n");
+    printf("  UNPACK            (for: PUTIMG; store the image as text file)\n");
+    printf("  LRECL len         (for: [M]GET[BIN]; with len in 1..255)\n");
+    printf("  RECFM x           (for: [M]GET[BIN]; with x in V or F)\n");
+    printf("  WINDOW n          (for: [M]PUT[BIN], [M]GET[BIN]; requests in flight\n");
+    printf("                     per file with n in 1..%d, default 4)\n",
+      NCFIO_MAXWINDOW);
+    printf("  STREAMS n         (for: MPUT[BIN], MGET[BIN]; files transferred at\n");
+    printf("                     once with n in 1..%d, default 4)\n",
+      XFER_MAXSTREAMS);
+    printf("  BLOCK n           (for: all transfers; bytes read/written per CMS\n");
+    printf("                     call for RECFM F files, default %d)\n",
+      RECIO_DEFAULT_BLOCKSIZE);
+    printf("  TOHOST | TOCMS    (for: SYNC[BIN]; direction, default TOHOST)\n");
+    printf("  HASH              (for: SYNC[BIN]; compare host file checksums)\n");
+    printf("  MANIFEST fn       (for: SYNC[BIN]; manifest 'fn MANIFEST A',\n");
+    printf("                     default NHFSSYNC)\n");
     printf("\n");
     return 0;
   }
@@ -176,7 +475,12 @@ int main(int argc, char *argv[]) {
         printf("%s\n", &line[1]);
       }
     }
-    nclose(stream);
+    int err = nclose(stream);
+    if (err != NERR_NOERROR) {
+      printf("** error listing host directory\n");
+      printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+      DONE(24);
+    }
   } else if (strequiv(argv[1], "type")) {
     argc = interpretOptions(argc, argv, true);
     if (argc < 0) { DONE(4); }
@@ -198,7 +502,12 @@ int main(int argc, char *argv[]) {
     while(line = ngetline(lineBuffer, 81, stream)) {
       printf("%s\n", line);
     }
-    nclose(stream);
+    int err = nclose(stream);
+    if (err != NERR_NOERROR) {
+      printf("** error reading from host file\n");
+      printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+      DONE(24);
+    }
   } else if (strequiv(argv[1], "mkdir")) {
     argc = interpretOptions(argc, argv, true);
     if (argc < 0) { DONE(4); }
@@ -212,166 +521,125 @@ int main(int argc, char *argv[]) {
       printf("** reason: %s\n", hostfs_lastErrmsg());
       DONE(12);
     }
-  } else if (strequiv(argv[1], "put")) {
+  } else if (strequiv(argv[1], "put") || strequiv(argv[1], "putbin")) {
+    doText = strequiv(argv[1], "put");
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
     if (argc < 4) {
-      printf("** missing arguments <fn ft> for subcommand put\n");
+      printf("** missing arguments <fn ft> for subcommand %s\n", argv[1]);
       DONE(4);
     }
-    int rc = openFile(argv[2], argv[3], "A", true);
-    if (rc != 0) { DONE(rc); }
-    BULKSTREAM stream = hostfs_putfile(
-                          argv[2], argv[3],
-                          doReplace,
-                          &argv[4], argc - 4,
-                          true);
-    if (stream == NULL) {
-      printf("** error accessing host file\n");
-      printf("** reason: %s\n", hostfs_lastErrmsg());
-      closeFile();
-      DONE(24);
-    }
-    bool eof;
-    int len;
-    len = readRecord(&eof);
-    while (!eof) {
-      if (!nputline(io_buffer, stream)) {
-        printf("** error writing to host file, trnasfer aborted\n");
-        printf("** reason: %s\n", hostfs_lastErrmsg());
-        closeFile();
-        nclose(stream);
-        DONE(24);
-      }
-      len = readRecord(&eof);
+    int rc = putFile(argv[2], argv[3], &argv[4], argc - 4);
+    DONE(rc);
+  } else if (strequiv(argv[1], "get") || strequiv(argv[1], "getbin")) {
+    doText = strequiv(argv[1], "get");
+    argc = interpretOptions(argc, argv, false);
+    if (argc < 0) { DONE(4); }
+    if (argc < 4) {
+      printf("** missing arguments <fn ft> for subcommand %s\n", argv[1]);
+      DONE(4);
     }
-    closeFile();
-    nclose(stream);
-  } else if (strequiv(argv[1], "putbin")) {
-    doText = false;
+    int rc = getFile(argv[2], argv[3], &argv[4], argc - 4);
+    DONE(rc);
+  } else if (strequiv(argv[1], "putimg") || strequiv(argv[1], "getimg")) {
+    doImage = true;
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
     if (argc < 4) {
-      printf("** missing arguments <fn ft> for subcommand putbin\n");
+      printf("** missing arguments <fn ft> for subcommand %s\n", argv[1]);
       DONE(4);
     }
-    int rc = openFile(argv[2], argv[3], "A", true);
-    if (rc != 0) { DONE(rc); }
-    BULKSTREAM stream = hostfs_putfile(
-                          argv[2], argv[3],
-                          doReplace,
-                          &argv[4], argc - 4,
-                          false);
-    if (stream == NULL) {
-      printf("** error accessing host file\n");
-      printf("** reason: %s\n", hostfs_lastErrmsg());
-      closeFile();
-      DONE(24);
+    int rc = (strequiv(argv[1], "putimg"))
+           ? putFile(argv[2], argv[3], &argv[4], argc - 4)
+           : getFile(argv[2], argv[3], &argv[4], argc - 4);
+    DONE(rc);
+  } else if (strequiv(argv[1], "mput") || strequiv(argv[1], "mputbin")) {
+    doText = strequiv(argv[1], "mput");
+    argc = interpretOptions(argc, argv, false);
+    if (argc < 0) { DONE(4); }
+    if (argc < 4) {
+      printf("** missing arguments <fn ft> for subcommand %s\n", argv[1]);
+      DONE(4);
     }
-    bool eof;
-    int len;
-    len = readRecord(&eof);
-    while (!eof && len >= 0) {
-      if (recfm == 'F' && len != lrecl) {
-        printf("*** recfm = 'F', lrecl = %d BUT len = %d\n", lrecl, len);
-      }
-      uint count = nwrite(io_buffer, len, stream);
-      if (count != lrecl && nerror(stream) != NERR_NOERROR) {
-        printf("** error writing to host file, transfer aborted\n");
-        printf("** reason: %s\n", hostfs_lastErrmsg());
-        closeFile();
-        nclose(stream);
-        DONE(24);
-      }
-      len = readRecord(&eof);
+    CMSFILEID *files;
+    int count = listCmsFiles(argv[2], argv[3], "A", &files);
+    if (count < 0) { DONE(24); }
+    if (count == 0) {
+      printf("** no CMS files found for '%s %s A'\n", argv[2], argv[3]);
+      DONE(28);
     }
-    closeFile();
-    nclose(stream);
-  } else if (strequiv(argv[1], "get")) {
+    time_t start;
+    time(&start);
+    xferPath = &argv[4];
+    xferPathCount = argc - 4;
+    int failed = transferFiles(files, count, &startMput);
+    free(files);
+    transferSummary(argv[1], count, failed, start);
+    DONE((failed > 0) ? 24 : 0);
+  } else if (strequiv(argv[1], "mget") || strequiv(argv[1], "mgetbin")) {
+    doText = strequiv(argv[1], "mget");
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
     if (argc < 4) {
-      printf("** missing arguments <fn ft> for subcommand get\n");
+      printf("** missing arguments <fn ft> for subcommand %s\n", argv[1]);
       DONE(4);
     }
-    if (f_exists(argv[2], argv[3], "A") && !doReplace) {
-      printf("** CMS file already exists, transfer aborted\n");
-      DONE(24);
-    }
-    BULKSTREAM stream = hostfs_getfile(
-                          argv[2], argv[3],
-                          &argv[4], argc - 4,
-                          true);
+    BULKSTREAM stream = hostfs_list(&argv[4], argc - 4);
     if (stream == NULL) {
-      printf("** unable to access host file, aborting\n");
+      printf("** error listing host directory\n");
       printf("** reason: %s\n", hostfs_lastErrmsg());
       DONE(24);
     }
-    int rc = openFile(argv[2], argv[3], "A", false);
-    if (rc != 0) {
-      nclose(stream);
-      DONE(rc);
-    }
+    /* collect the matching files first: "F fn       ft       size ..." */
+    CMSFILEID *files = NULL;
+    int count = 0;
+    int capacity = 0;
+    char lineBuffer[81];
     char *line;
-    while(line = ngetline(io_buffer, lrecl + 1, stream)) {
-      int len = strlen(line);
-      if (writeRecord(len)) {
-        closeFile();
-        nclose(stream);
-        DONE(24);
+    while(line = ngetline(lineBuffer, 81, stream)) {
+      if (*line != 'F' || strlen(line) < 19) { continue; }
+      char fn[9];
+      char ft[9];
+      int i;
+      for (i = 0; i < 8 && line[2 + i] != ' '; i++) { fn[i] = line[2 + i]; }
+      fn[i] = '\0';
+      for (i = 0; i < 8 && line[11 + i] != ' '; i++) { ft[i] = line[11 + i]; }
+      ft[i] = '\0';
+      if (patternMatch(argv[2], fn) && patternMatch(argv[3], ft)) {
+        addFileId(&files, &count, &capacity, fn, ft, "A");
       }
     }
-    if (!neof(stream)) {
-      printf("Error reading from host file, nerror = %d\n", nerror(stream));
-      closeFile();
-      nclose(stream);
+    int err = nclose(stream);
+    if (err != NERR_NOERROR) {
+      printf("** error listing host directory\n");
+      printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+      free(files);
       DONE(24);
     }
-    closeFile();
-    nclose(stream);
-  } else if (strequiv(argv[1], "getbin")) {
-    doText = false;
+    if (count == 0) {
+      printf("** no host files found for '%s %s'\n", argv[2], argv[3]);
+      DONE(28);
+    }
+    time_t start;
+    time(&start);
+    xferPath = &argv[4];
+    xferPathCount = argc - 4;
+    int failed = transferFiles(files, count, &startMget);
+    free(files);
+    transferSummary(argv[1], count, failed, start);
+    DONE((failed > 0) ? 24 : 0);
+  } else if (strequiv(argv[1], "sync") || strequiv(argv[1], "syncbin")) {
+    doText = strequiv(argv[1], "sync");
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
     if (argc < 4) {
-      printf("** missing arguments <fn ft> for subcommand getbin\n");
+      printf("** missing arguments <fn ft> for subcommand %s\n", argv[1]);
       DONE(4);
     }
-    if (f_exists(argv[2], argv[3], "A") && !doReplace) {
-      printf("** CMS file already exists, transfer aborted\n");
-      DONE(24);
-    }
-    BULKSTREAM stream = hostfs_getfile(
-                          argv[2], argv[3],
-                          &argv[4], argc - 4,
-                          false);
-    if (stream == NULL) {
-      printf("** unable to access host file, aborting\n");
-      printf("** reason: %s\n", hostfs_lastErrmsg());
-      DONE(24);
-    }
-    int rc = openFile(argv[2], argv[3], "A", false);
-    if (rc != 0) {
-      nclose(stream);
-      DONE(rc);
-    }
-    int recLen = nread(io_buffer, lrecl, false, stream);
-    while(!neof(stream) && nerror(stream) == NERR_NOERROR) {
-      if (writeRecord(recLen)) {
-        closeFile();
-        nclose(stream);
-        DONE(24);
-      }
-      recLen = nread(io_buffer, lrecl, false, stream);
-    }
-    if (!neof(stream)) {
-      printf("Error reading from host file, nerror = %d\n", nerror(stream));
-      closeFile();
-      nclose(stream);
-      DONE(24);
-    }
-    closeFile();
-    nclose(stream);
+    xferPath = &argv[4];
+    xferPathCount = argc - 4;
+    int rc = syncFiles(argv[2], argv[3], "A", "NHFSSYNC", &syncOps);
+    DONE(rc);
   } else {
     printf("** unknown subcommand '%s', aborting\n", argv[1]);
     DONE(4);
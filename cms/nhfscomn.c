@@ -93,11 +93,12 @@ bool doReplace = false;
 char recfm = 'V';
 int  lrecl = 80;
 bool doAppend = false;
-static char filename[128];
-static CMSFILE cmsfile;
-static CMSFILE *f = NULL;
-char io_buffer[544]; /* 512 bytes buffer + 32 spare */
-static int recordNum = 1;
+bool doImage = false;
+bool doUnpack = false;
+int  window = 4;
+int  blockSize = RECIO_DEFAULT_BLOCKSIZE;
+int  streams = 4;
+unsigned int bytesTransferred = 0;
  
 /* build a FID string from the components fn ft fm */
 void buildFid(char *fid, char *fn, char *ft, char *fm) {
@@ -125,34 +126,38 @@ bool f_exists(char *fn, char *ft, char *fm) {
   return (rc == 0);
 }
  
-/* try to open the file and:
-   - set global variable 'f' and return true if successfull
-   - send an error status and return false if the file cannot be opened
+/* open the file 'fn ft fm' for the transfer 'x' with the given mode and
+   record format, returning 0 if successful or the error code
 */
-int openFile(
+static int openFileAs(
+    CMSXFER *x,
     char *fn, char *ft, char *fm,
-    bool openForRead) {
-  memset(io_buffer, '\0', sizeof(io_buffer));
+    bool openForRead, bool text,
+    char fileRecfm, int fileLrecl, bool append) {
+  memset(x->io_buffer, '\0', sizeof(x->io_buffer));
+  x->f = NULL;
+  x->stream = NULL;
+  x->text = text;
+  x->recfm = fileRecfm;
+  x->lrecl = fileLrecl;
  
-  memset(filename, '\0', sizeof(filename));
-  char *fid = filename;
+  memset(x->filename, '\0', sizeof(x->filename));
+  char *fid = x->filename;
   buildFid(fid, fn, ft , fm);
  
   CMSFILEINFO *fInfo;
   int rc = CMSfileState(fid, &fInfo);
   if (rc == 28) {
     if (openForRead) {
-      f = NULL;
       printf("CMS file '%s' not found: file transfer canceled\n", fid);
       return rc;
     }
   } else if (rc != 0) {
-    f = NULL;
     printf(
       "Error accessing file '%s' (RC = %d): file transfer canceled\n",
       fid, rc);
     return rc;
-  } else if (!openForRead && !doAppend) {
+  } else if (!openForRead && !append) {
     /* file exists (rc = 0) and overwrite => delete it */
     rc = CMSfileErase(fid);
     if (rc != 0 && rc != 28) {
@@ -164,30 +169,19 @@ int openFile(
     return 4;
   }
  
-  int firstLine = 1;
-  if (!openForRead && doAppend) { firstLine = 0; }
-  rc = CMSfileOpen(
-         fid,
-         io_buffer,
-         (openForRead) ? sizeof(io_buffer)-1 : lrecl,
-         recfm,
-         1,         /* number of lines read/written per operation */
-         firstLine, /* first line to read/write */
-         &cmsfile);
-  if (rc == 0 || rc == 28) {
-    f = &cmsfile;
-    if (openForRead) {
-      recordNum = 0;
-    } else {
-      recordNum = (doAppend) ? 0 : 1;
-    }
+  rc = recOpen(
+         &x->recfile, fid, openForRead,
+         fileRecfm, fileLrecl, append, blockSize);
+  if (rc == 0) {
+    x->f = &x->recfile;
     return 0;
+  } else if (rc == RECIO_NOMEM) {
+    printf("Not enough memory for file buffer: file transfer canceled\n");
+    return rc;
   } else if (rc == 20) {
-    f = NULL;
     printf("Invalid file name '%s': file transfer canceled\n", fid);
     return rc;
   } else {
-    f = NULL;
     printf(
       "Error accessing file '%s' (RC = %d): file transfer canceled\n",
       fid, rc);
@@ -197,78 +191,906 @@ int openFile(
   return 2;
 }
  
-/* close the CMS file */
-void closeFile() {
-  if (f) { CMSfileClose(f); }
-  f = NULL;
+/* try to open the file for the transfer 'x' with the current options and:
+   - return 0 if successfull
+   - print an error message and return the error code if the file cannot
+     be opened
+*/
+int openFile(
+    CMSXFER *x,
+    char *fn, char *ft, char *fm,
+    bool openForRead) {
+  return openFileAs(
+           x, fn, ft, fm,
+           openForRead, doText,
+           recfm, lrecl, doAppend);
+}
+ 
+/* report the CMS return code 'rc' of a failed write */
+static void writeFailed(CMSXFER *x, int rc) {
+  if (rc == 4 || rc == 5 || rc == 20 || rc == 21) {
+    printf("Incorrect CMS filename '%s', transfer canceled\n", x->filename);
+  } else if (rc == 10 || rc == 13 || rc == 19) {
+    printf("CMS disk is full, file transfer canceled\n");
+  } else if (rc == 12) {
+    printf("CMS disk is read-only, file transfer canceled\n");
+  } else {
+    printf(
+      "Error writing CMS file '%s' (RC = %d): file transfer canceled\n",
+      x->filename, rc);
+  }
+}
+ 
+/* close the CMS file, writing the records still buffered,
+   return true if writing failed
+*/
+bool closeFile(CMSXFER *x) {
+  int rc = 0;
+  if (x->f) { rc = recClose(x->f); }
+  x->f = NULL;
+  if (rc != 0) {
+    writeFailed(x, rc);
+    return true;
+  }
+  return false;
 }
  
-/* read a record of the file into 'io_buffer',
+/* read a record of the file into 'x->io_buffer',
    set 'eof' to true if no more records are available,
    return the length of the record just read.
 */
-int readRecord(bool *eof) {
+int readRecord(CMSXFER *x, bool *eof) {
   int len = 0;
   *eof = false;
-  char msg[80];
-  int rc = CMSfileRead(f, recordNum, &len);
-  recordNum = 0;
+  int rc = recRead(x->f, x->io_buffer, &len);
   if (rc == 12) {
     *eof = true;
     len = 0;
   } else if (rc == 1) {
-    printf("CMS file '%s' not found\n", filename);
+    printf("CMS file '%s' not found\n", x->filename);
     len = -1;
   } else if (rc == 14 || rc == 15) {
-    printf("Invalid CMS file name '%s', transfer canceled\n", filename);
+    printf("Invalid CMS file name '%s', transfer canceled\n", x->filename);
     len = -1;
   } else if (rc != 0) {
     printf(
       "Error reading file '%s' (RC = %d): file transfer canceled\n",
-      filename, rc);
+      x->filename, rc);
     len = -1;
-  } else if (doText) {
-    char *p = &io_buffer[len-1];
-    while (p > io_buffer && *p == ' ') { len--; p--; } /* strip blanks a end */
-    io_buffer[len] = '\0';
+  } else if (x->text) {
+    char *p = &x->io_buffer[len-1];
+    while (p > x->io_buffer && *p == ' ') { len--; p--; } /* strip blanks a end */
+    x->io_buffer[len] = '\0';
   }
+  if (len > 0) { bytesTransferred += len; }
   return len;
 }
  
-/* write a record from 'io_buffer' with the specified record len,
+/* write a record from 'x->io_buffer' with the specified record len,
    return true if writing failed
 */
-bool writeRecord(int len) {
-  char fillChar = (doText) ? ' ' : '\0';
+bool writeRecord(CMSXFER *x, int len) {
+  char fillChar = (x->text) ? ' ' : '\0';
  
   if (len < 1) { /* avoid a "non-write" for empty records */
-    io_buffer[0] = fillChar;
+    x->io_buffer[0] = fillChar;
     len = 1;
   }
-  if (recfm == 'F' && len < lrecl) { /* fill fixed length records to LRECL */
-    char *tail = &io_buffer[len];
-    while(len < lrecl) {
+  if (x->recfm == 'F' && len < x->lrecl) { /* fill fixed length records to LRECL */
+    char *tail = &x->io_buffer[len];
+    while(len < x->lrecl) {
       *tail++ = fillChar;
       len++;
     }
   }
  
-  int rc = CMSfileWrite(f, recordNum, len);
-  recordNum = 0;
-  if (rc == 4 || rc == 5 || rc == 20 || rc == 21) {
-    printf("Incorrect CMS filename '%s', transfer canceled\n", filename);
-    return true;
-  } else if (rc == 10 || rc == 13 || rc == 19) {
-    printf("CMS disk is full, file transfer canceled\n");
-    return true;
-  } else if (rc == 12) {
-    printf("CMS disk is read-only, file transfer canceled\n");
-    return true;
-  } else if (rc != 0) {
-    char msg[80];
-    printf("Error writing CMS file (RC = %d): file transfer canceled\n", rc);
+  int rc = recWrite(x->f, x->io_buffer, len);
+  bytesTransferred += len;
+  if (rc != 0) {
+    writeFailed(x, rc);
     return true;
   }
   return false;
 }
  
+ 
+/*
+** step-wise file transfers
+*/
+ 
+/* bytes moved by one transferStep(), about one block of the bulk stream */
+#define XFER_STEP_BYTES 4096
+ 
+/* start the transfer between the CMS file opened in 'x' and the host file
+   'stream' in the given direction, in text or binary mode as given by
+   'doText' when the CMS file was opened
+*/
+void transferStart(CMSXFER *x, BULKSTREAM stream, bool toHost) {
+  x->stream = stream;
+  x->toHost = toHost;
+  nsetwindow(stream, window);
+  if (x->text) { /* let the proxy build resp. split the lines if possible */
+    nrecmode(stream, (toHost) ? 0 : x->lrecl, 0);
+  }
+}
+ 
+/* transfer the next records (about one stream block) of the transfer 'x',
+   returning XFER_MORE if the transfer is not complete, else 0 if all
+   records were transferred or the return code for the command
+*/
+int transferStep(CMSXFER *x) {
+  BULKSTREAM stream = x->stream;
+  int moved = 0;
+  bool eof;
+  int len;
+ 
+  while (moved < XFER_STEP_BYTES) {
+    if (x->toHost) {
+      len = readRecord(x, &eof);
+      if (eof) { return 0; }
+      if (len < 0) { return 24; }
+      if (x->recfm == 'F' && !x->text && len != x->lrecl) {
+        printf("*** recfm = 'F', lrecl = %d BUT len = %d\n", x->lrecl, len);
+      }
+      bool ok = (x->text)
+              ? nputline(x->io_buffer, stream)
+              : (nwrite(x->io_buffer, len, stream) == len);
+      if (!ok || nerror(stream) != NERR_NOERROR) {
+        printf("** error writing '%s' to host file, transfer aborted\n",
+          x->filename);
+        printf("** reason: %s\n", nerrmsg(stream));
+        return 24;
+      }
+    } else if (x->text) {
+      char *line = ngetline(x->io_buffer, x->lrecl + 1, stream);
+      if (!line) { return 0; }
+      len = strlen(line);
+      if (writeRecord(x, len)) { return 24; }
+    } else {
+      len = nread(x->io_buffer, x->lrecl, false, stream);
+      if (neof(stream) || nerror(stream) != NERR_NOERROR) { return 0; }
+      if (writeRecord(x, len)) { return 24; }
+    }
+    moved += len + 1; /* also count empty records */
+  }
+  return XFER_MORE;
+}
+ 
+/* end the transfer 'x' with the result 'rc' of the last transferStep(),
+   closing the CMS file and the host stream (reporting the errors of the
+   remaining write-behind requests), returning the return code for the
+   command
+*/
+int transferEnd(CMSXFER *x, int rc) {
+  if (rc == 0 && !x->toHost && !neof(x->stream)) {
+    printf("** error reading host file for '%s', transfer aborted\n",
+      x->filename);
+    printf("** reason: %s\n", nerrmsg(x->stream));
+    rc = 24;
+  }
+  if (closeFile(x) && rc == 0) { rc = 24; }
+  int err = nclose(x->stream); /* reports a failed write-behind request */
+  x->stream = NULL;
+  if (rc == 0 && err != NERR_NOERROR) {
+    printf((x->toHost)
+      ? "** error writing '%s' to host file, transfer aborted\n"
+      : "** error reading host file for '%s', transfer aborted\n",
+      x->filename);
+    printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+    rc = 24;
+  }
+  return rc;
+}
+ 
+/* do the complete transfer 'x' started with transferStart(), returning
+   0 if successful or the return code for the command
+*/
+int transferFile(CMSXFER *x) {
+  int rc = transferStep(x);
+  while (rc == XFER_MORE) { rc = transferStep(x); }
+  return transferEnd(x, rc);
+}
+ 
+ 
+/*
+** CMS file images
+*/
+ 
+/* the magic "CMSI" at the start of an image (always EBCDIC) */
+static const char imgMagic[4] = { 0xC3, 0xD4, 0xE2, 0xC9 };
+ 
+static void putWord(char *p, unsigned int w) {
+  p[0] = (w >> 24) & 0xFF;
+  p[1] = (w >> 16) & 0xFF;
+  p[2] = (w >> 8) & 0xFF;
+  p[3] = w & 0xFF;
+}
+ 
+static unsigned int getWord(char *p) {
+  unsigned char *u = (unsigned char*)p;
+  return (u[0] << 24) | (u[1] << 16) | (u[2] << 8) | u[3];
+}
+ 
+/* write the CMS file 'fn ft fm', already opened for reading with openFile()
+   in 'x', as image to the binary sink stream, returning 0 if successful or
+   the return code for the command
+*/
+int writeImage(
+    CMSXFER *x,
+    char *fn, char *ft, char *fm,
+    BULKSTREAM stream) {
+  char fid[19];
+  CMSFILEINFO *fInfo;
+  buildFid(fid, fn, ft, fm);
+  if (CMSfileState(fid, &fInfo) != 0) {
+    printf("CMS file '%s' not found: file transfer canceled\n", fid);
+    return 28;
+  }
+ 
+  char *hdr = nputrec(IMG_HEADER_LEN, false, stream);
+  if (!hdr) {
+    printf("** error writing to host file, transfer aborted\n");
+    return 24;
+  }
+  memcpy(hdr, imgMagic, 4);
+  hdr[4] = IMG_VERSION;
+  hdr[5] = fInfo->recordFormat;
+  hdr[6] = 0;
+  hdr[7] = 0;
+  putWord(&hdr[8], fInfo->lrecl);
+  putWord(&hdr[12], fInfo->recordCount);
+ 
+  /* records are copied unchanged, so don't strip blanks */
+  x->text = false;
+  bool eof;
+  int len = readRecord(x, &eof);
+  while (!eof && len >= 0) {
+    char *rec = nputrec(len + 2, false, stream);
+    if (!rec) {
+      printf("** error writing to host file, transfer aborted\n");
+      printf("** reason: %s\n", nerrmsg(stream));
+      return 24;
+    }
+    rec[0] = (len >> 8) & 0xFF;
+    rec[1] = len & 0xFF;
+    memcpy(&rec[2], x->io_buffer, len);
+    len = readRecord(x, &eof);
+  }
+  return (len < 0) ? 24 : 0;
+}
+ 
+/* read the image from the binary source stream into the CMS file 'fn ft fm'
+   created in 'x' with the RECFM and LRECL of the image, returning 0 if
+   successful or the return code for the command
+*/
+int readImage(
+    CMSXFER *x,
+    char *fn, char *ft, char *fm,
+    BULKSTREAM stream) {
+  char hdr[IMG_HEADER_LEN];
+  if (nread(hdr, IMG_HEADER_LEN, false, stream) != IMG_HEADER_LEN
+      || memcmp(hdr, imgMagic, 4) || hdr[4] != IMG_VERSION) {
+    printf("** host file is not a CMS file image, transfer aborted\n");
+    return 24;
+  }
+  unsigned int imgLrecl = getWord(&hdr[8]);
+  unsigned int imgCount = getWord(&hdr[12]);
+  if (hdr[5] != 'F' && hdr[5] != 'V') {
+    printf("** invalid RECFM in file image, transfer aborted\n");
+    return 24;
+  }
+  if (imgLrecl < 1 || imgLrecl > 255) {
+    printf("LRECL > 255 unsupported: file transfer canceled\n");
+    return 24;
+  }
+ 
+  /* create the file like the original */
+  int rc = openFileAs(x, fn, ft, fm, false, false, hdr[5], imgLrecl, false);
+ 
+  unsigned int count = 0;
+  char lenBytes[2];
+  while (rc == 0 && nread(lenBytes, 2, false, stream) == 2) {
+    int len = ((lenBytes[0] & 0xFF) << 8) | (lenBytes[1] & 0xFF);
+    if (len > x->lrecl || nread(x->io_buffer, len, false, stream) != len) {
+      printf("** invalid record in file image, transfer aborted\n");
+      rc = 24;
+    } else if (writeRecord(x, len)) {
+      rc = 24;
+    } else {
+      count++;
+    }
+  }
+  if (rc == 0 && !neof(stream)) {
+    printf("** error reading from host file, transfer aborted\n");
+    printf("** reason: %s\n", nerrmsg(stream));
+    rc = 24;
+  }
+  if (rc == 0 && imgCount != IMG_UNKNOWN_COUNT && count != imgCount) {
+    printf("** file image truncated (%d of %d records), transfer aborted\n",
+      count, imgCount);
+    rc = 24;
+  }
+  if (closeFile(x) && rc == 0) { rc = 24; }
+  return rc;
+}
+ 
+ 
+/*
+** multi-file transfers
+*/
+ 
+/* check if 'name' matches 'pattern' (case-insensitive), with the CMS
+   wildcards '*' (any number of chars) and '%' (exactly one char)
+*/
+bool patternMatch(char *pattern, char *name) {
+  while (*pattern) {
+    if (*pattern == '*') {
+      while (*pattern == '*') { pattern++; }
+      if (!*pattern) { return true; }
+      while (*name) {
+        if (patternMatch(pattern, name)) { return true; }
+        name++;
+      }
+      return false;
+    }
+    if (!*name) { return false; }
+    if (*pattern != '%' && toupper(*pattern) != toupper(*name)) {
+      return false;
+    }
+    pattern++;
+    name++;
+  }
+  return (*name == '\0');
+}
+ 
+/* copy at most 'maxLen' chars of 'src' to 'dest', terminated with a null char
+*/
+static void copyToken(char *dest, char *src, int maxLen) {
+  int i;
+  for (i = 0; i < maxLen && src[i] && src[i] != ' '; i++) { dest[i] = src[i]; }
+  dest[i] = '\0';
+}
+ 
+/* append the file id 'fn ft fm' to the list 'files' with 'count' entries,
+   growing the list (allocated with malloc) as needed.
+*/
+void addFileId(
+    CMSFILEID **files, int *count, int *capacity,
+    char *fn, char *ft, char *fm) {
+  if (*count >= *capacity) {
+    int newCapacity = (*capacity < 16) ? 16 : *capacity * 2;
+    CMSFILEID *newFiles = (CMSFILEID*)malloc(newCapacity * sizeof(CMSFILEID));
+    if (*files) {
+      memcpy(newFiles, *files, *count * sizeof(CMSFILEID));
+      free(*files);
+    }
+    *files = newFiles;
+    *capacity = newCapacity;
+  }
+  CMSFILEID *id = &(*files)[*count];
+  copyToken(id->fn, fn, 8);
+  copyToken(id->ft, ft, 8);
+  copyToken(id->fm, fm, 2);
+  (*count)++;
+}
+ 
+/* get the CMS files matching 'fnPat ftPat fmPat' (with LISTFILE),
+   returning the number of files found or -1 if LISTFILE failed,
+   the list of file ids is returned in 'files' (allocated with malloc)
+*/
+int listCmsFiles(
+    char *fnPat, char *ftPat, char *fmPat,
+    CMSFILEID **files) {
+  char line[133];
+  char cmd[80];
+  int count = 0;
+  int capacity = 0;
+  *files = NULL;
+ 
+  /* drain stack (remove any user input present) */
+  while(CMSstackQuery()) { CMSconsoleRead(line); }
+ 
+  sprintf(cmd, "LISTFILE %s %s %s ( FIFO", fnPat, ftPat, fmPat);
+  int rc = CMScommand(cmd, CMS_FUNCTION);
+  if (rc == 28) { return 0; } /* no files found */
+  if (rc != 0) {
+    printf("LISTFILE failed (RC = %d)\n", rc);
+    return -1;
+  }
+ 
+  /* the stacked lines are "fn ft fm" */
+  while(CMSstackQuery()) {
+    int len = CMSconsoleRead(line);
+    line[len] = '\0';
+    char *fn = line;
+    while (*fn == ' ') { fn++; }
+    char *ft = fn;
+    while (*ft && *ft != ' ') { ft++; }
+    while (*ft == ' ') { ft++; }
+    char *fm = ft;
+    while (*fm && *fm != ' ') { fm++; }
+    while (*fm == ' ') { fm++; }
+    if (!*fn || !*ft || !*fm) { continue; }
+    addFileId(files, &count, &capacity, fn, ft, fm);
+  }
+  return count;
+}
+ 
+/* transfer the 'count' files 'files' with up to 'streams' transfers at once,
+   each started in a free CMSXFER with 'start' (opening the CMS file and the
+   host file, then calling transferStart() and returning 0 if successful),
+   interleaving the blocks of the transfers so the requests of all streams
+   are in flight together, returning the number of failed transfers
+*/
+int transferFiles(
+    CMSFILEID *files, int count,
+    int (*start)(CMSXFER *x, CMSFILEID *id)) {
+  static CMSXFER xfers[XFER_MAXSTREAMS];
+  bool busy[XFER_MAXSTREAMS];
+  int slots = (streams < 1) ? 1 : streams;
+  if (slots > XFER_MAXSTREAMS) { slots = XFER_MAXSTREAMS; }
+  if (slots > count) { slots = count; }
+  int next = 0;
+  int running = 0;
+  int failed = 0;
+  int i;
+ 
+  for (i = 0; i < slots; i++) { busy[i] = false; }
+  while (next < count || running > 0) {
+    /* start the next files in the free slots */
+    for (i = 0; i < slots && next < count; i++) {
+      if (busy[i]) { continue; }
+      if (start(&xfers[i], &files[next++]) != 0) {
+        failed++;
+        i--; /* try the next file in the same slot */
+      } else {
+        busy[i] = true;
+        running++;
+      }
+    }
+ 
+    /* let each transfer move one block, so the streams overlap */
+    for (i = 0; i < slots; i++) {
+      if (!busy[i]) { continue; }
+      int rc = transferStep(&xfers[i]);
+      if (rc == XFER_MORE) { continue; }
+      if (transferEnd(&xfers[i], rc) != 0) { failed++; }
+      busy[i] = false;
+      running--;
+    }
+  }
+  return failed;
+}
+ 
+/* print the summary for the transfer of several files started at 'start'
+*/
+void transferSummary(char *what, int files, int failed, time_t start) {
+  time_t end;
+  time(&end);
+  unsigned int secs = (unsigned int)(end - start);
+  printf("%s: %d files transferred, %d failed, %d bytes in %d secs",
+    what, files - failed, failed, bytesTransferred, secs);
+  if (secs > 0) {
+    printf(" => %d bytes/sec\n", bytesTransferred / secs);
+  } else {
+    printf("\n");
+  }
+  printf("%s: %d CMS file I/O calls\n", what, recioCalls);
+}
+ 
+ 
+/*
+** incremental synchronization
+*/
+ 
+bool syncToHost = true;
+bool syncHash = false;
+char syncManifest[9] = "";
+ 
+/* get the next blank-separated token of the string at '*s' into 'dest',
+   returning false if there is no more token
+*/
+static bool nextToken(char **s, char *dest, int maxLen) {
+  char *p = *s;
+  while (*p == ' ') { p++; }
+  if (!*p) { return false; }
+  int i = 0;
+  while (*p && *p != ' ') {
+    if (i < maxLen) { dest[i++] = *p; }
+    p++;
+  }
+  dest[i] = '\0';
+  *s = p;
+  return true;
+}
+ 
+/* get the decimal number at the start of 's' */
+static unsigned int parseUint(char *s) {
+  unsigned int n = 0;
+  while (*s >= '0' && *s <= '9') { n = (n * 10) + (*s++ - '0'); }
+  return n;
+}
+ 
+/* get the state of the CMS file 'fn ft fm' as stamp (year, date, time)
+   and record count, returning false if the file does not exist
+*/
+static bool getCmsState(char *fn, char *ft, char *fm, char *stamp, int *records) {
+  char fid[19];
+  CMSFILEINFO *fInfo;
+ 
+  buildFid(fid, fn, ft, fm);
+  if (CMSfileState(fid, &fInfo) != 0) { return false; }
+  sprintf(stamp, "%04X%04X%04X",
+    (unsigned short)fInfo->fileYear,
+    (unsigned short)fInfo->filedate,
+    (unsigned short)fInfo->filetime);
+  *records = fInfo->recordCount;
+  return true;
+}
+ 
+/* append the host file 'fn.ft' to the list 'files' with 'count' entries,
+   growing the list (allocated with malloc) as needed.
+*/
+void addHostFile(
+    HOSTFILE **files, int *count, int *capacity,
+    char *fn, char *ft, unsigned int size, char *stamp) {
+  if (*count >= *capacity) {
+    int newCapacity = (*capacity < 16) ? 16 : *capacity * 2;
+    HOSTFILE *newFiles = (HOSTFILE*)malloc(newCapacity * sizeof(HOSTFILE));
+    if (*files) {
+      memcpy(newFiles, *files, *count * sizeof(HOSTFILE));
+      free(*files);
+    }
+    *files = newFiles;
+    *capacity = newCapacity;
+  }
+  HOSTFILE *h = &(*files)[*count];
+  copyToken(h->fn, fn, 8);
+  copyToken(h->ft, ft, 8);
+  h->size = size;
+  strncpy(h->stamp, stamp, 19);
+  h->stamp[19] = '\0';
+  (*count)++;
+}
+ 
+/* find the host file 'fn.ft' in the list */
+static HOSTFILE* findHostFile(HOSTFILE *files, int count, char *fn, char *ft) {
+  int i;
+  for (i = 0; i < count; i++) {
+    if (strequiv(files[i].fn, fn) && strequiv(files[i].ft, ft)) {
+      return &files[i];
+    }
+  }
+  return NULL;
+}
+ 
+/* find the manifest entry for 'fn ft' */
+static SYNCENTRY* findSyncEntry(SYNCENTRY *entries, int count, char *fn, char *ft) {
+  int i;
+  for (i = 0; i < count; i++) {
+    if (strequiv(entries[i].fn, fn) && strequiv(entries[i].ft, ft)) {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+ 
+/* append a new (empty) manifest entry for 'fn ft' */
+static SYNCENTRY* addSyncEntry(
+    SYNCENTRY **entries, int *count, int *capacity,
+    char *fn, char *ft) {
+  if (*count >= *capacity) {
+    int newCapacity = (*capacity < 16) ? 16 : *capacity * 2;
+    SYNCENTRY *newEntries = (SYNCENTRY*)malloc(newCapacity * sizeof(SYNCENTRY));
+    if (*entries) {
+      memcpy(newEntries, *entries, *count * sizeof(SYNCENTRY));
+      free(*entries);
+    }
+    *entries = newEntries;
+    *capacity = newCapacity;
+  }
+  SYNCENTRY *e = &(*entries)[*count];
+  memset(e, '\0', sizeof(SYNCENTRY));
+  copyToken(e->fn, fn, 8);
+  copyToken(e->ft, ft, 8);
+  (*count)++;
+  return e;
+}
+ 
+/* the manifest file being read resp. written */
+static CMSXFER manifestFile;
+ 
+/* read the manifest file 'fn MANIFEST fm', with one line per file:
+     fn ft cmsstamp cmsrecords hostsize hostdate hosttime hostcrc
+   returning the number of entries (0 if there is no manifest yet) or -1
+   if reading failed
+*/
+static int readManifest(
+    char *fn, char *fm,
+    SYNCENTRY **entries, int *capacity) {
+  int count = 0;
+  *entries = NULL;
+  *capacity = 0;
+  if (!f_exists(fn, SYNC_MANIFEST_FT, fm)) { return 0; }
+ 
+  CMSXFER *x = &manifestFile;
+  unsigned int oldBytes = bytesTransferred;
+  int rc = openFileAs(x, fn, SYNC_MANIFEST_FT, fm, true, true, 'V', 100, false);
+  if (rc != 0) { return -1; }
+  bool eof;
+  int len = readRecord(x, &eof);
+  while (!eof && len >= 0) {
+    char efn[9];
+    char eft[9];
+    char tok[20];
+    char *p = x->io_buffer;
+    if (nextToken(&p, efn, 8) && nextToken(&p, eft, 8)) {
+      SYNCENTRY *e = addSyncEntry(entries, &count, capacity, efn, eft);
+      if (nextToken(&p, e->cmsStamp, 12)) {
+        if (nextToken(&p, tok, 10)) { e->cmsRecords = (int)parseUint(tok); }
+        if (nextToken(&p, tok, 10)) { e->hostSize = parseUint(tok); }
+        if (nextToken(&p, tok, 10)) {
+          strcpy(e->hostStamp, tok);
+          if (nextToken(&p, tok, 8)) {
+            strcat(e->hostStamp, " ");
+            strcat(e->hostStamp, tok);
+          }
+        }
+        if (nextToken(&p, tok, 10)) { e->hostCrc = parseUint(tok); }
+      }
+    }
+    len = readRecord(x, &eof);
+  }
+  closeFile(x);
+  bytesTransferred = oldBytes;
+  return (len < 0) ? -1 : count;
+}
+ 
+/* (re)write the manifest file 'fn MANIFEST fm' with the entries, returning
+   true if successful
+*/
+static bool writeManifest(
+    char *fn, char *fm,
+    SYNCENTRY *entries, int count) {
+  CMSXFER *x = &manifestFile;
+  unsigned int oldBytes = bytesTransferred;
+  bool ok = (openFileAs(
+               x, fn, SYNC_MANIFEST_FT, fm,
+               false, true, 'V', 100, false) == 0);
+  int i;
+  for (i = 0; ok && i < count; i++) {
+    SYNCENTRY *e = &entries[i];
+    sprintf(x->io_buffer, "%-8s %-8s %s %d %u %s %u",
+      e->fn, e->ft,
+      (e->cmsStamp[0]) ? e->cmsStamp : "-",
+      e->cmsRecords,
+      e->hostSize,
+      (e->hostStamp[0]) ? e->hostStamp : "- -",
+      e->hostCrc);
+    ok = !writeRecord(x, strlen(x->io_buffer));
+  }
+  if (closeFile(x)) { ok = false; }
+  bytesTransferred = oldBytes;
+  return ok;
+}
+ 
+/* check if the host file differs from the state recorded in the manifest
+   entry, using the host checksum (if requested and known) to recognize
+   files touched on the host but not changed
+*/
+static bool hostChanged(SYNCENTRY *e, HOSTFILE *h, SYNCOPS *ops) {
+  if (e->hostSize == h->size && !strcmp(e->hostStamp, h->stamp)) {
+    return false;
+  }
+  unsigned int crc;
+  if (syncHash && ops->checksum && e->hostSize == h->size && e->hostCrc != 0
+      && ops->checksum(h->fn, h->ft, &crc) && crc == e->hostCrc) {
+    /* same content: only remember the new timestamp */
+    strcpy(e->hostStamp, h->stamp);
+    return false;
+  }
+  return true;
+}
+ 
+/* get the checksum of an unchanged host file not yet known in the manifest
+   entry (e.g. if the last sync was done without HASH)
+*/
+static void rememberChecksum(SYNCENTRY *e, HOSTFILE *h, SYNCOPS *ops) {
+  if (syncHash && ops->checksum && e->hostCrc == 0) {
+    ops->checksum(h->fn, h->ft, &e->hostCrc);
+  }
+}
+ 
+/* synchronize the files matching 'fnPat ftPat' between the CMS disk 'fm'
+   and the host directory in the direction given by 'syncToHost', only
+   transferring files that are new or changed since the last sync according
+   to the manifest file (default filename: 'defaultManifest'), which is
+   updated afterwards.
+   Returns the return code for the command.
+*/
+int syncFiles(
+    char *fnPat, char *ftPat, char *fm,
+    char *defaultManifest,
+    SYNCOPS *ops) {
+  char *manifest = (syncManifest[0]) ? syncManifest : defaultManifest;
+  char stamp[13];
+  int records;
+  int i;
+ 
+  /* the state at the last sync */
+  SYNCENTRY *entries;
+  int entryCapacity;
+  int entryCount = readManifest(manifest, fm, &entries, &entryCapacity);
+  if (entryCount < 0) {
+    printf("** unable to read manifest '%s %s %s'\n",
+      manifest, SYNC_MANIFEST_FT, fm);
+    return 24;
+  }
+ 
+  /* the current state on both sides */
+  CMSFILEID *cmsFiles;
+  int cmsCount = listCmsFiles(fnPat, ftPat, fm, &cmsFiles);
+  if (cmsCount < 0) {
+    if (entries) { free(entries); }
+    return 24;
+  }
+  HOSTFILE *hostFiles;
+  int hostCount = ops->listHost(&hostFiles);
+  if (hostCount < 0) {
+    if (entries) { free(entries); }
+    if (cmsFiles) { free(cmsFiles); }
+    return 24;
+  }
+ 
+  time_t start;
+  time(&start);
+  bool oldReplace = doReplace;
+  doReplace = true;
+  int transferred = 0;
+  int failed = 0;
+  int unchanged = 0;
+ 
+  if (syncToHost) {
+    bool *sent = (bool*)malloc((cmsCount + 1) * sizeof(bool));
+    for (i = 0; i < cmsCount; i++) {
+      CMSFILEID *id = &cmsFiles[i];
+      sent[i] = false;
+      if (strequiv(id->fn, manifest) && strequiv(id->ft, SYNC_MANIFEST_FT)) {
+        continue;
+      }
+      if (!getCmsState(id->fn, id->ft, id->fm, stamp, &records)) { continue; }
+      SYNCENTRY *e = findSyncEntry(entries, entryCount, id->fn, id->ft);
+      HOSTFILE *h = findHostFile(hostFiles, hostCount, id->fn, id->ft);
+      if (e) { e->seen = true; }
+      char *reason = NULL;
+      if (!e) {
+        reason = "new";
+      } else if (strcmp(e->cmsStamp, stamp) || e->cmsRecords != records) {
+        reason = "changed";
+      } else if (!h) {
+        reason = "missing on host";
+      } else if (hostChanged(e, h, ops)) {
+        reason = "changed on host";
+      }
+      if (!reason) {
+        rememberChecksum(e, h, ops);
+        unchanged++;
+        continue;
+      }
+ 
+      printf("%s %s %s -> host (%s)\n", id->fn, id->ft, id->fm, reason);
+      if (!e) {
+        e = addSyncEntry(&entries, &entryCount, &entryCapacity, id->fn, id->ft);
+        e->seen = true;
+      }
+      if (ops->putFile(id->fn, id->ft, id->fm) != 0) {
+        e->cmsStamp[0] = '\0'; /* force a new transfer next time */
+        failed++;
+      } else {
+        strcpy(e->cmsStamp, stamp);
+        e->cmsRecords = records;
+        sent[i] = true;
+      }
+      transferred++;
+    }
+ 
+    /* get the new host state for the files sent */
+    if (transferred > failed) {
+      free(hostFiles);
+      hostCount = ops->listHost(&hostFiles);
+      if (hostCount < 0) { hostFiles = NULL; hostCount = 0; }
+      for (i = 0; i < cmsCount; i++) {
+        if (!sent[i]) { continue; }
+        CMSFILEID *id = &cmsFiles[i];
+        SYNCENTRY *e = findSyncEntry(entries, entryCount, id->fn, id->ft);
+        HOSTFILE *h = findHostFile(hostFiles, hostCount, id->fn, id->ft);
+        if (!h) {
+          e->hostSize = 0;
+          e->hostStamp[0] = '\0';
+          e->hostCrc = 0;
+          continue;
+        }
+        e->hostSize = h->size;
+        strcpy(e->hostStamp, h->stamp);
+        e->hostCrc = 0;
+        if (syncHash && ops->checksum) { ops->checksum(h->fn, h->ft, &e->hostCrc); }
+      }
+    }
+    free(sent);
+  } else {
+    for (i = 0; i < hostCount; i++) {
+      HOSTFILE *h = &hostFiles[i];
+      if (!patternMatch(fnPat, h->fn) || !patternMatch(ftPat, h->ft)) {
+        continue;
+      }
+      if (strequiv(h->fn, manifest) && strequiv(h->ft, SYNC_MANIFEST_FT)) {
+        continue;
+      }
+      SYNCENTRY *e = findSyncEntry(entries, entryCount, h->fn, h->ft);
+      bool cmsExists = getCmsState(h->fn, h->ft, fm, stamp, &records);
+      if (e) { e->seen = true; }
+      char *reason = NULL;
+      if (!e) {
+        reason = "new";
+      } else if (hostChanged(e, h, ops)) {
+        reason = "changed";
+      } else if (!cmsExists) {
+        reason = "missing on CMS";
+      } else if (strcmp(e->cmsStamp, stamp) || e->cmsRecords != records) {
+        reason = "changed on CMS";
+      }
+      if (!reason) {
+        rememberChecksum(e, h, ops);
+        unchanged++;
+        continue;
+      }
+ 
+      printf("host -> %s %s %s (%s)\n", h->fn, h->ft, fm, reason);
+      if (!e) {
+        e = addSyncEntry(&entries, &entryCount, &entryCapacity, h->fn, h->ft);
+        e->seen = true;
+      }
+      e->hostSize = h->size;
+      strcpy(e->hostStamp, h->stamp);
+      e->hostCrc = 0;
+      if (ops->getFile(h->fn, h->ft, fm) != 0
+          || !getCmsState(h->fn, h->ft, fm, stamp, &records)) {
+        e->hostStamp[0] = '\0'; /* force a new transfer next time */
+        failed++;
+      } else {
+        strcpy(e->cmsStamp, stamp);
+        e->cmsRecords = records;
+        if (syncHash && ops->checksum) { ops->checksum(h->fn, h->ft, &e->hostCrc); }
+      }
+      transferred++;
+    }
+  }
+  doReplace = oldReplace;
+ 
+  /* drop the entries of files matching the patterns that no longer exist
+     on the source side, keeping the entries for other files */
+  int kept = 0;
+  for (i = 0; i < entryCount; i++) {
+    SYNCENTRY *e = &entries[i];
+    if (!e->seen && patternMatch(fnPat, e->fn) && patternMatch(ftPat, e->ft)) {
+      continue;
+    }
+    if (kept != i) { memcpy(&entries[kept], e, sizeof(SYNCENTRY)); }
+    kept++;
+  }
+ 
+  int rc = (failed > 0) ? 24 : 0;
+  if (!writeManifest(manifest, fm, entries, kept)) {
+    printf("** unable to write manifest '%s %s %s'\n",
+      manifest, SYNC_MANIFEST_FT, fm);
+    rc = 24;
+  }
+ 
+  if (entries) { free(entries); }
+  if (cmsFiles) { free(cmsFiles); }
+  if (hostFiles) { free(hostFiles); }
+ 
+  printf("sync: %d files unchanged\n", unchanged);
+  transferSummary("sync", transferred, failed, start);
+  return rc;
+}
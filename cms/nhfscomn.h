@@ -16,6 +16,13 @@
 #ifndef __NHFSCOMN_included
 #define __NHFSCOMN_included
  
+#include <time.h>
+ 
+#include "nicofclt.h"
+#include "ncfio.h"
+#include "ncfbases.h"
+#include "cmsrecio.h"
+ 
 #ifndef true
 typedef char bool;
 #define true ((bool)1)
@@ -44,11 +51,29 @@ extern bool doReplace;
 extern char recfm;
 extern int  lrecl;
 extern bool doAppend;
-/*extern char filename[128];*/
-/*extern CMSFILE cmsfile;*/
-/*extern CMSFILE *f = NULL;*/
-extern char io_buffer[544]; /* 512 bytes buffer + 32 spare */
-/*extern int recordNum = 1;*/
+extern bool doImage;  /* transfer CMS file images (see writeImage/readImage) */
+extern bool doUnpack; /* let the host store images as text files */
+extern int  window; /* requests in flight per bulk stream (see nsetwindow) */
+extern int  blockSize; /* bytes read/written per CMS call (see CMSRECIO.H) */
+extern int  streams; /* files transferred at once (see transferFiles) */
+ 
+/* max. number of files transferred at once */
+#define XFER_MAXSTREAMS 8
+ 
+/* the state of the transfer of a CMS file, so several files can be
+   transferred at once
+*/
+typedef struct _cmsxfer {
+  char filename[19];    /* the FID of the CMS file */
+  RECFILE recfile;      /* the CMS file opened with openFile() */
+  RECFILE *f;           /* &recfile while the file is open, else NULL */
+  bool text;            /* text mode: strip resp. fill with blanks */
+  char recfm;           /* RECFM and LRECL the file was opened with */
+  int lrecl;
+  bool toHost;          /* direction of the transfer (see transferStart) */
+  BULKSTREAM stream;    /* the host file of the transfer */
+  char io_buffer[544];  /* 512 bytes buffer + 32 spare */
+  } CMSXFER;
  
 /* build a FID string from the components fn ft fm */
 extern void buildFid(char *fid, char *fn, char *ft, char *fm);
@@ -56,26 +81,216 @@ extern void buildFid(char *fid, char *fn, char *ft, char *fm);
 /* check if the file 'fn ft fm' exists */
 extern bool f_exists(char *fn, char *ft, char *fm);
  
-/* try to open the file and:
-   - set global variable 'f' and return true if successfull
-   - send an error status and return false if the file cannot be opened
+/* try to open the file for the transfer 'x' with the current options and:
+   - return 0 if successfull
+   - print an error message and return the error code if the file cannot
+     be opened
 */
 extern int openFile(
+    CMSXFER *x,
     char *fn, char *ft, char *fm,
     bool openForRead);
  
-/* close the CMS file */
-extern void closeFile();
+/* close the CMS file, writing the records still buffered,
+   return true if writing failed
+*/
+extern bool closeFile(CMSXFER *x);
  
-/* read a record of the file into 'io_buffer',
+/* read a record of the file into 'x->io_buffer',
    set 'eof' to true if no more records are available,
    return the length of the record just read.
 */
-extern int readRecord(bool *eof);
+extern int readRecord(CMSXFER *x, bool *eof);
  
-/* write a record from 'io_buffer' with the specified record len,
+/* write a record from 'x->io_buffer' with the specified record len,
    return true if writing failed
 */
-extern bool writeRecord(int len);
+extern bool writeRecord(CMSXFER *x, int len);
+ 
+/* total bytes of the records read resp. written with readRecord() and
+   writeRecord() since the program start
+*/
+extern unsigned int bytesTransferred;
+ 
+/*
+** step-wise file transfers
+*/
+ 
+/* result of transferStep() if the transfer is not complete */
+#define XFER_MORE (-1)
+ 
+/* start the transfer between the CMS file opened in 'x' and the host file
+   'stream' in the given direction, in text or binary mode as given by
+   'doText' when the CMS file was opened
+*/
+extern void transferStart(CMSXFER *x, BULKSTREAM stream, bool toHost);
+ 
+/* transfer the next records (about one stream block) of the transfer 'x',
+   returning XFER_MORE if the transfer is not complete, else 0 if all
+   records were transferred or the return code for the command
+*/
+extern int transferStep(CMSXFER *x);
+ 
+/* end the transfer 'x' with the result 'rc' of the last transferStep(),
+   closing the CMS file and the host stream (reporting the errors of the
+   remaining write-behind requests), returning the return code for the
+   command
+*/
+extern int transferEnd(CMSXFER *x, int rc);
+ 
+/* do the complete transfer 'x' started with transferStart(), returning
+   0 if successful or the return code for the command
+*/
+extern int transferFile(CMSXFER *x);
+ 
+/*
+** CMS file images
+*/
+ 
+/* A CMS file image holds the content of a CMS file with its record structure,
+   so files with any RECFM can be transferred as one binary stream without
+   looking at the record content:
+   - header (IMG_HEADER_LEN bytes):
+       4 bytes : magic "CMSI" (in EBCDIC: C3 D4 E2 C9)
+       1 byte  : format version (IMG_VERSION)
+       1 byte  : RECFM (EBCDIC 'F' or 'V')
+       2 bytes : reserved (0)
+       4 bytes : LRECL
+       4 bytes : record count (IMG_UNKNOWN_COUNT if not known)
+   - for each record: 2 bytes length followed by the (unconverted) record data
+   All numbers are big-endian.
+*/
+#define IMG_HEADER_LEN    16
+#define IMG_VERSION       1
+#define IMG_UNKNOWN_COUNT 0xFFFFFFFF
+ 
+/* write the CMS file 'fn ft fm', already opened for reading with openFile()
+   in 'x', as image to the binary sink stream, returning 0 if successful or
+   the return code for the command
+*/
+extern int writeImage(
+    CMSXFER *x,
+    char *fn, char *ft, char *fm,
+    BULKSTREAM stream);
+ 
+/* read the image from the binary source stream into the CMS file 'fn ft fm'
+   created in 'x' with the RECFM and LRECL of the image, returning 0 if
+   successful or the return code for the command
+*/
+extern int readImage(
+    CMSXFER *x,
+    char *fn, char *ft, char *fm,
+    BULKSTREAM stream);
+ 
+/*
+** multi-file transfers
+*/
+ 
+/* the id of a CMS file */
+typedef struct _cmsfileid {
+  char fn[9];
+  char ft[9];
+  char fm[3];
+  } CMSFILEID;
+ 
+/* check if 'name' matches 'pattern' (case-insensitive), with the CMS
+   wildcards '*' (any number of chars) and '%' (exactly one char)
+*/
+extern bool patternMatch(char *pattern, char *name);
+ 
+/* append the file id 'fn ft fm' to the list 'files' with 'count' entries,
+   growing the list (allocated with malloc) as needed.
+*/
+extern void addFileId(
+    CMSFILEID **files, int *count, int *capacity,
+    char *fn, char *ft, char *fm);
+ 
+/* get the CMS files matching 'fnPat ftPat fmPat' (with LISTFILE),
+   returning the number of files found or -1 if LISTFILE failed,
+   the list of file ids is returned in 'files' (allocated with malloc)
+*/
+extern int listCmsFiles(
+    char *fnPat, char *ftPat, char *fmPat,
+    CMSFILEID **files);
+ 
+/* transfer the 'count' files 'files' with up to 'streams' transfers at once,
+   each started in a free CMSXFER with 'start' (opening the CMS file and the
+   host file, then calling transferStart() and returning 0 if successful),
+   interleaving the blocks of the transfers so the requests of all streams
+   are in flight together, returning the number of failed transfers
+*/
+extern int transferFiles(
+    CMSFILEID *files, int count,
+    int (*start)(CMSXFER *x, CMSFILEID *id));
+ 
+/* print the summary for the transfer of several files started at 'start'
+*/
+extern void transferSummary(char *what, int files, int failed, time_t start);
+ 
+/*
+** incremental synchronization
+*/
+ 
+/* sync options: direction, compare host checksums, manifest filename */
+extern bool syncToHost;
+extern bool syncHash;
+extern char syncManifest[9];
+ 
+/* the filetype of the manifest file 'syncManifest MANIFEST fm' */
+#define SYNC_MANIFEST_FT "MANIFEST"
+ 
+/* the state of a file at the last synchronization, as kept in the manifest */
+typedef struct _syncentry {
+  char fn[9];
+  char ft[9];
+  char cmsStamp[13];     /* CMS year, date, time as 12 hex digits */
+  int  cmsRecords;
+  unsigned int hostSize;
+  char hostStamp[20];    /* host timestamp "yyyy-MM-dd hh:mm:ss" */
+  unsigned int hostCrc;  /* 0 if unknown */
+  bool seen;             /* (internal) file present in the current run */
+  } SYNCENTRY;
+ 
+/* a file in the host directory to synchronize */
+typedef struct _hostfile {
+  char fn[9];
+  char ft[9];
+  unsigned int size;
+  char stamp[20];        /* host timestamp "yyyy-MM-dd hh:mm:ss" */
+  } HOSTFILE;
+ 
+/* append the host file 'fn.ft' to the list 'files' with 'count' entries,
+   growing the list (allocated with malloc) as needed.
+*/
+extern void addHostFile(
+    HOSTFILE **files, int *count, int *capacity,
+    char *fn, char *ft, unsigned int size, char *stamp);
+ 
+/* the operations of the file service used by syncFiles():
+   - listHost: get the files in the host directory (list allocated with
+     malloc), returning the number of files or -1 if listing failed
+   - putFile/getFile: transfer the file between CMS 'fn ft fm' and the host
+     file 'fn.ft', returning 0 if successful
+   - checksum: get the CRC-32 of the host file 'fn.ft', returning true if
+     successful
+*/
+typedef struct _syncops {
+  int (*listHost)(HOSTFILE **files);
+  int (*putFile)(char *fn, char *ft, char *fm);
+  int (*getFile)(char *fn, char *ft, char *fm);
+  bool (*checksum)(char *fn, char *ft, unsigned int *crc);
+  } SYNCOPS;
+ 
+/* synchronize the files matching 'fnPat ftPat' between the CMS disk 'fm'
+   and the host directory in the direction given by 'syncToHost', only
+   transferring files that are new or changed since the last sync according
+   to the manifest file (default filename: 'defaultManifest'), which is
+   updated afterwards.
+   Returns the return code for the command.
+*/
+extern int syncFiles(
+    char *fnPat, char *ftPat, char *fm,
+    char *defaultManifest,
+    SYNCOPS *ops);
  
 #endif /* #ifndef __NHFSCOMN_included */
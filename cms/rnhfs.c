@@ -45,11 +45,61 @@
 **       The file content is transferred in binary mode, no conversion is made.
 **       If the file exists, REPLACE must be given to overwrite it.
 **
+**  RNHFS PUTIMG fn ft [ fm ] hostfile [ ( [ REPLACE ] [ UNPACK ] ]
+**    -> copy the CMS file 'fn ft fm' as CMS file image to the file 'hostfile'
+**       in the current directory, keeping the RECFM, LRECL and the record
+**       boundaries without any conversion.
+**       With UNPACK, the records are converted to ASCII text lines on the
+**       host side and stored as text file instead of the image.
+**       If the file exists, REPLACE must be given to overwrite it.
+**
+**  RNHFS GETIMG hostfile fn ft [ fm ] [ ( [ REPLACE ] ]
+**    -> recreate the CMS file 'fn ft fm' with the RECFM, LRECL and records
+**       of the CMS file image 'hostfile' in the current directory.
+**       If the file exists, REPLACE must be given to overwrite it.
+**
+**  RNHFS MPUT fnpat ftpat [ fm ] [ ( [ REPLACE ] ]
+**  RNHFS MPUTBIN fnpat ftpat [ fm ] [ ( [ REPLACE ] ]
+**    -> copy all CMS files matching 'fnpat ftpat fm' (with the CMS wildcards
+**       '*' and '%') like PUT resp. PUTBIN to the files 'fn.ft' (lowercase)
+**       in the current directory, all in one session with up to STREAMS
+**       files at once, and print a summary with the throughput.
+**
+**  RNHFS MGET hostpattern [ fm ] [ ( [ REPLACE ] [ RECFM x ] [ LRECL x ] ]
+**  RNHFS MGETBIN hostpattern [ fm ] [ ( [ REPLACE ] [ RECFM x ] [ LRECL x ] ]
+**    -> copy all files in the current directory matching 'hostpattern' (as
+**       for LIST) and having a name 'fn.ft' valid for CMS like GET resp.
+**       GETBIN to the CMS files 'fn ft fm', all in one session with up to
+**       STREAMS files at once, and print a summary with the throughput.
+**
+**  RNHFS SYNC fnpat ftpat [ fm ] [ ( [ TOHOST | TOCMS ] [ HASH ] [ MANIFEST fn ] ]
+**  RNHFS SYNCBIN fnpat ftpat [ fm ] [ ( [ TOHOST | TOCMS ] [ HASH ] [ MANIFEST fn ] ]
+**    -> transfer only the files matching 'fnpat ftpat' that are new or were
+**       changed since the last sync from the CMS disk 'fm' to the files
+**       'fn.ft' in the current directory with TOHOST (default) resp. in the
+**       other direction with TOCMS, in text resp. binary mode.
+**       The state of the files (CMS date/time and record count, host size
+**       and timestamp) after the last sync is kept in the manifest file
+**       'fn MANIFEST fm' (default: RNHFSYNC), a file is transferred if it
+**       is missing or its state differs on either side.
+**       With HASH, the checksum of host files is kept in the manifest, so
+**       host files with a new timestamp but unchanged content are not
+**       transferred again.
+**
 ** When transferring files:
 **  - the CMS file LRECL is limited to 255 characters
 **  - the CMS file is always specified first
 **  - the host file is always given as last (non-option) parameter and
 **    must be a single token (no blanks permitted)
+**  - the option WINDOW n (1..8, default 4) gives the number of block
+**    requests kept in flight for each file transferred, overlapping the
+**    CMS disk I/O with the transfer of the next blocks
+**  - the option STREAMS n (1..8, default 4) gives the number of files
+**    transferred at once by MPUT and MGET, each with its own bulk stream,
+**    so the block requests of all these streams are in flight together
+**  - the option BLOCK n (default 4096) gives the number of bytes read resp.
+**    written with one CMS call for RECFM F files, so several records are
+**    transferred per FSREAD/FSWRITE
 **  - the omission of 'fm' is recognized if only 3 non-option parameters
 **    are found when enumerating the parameter tokens; minidisk A is then
 **    assumed when PUTting files to the host resp. A1 when GETting files
@@ -71,9 +121,228 @@
  
 #include "nhfscomn.h"
 #include "svcrnhfs.h"
+#include "ncfbases.h"
  
 static char hostElemName[2048];
  
+/*
+** file transfers
+*/
+ 
+/* convert the EBCDIC letters in 's' to lowercase */
+static void lowercase(char *s) {
+  unsigned char *p = (unsigned char*)s;
+  for (; *p; p++) {
+    if ((*p >= 0xC1 && *p <= 0xC9)
+        || (*p >= 0xD1 && *p <= 0xD9)
+        || (*p >= 0xE2 && *p <= 0xE9)) {
+      *p -= 0x40;
+    }
+  }
+}
+ 
+/* open the CMS file 'fn ft fm' and the host file 'hostfilename' for the
+   transfer 'x' to the host, as image or in text or binary mode depending
+   on 'doImage' and 'doText', returning 0 if successful or the return code
+   for the command
+*/
+static int startPut(
+    CMSXFER *x,
+    char *fn, char *ft, char *fm,
+    char *hostfilename) {
+  int rc = openFile(x, fn, ft, fm, true);
+  if (rc != 0) { return rc; }
+  BULKSTREAM stream = (doImage)
+                    ? rawhostfs_putimage(
+                        hostfilename,
+                        doReplace,
+                        doUnpack)
+                    : rawhostfs_putfile(
+                        hostfilename,
+                        doReplace,
+                        doText);
+  if (stream == NULL) {
+    printf("** error accessing host file\n");
+    printf("** reason: %s\n", rawhostfs_lastErrmsg());
+    closeFile(x);
+    return 24;
+  }
+  if (doImage) { /* the CMS file is sent with writeImage() */
+    x->stream = stream;
+    nsetwindow(stream, window);
+    return 0;
+  }
+  transferStart(x, stream, true);
+  return 0;
+}
+ 
+/* open the host file 'hostfilename' and the CMS file 'fn ft fm' for the
+   transfer 'x' to CMS, as image or in text or binary mode depending on
+   'doImage' and 'doText', returning 0 if successful or the return code
+   for the command
+*/
+static int startGet(
+    CMSXFER *x,
+    char *hostfilename,
+    char *fn, char *ft, char *fm) {
+  if (f_exists(fn, ft, fm) && !doReplace) {
+    printf("** CMS file already exists, transfer aborted\n");
+    return 24;
+  }
+  BULKSTREAM stream = rawhostfs_getfile(
+                        hostfilename,
+                        doText && !doImage);
+  if (stream == NULL) {
+    printf("** unable to access host file, aborting\n");
+    printf("** reason: %s\n", rawhostfs_lastErrmsg());
+    return 24;
+  }
+  if (doImage) { /* the CMS file is created by readImage() */
+    x->stream = stream;
+    nsetwindow(stream, window);
+    return 0;
+  }
+  int rc = openFile(x, fn, ft, fm, false);
+  if (rc != 0) {
+    nclose(stream);
+    return rc;
+  }
+  transferStart(x, stream, false);
+  return 0;
+}
+ 
+/* the single file transferred with putFile() resp. getFile() */
+static CMSXFER xfer;
+ 
+/* copy the CMS file 'fn ft fm' to the host file 'hostfilename', as image or
+   in text or binary mode depending on 'doImage' and 'doText', returning 0
+   if successful or the return code for the command
+*/
+static int putFile(char *fn, char *ft, char *fm, char *hostfilename) {
+  int rc = startPut(&xfer, fn, ft, fm, hostfilename);
+  if (rc != 0) { return rc; }
+  if (!doImage) { return transferFile(&xfer); }
+ 
+  rc = writeImage(&xfer, fn, ft, fm, xfer.stream);
+  closeFile(&xfer);
+  int err = nclose(xfer.stream);
+  if (rc == 0 && err != NERR_NOERROR) {
+    printf("** error writing to host file, transfer aborted\n");
+    printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+    rc = 24;
+  }
+  return rc;
+}
+ 
+/* copy the host file 'hostfilename' to the CMS file 'fn ft fm', as image or
+   in text or binary mode depending on 'doImage' and 'doText', returning 0
+   if successful or the return code for the command
+*/
+static int getFile(char *hostfilename, char *fn, char *ft, char *fm) {
+  int rc = startGet(&xfer, hostfilename, fn, ft, fm);
+  if (rc != 0) { return rc; }
+  if (!doImage) { return transferFile(&xfer); }
+ 
+  rc = readImage(&xfer, fn, ft, fm, xfer.stream);
+  int err = nclose(xfer.stream);
+  if (rc == 0 && err != NERR_NOERROR) {
+    printf("** error reading from host file\n");
+    printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+    rc = 24;
+  }
+  return rc;
+}
+ 
+/* start the transfer of a file for MPUT[BIN] to 'fn.ft' (lowercase) */
+static int startMput(CMSXFER *x, CMSFILEID *id) {
+  char hostfilename[18];
+  sprintf(hostfilename, "%s.%s", id->fn, id->ft);
+  lowercase(hostfilename);
+  printf("%s %s %s -> %s\n", id->fn, id->ft, id->fm, hostfilename);
+  return startPut(x, id->fn, id->ft, id->fm, hostfilename);
+}
+ 
+/* start the transfer of a file for MGET[BIN] from 'fn.ft' */
+static int startMget(CMSXFER *x, CMSFILEID *id) {
+  char hostfilename[18];
+  sprintf(hostfilename, "%s.%s", id->fn, id->ft);
+  printf("%s -> %s %s %s\n", hostfilename, id->fn, id->ft, id->fm);
+  return startGet(x, hostfilename, id->fn, id->ft, id->fm);
+}
+ 
+/*
+** incremental synchronization
+*/
+ 
+/* get the files in the current directory having a name 'fn.ft' valid for
+   CMS, the lines are: "yyyy-MM-dd hh:mm:ss     size name"
+*/
+static int syncListHost(HOSTFILE **files) {
+  *files = NULL;
+  BULKSTREAM stream = rawhostfs_list(NULL);
+  if (stream == NULL) {
+    printf("** error listing host directory\n");
+    printf("** reason: %s\n", rawhostfs_lastErrmsg());
+    return -1;
+  }
+  int count = 0;
+  int capacity = 0;
+  char *line;
+  while(line = ngetline(hostElemName, sizeof(hostElemName), stream)) {
+    if (strlen(line) < 22) { continue; }
+    line[19] = '\0';
+    char *size = &line[20];
+    while (*size == ' ') { size++; }
+    if (!strncmp(size, "<subdir>", 8)) { continue; }
+    char *name = size;
+    while (*name && *name != ' ') { name++; }
+    if (*name == ' ') { *name++ = '\0'; }
+    char *dot = strchr(name, '.');
+    if (!dot || dot == name || (dot - name) > 8
+        || strlen(dot + 1) < 1 || strlen(dot + 1) > 8
+        || strchr(dot + 1, '.') || strchr(name, ' ')) {
+      continue;
+    }
+    *dot = '\0';
+    addHostFile(
+      files, &count, &capacity,
+      name, dot + 1,
+      (unsigned int)atoi(size), line);
+  }
+  int err = nclose(stream);
+  if (err != NERR_NOERROR) { /* an incomplete listing would mislead the sync */
+    printf("** error listing host directory\n");
+    printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+    if (*files) { free(*files); }
+    *files = NULL;
+    return -1;
+  }
+  return count;
+}
+ 
+static int syncPutFile(char *fn, char *ft, char *fm) {
+  char hostfilename[18];
+  sprintf(hostfilename, "%s.%s", fn, ft);
+  lowercase(hostfilename);
+  return putFile(fn, ft, fm, hostfilename);
+}
+ 
+static int syncGetFile(char *fn, char *ft, char *fm) {
+  char hostfilename[18];
+  sprintf(hostfilename, "%s.%s", fn, ft);
+  return getFile(hostfilename, fn, ft, fm);
+}
+ 
+static bool syncChecksum(char *fn, char *ft, unsigned int *crc) {
+  char hostfilename[18];
+  sprintf(hostfilename, "%s.%s", fn, ft);
+  return rawhostfs_checksum(hostfilename, crc);
+}
+ 
+static SYNCOPS syncOps = {
+  &syncListHost, &syncPutFile, &syncGetFile, &syncChecksum
+  };
+ 
 /*
 ** main routine
 */
@@ -114,10 +383,49 @@ static int interpretOptions(int argc, char *argv[], bool paramsEndOnly) {
         printf("Command option incomplete (missing/invalid LRECL value)\n");
         return -1;
       }
+    } else if (strequiv(p, "window")) {
+      i++;
+      if (i < argc) { p = argv[i]; }
+      window = atoi(p);
+      if (window < 1 || window > NCFIO_MAXWINDOW) {
+        printf("Command option incomplete (missing/invalid WINDOW value)\n");
+        return -1;
+      }
+    } else if (strequiv(p, "streams")) {
+      i++;
+      if (i < argc) { p = argv[i]; }
+      streams = atoi(p);
+      if (streams < 1 || streams > XFER_MAXSTREAMS) {
+        printf("Command option incomplete (missing/invalid STREAMS value)\n");
+        return -1;
+      }
+    } else if (strequiv(p, "block")) {
+      i++;
+      if (i < argc) { p = argv[i]; }
+      blockSize = atoi(p);
+      if (blockSize < 1 || blockSize > RECIO_MAX_BLOCKSIZE) {
+        printf("Command option incomplete (missing/invalid BLOCK value)\n");
+        return -1;
+      }
+    } else if (strequiv(p, "tohost")) {
+      syncToHost = true;
+    } else if (strequiv(p, "tocms")) {
+      syncToHost = false;
+    } else if (strequiv(p, "hash")) {
+      syncHash = true;
+    } else if (strequiv(p, "manifest")) {
+      i++;
+      if (i >= argc || strlen(argv[i]) > 8) {
+        printf("Command option incomplete (missing/invalid MANIFEST filename)\n");
+        return -1;
+      }
+      strcpy(syncManifest, argv[i]);
     } else if (strequiv(p, "append")) {
       doAppend = true;
     } else if (strequiv(p, "replace")) {
       doReplace = true;
+    } else if (strequiv(p, "unpack")) {
+      doUnpack = true;
     } else {
       printf("Invalid option '%s'\n", p);
       return -1;
@@ -143,11 +451,33 @@ int main(int argc, char* argv[]) {
     printf("   %s PUTBIN fn ft [ fm ] hostfilename [ ( options ]\n", argv[0]);
     printf("   %s GET hostfilename fn ft [ fm ] [ ( options ]\n", argv[0]);
     printf("   %s GETBIN hostfilename fn ft [ fm ] [ ( options ]\n", argv[0]);
+    printf("   %s PUTIMG fn ft [ fm ] hostfilename [ ( options ]\n", argv[0]);
+    printf("   %s GETIMG hostfilename fn ft [ fm ] [ ( options ]\n", argv[0]);
+    printf("   %s MPUT fnpat ftpat [ fm ] [ ( options ]\n", argv[0]);
+    printf("   %s MPUTBIN fnpat ftpat [ fm ] [ ( options ]\n", argv[0]);
+    printf("   %s MGET hostpattern [ fm ] [ ( options ]\n", argv[0]);
+    printf("   %s MGETBIN hostpattern [ fm ] [ ( options ]\n", argv[0]);
+    printf("   %s SYNC fnpat ftpat [ fm ] [ ( options ]\n", argv[0]);
+    printf("   %s SYNCBIN fnpat ftpat [ fm ] [ ( options ]\n", argv[0]);
     printf("\n");
     printf("Options:\n");
-    printf("  REPLACE           (for: PUT, PUTBIN, GET, GETBIN)\n");
-    printf("  LRECL len         (for: GET, GETBIN; with len in 1..255)\n");
-    printf("  RECFM x           (for: GET, GETBIN; with x in V or F)\n");
+    printf("  REPLACE           (for: [M]PUT[BIN], [M]GET[BIN], PUTIMG, GETIMG)\n");
+    printf("  UNPACK            (for: PUTIMG; store the image as text file)\n");
+    printf("  LRECL len         (for: [M]GET[BIN]; with len in 1..255)\n");
+    printf("  RECFM x           (for: [M]GET[BIN]; with x in V or F)\n");
+    printf("  WINDOW n          (for: [M]PUT[BIN], [M]GET[BIN]; requests in flight\n");
+    printf("                     per file with n in 1..%d, default 4)\n",
+      NCFIO_MAXWINDOW);
+    printf("  STREAMS n         (for: MPUT[BIN], MGET[BIN]; files transferred at\n");
+    printf("                     once with n in 1..%d, default 4)\n",
+      XFER_MAXSTREAMS);
+    printf("  BLOCK n           (for: all transfers; bytes read/written per CMS\n");
+    printf("                     call for RECFM F files, default %d)\n",
+      RECIO_DEFAULT_BLOCKSIZE);
+    printf("  TOHOST | TOCMS    (for: SYNC[BIN]; direction, default TOHOST)\n");
+    printf("  HASH              (for: SYNC[BIN]; compare host file checksums)\n");
+    printf("  MANIFEST fn       (for: SYNC[BIN]; manifest 'fn MANIFEST fm',\n");
+    printf("                     default RNHFSYNC)\n");
     printf("\n");
     return 0;
   }
@@ -223,7 +553,12 @@ int main(int argc, char* argv[]) {
     while(line = ngetline(lineBuffer, 81, stream)) {
         printf("%s\n", line);
     }
-    nclose(stream);
+    int err = nclose(stream);
+    if (err != NERR_NOERROR) {
+      printf("** error listing host directory\n");
+      printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+      DONE(24);
+    }
  
   } else if (strequiv(argv[1], "type")) {
  
@@ -248,18 +583,28 @@ int main(int argc, char* argv[]) {
     while(line = ngetline(lineBuffer, 81, stream)) {
       printf("%s\n", line);
     }
-    nclose(stream);
+    int err = nclose(stream);
+    if (err != NERR_NOERROR) {
+      printf("** error reading from host file\n");
+      printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+      DONE(24);
+    }
  
-  } else if (strequiv(argv[1], "put")) {
+  } else if (strequiv(argv[1], "put") || strequiv(argv[1], "putbin")
+             || strequiv(argv[1], "putimg")) {
  
     /*
     ** PUT fn ft [ fm ] hostfilename [ ( options ]
+    ** PUTBIN fn ft [ fm ] hostfilename [ ( options ]
+    ** PUTIMG fn ft [ fm ] hostfilename [ ( options ]
     */
  
+    doText = strequiv(argv[1], "put");
+    doImage = strequiv(argv[1], "putimg");
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
     if (argc < 5) {
-      printf("** missing arguments for subcommand PUT\n");
+      printf("** missing arguments for subcommand %s\n", argv[1]);
       DONE(4);
     }
  
@@ -270,199 +615,151 @@ int main(int argc, char* argv[]) {
       hostfilename = argv[5];
     }
  
-    int rc = openFile(argv[2], argv[3], fm, true);
-    if (rc != 0) { DONE(rc); }
-    BULKSTREAM stream = rawhostfs_putfile(
-                          hostfilename,
-                          doReplace,
-                          true);
-    if (stream == NULL) {
-      printf("** error accessing host file\n");
-      printf("** reason: %s\n", rawhostfs_lastErrmsg());
-      closeFile();
-      DONE(24);
-    }
-    bool eof;
-    int len;
-    len = readRecord(&eof);
-    while (!eof) {
-      if (!nputline(io_buffer, stream)) {
-        printf("** error writing to host file, transfer aborted\n");
-        printf("** reason: %s\n", rawhostfs_lastErrmsg());
-        closeFile();
-        nclose(stream);
-        DONE(24);
-      }
-      len = readRecord(&eof);
-    }
-    closeFile();
-    nclose(stream);
+    int rc = putFile(argv[2], argv[3], fm, hostfilename);
+    DONE(rc);
  
-  } else if (strequiv(argv[1], "putbin")) {
+  } else if (strequiv(argv[1], "get") || strequiv(argv[1], "getbin")
+             || strequiv(argv[1], "getimg")) {
  
     /*
-    ** PUTBIN fn ft [ fm ] hostfilename [ ( options ]
+    ** GET hostfilename fn ft [ fm ] [ ( options ]
+    ** GETBIN hostfilename fn ft [ fm ] [ ( options ]
+    ** GETIMG hostfilename fn ft [ fm ] [ ( options ]
     */
  
+    doText = strequiv(argv[1], "get");
+    doImage = strequiv(argv[1], "getimg");
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
     if (argc < 5) {
-      printf("** missing arguments for subcommand PUTBIN\n");
+      printf("** missing arguments for subcommand %s\n", argv[1]);
       DONE(4);
     }
- 
-    char *fm = "A";
-    char *hostfilename = argv[4];
-    if (argc > 5) {
-      fm = argv[4];
-      hostfilename = argv[5];
+    if (argc > 6) {
+      printf("** too many arguments for subcommandn %s\n", argv[1]);
+      DONE(4);
     }
  
-    int rc = openFile(argv[2], argv[3], fm, true);
-    if (rc != 0) { DONE(rc); }
-    BULKSTREAM stream = rawhostfs_putfile(
-                          hostfilename,
-                          doReplace,
-                          false);
-    if (stream == NULL) {
-      printf("** error accessing host file\n");
-      printf("** reason: %s\n", rawhostfs_lastErrmsg());
-      closeFile();
-      DONE(24);
-    }
-    bool eof;
-    int len;
-    len = readRecord(&eof);
-    while (!eof && len >= 0) {
-      if (recfm == 'F' && len != lrecl) {
-        printf("*** recfm = 'F', lrecl = %d BUT len = %d\n", lrecl, len);
-      }
-      uint count = nwrite(io_buffer, len, stream);
-      if (count != lrecl && nerror(stream) != NERR_NOERROR) {
-        printf("** error writing to host file, transfer aborted\n");
-        printf("** reason: %s\n", rawhostfs_lastErrmsg());
-        closeFile();
-        nclose(stream);
-        DONE(24);
-      }
-      len = readRecord(&eof);
-    }
-    closeFile();
-    nclose(stream);
+    char *hostfilename = argv[2];
+    char *fn = argv[3];
+    char *ft = argv[4];
+    char *fm = (argc > 5) ? argv[5] : "A";
  
-  } else if (strequiv(argv[1], "get")) {
+    int rc = getFile(hostfilename, fn, ft, fm);
+    DONE(rc);
+ 
+  } else if (strequiv(argv[1], "mput") || strequiv(argv[1], "mputbin")) {
  
     /*
-    ** GET hostfilename fn ft [ fm ] [ ( options ]
+    ** MPUT fnpat ftpat [ fm ] [ ( options ]
+    ** MPUTBIN fnpat ftpat [ fm ] [ ( options ]
     */
  
+    doText = strequiv(argv[1], "mput");
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
-    if (argc < 5) {
-      printf("** missing arguments for subcommand GET\n");
+    if (argc < 4) {
+      printf("** missing arguments for subcommand %s\n", argv[1]);
       DONE(4);
     }
-    if (argc > 6) {
-      printf("** too many arguments for subcommandn GET\n");
-      DONE(4);
+    char *fm = (argc > 4) ? argv[4] : "A";
+ 
+    CMSFILEID *files;
+    int count = listCmsFiles(argv[2], argv[3], fm, &files);
+    if (count < 0) { DONE(24); }
+    if (count == 0) {
+      printf("** no CMS files found for '%s %s %s'\n", argv[2], argv[3], fm);
+      DONE(28);
     }
+    time_t start;
+    time(&start);
+    int failed = transferFiles(files, count, &startMput);
+    free(files);
+    transferSummary(argv[1], count, failed, start);
+    DONE((failed > 0) ? 24 : 0);
  
-    char *hostfilename = argv[2];
-    char *fn = argv[3];
-    char *ft = argv[4];
-    char *fm = (argc > 5) ? argv[5] : "A";
+  } else if (strequiv(argv[1], "mget") || strequiv(argv[1], "mgetbin")) {
  
-    if (f_exists(fn, ft, fm) && !doReplace) {
-      printf("** CMS file already exists, transfer aborted\n");
-      DONE(24);
+    /*
+    ** MGET hostpattern [ fm ] [ ( options ]
+    ** MGETBIN hostpattern [ fm ] [ ( options ]
+    */
+ 
+    doText = strequiv(argv[1], "mget");
+    argc = interpretOptions(argc, argv, false);
+    if (argc < 0) { DONE(4); }
+    if (argc < 3) {
+      printf("** missing arguments for subcommand %s\n", argv[1]);
+      DONE(4);
     }
-    BULKSTREAM stream = rawhostfs_getfile(
-                          hostfilename,
-                          true);
+    char *fm = (argc > 3) ? argv[3] : "A";
+ 
+    BULKSTREAM stream = rawhostfs_list(argv[2]);
     if (stream == NULL) {
-      printf("** unable to access host file, aborting\n");
+      printf("** error listing host directory\n");
       printf("** reason: %s\n", rawhostfs_lastErrmsg());
       DONE(24);
     }
-    int rc = openFile(fn, ft, fm, false);
-    if (rc != 0) {
-      nclose(stream);
-      DONE(rc);
-    }
+ 
+    /* collect the host files having a name usable as 'fn.ft' in CMS,
+       the lines are: "yyyy-MM-dd hh:mm:ss     size name" */
+    CMSFILEID *files = NULL;
+    int count = 0;
+    int capacity = 0;
     char *line;
-    while(line = ngetline(io_buffer, lrecl + 1, stream)) {
-      int len = strlen(line);
-      if (writeRecord(len)) {
-        closeFile();
-        nclose(stream);
-        DONE(24);
+    while(line = ngetline(hostElemName, sizeof(hostElemName), stream)) {
+      if (strlen(line) < 22) { continue; }
+      char *name = &line[19];
+      while (*name == ' ') { name++; }
+      if (!strncmp(name, "<subdir>", 8)) { continue; }
+      while (*name && *name != ' ') { name++; } /* skip the size */
+      if (*name == ' ') { name++; }
+      char *dot = strchr(name, '.');
+      if (!dot || dot == name || (dot - name) > 8
+          || strlen(dot + 1) < 1 || strlen(dot + 1) > 8
+          || strchr(dot + 1, '.') || strchr(name, ' ')) {
+        printf("** skipping host file '%s' (no valid CMS name)\n", name);
+        continue;
       }
+      *dot = '\0';
+      addFileId(&files, &count, &capacity, name, dot + 1, fm);
     }
-    if (!neof(stream)) {
-      printf("Error reading from host file, nerror = %d\n", nerror(stream));
-      closeFile();
-      nclose(stream);
+    int err = nclose(stream);
+    if (err != NERR_NOERROR) {
+      printf("** error listing host directory\n");
+      printf("** reason: %s\n", ncfbasesvc_errmsg(err));
+      free(files);
       DONE(24);
     }
-    closeFile();
-    nclose(stream);
+    if (count == 0) {
+      printf("** no host files found for '%s'\n", argv[2]);
+      DONE(28);
+    }
+    time_t start;
+    time(&start);
+    int failed = transferFiles(files, count, &startMget);
+    free(files);
+    transferSummary(argv[1], count, failed, start);
+    DONE((failed > 0) ? 24 : 0);
  
-  } else if (strequiv(argv[1], "getbin")) {
+  } else if (strequiv(argv[1], "sync") || strequiv(argv[1], "syncbin")) {
  
     /*
-    ** GETBIN hostfilename fn ft [ fm ] [ ( options ]
+    ** SYNC fnpat ftpat [ fm ] [ ( options ]
+    ** SYNCBIN fnpat ftpat [ fm ] [ ( options ]
     */
  
+    doText = strequiv(argv[1], "sync");
     argc = interpretOptions(argc, argv, false);
     if (argc < 0) { DONE(4); }
-    if (argc < 5) {
-      printf("** missing arguments for subcommand GETBIN\n");
+    if (argc < 4) {
+      printf("** missing arguments for subcommand %s\n", argv[1]);
       DONE(4);
     }
-    if (argc > 6) {
-      printf("** too many arguments for subcommandn GETBIN\n");
-      DONE(4);
-    }
- 
-    char *hostfilename = argv[2];
-    char *fn = argv[3];
-    char *ft = argv[4];
-    char *fm = (argc > 5) ? argv[5] : "A";
+    char *fm = (argc > 4) ? argv[4] : "A";
  
-    if (f_exists(fn, ft, fm) && !doReplace) {
-      printf("** CMS file already exists, transfer aborted\n");
-      DONE(24);
-    }
-    BULKSTREAM stream = rawhostfs_getfile(
-                          hostfilename,
-                          false);
-    if (stream == NULL) {
-      printf("** unable to access host file, aborting\n");
-      printf("** reason: %s\n", rawhostfs_lastErrmsg());
-      DONE(24);
-    }
-    int rc = openFile(fn, ft, fm, false);
-    if (rc != 0) {
-      nclose(stream);
-      DONE(rc);
-    }
-    int recLen = nread(io_buffer, lrecl, false, stream);
-    while(!neof(stream) && nerror(stream) == NERR_NOERROR) {
-      if (writeRecord(recLen)) {
-        closeFile();
-        nclose(stream);
-        DONE(24);
-      }
-      recLen = nread(io_buffer, lrecl, false, stream);
-    }
-    if (!neof(stream)) {
-      printf("Error reading from host file, nerror = %d\n", nerror(stream));
-      closeFile();
-      nclose(stream);
-      DONE(24);
-    }
-    closeFile();
-    nclose(stream);
+    int rc = syncFiles(argv[2], argv[3], fm, "RNHFSYNC", &syncOps);
+    DONE(rc);
  
   } else {
     printf("** unknown subcommand '%s', aborting\n", argv[1]);
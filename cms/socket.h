@@ -420,6 +420,23 @@ extern SOCKET accept(
 ** - the transmittable buffer length for a single call is limited to 2048 bytes
 ** - out-of-band data transmission is not supported
 **
+** If a send buffer was set for a stream socket with setsockopt(SO_SNDBUF),
+** send() only queues the data for the proxy and returns the byte count
+** without waiting for the proxy to confirm the transmission, as long as
+** less than SO_SNDBUF/2048 sends are queued; the queued sends are
+** transmitted in order and an error of a queued send is reported by the
+** next send(), shutdown() or closesocket() for the socket (a queued send
+** transmitted only partially by the proxy is reported as ECONNABORTED, as
+** the stream lost data).
+** For such a socket:
+** - a full send window waits for the oldest queued send (blocking socket)
+**   resp. fails with EWOULDBLOCK without queuing the data (non-blocking
+**   socket), select() reports the socket writable when the oldest queued
+**   send completed
+** - passing 'buflen' == 0 waits for all queued sends to complete (blocking
+**   socket) resp. fails with EALREADY as long as sends are queued
+**   (non-blocking socket)
+**
 ** possible errno values when count < 0 is returned:
 **  ENOTSOCK
 **   -> invalid sockfd (not an allocated socket)
@@ -431,9 +448,11 @@ extern SOCKET accept(
 **   -> a concurrent operation is already underway (non-blocking socket)
 **  EWOULDBLOCK
 **   -> the socket is non-blocking: the asynchronous operation was started
+**      (send window: the window is full, the data was not queued)
 **  EALREADY
 **   -> the socket is non-blocking: the same operation is already started
 **      and has not returned so far
+**      (send window: 'buflen' == 0 and sends are still queued)
 **  ECONNABORTED
 **   -> connection reset by peer (closed socket or SHUT_RD-shutdown)
 */
@@ -550,6 +569,9 @@ extern int recvfrom(
 **   -> shutdown not supported for a listering (server) socket
 **  ENOTCONN
 **   -> socket is not connected to a remote endpoint
+**  (the error of a failed queued send, see send())
+**
+** shutdown() waits for the queued sends of the socket to complete
 */
  
 #define SHUT_RD   0
@@ -566,9 +588,13 @@ extern int shutdown(SOCKET sockfd, int how);
 **   the standard C-API, an explicit socket-related name is used!
 ** - the C-library function close() will not work with sockets
 **
+** closesocket() waits for the queued sends of the socket to complete before
+** closing the socket (see send())
+**
 ** possible errno values when sockfd < 0 is returned:
 **  ENOTSOCK
 **   -> invalid sockfd (not an allocated socket)
+**  (the error of a failed queued send, the socket is closed nevertheless)
 */
 extern int closesocket(
     SOCKET sockfd);
@@ -600,6 +626,46 @@ extern int closesocket(
  
 extern int ioctlsocket(SOCKET sockfd, long flag, ncs_uint *value);
  
+/* rc <- setsockopt(sockfd, level, optname, optval, optlen)
+** rc <- getsockopt(sockfd, level, optname, optval, &optlen)
+**
+** set resp. get an option of the socket
+**
+** NICOF sockets only support the option SO_SNDBUF at level SOL_SOCKET for
+** stream sockets, with 'optval' pointing to an ncs_int giving the size of
+** the send buffer in bytes, which is rounded up to multiples of 2048 bytes
+** (the data of one send request) up to 8 requests (16384 bytes); a size up
+** to 2048 bytes switches back to unbuffered sends (the default), waiting
+** for each send to be confirmed by the proxy (see send()).
+** setsockopt() waits for the sends queued so far to complete.
+**
+** possible errno values when rc < 0 is returned:
+**  ENOTSOCK
+**   -> invalid sockfd (not an allocated socket)
+**  EINVAL
+**   -> unsupported level or option or invalid 'optval' / 'optlen'
+**  EOPNOTSUPP
+**   -> setsockopt(): the socket is a datagram socket
+**  (setsockopt(): the error of a failed queued send)
+*/
+ 
+#define SOL_SOCKET 0xFFFF
+#define SO_SNDBUF  0x1001
+ 
+extern int setsockopt(
+    SOCKET sockfd,
+    ncs_int level,
+    ncs_int optname,
+    const ncs_char *optval,
+    ncs_int optlen);
+ 
+extern int getsockopt(
+    SOCKET sockfd,
+    ncs_int level,
+    ncs_int optname,
+    ncs_char *optval,
+    ncs_int *optlen);
+ 
  
 /*
 ** ****
@@ -621,7 +687,7 @@ extern int ioctlsocket(SOCKET sockfd, long flag, ncs_uint *value);
 ** that can be allocated in a VM.
 ** (it must match the constant MAX_SOCKET_COUNT of the NICOF-Java-service impl.)
 */
-#define FD_SETSIZE 64
+#define FD_SETSIZE 512
  
 /* size in bytes of the 'fd_set' structure */
 #define FD_BYTES ((FD_SETSIZE + 7) / 8)
@@ -670,10 +736,18 @@ struct timeval {
 ** the socket is contained:
 **  -> set 'rd_fds' : recv() and accept()
 **  -> set 'wr_fds' : send() and connect()
-** except for 'send()', the operations will be initiated if the socket is
-** in the corresponding set and the operation is not already underway
-** (waiting for a 'send()' to finish is only meaningful if it has already
-** been started in non-blocking mode)
+** a connected stream socket is reported in 'rd_fds' as soon as data or
+** the end of the connection is available for recv() and a listening socket
+** as soon as a connection is available for accept(), so the following
+** recv() resp. accept() returns without waiting; a connected stream socket
+** not sending is reported in 'wr_fds' as soon as it can send()
+** all stream sockets are watched through a single pending request to the
+** proxy (the event channel), which is reused by the next select() if it
+** watches the same sockets
+** for datagram sockets (and sockets with an operation already underway),
+** recv() will be initiated if the socket is in 'rd_fds' and the operation
+** is not already underway, whereas waiting for 'send()' to finish is only
+** meaningful if it has already been started in non-blocking mode
 **
 ** all sets can be passed as NULL, meaning the corresponding operations
 ** need not to be watched for any socket
@@ -708,7 +782,7 @@ extern int select(
     ncs_int num_fds, /* largest sockfd passed in any set, +1 (plus one)!! */
     fd_set *rd_fds,  /* sockets to watch for recv() & accept() operations */
     fd_set *wr_fds,  /* sockets to watch for send() & connect() operations */
-    fd_set *ex_fds,  /* not used (out-of-band is unsupported) */
+    fd_set *ex_fds,  /* stream sockets to watch for failures (no OOB) */
     const struct timeval *timeout /* timeout specification */
     );
  
@@ -728,13 +802,60 @@ extern int selectX(
     ncs_int num_fds,   /* largest sockfd passed in any input-set, +1 !! */
     fd_set *rd_fds_in, /* input set of sockets to watch for recv()/accept() */
     fd_set *wr_fds_in, /* input set of sockets to watch for send()/connept() */
-    fd_set *ex_fds_in, /* not used (out-of-band is unsupported) */
+    fd_set *ex_fds_in, /* input set of stream sockets to watch for failures */
     fd_set *rd_fds_out,/* output set of active sockets in 'rd_fds_in' */
     fd_set *wr_fds_out,/* output set of active sockets in 'wr_fds_in' */
-    fd_set *ex_fds_out,/* irrelevant */
+    fd_set *ex_fds_out,/* output set of failed sockets in 'ex_fds_in' */
     const struct timeval *timeout /* timeout specification */
  );
  
+/* an entry of the socket array passed to poll() */
+struct pollfd {
+    SOCKET fd;        /* the socket to watch (ignored if < 0) */
+    ncs_short events; /* the events to watch for the socket */
+    ncs_short revents;/* the events that occured for the socket */
+};
+ 
+/* poll() events */
+#define POLLIN   0x0001  /* data to recv() resp. connection to accept() */
+#define POLLPRI  0x0002  /* (never reported, out-of-band is unsupported) */
+#define POLLOUT  0x0004  /* send() resp. non-blocking connect() can proceed */
+#define POLLERR  0x0008  /* the connection failed (always watched) */
+#define POLLHUP  0x0010  /* (never reported, shown as POLLIN, recv() => 0) */
+#define POLLNVAL 0x0020  /* 'fd' is not an allocated socket (always watched) */
+ 
+/* count <- poll(fds, nfds, timeout)
+**
+** alternative to select() watching the sockets given as an array of
+** 'nfds' entries, each specifying the 'events' (POLLIN, POLLOUT) to watch
+** for the socket 'fd' and receiving the 'revents' that occured
+**
+** unlike select(), the time spent by poll() depends only on the number of
+** entries passed, not on the highest socket number, which makes poll()
+** the better choice for servers with many connections
+**
+** the last parameter defines the timeout handling in milliseconds:
+**  - passing a negative value will let poll() wait until at least one
+**    socket shows activity
+**  - passing 0 will let poll() simply check the sockets and return
+**    immediately
+**  - passing a positive value will let poll() wait up to the specified
+**    interval with a resolution of 1/100 second
+**
+** returns:
+**  - the number of entries with 'revents' != 0
+**  - 0 if the timeout occured without any socket activity
+**  - -1 if an error occured
+**
+** when count < 0 is returned, errno will only indicate NICOFCLT errors
+** (or EINVAL if 'fds' is NULL)
+*/
+extern int poll(
+    struct pollfd *fds, /* the sockets to watch */
+    ncs_uint nfds,      /* number of entries in 'fds' */
+    ncs_int timeout     /* timeout in milliseconds (< 0: no timeout) */
+    );
+ 
  
 /*
 ** additional service functionality
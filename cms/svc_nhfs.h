@@ -10,6 +10,7 @@
 **  - create directories
 **  - read text or binary files
 **  - write (create) text or binary files
+**  - compute the checksum of files
 ** Accessing files and directories is restricted to a user specific directory
 ** (the current user's area) in the base directory for the whole service.
 ** Furthermore only files and  directories named in a CMS compatible way
@@ -102,6 +103,28 @@ extern BULKSTREAM nhfs_004(
     bool isText);
  
  
+/* Get a binary sink stream to write a CMS file image (see NHFSCOMN.H) to a
+** file in the current user's area.
+**
+** The file and 'overwrite' are specified as for hostfs_putfile().
+** If 'unpack' is false, the image is stored as is, keeping the record
+** structure of the CMS file. If 'unpack' is true, the host side converts the
+** records of the image to text lines and stores these as text file.
+**
+** If the file cannot be created, NULL is returned and the failure reason
+** can be rerieved with hostfs_lastErrorcode resp. hostfs_lastErrormsg.
+*/
+#define hostfs_putimage(fn,ft,overwrite,unpack,pathElems,count) \
+  nhfs_009(fn,ft,overwrite,unpack,pathElems,count)
+extern BULKSTREAM nhfs_009(
+    char *fn,
+    char *ft,
+    bool overwrite,
+    bool unpack,
+    char **pathElems,
+    int count);
+ 
+ 
 /* Create a subdirectory in the current user's area.
 **
 ** The new subdirectory is identified by the 'dirName' parameter.
@@ -117,6 +140,27 @@ int nhfs_005(
     char **pathElems,
     int count);
  
+/* Compute the CRC-32 checksum of a file in the current user's area.
+**
+** The file is identified by the 'fn' and 'ft' parameters and is named 'fn.ft'.
+** The directory where it is to be looked for is given by 'pathElems'/'count'
+** (see hostfs_list()).
+** The checksum is computed on the host side over the file content as stored
+** there, so it allows to check if a host file really changed since the
+** checksum was last computed, without transferring the file.
+**
+** Returns 0 if the checksum was stored in 'crc' or the error code for the
+** operation.
+*/
+#define hostfs_checksum(fn,ft,pathElems,count,crc) \
+  nhfs_008(fn,ft,pathElems,count,crc)
+extern int nhfs_008(
+    char *fn,
+    char *ft,
+    char **pathElems,
+    int count,
+    uint *crc);
+ 
 #define ERR_NOT_USABLE          4050
 #define ERR_INVALID_COMMAND     4051
 #define ERR_INV_NAME_TOKEN      4052
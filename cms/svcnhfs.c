@@ -10,6 +10,7 @@
 **  - create directories
 **  - read text or binary files
 **  - write (create) text or binary files
+**  - compute the checksum of files
 ** Accessing files and directories is restricted to a user specific directory
 ** (the current user's area) in the base directory for the whole service.
 ** Furthermore only files and  directories named in a CMS compatible way
@@ -126,10 +127,10 @@ BULKSTREAM nhfs_003(
   return NULL;
 }
  
-BULKSTREAM nhfs_004(
+static BULKSTREAM openSink(
     char *fn,
     char *ft,
-    bool overwrite,
+    int ctlWord,
     char **pathElems,
     int pathElemsCount,
     bool isText) {
@@ -139,13 +140,11 @@ BULKSTREAM nhfs_004(
   int pathLen = encodePath(pathElems, pathElemsCount, &buffer[fnftLen]);
   int bufLen = fnftLen + pathLen;
  
-  int ctlWord = (overwrite) ? 1 : 0;
- 
   uint streamId;
   lastRc = ncfbasesvc_invoke_sync(
              svcId,      /* svcId */
              3,          /* svcCmd     ==> write file */
-             ctlWord,    /* inCtlWord  ==> overwrite if exists? */
+             ctlWord,    /* inCtlWord  ==> overwrite if exists? unpack image? */
              buffer,     /* inData     ==> fn, ft & path components */
              bufLen,     /* inDataLen  ==> length of path components */
              &streamId,  /* outCtlWord */
@@ -162,6 +161,28 @@ BULKSTREAM nhfs_004(
   return NULL;
 }
  
+BULKSTREAM nhfs_004(
+    char *fn,
+    char *ft,
+    bool overwrite,
+    char **pathElems,
+    int pathElemsCount,
+    bool isText) {
+  int ctlWord = (overwrite) ? 1 : 0;
+  return openSink(fn, ft, ctlWord, pathElems, pathElemsCount, isText);
+}
+ 
+BULKSTREAM nhfs_009(
+    char *fn,
+    char *ft,
+    bool overwrite,
+    bool unpack,
+    char **pathElems,
+    int pathElemsCount) {
+  int ctlWord = ((overwrite) ? 1 : 0) | ((unpack) ? 2 : 0);
+  return openSink(fn, ft, ctlWord, pathElems, pathElemsCount, false);
+}
+ 
 int nhfs_005(
     char *dirName,
     char **pathElems,
@@ -186,6 +207,32 @@ int nhfs_005(
   return lastRc;
 }
  
+int nhfs_008(
+    char *fn,
+    char *ft,
+    char **pathElems,
+    int pathElemsCount,
+    uint *crc) {
+  char buffer[18 + (NHFS_MAX_PATH_DEPTH * 9)];
+  sprintf(buffer, "%s %s%c", fn, ft, (pathElemsCount > 0) ? ' ' : '\0');
+  int fnftLen = strlen(buffer);
+  int pathLen = encodePath(pathElems, pathElemsCount, &buffer[fnftLen]);
+  int bufLen = fnftLen + pathLen;
+ 
+  lastRc = ncfbasesvc_invoke_sync(
+             svcId,      /* svcId */
+             5,          /* svcCmd     ==> checksum of file */
+             0,          /* inCtlWord */
+             buffer,     /* inData     ==> fn, ft & path components */
+             bufLen,     /* inDataLen  ==> length of path components */
+             crc,        /* outCtlWord ==> CRC-32 of the file */
+             NULL,       /* outData */
+             NULL,       /* outDataLen */
+             INDATA_TEXT /* dataFlags */
+             );
+  return lastRc;
+}
+ 
 char* nhfs_000(int rc) {
   switch(rc) {
     case ERR_NOT_USABLE          :
@@ -152,16 +152,15 @@ BULKSTREAM rhnfs015(char *fn, bool isText) {
 }
  
  
-/* Get a sink stream to write a file in the current user's area.
-** (returns 'null' if failed -> rawhostfs_lastXXX())
+/* open a sink stream to write a file in the current directory, with the
+** flags 'ctlData' (1: overwrite, 2: unpack image)
 */
-BULKSTREAM rhnfs016(char *fn, bool overwrite, bool isText) {
+static BULKSTREAM openSink(char *fn, int ctlData, bool isText) {
   uint streamId;
-  int ctlData = (overwrite) ? 1 : 0;
   lastRc = ncfbasesvc_invoke_sync(
              svcId,      /* svcId */
              5,          /* svcCmd     ==> write file */
-             ctlData,    /* inCtlWord  ==> overwrite */
+             ctlData,    /* inCtlWord  ==> overwrite, unpack image */
              fn,         /* inData     ==> filename */
              strlen(fn), /* inDataLen  ==> length of filename */
              &streamId,  /* outCtlWord */
@@ -179,6 +178,44 @@ BULKSTREAM rhnfs016(char *fn, bool overwrite, bool isText) {
 }
  
  
+/* Get a sink stream to write a file in the current user's area.
+** (returns 'null' if failed -> rawhostfs_lastXXX())
+*/
+BULKSTREAM rhnfs016(char *fn, bool overwrite, bool isText) {
+  int ctlData = (overwrite) ? 1 : 0;
+  return openSink(fn, ctlData, isText);
+}
+ 
+ 
+/* Get a binary sink stream to write a CMS file image to a file in the
+** current directory.
+** (returns 'null' if failed -> rawhostfs_lastXXX())
+*/
+BULKSTREAM rhnfs018(char *fn, bool overwrite, bool unpack) {
+  int ctlData = ((overwrite) ? 1 : 0) | ((unpack) ? 2 : 0);
+  return openSink(fn, ctlData, false);
+}
+ 
+ 
+/* Compute the CRC-32 checksum of a file in the current directory.
+** (returns 'false' if failed -> rawhostfs_lastXXX())
+*/
+bool rhnfs017(char *fn, uint *crc) {
+  lastRc = ncfbasesvc_invoke_sync(
+             svcId,      /* svcId */
+             6,          /* svcCmd     ==> checksum of file */
+             0,          /* inCtlWord */
+             fn,         /* inData     ==> filename */
+             strlen(fn), /* inDataLen  ==> length of filename */
+             crc,        /* outCtlWord ==> CRC-32 of the file */
+             NULL,       /* outData */
+             NULL,       /* outDataLen */
+             INDATA_TEXT /* dataFlags */
+             );
+  return (lastRc == 0);
+}
+ 
+ 
 /* Return the error code of the last operation.
 **
 ** Each remote operation executed sets the value retrieved by this function,
@@ -230,6 +267,8 @@ char* rnhfs000(int rc) {
       return "error accessing file";
     case ERR_FILE_EXISTS:
       return "file already exists";
+    case ERR_FILE_READ_ERROR:
+      return "error reading file";
     default:
       return ncfbasesvc_errmsg(lastRc);
   }
@@ -76,6 +76,25 @@ extern BULKSTREAM rhnfs015(char *fileName, bool isText);
 extern BULKSTREAM rhnfs016(char *fileName, bool overwrite, bool isText);
  
  
+/* Get a binary sink stream to write a CMS file image (see NHFSCOMN.H) to a
+** file in the current directory, stored as is or, with 'unpack', converted
+** to a text file by the host side.
+** (returns 'null' if failed -> rawhostfs_lastXXX())
+*/
+#define rawhostfs_putimage(fileName, overwrite, unpack) \
+  rhnfs018(fileName, overwrite, unpack)
+extern BULKSTREAM rhnfs018(char *fileName, bool overwrite, bool unpack);
+ 
+ 
+/* Compute the CRC-32 checksum of a file in the current directory, allowing
+** to check if the file content really changed without transferring the file.
+** (returns 'false' if failed -> rawhostfs_lastXXX())
+*/
+#define rawhostfs_checksum(fileName, crc) \
+  rhnfs017(fileName, crc)
+extern bool rhnfs017(char *fileName, uint *crc);
+ 
+ 
 /* error codes of the Raw NICOF Host File System
 */
 #define ERR_NOT_USABLE         5050
@@ -89,6 +108,7 @@ extern BULKSTREAM rhnfs016(char *fileName, bool overwrite, bool isText);
 #define ERR_DIR_IS_READONLY    5074
 #define ERR_FILE_ACCESS_ERROR  5075
 #define ERR_FILE_EXISTS        5076
+#define ERR_FILE_READ_ERROR    5077
  
  
 /* Return the error code of the last operation.
@@ -1,7 +1,128 @@
  
 #include <stdio.h>
+#include <time.h>
  
 #include "svc_tblk.h"
+#include "benchutl.h"
+ 
+/*
+** read a binary source stream of 'recs' records with 'lrecl' bytes each
+** with the read-ahead 'window' and print the throughput
+*/
+static void benchBinSource(byte lrecl, uint recs, uint window) {
+  BULKSTREAM stream = testbulks_getBinSourceStream(lrecl, recs);
+  if (stream == NULL) {
+    printf("** unable to access bin source stream, skipping benchmark\n");
+    return;
+  }
+  window = nsetwindow(stream, window);
+ 
+  char buf[2048];
+  uint totalBytes = 0;
+  BENCHCLOCK timing;
+  benchStart(&timing);
+  while(!neof(stream)) {
+    uint count = nread(buf, sizeof(buf), false, stream);
+    if (count == 0 && nerror(stream) != NERR_NOERROR) {
+      printf("** nread() => error: %s\n", nerrmsg(stream));
+      break;
+    }
+    totalBytes += count;
+  }
+  nclose(stream);
+ 
+  char what[32];
+  sprintf(what, "nread, window %d", window);
+  benchReport(what, totalBytes, &timing);
+}
+ 
+/*
+** write 'recs' records with 'lrecl' bytes each to a binary sink stream
+** with the write-behind 'window' and print the throughput
+*/
+static void benchBinSink(uint lrecl, uint recs, uint window) {
+  BULKSTREAM stream = testbulks_getBinSinkStream(lrecl, recs);
+  if (stream == NULL) {
+    printf("** unable to access bin sink stream, skipping benchmark\n");
+    return;
+  }
+  window = nsetwindow(stream, window);
+ 
+  char rec[256];
+  memset(rec, 0x30, sizeof(rec));
+  uint totalBytes = 0;
+  BENCHCLOCK timing;
+  benchStart(&timing);
+  while(nwrite(rec, lrecl, stream) > 0) {
+    totalBytes += lrecl;
+  }
+  nclose(stream);
+ 
+  char what[32];
+  sprintf(what, "nwrite, window %d", window);
+  benchReport(what, totalBytes, &timing);
+}
+ 
+/*
+** read 'lines' text lines, either copying with ngetline() or
+** with the zero-copy ngetrec()
+*/
+static void benchTextSource(uint lines, bool zeroCopy) {
+  BULKSTREAM stream = testbulks_getTextSourceStream(lines);
+  if (stream == NULL) {
+    printf("** unable to access text source stream, skipping benchmark\n");
+    return;
+  }
+  nsetwindow(stream, 4);
+ 
+  char lineBuffer[81];
+  uint totalBytes = 0;
+  BENCHCLOCK timing;
+  benchStart(&timing);
+  if (zeroCopy) {
+    uint len;
+    while(ngetrec(80, &len, stream)) { totalBytes += len; }
+  } else {
+    char *line;
+    while(line = ngetline(lineBuffer, 81, stream)) {
+      totalBytes += strlen(line);
+    }
+  }
+  nclose(stream);
+ 
+  benchReport((zeroCopy) ? "ngetrec" : "ngetline", totalBytes, &timing);
+}
+ 
+/*
+** write text lines until the sink accepts no more, either copying with
+** nputline() or placing the data with the zero-copy nputrec()
+*/
+static void benchTextSink(uint lines, bool zeroCopy) {
+  BULKSTREAM stream = testbulks_getTextSinkStream(lines);
+  if (stream == NULL) {
+    printf("** unable to access text sink stream, skipping benchmark\n");
+    return;
+  }
+  nsetwindow(stream, 4);
+ 
+  char *line = "--11--22--33--44--55--66--77--88--99--00--";
+  uint lineLen = strlen(line);
+  uint totalBytes = 0;
+  BENCHCLOCK timing;
+  benchStart(&timing);
+  if (zeroCopy) {
+    char *rec;
+    while(rec = nputrec(lineLen, true, stream)) {
+      memcpy(rec, line, lineLen);
+      totalBytes += lineLen;
+    }
+  } else {
+    while(nputline(line, stream)) { totalBytes += lineLen; }
+  }
+  nclose(stream);
+ 
+  benchReport((zeroCopy) ? "nputrec" : "nputline", totalBytes, &timing);
+}
  
 int main() {
  
@@ -106,6 +227,85 @@ int main() {
   nclose(stream);
   printf("\n");
  
+  /*
+  ** test positional reads on a bin source
+  */
+  stream = testbulks_getBinSourceStream(LRECL, recsToGet);
+  if (stream == NULL) {
+    printf("** unable to access bin source stream, aborting\n");
+    return 8;
+  }
+  printf("++ binary source stream created for positional reads\n");
+  nsetwindow(stream, 4);
+ 
+  char *fillChars = "123456789A"; /* record 'n' is filled with fillChars[n % 10] */
+  char rangeBuf[5000];
+  uint rangeOffset = (LRECL * 10) + 5;
+  uint rangeLen = (LRECL * (recsToGet - 10)) - 5;
+  uint rangeRead = nreadat(rangeBuf, sizeof(rangeBuf), rangeOffset, stream);
+  if (rangeRead != rangeLen) {
+    printf("** nreadat() => bytesRead(%d) != expected(%d), error: %s\n",
+      rangeRead, rangeLen, nerrmsg(stream));
+  } else {
+    int i;
+    for (i = 0; i < rangeRead; i++) {
+      if (rangeBuf[i] != fillChars[((rangeOffset + i) / LRECL) % 10]) { break; }
+    }
+    if (i < rangeRead) {
+      printf("** nreadat() => unexpected data at offset %d\n", rangeOffset + i);
+    } else {
+      printf(".. expected range (%d bytes) received\n", rangeRead);
+    }
+  }
+  rangeRead = nreadat(rangeBuf, LRECL, LRECL * recsToGet, stream);
+  if (rangeRead == 0) {
+    printf(".. no data behind the end of the stream\n");
+  } else {
+    printf("** nreadat() => %d bytes behind the end of the stream\n", rangeRead);
+  }
+  nclose(stream);
+  printf("\n");
+ 
+  /*
+  ** test reading several bin sources with vectored reads
+  */
+  BULKSTREAM streamA = testbulks_getBinSourceStream(LRECL, recsToGet);
+  BULKSTREAM streamB = testbulks_getBinSourceStream(LRECL, recsToGet * 2);
+  if (streamA == NULL || streamB == NULL) {
+    printf("** unable to access bin source streams, aborting\n");
+    return 8;
+  }
+  printf("++ 2 binary source streams created for vectored reads\n");
+ 
+  char bufA[LRECL * 4];
+  char bufB[LRECL * 4];
+  uint totalA = 0;
+  uint totalB = 0;
+  uint vecRounds = 0;
+  NREADVEC vec[2];
+  while (!neof(streamA) || !neof(streamB)) {
+    vec[0].stream = streamA;
+    vec[0].buffer = bufA;
+    vec[0].bufferLen = sizeof(bufA);
+    vec[1].stream = streamB;
+    vec[1].buffer = bufB;
+    vec[1].bufferLen = sizeof(bufB);
+    if (nreadv(vec, 2, false) == 0) { break; }
+    totalA += vec[0].count;
+    totalB += vec[1].count;
+    vecRounds++;
+  }
+  if (totalA == (LRECL * recsToGet) && totalB == (LRECL * recsToGet * 2)) {
+    printf(".. expected bytes (%d + %d) received in %d rounds\n",
+      totalA, totalB, vecRounds);
+  } else {
+    printf("** nreadv() => bytes received (%d + %d) != expected (%d + %d)\n",
+      totalA, totalB, LRECL * recsToGet, LRECL * recsToGet * 2);
+  }
+  nclose(streamA);
+  nclose(streamB);
+  printf("\n");
+ 
   /*
   ** test bulk text sink
   */
@@ -167,4 +367,32 @@ int main() {
   }
   nclose(stream);
   printf("\n");
+ 
+  /*
+  ** throughput of bin source streams with and without read-ahead
+  */
+  printf("++ bin source stream throughput\n");
+  benchBinSource(200, 5000, 1);
+  benchBinSource(200, 5000, 4);
+  benchBinSource(200, 5000, NCFIO_MAXWINDOW);
+  printf("\n");
+ 
+  /*
+  ** throughput of bin sink streams with and without write-behind
+  */
+  printf("++ bin sink stream throughput\n");
+  benchBinSink(200, 5000, 1);
+  benchBinSink(200, 5000, 4);
+  benchBinSink(200, 5000, NCFIO_MAXWINDOW);
+  printf("\n");
+ 
+  /*
+  ** CPU usage of copying vs. zero-copy text stream operations
+  */
+  printf("++ text stream CPU usage\n");
+  benchTextSource(10000, false);
+  benchTextSource(10000, true);
+  benchTextSink(10000, false);
+  benchTextSink(10000, true);
+  printf("\n");
 }
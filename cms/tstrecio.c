@@ -0,0 +1,194 @@
+ 
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+ 
+#include "intrapi.h"
+#include "cmsrecio.h"
+#include "benchutl.h"
+ 
+/*
+** test and benchmark for the blocked record I/O (CMSRECIO)
+*/
+ 
+#define TESTFID "TSTRECIODATA    A1"
+ 
+/*
+** build the content of record 'recNo' with 'len' bytes
+*/
+static void fillRecord(char *rec, int len, unsigned int recNo) {
+  int i;
+  for (i = 0; i < len; i++) { rec[i] = 'A' + ((recNo + i) % 26); }
+}
+ 
+/*
+** write 'recs' records to the test file with the given RECFM, LRECL and
+** block size, returning false if failed
+*/
+static bool writeTestFile(
+    char recfm, int lrecl, unsigned int recs, bool append, int blockSize) {
+  RECFILE rf;
+  char rec[256];
+  if (!append) { CMSfileErase(TESTFID); }
+ 
+  BENCHCLOCK timing;
+  benchStart(&timing);
+  int rc = recOpen(&rf, TESTFID, false, recfm, lrecl, append, blockSize);
+  if (rc != 0) {
+    printf("** recOpen(write) => rc = %d\n", rc);
+    return false;
+  }
+  unsigned int totalBytes = 0;
+  unsigned int i;
+  for (i = 0; i < recs; i++) {
+    int len = (recfm == 'F') ? lrecl : 1 + (i % lrecl);
+    fillRecord(rec, len, i);
+    totalBytes += len;
+    rc = recWrite(&rf, rec, len);
+    if (rc != 0) {
+      printf("** recWrite(%d) => rc = %d\n", i, rc);
+      recClose(&rf);
+      return false;
+    }
+  }
+  rc = recClose(&rf);
+  unsigned int calls = rf.calls; /* including the write of the last block */
+  if (rc != 0) {
+    printf("** recClose(write) => rc = %d\n", rc);
+    return false;
+  }
+  char what[64];
+  sprintf(what, "write, block %5d, %d records, %d CMS calls",
+    blockSize, recs, calls);
+  benchReport(what, totalBytes, &timing);
+  return true;
+}
+ 
+/*
+** read the test file with the given block size and check that it has
+** 'recs' records as written by writeTestFile(), the first 'firstRecs' records
+** having been written by a first call to writeTestFile(), returning false
+** if failed
+*/
+static bool readTestFile(
+    unsigned int recs, unsigned int firstRecs, int blockSize) {
+  RECFILE rf;
+  char rec[256];
+  char expected[256];
+ 
+  BENCHCLOCK timing;
+  benchStart(&timing);
+  int rc = recOpen(&rf, TESTFID, true, ' ', 0, false, blockSize);
+  if (rc != 0) {
+    printf("** recOpen(read) => rc = %d\n", rc);
+    return false;
+  }
+  unsigned int count = 0;
+  unsigned int totalBytes = 0;
+  int len;
+  rc = recRead(&rf, rec, &len);
+  while (rc == 0) {
+    unsigned int recNo = (count < firstRecs) ? count : count - firstRecs;
+    int expLen = (rf.recfm == 'F') ? rf.lrecl : 1 + (recNo % rf.lrecl);
+    fillRecord(expected, expLen, recNo);
+    if (len != expLen || memcmp(rec, expected, len)) {
+      printf("** record %d: content differs\n", count);
+      recClose(&rf);
+      return false;
+    }
+    count++;
+    totalBytes += len;
+    rc = recRead(&rf, rec, &len);
+  }
+  unsigned int calls = rf.calls;
+  recClose(&rf);
+  if (rc != 12) {
+    printf("** recRead(%d) => rc = %d\n", count, rc);
+    return false;
+  }
+  if (count != recs) {
+    printf("** read %d records, expected %d\n", count, recs);
+    return false;
+  }
+  char what[64];
+  sprintf(what, "read,  block %5d, %d records, %d CMS calls",
+    blockSize, recs, calls);
+  benchReport(what, totalBytes, &timing);
+  return true;
+}
+ 
+/*
+** read the test file (as written by writeTestFile() with RECFM F) from
+** record 'recNo' on and check the records up to the end of file, returning
+** false if failed
+*/
+static bool seekTestFile(
+    unsigned int recs, unsigned int recNo, int blockSize) {
+  RECFILE rf;
+  char rec[256];
+  char expected[256];
+ 
+  int rc = recOpen(&rf, TESTFID, true, ' ', 0, false, blockSize);
+  if (rc != 0) {
+    printf("** recOpen(read) => rc = %d\n", rc);
+    return false;
+  }
+  rc = recSeek(&rf, recNo);
+  unsigned int count = recNo - 1;
+  int len;
+  if (rc == 0) { rc = recRead(&rf, rec, &len); }
+  while (rc == 0) {
+    fillRecord(expected, rf.lrecl, count);
+    if (len != rf.lrecl || memcmp(rec, expected, len)) {
+      printf("** record %d after seek: content differs\n", count);
+      recClose(&rf);
+      return false;
+    }
+    count++;
+    rc = recRead(&rf, rec, &len);
+  }
+  recClose(&rf);
+  if (rc != 12 || count != recs) {
+    printf("** seek to %d: rc = %d after %d records\n", recNo, rc, count);
+    return false;
+  }
+  printf(".. seek to record %d, block %5d: ok\n", recNo, blockSize);
+  return true;
+}
+ 
+int main() {
+  intrapi();
+ 
+  int blockSizes[] = { 80, 800, 4096, 16000 };
+  int i;
+  bool ok = true;
+ 
+  printf("++ RECFM F, LRECL 80\n");
+  for (i = 0; ok && i < sizeof(blockSizes) / sizeof(int); i++) {
+    ok = writeTestFile('F', 80, 2000, false, blockSizes[i])
+      && readTestFile(2000, 2000, blockSizes[i]);
+  }
+ 
+  if (ok) {
+    printf("++ RECFM F, LRECL 80, seek\n");
+    ok = seekTestFile(2000, 1500, 4096)
+      && seekTestFile(2000, 1999, 4096)
+      && seekTestFile(2000, 2001, 4096);
+  }
+ 
+  if (ok) {
+    printf("++ RECFM F, LRECL 80, append\n");
+    ok = writeTestFile('F', 80, 7, true, 4096)
+      && readTestFile(2007, 2000, 4096);
+  }
+ 
+  if (ok) {
+    printf("++ RECFM V, LRECL 132\n");
+    ok = writeTestFile('V', 132, 500, false, 4096)
+      && readTestFile(500, 500, 4096);
+  }
+ 
+  CMSfileErase(TESTFID);
+  printf((ok) ? "++ all tests passed\n" : "** test failed\n");
+  return (ok) ? 0 : 4;
+}
@@ -0,0 +1,318 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+import static java.nio.file.StandardWatchEventKinds.ENTRY_CREATE;
+import static java.nio.file.StandardWatchEventKinds.ENTRY_DELETE;
+import static java.nio.file.StandardWatchEventKinds.ENTRY_MODIFY;
+
+import java.io.File;
+import java.io.IOException;
+import java.nio.file.ClosedWatchServiceException;
+import java.nio.file.DirectoryIteratorException;
+import java.nio.file.DirectoryStream;
+import java.nio.file.FileSystems;
+import java.nio.file.Files;
+import java.nio.file.Path;
+import java.nio.file.WatchKey;
+import java.nio.file.WatchService;
+import java.nio.file.attribute.BasicFileAttributes;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.Iterator;
+import java.util.LinkedHashMap;
+import java.util.List;
+import java.util.Map;
+
+import dev.hawala.vm370.Log;
+
+/**
+ * Cache for the content of directories listed by the host file services.
+ * <p>
+ * A directory not yet in the cache is read incrementally through a
+ * <tt>DirectoryStream</tt>, so the listing can be sent to the VM/370 side
+ * while it is read. The entries collected during a complete listing are kept,
+ * so repeated listings of the same directory are answered from memory, until
+ * the directory changes. The file services drop a directory synchronously with
+ * <tt>invalidate()</tt> when they change it themselves (creating or writing a
+ * file, creating a subdirectory), so a listing requested right after such a
+ * change sees it. Changes made by others are reported by a <tt>WatchService</tt>
+ * (possibly some seconds later on platforms where the watch service polls). If
+ * the platform does not provide a watch service, directories are always read
+ * from disk.
+ * <p>
+ * The number of directories kept is limited, the least recently listed
+ * directory is dropped first.
+ *
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public class DirectoryListCache {
+	
+	private static Log logger = Log.getLogger();
+	
+	// max. number of directories kept in the cache
+	private final static int MAX_DIRECTORIES = 64;
+	
+	private static DirectoryListCache instance = null;
+	
+	/**
+	 * Get the cache shared by all file services.
+	 * @return the directory list cache.
+	 */
+	public static synchronized DirectoryListCache getInstance() {
+		if (instance == null) { instance = new DirectoryListCache(); }
+		return instance;
+	}
+	
+	/**
+	 * The data of a file or directory in a listed directory.
+	 */
+	public static class DirEntry {
+		public final String name;
+		public final boolean isDirectory;
+		public final boolean isFile;
+		public final long size;
+		public final long lastModified;
+		
+		private DirEntry(String name, BasicFileAttributes attrs) {
+			this.name = name;
+			this.isDirectory = attrs.isDirectory();
+			this.isFile = attrs.isRegularFile();
+			this.size = attrs.size();
+			this.lastModified = attrs.lastModifiedTime().toMillis();
+		}
+	}
+	
+	// a directory known to the cache, with its entries once it was completely listed
+	private static class CachedDir {
+		private final Path dir;
+		private final WatchKey key;
+		private boolean valid = true; // false if the directory changed since the listing started
+		private List<DirEntry> entries = null; // null while the first listing is in progress
+		
+		private CachedDir(Path dir, WatchKey key) {
+			this.dir = dir;
+			this.key = key;
+		}
+	}
+	
+	private final WatchService watcher; // null if directory changes cannot be watched
+	
+	private final Map<WatchKey, CachedDir> watchedDirs = new HashMap<WatchKey, CachedDir>();
+	
+	private final LinkedHashMap<Path, CachedDir> cachedDirs = new LinkedHashMap<Path, CachedDir>(16, 0.75f, true) {
+		private static final long serialVersionUID = 1L;
+		
+		@Override
+		protected boolean removeEldestEntry(Map.Entry<Path, CachedDir> eldest) {
+			if (this.size() <= MAX_DIRECTORIES) { return false; }
+			forget(eldest.getValue(), false);
+			return true;
+		}
+	};
+	
+	private DirectoryListCache() {
+		WatchService ws = null;
+		try {
+			ws = FileSystems.getDefault().newWatchService();
+		} catch (Exception e) {
+			logger.warn("DirectoryListCache: no watch service available, directory listings will not be cached");
+		}
+		this.watcher = ws;
+		if (this.watcher != null) {
+			Thread t = new Thread(new Runnable() {
+				@Override
+				public void run() { watch(); }
+			});
+			t.setName("DirectoryListCache-Watcher");
+			t.setDaemon(true);
+			t.start();
+		}
+	}
+	
+	// the watcher thread: drop a directory from the cache if anything changes in it
+	private void watch() {
+		while (true) {
+			WatchKey key;
+			try {
+				key = this.watcher.take();
+			} catch (InterruptedException e) {
+				return;
+			} catch (ClosedWatchServiceException e) {
+				return;
+			}
+			key.pollEvents(); // any event (including an overflow) invalidates the listing
+			synchronized(this) {
+				CachedDir cd = this.watchedDirs.get(key);
+				if (cd != null) { this.forget(cd, true); }
+			}
+			key.cancel();
+		}
+	}
+	
+	// remove the directory from the cache and stop watching it (must be called synchronized)
+	private void forget(CachedDir cd, boolean removeFromCache) {
+		cd.valid = false;
+		cd.key.cancel();
+		this.watchedDirs.remove(cd.key);
+		if (removeFromCache && this.cachedDirs.get(cd.dir) == cd) {
+			this.cachedDirs.remove(cd.dir);
+		}
+	}
+	
+	/**
+	 * Drop the cached listing of the directory, as the file service changed
+	 * something in the directory. A listing of the directory currently in
+	 * progress will not be cached.
+	 * @param directory the directory changed.
+	 */
+	public void invalidate(File directory) {
+		if (directory == null) { return; }
+		Path dir = directory.toPath().toAbsolutePath().normalize();
+		synchronized(this) {
+			CachedDir cd = this.cachedDirs.get(dir);
+			if (cd != null) { this.forget(cd, true); }
+		}
+	}
+	
+	/**
+	 * Start listing the directory, either from the cache or from the disk.
+	 * @param directory the directory to list.
+	 * @return the listing delivering the directory entries.
+	 * @throws IOException if the directory cannot be read.
+	 */
+	public Listing open(File directory) throws IOException {
+		Path dir = directory.toPath().toAbsolutePath().normalize();
+		
+		CachedDir target = null;
+		synchronized(this) {
+			CachedDir cd = this.cachedDirs.get(dir);
+			if (cd != null && cd.valid && cd.entries != null) {
+				return new Listing(cd.entries.iterator());
+			}
+			if (cd == null && this.watcher != null) {
+				// watch the directory before reading it, so no change can get lost
+				try {
+					WatchKey key = dir.register(this.watcher, ENTRY_CREATE, ENTRY_DELETE, ENTRY_MODIFY);
+					target = new CachedDir(dir, key);
+					this.watchedDirs.put(key, target);
+					this.cachedDirs.put(dir, target);
+				} catch (Exception e) {
+					// not watchable, so simply not cached
+				}
+			}
+		}
+		
+		try {
+			return new Listing(Files.newDirectoryStream(dir), target);
+		} catch (IOException e) {
+			if (target != null) { synchronized(this) { this.forget(target, true); } }
+			throw e;
+		}
+	}
+	
+	/**
+	 * Incremental reader for the entries of a directory.
+	 */
+	public class Listing {
+		
+		private final Iterator<DirEntry> cached;
+		
+		private final DirectoryStream<Path> stream;
+		private final Iterator<Path> paths;
+		private final CachedDir target;
+		private final List<DirEntry> collected;
+		
+		private boolean done = false;
+		
+		private Listing(Iterator<DirEntry> cached) {
+			this.cached = cached;
+			this.stream = null;
+			this.paths = null;
+			this.target = null;
+			this.collected = null;
+		}
+		
+		private Listing(DirectoryStream<Path> stream, CachedDir target) {
+			this.cached = null;
+			this.stream = stream;
+			this.paths = stream.iterator();
+			this.target = target;
+			this.collected = (target != null) ? new ArrayList<DirEntry>() : null;
+		}
+		
+		/**
+		 * Get the next entry of the directory.
+		 * @return the next entry or <code>null</code> if the listing is complete.
+		 */
+		public DirEntry next() {
+			if (this.done) { return null; }
+			if (this.cached != null) {
+				if (this.cached.hasNext()) { return this.cached.next(); }
+				this.done = true;
+				return null;
+			}
+			
+			try {
+				while (this.paths.hasNext()) {
+					Path p = this.paths.next();
+					try {
+						BasicFileAttributes attrs = Files.readAttributes(p, BasicFileAttributes.class);
+						DirEntry e = new DirEntry(p.getFileName().toString(), attrs);
+						if (this.collected != null) { this.collected.add(e); }
+						return e;
+					} catch (IOException exc) {
+						// vanished since the directory was read or not accessible: skip it
+					}
+				}
+			} catch (DirectoryIteratorException exc) {
+				logger.warn("DirectoryListCache: error reading directory: ", exc.getCause());
+				this.close();
+				return null;
+			}
+			
+			// complete listing: remember it if the directory did not change in the meantime
+			if (this.target != null) {
+				synchronized(DirectoryListCache.this) {
+					if (this.target.valid) { this.target.entries = this.collected; }
+				}
+			}
+			this.done = true;
+			this.closeStream();
+			return null;
+		}
+		
+		/**
+		 * Stop the listing, dropping the entries read so far if it is not complete.
+		 */
+		public void close() {
+			if (!this.done && this.target != null) {
+				synchronized(DirectoryListCache.this) { forget(this.target, true); }
+			}
+			this.done = true;
+			this.closeStream();
+		}
+		
+		private void closeStream() {
+			if (this.stream == null) { return; }
+			try {
+				this.stream.close();
+			} catch (IOException e) {
+				// ignored
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+/**
+ * Interface for a bulk source data stream whose content can also be read at
+ * arbitrary positions, independently of the sequential reading with
+ * <tt>getNextBlock()</tt>.
+ * <p>
+ * Positional reads allow the VM/370 side to fetch several ranges of the
+ * source in parallel or to restart an interrupted transfer in the middle
+ * of the data (see <tt>nreadat()</tt> in NCFIO.H).
+ * 
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public interface IRandomAccessBulkSource extends IBulkSource {
+	
+	/**
+	 * Get the total length of the source data.
+	 * @return the length of the source in bytes.
+	 */
+	public long getLength();
+	
+	/**
+	 * Read a block of data starting at the given position in the source. This
+	 * neither changes the position for <tt>getNextBlock()</tt> nor the state of
+	 * the source and may be invoked concurrently from several threads.
+	 * @param position the offset of the first byte to read.
+	 * @param buffer the buffer to fill.
+	 * @param length the maximum number of bytes to read into the buffer.
+	 * @return the number of bytes filled into the buffer, which is less than
+	 *   'length' only if the end of the source was reached, or -1 if reading
+	 *   failed.
+	 */
+	public int getBlockAt(long position, byte[] buffer, int length);
+}
@@ -0,0 +1,162 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+import java.io.File;
+import java.io.IOException;
+import java.util.Calendar;
+
+import dev.hawala.vm370.commproxy.DirectoryListCache.DirEntry;
+
+/**
+ * Bulk source streaming the content of a directory as ASCII text lines, one
+ * line for each entry of the directory accepted by the subclass.
+ * <p>
+ * The directory entries are fetched from the <tt>DirectoryListCache</tt> only
+ * as far as needed to fill the next block requested by the VM/370 side, so even
+ * huge directories are transmitted without building the complete listing in
+ * memory first.
+ *
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public abstract class LevelOneDirectoryListSource implements IBulkSource {
+	
+	private final File dirToList;
+	
+	private int state = IBulkSource.STATE_OK;
+	
+	private DirectoryListCache.Listing listing = null;
+	
+	private final StringBuilder sb = new StringBuilder();
+	private final Calendar cal = Calendar.getInstance();
+	
+	private byte[] pending = null; // the line not yet completely transmitted
+	private int pendingOffset = 0;
+	
+	public LevelOneDirectoryListSource(File dirToList) {
+		this.dirToList = dirToList;
+	}
+	
+	/**
+	 * Check if the directory entry is to be listed.
+	 * @param e the directory entry.
+	 * @return <code>true</code> if a line is to be produced for the entry.
+	 */
+	protected abstract boolean accept(DirEntry e);
+	
+	/**
+	 * Append the line text (without line end) for the directory entry.
+	 * @param e the directory entry.
+	 * @param sb the target for the line text.
+	 */
+	protected abstract void appendLine(DirEntry e, StringBuilder sb);
+	
+	@Override
+	public void close() {
+		if (this.listing != null) {
+			this.listing.close();
+			this.listing = null;
+		}
+		this.state = IBulkSource.STATE_SOURCE_CLOSED;
+	}
+	
+	@Override
+	public int getNextBlock(byte[] buffer, boolean availableOnly) {
+		// check if there is nothing to transmit
+		if (this.state != IBulkSource.STATE_OK) { return 0; }
+		
+		// start reading the directory on first get block request
+		if (this.listing == null) {
+			try {
+				this.listing = DirectoryListCache.getInstance().open(this.dirToList);
+			} catch (IOException e) {
+				this.state = IBulkSource.STATE_READ_ERROR;
+				return 0;
+			}
+		}
+		
+		int count = 0;
+		while (count < buffer.length) {
+			// pass the (rest of the) current line
+			if (this.pending != null) {
+				int chunk = Math.min(buffer.length - count, this.pending.length - this.pendingOffset);
+				System.arraycopy(this.pending, this.pendingOffset, buffer, count, chunk);
+				count += chunk;
+				this.pendingOffset += chunk;
+				if (this.pendingOffset >= this.pending.length) { this.pending = null; }
+				continue;
+			}
+			
+			// get the next line to pass
+			DirEntry e = this.listing.next();
+			if (e == null) {
+				this.listing.close();
+				this.state = IBulkSource.STATE_SOURCE_ENDED;
+				break;
+			}
+			if (!this.accept(e)) { continue; }
+			this.sb.setLength(0);
+			this.appendLine(e, this.sb);
+			this.sb.append("\r\n");
+			this.pending = this.sb.toString().getBytes();
+			this.pendingOffset = 0;
+		}
+		
+		return count;
+	}
+	
+	@Override
+	public int getAvailableCount() { return (this.state == IBulkSource.STATE_OK) ? -1 : 0; }
+	
+	@Override
+	public int getRemainingCount() { return (this.state == IBulkSource.STATE_OK) ? -1 : 0; }
+	
+	@Override
+	public int getState() { return this.state; }
+	
+	/*
+	** formatting helpers for subclasses
+	*/
+	
+	// append the string left-justified in a field of 'width' chars
+	protected static void appendLeft(StringBuilder sb, String s, int width) {
+		sb.append(s);
+		for (int i = s.length(); i < width; i++) { sb.append(' '); }
+	}
+	
+	// append the number right-justified in a field of 'width' chars
+	protected static void appendRight(StringBuilder sb, long n, int width) {
+		String s = Long.toString(n);
+		for (int i = s.length(); i < width; i++) { sb.append(' '); }
+		sb.append(s);
+	}
+	
+	// append the timestamp formatted as "yyyy-MM-dd hh:mm:ss" (12-hour clock)
+	protected void appendTimestamp(StringBuilder sb, long millis) {
+		this.cal.setTimeInMillis(millis);
+		int hour = this.cal.get(Calendar.HOUR);
+		append2(sb.append(this.cal.get(Calendar.YEAR)).append('-'), this.cal.get(Calendar.MONTH) + 1);
+		append2(sb.append('-'), this.cal.get(Calendar.DAY_OF_MONTH));
+		append2(sb.append(' '), (hour == 0) ? 12 : hour);
+		append2(sb.append(':'), this.cal.get(Calendar.MINUTE));
+		append2(sb.append(':'), this.cal.get(Calendar.SECOND));
+	}
+	
+	private static void append2(StringBuilder sb, int n) {
+		if (n < 10) { sb.append('0'); }
+		sb.append(n);
+	}
+}
@@ -0,0 +1,142 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+import java.io.File;
+import java.io.FileOutputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
+
+import dev.hawala.vm370.Log;
+
+/**
+ * IBulkSink-Wrapper for a file, writing through the <tt>FileChannel</tt> of
+ * the file.
+ * <p>
+ * The (small) blocks received from the VM/370 side are collected in a large
+ * direct buffer, which is written to the file when full, so the file system
+ * sees few large writes. The file content is forced to the storage device
+ * once when the sink is closed.
+ * <p>
+ * A failed write of the buffer (e.g. if the disk is full) puts the sink in
+ * the write error state, which is returned for the block causing the write
+ * and for all later blocks, so the client stops sending. Writing the rest of
+ * the buffer when closing resp. forcing the file may also fail, which is
+ * reported by the state after close(). The first error is kept, also if the
+ * sink is closed again.
+ * <p>
+ * The cached listing of the directory of the file is dropped when the file
+ * is created and when the sink is closed, so the next listing shows the
+ * final size and timestamp of the file.
+ * 
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public class LevelOneFileChannelSink implements IBulkSink {
+	
+	private static Log logger = Log.getLogger();
+	
+	// size of the buffer collecting the blocks to write (a multiple of the page size)
+	private final static int WRITE_BUFFER_SIZE = 256 * 1024;
+	
+	private final String filename;
+	private final File directory;
+	private FileOutputStream fos;
+	private FileChannel channel;
+	private final ByteBuffer buffer = ByteBuffer.allocateDirect(WRITE_BUFFER_SIZE);
+	
+	private int state = IBulkSink.STATE_OK;
+	
+	public LevelOneFileChannelSink(String filename, FileOutputStream fos, File directory) {
+		this.filename = filename;
+		this.directory = directory;
+		this.fos = fos;
+		this.channel = fos.getChannel();
+		DirectoryListCache.getInstance().invalidate(directory); // the file was created resp. truncated
+	}
+
+	@Override
+	public void close() {
+		if (this.fos != null) {
+			boolean written = this.writeBuffer();
+			try {
+				if (written) { this.channel.force(false); }
+			} catch (IOException exc) {
+				logger.error("** Error forcing file '", filename, "' to disk, Exception: ", exc);
+				written = false;
+			}
+			try {
+				this.fos.close(); // also closes the channel
+			} catch (IOException e) {
+				// ignored
+			}
+			this.fos = null;
+			this.channel = null;
+			DirectoryListCache.getInstance().invalidate(this.directory);
+			if (!written && this.state == IBulkSink.STATE_OK) {
+				this.state = IBulkSink.STATE_WRITE_ERROR; // let the client know the data is lost
+			}
+		}
+		if (this.state == IBulkSink.STATE_OK) {
+			this.state = IBulkSink.STATE_TARGET_CLOSED;
+		}
+	}
+
+	@Override
+	public int getState() { return this.state; }
+
+	@Override
+	public void putBlock(byte[] buffer, int length) {
+		// check if we are still able to write
+		// (the state tells the client about a failed write of an earlier block)
+		if (this.state != IBulkSink.STATE_OK) {
+			logger.warn("putBlock: this.state != IBulkSink.STATE_OK");
+			return;
+		}
+		if (this.fos == null) {
+			logger.warn("putBlock: this.fos == null");
+			this.state = IBulkSink.STATE_TARGET_CLOSED;
+			return;
+		}
+		
+		// collect this block, writing the buffer to the file when full
+		int offset = 0;
+		while (offset < length) {
+			if (!this.buffer.hasRemaining() && !this.writeBuffer()) { return; }
+			int chunk = Math.min(length - offset, this.buffer.remaining());
+			this.buffer.put(buffer, offset, chunk);
+			offset += chunk;
+		}
+	}
+	
+	// write the collected data to the file, returning if this was successful
+	private boolean writeBuffer() {
+		if (this.state != IBulkSink.STATE_OK) { return false; }
+		this.buffer.flip();
+		try {
+			while (this.buffer.hasRemaining()) {
+				this.channel.write(this.buffer);
+			}
+		} catch (Exception exc) {
+			logger.error("** Error writing to file '", filename, "', Exception: ", exc);
+			this.state = IBulkSink.STATE_WRITE_ERROR;
+			return false;
+		} finally {
+			this.buffer.clear();
+		}
+		return true;
+	}
+}
@@ -0,0 +1,167 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+import java.io.FileInputStream;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.channels.FileChannel;
+
+/**
+ * IBulkSource-Wrapper for a file, reading through the <tt>FileChannel</tt> of the
+ * file and supporting positional reads.
+ * <p>
+ * Large files are read sequentially through a direct read-ahead buffer filled
+ * with large positional reads on the channel, so the file system sees few large
+ * reads instead of one per block. If the sequential hint is given, the read-ahead
+ * buffer is larger, so the operating system can read ahead the file data in large
+ * chunks. (memory mapping the file is avoided, as the mapped windows would stay
+ * mapped until garbage collected and reading a file truncated in the meantime
+ * would crash the proxy resp. raise an InternalError)
+ * 
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public class LevelOneFileChannelSource implements IRandomAccessBulkSource {
+	
+	// files at least this long are read through the read-ahead buffer
+	private final static long READAHEAD_MIN_LENGTH = 1024 * 1024;
+	
+	// size of the read-ahead buffer without resp. with the sequential hint
+	private final static int READAHEAD_SIZE = 64 * 1024;
+	private final static int READAHEAD_SEQUENTIAL_SIZE = 1024 * 1024;
+	
+	private int state = IBulkSource.STATE_OK;
+	
+	private FileInputStream fis = null;
+	private FileChannel channel = null;
+	private final long length;
+	private final boolean sequentialHint;
+	private long position = 0;
+	
+	private ByteBuffer readAhead = null; // allocated on the first read
+
+	public LevelOneFileChannelSource(FileInputStream fis, long fileLength, boolean sequentialHint) {
+		this.fis = fis;
+		this.channel = fis.getChannel();
+		this.length = fileLength;
+		this.sequentialHint = sequentialHint;
+	}
+
+	public LevelOneFileChannelSource(FileInputStream fis, long fileLength) {
+		this(fis, fileLength, false);
+	}
+	
+	@Override
+	public void close() {
+		if (this.fis != null) {
+			try {
+				this.fis.close(); // also closes the channel
+			} catch (IOException e) {
+				// ignored
+			}
+			this.fis = null;
+			this.channel = null;
+			this.readAhead = null;
+		}
+		this.state = IBulkSource.STATE_SOURCE_CLOSED;
+	}
+
+	@Override
+	public int getNextBlock(byte[] buffer, boolean availableOnly) {
+		// check if there is nothing to transmit
+		if (this.state != IBulkSource.STATE_OK) { return 0; }
+		
+		int count = (this.length >= READAHEAD_MIN_LENGTH)
+				? this.getBufferedBlock(buffer)
+				: this.getBlockAt(this.position, buffer, buffer.length);
+		if (count < 0) {
+			this.state = IBulkSource.STATE_READ_ERROR;
+			return 0;
+		}
+		
+		// a short read means that the end of the file was reached
+		this.position += count;
+		if (count < buffer.length) {
+			this.state = IBulkSource.STATE_SOURCE_ENDED;
+		}
+		
+		return count;
+	}
+	
+	// copy the next block from the read-ahead buffer at the current position,
+	// refilling the buffer from the file if it is exhausted
+	private int getBufferedBlock(byte[] buffer) {
+		if (this.readAhead == null) {
+			int size = (this.sequentialHint) ? READAHEAD_SEQUENTIAL_SIZE : READAHEAD_SIZE;
+			this.readAhead = ByteBuffer.allocateDirect(size);
+			this.readAhead.flip(); // empty
+		}
+		int count = 0;
+		try {
+			while (count < buffer.length) {
+				if (!this.readAhead.hasRemaining()) {
+					long start = this.position + count;
+					if (start >= this.length) { break; }
+					this.readAhead.clear();
+					this.readAhead.limit((int)Math.min(this.readAhead.capacity(), this.length - start));
+					while (this.readAhead.hasRemaining()) {
+						int read = this.channel.read(this.readAhead, start + this.readAhead.position());
+						if (read < 0) { break; } // end of file (possibly truncated in the meantime)
+					}
+					this.readAhead.flip();
+					if (!this.readAhead.hasRemaining()) { break; }
+				}
+				int chunk = Math.min(buffer.length - count, this.readAhead.remaining());
+				this.readAhead.get(buffer, count, chunk);
+				count += chunk;
+			}
+		} catch (IOException e) {
+			return -1;
+		}
+		return count;
+	}
+
+	@Override
+	public int getBlockAt(long position, byte[] buffer, int length) {
+		FileChannel fc = this.channel;
+		if (fc == null || position < 0) { return -1; }
+		
+		// positional reads on the channel are independent from each other,
+		// so no synchronization is needed here
+		ByteBuffer bb = ByteBuffer.wrap(buffer, 0, Math.min(length, buffer.length));
+		try {
+			while (bb.hasRemaining()) {
+				int count = fc.read(bb, position + bb.position());
+				if (count < 0) { break; }
+			}
+		} catch (IOException e) {
+			return -1;
+		}
+		return bb.position();
+	}
+
+	@Override
+	public long getLength() { return this.length; }
+
+	@Override
+	public int getAvailableCount() { return (int)Math.min(2048, this.length - this.position); }
+
+	@Override
+	public int getRemainingCount() { return (int)Math.min(Integer.MAX_VALUE, this.length - this.position); }
+
+	@Override
+	public int getState() { return this.state; }
+}
@@ -71,6 +71,7 @@ public class LevelOneFileContentSource implements IBulkSource {
 			return 0;
 		}
 		
+		this.remainingBytes = Math.max(0, this.remainingBytes - count);
 		return count;
 	}
 
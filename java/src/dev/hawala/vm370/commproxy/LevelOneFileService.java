@@ -15,15 +15,15 @@
 package dev.hawala.vm370.commproxy;
 
 import java.io.File;
-import java.io.FileFilter;
 import java.io.FileInputStream;
 import java.io.FileOutputStream;
-import java.text.SimpleDateFormat;
+import java.io.IOException;
 import java.util.ArrayList;
-import java.util.Date;
+import java.util.zip.CRC32;
 import java.util.regex.Pattern;
 
 import dev.hawala.vm370.Log;
+import dev.hawala.vm370.commproxy.DirectoryListCache.DirEntry;
 import dev.hawala.vm370.ebcdic.EbcdicHandler;
 
 /**
@@ -66,6 +66,12 @@ public class LevelOneFileService implements ILevelOneHandler {
 	// the accessible base directory of the VM-user to which this file service is bound. 
 	private File userDir = null; // if null => service is misconfigured and not usable
 	
+	// let the OS read ahead files in large chunks when read sequentially?
+	private boolean sequentialHint = true;
+	
+	// character set conversion for unpacking CMS file images to text files
+	private LevelOneRecordCodec codec = null;
+	
 	// the error-returncodes of the file service
 	private static final int ERR_NOT_USABLE = 4050;          // service is misconfigured
 	private static final int ERR_INVALID_COMMAND = 4051;
@@ -101,12 +107,17 @@ public class LevelOneFileService implements ILevelOneHandler {
 	 *   => Buffer: 1. token: filename, 2. token: extension (filetype), others: directory path to the file
 	 *      
 	 * 3 => write file
-	 *   => controlData: 1: overwrite if exists, others: don't overwrite
+	 *   => controlData: flags 0x01: overwrite if exists
+	 *                         0x02: data is a CMS file image to be unpacked to a text file
 	 *   => Buffer: 1. token: filename, 2. token: extension (filetype), others: directory path to the file
 	 *   
 	 * 4 => create dir
 	 *   => Buffer: 1. token: new directory name, others: directory path where the new directory is to be created
 	 *   
+	 * 5 => checksum of file
+	 *   => Buffer: 1. token: filename, 2. token: extension (filetype), others: directory path to the file
+	 *   ==> result: controlData: CRC-32 of the file content
+	 *   
 	 * Errorcodes: see ERR_* constants
 	 */
 	
@@ -116,6 +127,10 @@ public class LevelOneFileService implements ILevelOneHandler {
 	@Override
 	public void initialize(String name, EbcdicHandler clientVm, PropertiesExt configuration) {
 		String basepath = configuration.getString(name + ".basepath", "userbase");
+		this.sequentialHint = configuration.getBoolean(name + ".sequentialhint", true);
+		this.codec = new LevelOneRecordCodec(
+				configuration.getString("recordmode.codepage", null),
+				configuration.getString("recordmode.hostcharset", null));
 		File basedir = new File(basepath);
 		File userDir = new File(basedir, clientVm.toString().trim().toLowerCase());
 		if (userDir.exists() && !userDir.isDirectory()) {
@@ -159,6 +174,7 @@ public class LevelOneFileService implements ILevelOneHandler {
 		if (cmd == 2) { return this.createFileReader(tokens); }
 		if (cmd == 3) { return this.createFileWriter(tokens, controlData); }
 		if (cmd == 4) { return this.createDirectory(tokens); }
+		if (cmd == 5) { return this.computeChecksum(tokens); }
 		
 		return new LevelOneProtErrResult(ERR_INVALID_COMMAND);
 	}
@@ -185,88 +201,44 @@ public class LevelOneFileService implements ILevelOneHandler {
 	
 	// Level-One Bulk-stream writing the directory content (files and directories
 	// complying to the CMS naming rules) as ASCII data.
-	static private class DirectoryListSource implements IBulkSource {
-		
-		private final File dirToList;
-		
-		private int state = IBulkSource.STATE_OK;
-		
-		private byte[] content = null;
-		private int currOffset = 0;
-		private int remainingBytes = 0;
+	static private class DirectoryListSource extends LevelOneDirectoryListSource {
 
 		public DirectoryListSource(File dirToList) {
-			// just save the name of the directory to list
-			this.dirToList = dirToList;
+			super(dirToList);
 		}
 		
+		// check the CMS naming rules: "name" for directories and "name.type" for
+		// files, with names and types of 1..8 characters
 		@Override
-		public void close() { 
-			this.state = IBulkSource.STATE_SOURCE_CLOSED;
+		protected boolean accept(DirEntry e) {
+			int len = e.name.length();
+			int dot = e.name.indexOf('.');
+			if (e.isDirectory) {
+				return (dot < 0 && len > 0 && len <= 8);
+			}
+			return (e.isFile
+					&& dot > 0 && dot <= 8
+					&& (len - dot - 1) > 0 && (len - dot - 1) <= 8
+					&& e.name.indexOf('.', dot + 1) < 0);
 		}
 
+		// "D name" resp. "F name     type       size yyyy-MM-dd hh:mm:ss"
 		@Override
-		public int getNextBlock(byte[] buffer, boolean availableOnly) {
-			// check if there is nothing to transmit
-			if (this.state != IBulkSource.STATE_OK) { return 0; }
-			
-			// create the content on first get block request
-			if (this.content == null) {
-				StringBuffer sb = new StringBuffer();
-				File[] theFiles = this.dirToList.listFiles(new FileFilter() {
-					public boolean accept(File f) {
-						String[] parts = f.getName().split(Pattern.quote("."));
-						if (f.isDirectory()) {
-							return (parts.length == 1 && parts[0].length() > 0 && parts[0].length() <= 8);
-						}
-						return (parts.length == 2
-								&& parts[0].length() > 0 && parts[0].length() <= 8
-								&& parts[1].length() > 0 && parts[1].length() <= 8);
-					}
-				});
-				
-				SimpleDateFormat sdfmt = new SimpleDateFormat();
-				sdfmt.applyPattern("yyyy-MM-dd hh:mm:ss");
-
-				for (File f : theFiles) {
-					if (f.isDirectory()) {
-						sb.append("D ").append(f.getName());
-					} else if (f.isFile()) {
-						String[] parts = f.getName().split(Pattern.quote("."));
-						Date ts = new Date(f.lastModified());
-						String line = String.format(
-								"F %-8s %-8s %8d %s", 
-								parts[0], parts[1], f.length(), sdfmt.format(ts));
-						sb.append(line);
-					}
-					sb.append("\r\n");
-				}
-				
-				this.content = sb.toString().getBytes(); 
-				this.remainingBytes = this.content.length;
+		protected void appendLine(DirEntry e, StringBuilder sb) {
+			if (e.isDirectory) {
+				sb.append("D ").append(e.name);
+				return;
 			}
-			
-			// pass back the next chunk of bytes
-			int count = Math.min(2048, this.remainingBytes);
-			if (count == 0) { 
-				this.state = IBulkSource.STATE_SOURCE_ENDED; // why isn't this one already set?
-				return 0; 
-			}
-			System.arraycopy(this.content, this.currOffset, buffer, 0, count);
-			this.currOffset += count;
-			this.remainingBytes -= count;
-			if (this.remainingBytes <= 0) { this.state = IBulkSource.STATE_SOURCE_ENDED; }
-			return count;
+			int dot = e.name.indexOf('.');
+			sb.append("F ");
+			appendLeft(sb, e.name.substring(0, dot), 8);
+			sb.append(' ');
+			appendLeft(sb, e.name.substring(dot + 1), 8);
+			sb.append(' ');
+			appendRight(sb, e.size, 8);
+			sb.append(' ');
+			this.appendTimestamp(sb, e.lastModified);
 		}
-
-		@Override
-		public int getAvailableCount() { return Math.min(2048, this.remainingBytes); }
-
-		@Override
-		public int getRemainingCount() { return this.remainingBytes; }
-
-		@Override
-		public int getState() { return this.state; }
 	}
 
 	/*
@@ -302,7 +274,61 @@ public class LevelOneFileService implements ILevelOneHandler {
 			return new LevelOneProtErrResult(ERR_FILE_READ_ERROR);
 		}
 		
-		return new LevelOneFileContentSource(fis, (int)(f.length() & 0xFFFFFFFF));
+		return new LevelOneFileChannelSource(fis, f.length(), this.sequentialHint);
+	}
+	
+	/*
+	** checksum of a file
+	*/
+	
+	// compute the CRC-32 of the file specified by the tokens in the request, allowing
+	// the VM/370 side to check if the content of a file really changed.
+	private ILevelOneResult computeChecksum(ArrayList<String> tokens) {
+		if (tokens.size() < 2) {
+			return new LevelOneProtErrResult(ERR_MISSING_FNFT_TOKENS);
+		}
+		
+		String filename = tokens.get(0) + "." + tokens.get(1);
+		File dir = this.userDir;
+		for (int i = 2; i < tokens.size(); i++) {
+			dir = new File(dir, tokens.get(i));
+		}
+		if (!dir.exists() || !dir.isDirectory()) {
+			return new LevelOneProtErrResult(ERR_DIRPATH_NOT_PRESENT);
+		} 
+		
+		File f = new File(dir, filename);
+		if (!f.exists() || !f.isFile() || !f.canRead()) {
+			return new LevelOneProtErrResult(ERR_FILE_NOT_FOUND);
+		}
+		
+		try {
+			return new LevelOneBufferResult(0, fileChecksum(f), 0);
+		} catch (IOException e) {
+			logger.error("** Error computing checksum of file '", f.getPath(), "', Exception: ", e);
+			return new LevelOneProtErrResult(ERR_FILE_READ_ERROR);
+		}
+	}
+	
+	/**
+	 * Compute the CRC-32 of the content of a file.
+	 * @param f the file to read.
+	 * @return the CRC-32 of the file content.
+	 * @throws IOException if the file cannot be read.
+	 */
+	static int fileChecksum(File f) throws IOException {
+		CRC32 crc = new CRC32();
+		byte[] buffer = new byte[65536];
+		FileInputStream fis = new FileInputStream(f);
+		try {
+			int count;
+			while ((count = fis.read(buffer)) > 0) {
+				crc.update(buffer, 0, count);
+			}
+		} finally {
+			fis.close();
+		}
+		return (int)crc.getValue();
 	}
 	
 	/*
@@ -312,7 +338,8 @@ public class LevelOneFileService implements ILevelOneHandler {
 	// Create a Level-One writing bulk stream to the file specified by the request
 	// tokens. If the file already exists and the replace flag is not set in the 
 	// controldata or if the file cannot be created for others reasons, an error
-	// is returned instead of the stream.
+	// is returned instead of the stream. If the unpack flag is set, the stream
+	// converts the CMS file image written by the client to a text file.
 	private ILevelOneResult createFileWriter(
 				ArrayList<String> tokens, 
 				int controlData) {
@@ -320,7 +347,8 @@ public class LevelOneFileService implements ILevelOneHandler {
 			return new LevelOneProtErrResult(ERR_MISSING_FNFT_TOKENS);
 		}
 		
-		boolean overwriteIfExists = (controlData == 1);
+		boolean overwriteIfExists = ((controlData & 0x01) != 0);
+		boolean unpackImage = ((controlData & 0x02) != 0);
 		
 		String filename = tokens.get(0) + "." + tokens.get(1);
 		File dir = this.userDir;
@@ -344,7 +372,8 @@ public class LevelOneFileService implements ILevelOneHandler {
 			return new LevelOneProtErrResult(ERR_FILE_NOT_CREATED);
 		}
 		
-		return new LevelOneFileContentSink(f.getPath(), fos);
+		IBulkSink sink = new LevelOneFileChannelSink(f.getPath(), fos, dir);
+		return (unpackImage) ? new LevelOneImageSink(sink, this.codec) : sink;
 	}
 	
 	/*
@@ -373,6 +402,7 @@ public class LevelOneFileService implements ILevelOneHandler {
 		}
 		
 		newDir.mkdir();
+		DirectoryListCache.getInstance().invalidate(parentDir);
 		if (!newDir.isDirectory()) {
 			return new LevelOneProtErrResult(ERR_DIR_NOT_CREATED);			
 		}
@@ -0,0 +1,161 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+/**
+ * Bulk sink unpacking a CMS file image received from the VM/370 side into a
+ * text file: the records of the image are converted to text lines with the
+ * line end of the platform where the outside NICOF proxy runs (with trailing
+ * blanks removed) and passed to the wrapped sink.
+ * <p>
+ * A CMS file image (written by NHFS resp. RNHFS with PUTIMG) consists of a
+ * 16 byte header followed by the records, each record prefixed with its length
+ * as 2 byte big-endian integer. The header has the layout:
+ * <ul>
+ * <li>4 bytes: magic "CMSI" in EBCDIC (C3 D4 E2 C9)</li>
+ * <li>1 byte: format version (1)</li>
+ * <li>1 byte: RECFM (EBCDIC 'F' or 'V')</li>
+ * <li>2 bytes: reserved</li>
+ * <li>4 bytes: LRECL (big-endian)</li>
+ * <li>4 bytes: record count (big-endian, 0xFFFFFFFF if unknown)</li>
+ * </ul>
+ * Unlike the record mode of bulk streams, records may span the blocks
+ * received from the VM/370 side.
+ * 
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public class LevelOneImageSink implements IBulkSink {
+	
+	/** length of the image header. */
+	public final static int HEADER_LENGTH = 16;
+	
+	/** format version of the image. */
+	public final static int VERSION = 1;
+	
+	private final static byte[] MAGIC = { (byte)0xC3, (byte)0xD4, (byte)0xE2, (byte)0xC9 };
+	
+	private final static byte EBCDIC_BLANK = (byte)0x40;
+	
+	private final static byte[] LINE_END = System.getProperty("line.separator").getBytes();
+	
+	private final IBulkSink sink;
+	private final LevelOneRecordCodec codec;
+	
+	private int state = IBulkSink.STATE_OK;
+	
+	// the header resp. the record currently collected
+	private final byte[] header = new byte[HEADER_LENGTH];
+	private int headerLength = 0;
+	private byte[] record = new byte[256];
+	private int recordLength = -1; // -1 => length prefix not yet complete
+	private int recordPos = 0;
+	private int lengthBytes = 0; // bytes of the length prefix received so far
+	private int lengthHigh = 0;
+	
+	// the converted lines of the current block
+	private byte[] outBuffer = new byte[4096];
+	private int outLen = 0;
+	
+	public LevelOneImageSink(IBulkSink sink, LevelOneRecordCodec codec) {
+		this.sink = sink;
+		this.codec = codec;
+	}
+	
+	@Override
+	public void putBlock(byte[] buffer, int length) {
+		if (this.getState() != IBulkSink.STATE_OK) { return; }
+		
+		int pos = 0;
+		
+		// collect the header first
+		while (this.headerLength < HEADER_LENGTH && pos < length) {
+			this.header[this.headerLength++] = buffer[pos++];
+			if (this.headerLength == HEADER_LENGTH && !this.isValidHeader()) {
+				this.state = IBulkSink.STATE_WRITE_ERROR;
+				return;
+			}
+		}
+		
+		this.outLen = 0;
+		while (pos < length) {
+			// length prefix (possibly split over 2 blocks)
+			if (this.recordLength < 0) {
+				if (this.lengthBytes == 0) {
+					this.lengthHigh = buffer[pos++] & 0xFF;
+					this.lengthBytes = 1;
+					continue;
+				}
+				this.recordLength = (this.lengthHigh << 8) | (buffer[pos++] & 0xFF);
+				this.lengthBytes = 0;
+				if (this.recordLength > this.record.length) {
+					this.record = new byte[this.recordLength];
+				}
+			}
+			
+			// record data
+			int chunk = Math.min(length - pos, this.recordLength - this.recordPos);
+			System.arraycopy(buffer, pos, this.record, this.recordPos, chunk);
+			pos += chunk;
+			this.recordPos += chunk;
+			if (this.recordPos < this.recordLength) { break; }
+			this.appendLine();
+			this.recordLength = -1;
+			this.recordPos = 0;
+		}
+		
+		if (this.outLen > 0) { this.sink.putBlock(this.outBuffer, this.outLen); }
+	}
+	
+	// check the header collected
+	private boolean isValidHeader() {
+		for (int i = 0; i < MAGIC.length; i++) {
+			if (this.header[i] != MAGIC[i]) { return false; }
+		}
+		return (this.header[4] == VERSION);
+	}
+	
+	// convert the record collected to a line in the output buffer
+	private void appendLine() {
+		int len = this.recordLength;
+		while (len > 0 && this.record[len - 1] == EBCDIC_BLANK) { len--; }
+		byte[] line = this.codec.toHost(this.record, 0, len);
+		
+		int needed = this.outLen + line.length + LINE_END.length;
+		if (needed > this.outBuffer.length) {
+			byte[] newBuffer = new byte[Math.max(needed, this.outBuffer.length * 2)];
+			System.arraycopy(this.outBuffer, 0, newBuffer, 0, this.outLen);
+			this.outBuffer = newBuffer;
+		}
+		System.arraycopy(line, 0, this.outBuffer, this.outLen, line.length);
+		this.outLen += line.length;
+		System.arraycopy(LINE_END, 0, this.outBuffer, this.outLen, LINE_END.length);
+		this.outLen += LINE_END.length;
+	}
+	
+	@Override
+	public void close() {
+		if (this.state == IBulkSink.STATE_OK && (this.headerLength < HEADER_LENGTH || this.recordLength >= 0 || this.lengthBytes > 0)) {
+			// incomplete image: the client aborted the transfer
+			this.state = IBulkSink.STATE_WRITE_ERROR;
+		}
+		this.sink.close();
+	}
+	
+	@Override
+	public int getState() {
+		return (this.state != IBulkSink.STATE_OK) ? this.state : this.sink.getState();
+	}
+}
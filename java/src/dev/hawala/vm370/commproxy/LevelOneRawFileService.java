@@ -14,19 +14,14 @@
 
 package dev.hawala.vm370.commproxy;
 
-import java.io.ByteArrayInputStream;
 import java.io.File;
 import java.io.FileInputStream;
 import java.io.FileOutputStream;
-import java.io.FilenameFilter;
 import java.io.IOException;
-import java.io.InputStream;
-import java.io.OutputStream;
-import java.text.SimpleDateFormat;
-import java.util.Date;
 import java.util.regex.Pattern;
 
 import dev.hawala.vm370.Log;
+import dev.hawala.vm370.commproxy.DirectoryListCache.DirEntry;
 import dev.hawala.vm370.ebcdic.EbcdicHandler;
 
 /**
@@ -58,6 +53,7 @@ public class LevelOneRawFileService implements ILevelOneHandler {
 	private static final int ERR_DIR_IS_READONLY = 5074;
 	private static final int ERR_FILE_ACCESS_ERROR = 5075;
 	private static final int ERR_FILE_EXISTS = 5076;
+	private static final int ERR_FILE_READ_ERROR = 5077;
 
 	// access class to the file system with navigation, file enumeration and access.  
 	static class Path {
@@ -111,10 +107,9 @@ public class LevelOneRawFileService implements ILevelOneHandler {
 			return true;
 		}
 		
-		public String getFilelist(String pat) {
+		public IBulkSource createLister(String pat) {
 			if (pat != null && this.ignoreCase) { pat = pat.toLowerCase(); }
 			
-			StringBuffer sb = new StringBuffer();
 			final Pattern p = (pat != null && pat.length()> 0)
 					? Pattern.compile(
 							pat.replace("\\", "/")
@@ -124,37 +119,30 @@ public class LevelOneRawFileService implements ILevelOneHandler {
 							   .replace("]", "\\]")
 							   .replace("+", "\\+"))
 					: null;
-			File[] theFiles = (p == null) 
-				? this.wd.listFiles()
-				: this.wd.listFiles(new FilenameFilter() {
-					@Override
-					public boolean accept(File f, String name) {
-						if (ignoreCase) { name = name.toLowerCase(); }
-						return p.matcher(name).matches();
-					}
-				});
-			if (theFiles == null) { return sb.toString(); }
+			
+			return new LevelOneDirectoryListSource(this.wd) {
+				@Override
+				protected boolean accept(DirEntry e) {
+					if (!e.isDirectory && !e.isFile) { return false; }
+					if (p == null) { return true; }
+					String name = (ignoreCase) ? e.name.toLowerCase() : e.name;
+					return p.matcher(name).matches();
+				}
 				
-			SimpleDateFormat sdfmt = new SimpleDateFormat();
-			sdfmt.applyPattern("yyyy-MM-dd hh:mm:ss");
-
-			for (File f : theFiles) {
-				Date ts = new Date(f.lastModified());
-				String tsString = sdfmt.format(ts);
-				if (f.isDirectory()) {
-					String line = String.format(
-							"%s <subdir> %s", 
-							tsString, f.getName());
-					sb.append(line).append("\r\n");
-				} else if (f.isFile()) {
-					String line = String.format(
-							"%s %8d %s", 
-							tsString, f.length(), f.getName());
-					sb.append(line).append("\r\n");
+				// "yyyy-MM-dd hh:mm:ss <subdir> name" resp. "yyyy-MM-dd hh:mm:ss     size name"
+				@Override
+				protected void appendLine(DirEntry e, StringBuilder sb) {
+					this.appendTimestamp(sb, e.lastModified);
+					if (e.isDirectory) {
+						sb.append(" <subdir> ");
+					} else {
+						sb.append(' ');
+						appendRight(sb, e.size, 8);
+						sb.append(' ');
+					}
+					sb.append(e.name);
 				}
-			}
-			
-		return sb.toString();
+			};
 		}
 		
 		public Boolean dirIsWritable() {
@@ -201,6 +189,14 @@ public class LevelOneRawFileService implements ILevelOneHandler {
 				}
 			}
 			
+			public int checksum() throws IOException {
+				return LevelOneFileService.fileChecksum(this.f);
+			}
+			
+			public File getDirectory() {
+				return this.f.getAbsoluteFile().getParentFile();
+			}
+			
 			public FileOutputStream createFile() {
 				try {
 					return new FileOutputStream(this.f);
@@ -215,12 +211,22 @@ public class LevelOneRawFileService implements ILevelOneHandler {
 	
 	private final Path path = new Path();  
 	
+	// let the OS read ahead files in large chunks when read sequentially?
+	private boolean sequentialHint = true;
+	
+	// character set conversion for unpacking CMS file images to text files
+	private LevelOneRecordCodec codec = null;
+	
 	@Override
 	public void deinitialize() { }
 
 	@Override
 	public void initialize(String name, EbcdicHandler clientVm, PropertiesExt configuration) {
 		logger.info("new raw file service for: ", clientVm);
+		this.sequentialHint = configuration.getBoolean(name + ".sequentialhint", true);
+		this.codec = new LevelOneRecordCodec(
+				configuration.getString("recordmode.codepage", null),
+				configuration.getString("recordmode.hostcharset", null));
 		if (this.path == null) { 
 			logger.info("**** ERROR: no current directory !!!!");
 		} else {
@@ -268,9 +274,7 @@ public class LevelOneRawFileService implements ILevelOneHandler {
 			if (requestDataLength > 0) {
 				pat = new String(requestData, 0, requestDataLength);
 			}
-			String res = this.path.getFilelist(pat);
-			ByteArrayInputStream bis = new ByteArrayInputStream(res.getBytes());
-			return new LevelOneFileContentSource(bis, res.length());
+			return this.path.createLister(pat);
 		}
 		
 		// command READ: read a file
@@ -281,26 +285,45 @@ public class LevelOneRawFileService implements ILevelOneHandler {
 			if (!e.exists()) { return new LevelOneProtErrResult(ERR_FILENAME_NOT_FOUND); }
 			if (e.isDir()) { return new LevelOneProtErrResult(ERR_FILENAME_IS_DIR); }
 			if (!e.isReadable()) { return new LevelOneProtErrResult(ERR_FILE_NOT_READABLE); }
-			int fileLen = (int)Math.min((long)Integer.MAX_VALUE, e.fileLength());
+			long fileLen = e.fileLength();
 			if (fileLen < 0) { return new LevelOneProtErrResult(ERR_FILE_ACCESS_ERROR); }
-			InputStream is = e.readFile();
-			if (is == null) { return new LevelOneProtErrResult(ERR_FILE_ACCESS_ERROR); }
-			return new LevelOneFileContentSource(is, fileLen);
+			FileInputStream fis = e.readFile();
+			if (fis == null) { return new LevelOneProtErrResult(ERR_FILE_ACCESS_ERROR); }
+			return new LevelOneFileChannelSource(fis, fileLen, this.sequentialHint);
 		}
 		
 		// command WRITE: create or overwrite a file
+		//  -> controlData: flags 0x01: overwrite, 0x02: unpack the CMS file image written to a text file
 		if (cmd == 5) {
 			if (requestDataLength <= 0) { return new LevelOneProtErrResult(ERR_NO_FILENAME); }
 			if (!this.path.dirIsWritable()) { return new LevelOneProtErrResult(ERR_DIR_IS_READONLY); }
-			boolean overwrite = (controlData != 0);
+			boolean overwrite = ((controlData & 0x01) != 0);
+			boolean unpackImage = ((controlData & 0x02) != 0);
 			String fn = new String(requestData, 0, requestDataLength);
 			Path.Element e = this.path.checkElement(fn);
 			if (e.isDir()) { return new LevelOneProtErrResult(ERR_FILENAME_IS_DIR); }
 			if (e.exists() && !overwrite) { return new LevelOneProtErrResult(ERR_FILE_EXISTS); }
 			if (e.exists() && !e.isWritable()) { return new LevelOneProtErrResult(ERR_FILE_NOT_WRITABLE); }
-			OutputStream os = e.createFile();
-			if (os == null) { return new LevelOneProtErrResult(ERR_FILE_ACCESS_ERROR); }
-			return new LevelOneFileContentSink(fn, os);
+			FileOutputStream fos = e.createFile();
+			if (fos == null) { return new LevelOneProtErrResult(ERR_FILE_ACCESS_ERROR); }
+			IBulkSink sink = new LevelOneFileChannelSink(fn, fos, e.getDirectory());
+			return (unpackImage) ? new LevelOneImageSink(sink, this.codec) : sink;
+		}
+		
+		// command CHECKSUM: compute the CRC-32 of a file
+		//  -> controlData of the response is the checksum
+		if (cmd == 6) {
+			if (requestDataLength <= 0) { return new LevelOneProtErrResult(ERR_NO_FILENAME); }
+			String fn = new String(requestData, 0, requestDataLength);
+			Path.Element e = this.path.checkElement(fn);
+			if (!e.exists()) { return new LevelOneProtErrResult(ERR_FILENAME_NOT_FOUND); }
+			if (e.isDir()) { return new LevelOneProtErrResult(ERR_FILENAME_IS_DIR); }
+			if (!e.isReadable()) { return new LevelOneProtErrResult(ERR_FILE_NOT_READABLE); }
+			try {
+				return new LevelOneBufferResult(0, e.checksum(), 0);
+			} catch (IOException exc) {
+				return new LevelOneProtErrResult(ERR_FILE_READ_ERROR);
+			}
 		}
 		
 		// unknown command...
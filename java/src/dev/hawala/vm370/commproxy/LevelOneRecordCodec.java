@@ -0,0 +1,154 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+import java.nio.charset.Charset;
+
+import dev.hawala.vm370.Log;
+
+/**
+ * Character set conversion between text lines on the platform where the
+ * outside NICOF proxy runs and EBCDIC records on the VM/370 side, used by the
+ * record mode of bulk streams (see <tt>LevelOneRecordSource</tt> and
+ * <tt>LevelOneRecordSink</tt>).
+ * <p>
+ * Without a configured code page, the conversion uses the same tables as the
+ * text stream translation done by the NICOF client on the VM/370 side (NICOFCLT),
+ * translating byte by byte. With a code page, the text is decoded with the
+ * host character set and encoded with the EBCDIC code page (both given as
+ * Java charset names).
+ * 
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public class LevelOneRecordCodec {
+	
+	private static Log logger = Log.getLogger();
+	
+	/* the translation tables of NICOFCLT (as hex strings) */
+	
+	private static final String A2E_HEX =
+		  "404040404040404040402540400D4040"  /* 0 */
+		+ "40404040404040404040404040404040"  /* 1 */
+		+ "405A7F7B5B6C507D4D5D5C4E6B604B61"  /* 2 */
+		+ "F0F1F2F3F4F5F6F7F8F97A5E4C7E6E6F"  /* 3 */
+		+ "7CC1C2C3C4C5C6C7C8C9D1D2D3D4D5D6"  /* 4 */
+		+ "D7D8D9E2E3E4E5E6E7E8E9ADE0BDB06D"  /* 5 */
+		+ "79818283848586878889919293949596"  /* 6 */
+		+ "979899A2A3A4A5A6A7A8A9C04FD0A140"  /* 7 */
+		+ "40404040404040404040404040404040"  /* 8 */
+		+ "40404040404040404040404040404040"  /* 9 */
+		+ "41AA4AB19FB26AB5BBB49A8A5FCAAFBC"  /* A */
+		+ "908FEAFABEA0B6B39DDA9B8BB7B8B9AB"  /* B */
+		+ "6465626663679E687471727378757677"  /* C */
+		+ "AC69EDEEEBEFECBF80FDFEFBFCBAAE59"  /* D */
+		+ "4445424643479C485451525358555657"  /* E */
+		+ "8C49CDCECBCFCCE170DDDEDBDC8D8EDF"  /* F */
+	;
+	
+	private static final String E2A_HEX =
+		  "202020202020202020202020200D2020"  /* 0 */
+		+ "20202020202020202020202020202020"  /* 1 */
+		+ "20202020200A20202020202020202020"  /* 2 */
+		+ "20202020202020202020202020202020"  /* 3 */
+		+ "20A0E2E4E0E1E3E5E7F1A22E3C282B7C"  /* 4 */
+		+ "26E9EAEBE8EDEEEFECDF21242A293BAC"  /* 5 */
+		+ "2D2FC2C4C0C1C3C5C7D1A62C255F3E3F"  /* 6 */
+		+ "F8C9CACBC8CDCECFCC603A2340273D22"  /* 7 */
+		+ "D8616263646566676869ABBBF0FDFEB1"  /* 8 */
+		+ "B06A6B6C6D6E6F707172AABAE6B8C6A4"  /* 9 */
+		+ "B57E737475767778797AA1BFD05BDEAE"  /* A */
+		+ "5EA3A5B7A9A7B6BCBDBEDDA8AF5DB4D7"  /* B */
+		+ "7B414243444546474849ADF4F6F2F3F5"  /* C */
+		+ "7D4A4B4C4D4E4F505152B9FBFCF9FAFF"  /* D */
+		+ "5CF7535455565758595AB2D4D6D2D3D5"  /* E */
+		+ "30313233343536373839B3DBDCD9DA20"  /* F */
+	;
+	
+	private static final byte[] A2E = fromHex(A2E_HEX);
+	private static final byte[] E2A = fromHex(E2A_HEX);
+	
+	private static byte[] fromHex(String hex) {
+		byte[] b = new byte[hex.length() / 2];
+		for (int i = 0; i < b.length; i++) {
+			b[i] = (byte)Integer.parseInt(hex.substring(2 * i, 2 * i + 2), 16);
+		}
+		return b;
+	}
+	
+	private final Charset ebcdicCharset; // null => use the NICOFCLT tables
+	private final Charset hostCharset;
+	
+	/**
+	 * Create a codec for the given character sets.
+	 * @param ebcdicCodepage the Java charset name of the EBCDIC code page or
+	 *   <code>null</code> for the NICOFCLT translation tables. 
+	 * @param hostCharsetName the Java charset name of the text on the proxy's platform or
+	 *   <code>null</code> for the platform's default charset.
+	 */
+	public LevelOneRecordCodec(String ebcdicCodepage, String hostCharsetName) {
+		Charset ebcdic = null;
+		Charset host = Charset.defaultCharset();
+		try {
+			if (ebcdicCodepage != null && ebcdicCodepage.length() > 0) {
+				ebcdic = Charset.forName(ebcdicCodepage);
+			}
+			if (hostCharsetName != null && hostCharsetName.length() > 0) {
+				host = Charset.forName(hostCharsetName);
+			}
+		} catch (Exception e) {
+			logger.warn("LevelOneRecordCodec: unsupported charset, using NICOFCLT tables: ", e.getMessage());
+			ebcdic = null;
+		}
+		this.ebcdicCharset = ebcdic;
+		this.hostCharset = host;
+	}
+	
+	/**
+	 * Convert a text line of the proxy's platform to EBCDIC.
+	 * @param line the buffer holding the line.
+	 * @param offset start offset of the line in the buffer.
+	 * @param length length of the line (without line end).
+	 * @return the EBCDIC bytes for the line.
+	 */
+	public byte[] toEbcdic(byte[] line, int offset, int length) {
+		if (this.ebcdicCharset != null) {
+			return new String(line, offset, length, this.hostCharset).getBytes(this.ebcdicCharset);
+		}
+		byte[] rec = new byte[length];
+		for (int i = 0; i < length; i++) {
+			rec[i] = A2E[line[offset + i] & 0xFF];
+		}
+		return rec;
+	}
+	
+	/**
+	 * Convert an EBCDIC record to a text line of the proxy's platform.
+	 * @param rec the buffer holding the record.
+	 * @param offset start offset of the record in the buffer.
+	 * @param length length of the record.
+	 * @return the text bytes for the record (without line end).
+	 */
+	public byte[] toHost(byte[] rec, int offset, int length) {
+		if (this.ebcdicCharset != null) {
+			return new String(rec, offset, length, this.ebcdicCharset).getBytes(this.hostCharset);
+		}
+		byte[] line = new byte[length];
+		for (int i = 0; i < length; i++) {
+			line[i] = E2A[rec[offset + i] & 0xFF];
+		}
+		return line;
+	}
+}
@@ -0,0 +1,95 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+/**
+ * Record mode wrapper for a text bulk sink: the blocks received from the VM/370
+ * side contain length-prefixed EBCDIC records (see <tt>LevelOneRecordSource</tt>
+ * for the format), which are converted to text lines with the line end of the
+ * platform where the outside NICOF proxy runs before being passed to the
+ * wrapped sink. If requested, trailing blanks are stripped from the records.
+ * 
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public class LevelOneRecordSink implements IBulkSink {
+	
+	private final static byte EBCDIC_BLANK = (byte)0x40;
+	
+	private final static byte[] LINE_END = System.getProperty("line.separator").getBytes();
+	
+	private final IBulkSink sink;
+	private final LevelOneRecordCodec codec;
+	private final boolean stripBlanks;
+	
+	private int state = IBulkSink.STATE_OK;
+	
+	// the converted lines of the current block
+	private byte[] outBuffer = new byte[4096];
+	
+	public LevelOneRecordSink(IBulkSink sink, LevelOneRecordCodec codec, boolean stripBlanks) {
+		this.sink = sink;
+		this.codec = codec;
+		this.stripBlanks = stripBlanks;
+	}
+	
+	@Override
+	public void putBlock(byte[] buffer, int length) {
+		if (this.getState() != IBulkSink.STATE_OK) { return; }
+		
+		int pos = 0;
+		int outLen = 0;
+		while (pos < length) {
+			if (pos + 2 > length) { break; }
+			int recLen = ((buffer[pos] & 0xFF) << 8) | (buffer[pos + 1] & 0xFF);
+			pos += 2;
+			if (pos + recLen > length) { break; }
+			
+			int len = recLen;
+			if (this.stripBlanks) {
+				while (len > 0 && buffer[pos + len - 1] == EBCDIC_BLANK) { len--; }
+			}
+			byte[] line = this.codec.toHost(buffer, pos, len);
+			pos += recLen;
+			
+			int needed = outLen + line.length + LINE_END.length;
+			if (needed > this.outBuffer.length) {
+				byte[] newBuffer = new byte[Math.max(needed, this.outBuffer.length * 2)];
+				System.arraycopy(this.outBuffer, 0, newBuffer, 0, outLen);
+				this.outBuffer = newBuffer;
+			}
+			System.arraycopy(line, 0, this.outBuffer, outLen, line.length);
+			outLen += line.length;
+			System.arraycopy(LINE_END, 0, this.outBuffer, outLen, LINE_END.length);
+			outLen += LINE_END.length;
+		}
+		
+		if (outLen > 0) { this.sink.putBlock(this.outBuffer, outLen); }
+		if (pos < length) {
+			// a record does not fit into the block: the client does not follow the protocol
+			this.state = IBulkSink.STATE_WRITE_ERROR;
+		}
+	}
+	
+	@Override
+	public void close() {
+		this.sink.close();
+	}
+	
+	@Override
+	public int getState() {
+		return (this.state != IBulkSink.STATE_OK) ? this.state : this.sink.getState();
+	}
+}
@@ -0,0 +1,169 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility 
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2012
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy;
+
+import java.util.LinkedList;
+
+/**
+ * Record mode wrapper for a text bulk source: the text lines read from the
+ * wrapped source are converted to EBCDIC and delivered as length-prefixed
+ * records, so the VM/370 side neither translates nor scans for line ends.
+ * <p>
+ * Each block returned by <tt>getNextBlock()</tt> contains only complete records,
+ * each record being preceded by its length as 2 byte big-endian integer. Lines
+ * longer than the record length are split into several records, an empty line
+ * becomes a record with a single blank (as CMS records cannot be empty). If
+ * requested, records are padded with blanks to the record length (for
+ * fixed length CMS files).
+ * 
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2012
+ *
+ */
+public class LevelOneRecordSource implements IBulkSource {
+	
+	// max. record length (2048 bytes per block less the length prefix)
+	public final static int MAX_LRECL = 2046;
+	
+	private final static byte EBCDIC_BLANK = (byte)0x40;
+	
+	private final IBulkSource source;
+	private final LevelOneRecordCodec codec;
+	private final int lrecl;
+	private final boolean padRecords;
+	
+	private int state = IBulkSource.STATE_OK;
+	
+	// the raw data from the wrapped source not yet converted to records
+	private final byte[] rawBuffer = new byte[2048];
+	private int rawPos = 0;
+	private int rawLen = 0;
+	private boolean sourceEnded = false;
+	private int sourceState = IBulkSource.STATE_OK;
+	
+	// the line currently collected
+	private byte[] line = new byte[256];
+	private int lineLen = 0;
+	private boolean skipLF = false; // last line ended with CR, ignore a following LF
+	
+	// the records converted but not yet passed
+	private final LinkedList<byte[]> records = new LinkedList<byte[]>();
+	
+	public LevelOneRecordSource(IBulkSource source, LevelOneRecordCodec codec, int lrecl, boolean padRecords) {
+		this.source = source;
+		this.codec = codec;
+		this.lrecl = (lrecl < 1 || lrecl > MAX_LRECL) ? MAX_LRECL : lrecl;
+		this.padRecords = padRecords;
+	}
+	
+	@Override
+	public int getNextBlock(byte[] buffer, boolean availableOnly) {
+		// check if there is nothing to transmit
+		if (this.state != IBulkSource.STATE_OK) { return 0; }
+		
+		int count = 0;
+		while (true) {
+			if (this.records.isEmpty() && !this.convertNextLine()) {
+				// no more lines: pass the final state of the wrapped source
+				this.state = (this.sourceState == IBulkSource.STATE_OK)
+						? IBulkSource.STATE_SOURCE_ENDED
+						: this.sourceState;
+				break;
+			}
+			byte[] rec = this.records.getFirst();
+			if (count + 2 + rec.length > buffer.length) { break; }
+			this.records.removeFirst();
+			buffer[count++] = (byte)((rec.length >> 8) & 0xFF);
+			buffer[count++] = (byte)(rec.length & 0xFF);
+			System.arraycopy(rec, 0, buffer, count, rec.length);
+			count += rec.length;
+		}
+		return count;
+	}
+	
+	// collect the next line from the wrapped source and convert it to records,
+	// returning false if the source has no more lines
+	private boolean convertNextLine() {
+		while (true) {
+			if (this.rawPos >= this.rawLen) {
+				if (this.sourceEnded) {
+					if (this.lineLen == 0) { return false; }
+					this.addRecords(); // last line without line end
+					return true;
+				}
+				this.rawLen = this.source.getNextBlock(this.rawBuffer, false);
+				this.rawPos = 0;
+				this.sourceState = this.source.getState();
+				if (this.sourceState != IBulkSource.STATE_OK || this.rawLen <= 0) {
+					this.sourceEnded = true;
+					if (this.sourceState == IBulkSource.STATE_SOURCE_ENDED) {
+						this.sourceState = IBulkSource.STATE_OK;
+					}
+				}
+				if (this.rawLen < 0) { this.rawLen = 0; }
+				continue;
+			}
+			
+			byte b = this.rawBuffer[this.rawPos++];
+			if (this.skipLF) {
+				this.skipLF = false;
+				if (b == (byte)0x0A) { continue; }
+			}
+			if (b == (byte)0x0A || b == (byte)0x0D) {
+				this.skipLF = (b == (byte)0x0D);
+				this.addRecords();
+				return true;
+			}
+			if (this.lineLen >= this.line.length) {
+				byte[] newLine = new byte[this.line.length * 2];
+				System.arraycopy(this.line, 0, newLine, 0, this.lineLen);
+				this.line = newLine;
+			}
+			this.line[this.lineLen++] = b;
+		}
+	}
+	
+	// convert the collected line and split it into records
+	private void addRecords() {
+		byte[] ebcdic = this.codec.toEbcdic(this.line, 0, this.lineLen);
+		this.lineLen = 0;
+		if (ebcdic.length == 0) {
+			ebcdic = new byte[] { EBCDIC_BLANK };
+		}
+		int pos = 0;
+		while (pos < ebcdic.length) {
+			int len = Math.min(this.lrecl, ebcdic.length - pos);
+			byte[] rec = new byte[(this.padRecords) ? this.lrecl : len];
+			System.arraycopy(ebcdic, pos, rec, 0, len);
+			for (int i = len; i < rec.length; i++) { rec[i] = EBCDIC_BLANK; }
+			this.records.add(rec);
+			pos += len;
+		}
+	}
+	
+	@Override
+	public void close() {
+		this.source.close();
+		this.state = IBulkSource.STATE_SOURCE_CLOSED;
+	}
+	
+	@Override
+	public int getAvailableCount() { return (this.state == IBulkSource.STATE_OK) ? -1 : 0; }
+	
+	@Override
+	public int getRemainingCount() { return (this.state == IBulkSource.STATE_OK) ? -1 : 0; }
+	
+	@Override
+	public int getState() { return this.state; }
+}
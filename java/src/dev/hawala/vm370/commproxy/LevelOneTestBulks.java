@@ -110,9 +110,10 @@ public class LevelOneTestBulks implements ILevelOneHandler {
 		public int getState() { return this.state; }
 	}
 	
-	private static class BulkSourceBin implements IBulkSource {
+	private static class BulkSourceBin implements IRandomAccessBulkSource {
 		
 		private final int lrecl;
+		private final long length;
 		
 		private int remainingRecords = 0;
 		private int remainingBytes = 0;
@@ -127,6 +128,7 @@ public class LevelOneTestBulks implements ILevelOneHandler {
 			this.lrecl = Math.max(1, controlWord & 0xFF);
 			this.remainingRecords = controlWord >> 8;
 			this.remainingBytes = this.lrecl * this.remainingRecords;
+			this.length = this.remainingBytes;
 			if (this.remainingRecords == 0) { this.state = IBulkSource.STATE_SOURCE_ENDED; }
 		}
 
@@ -153,6 +155,20 @@ public class LevelOneTestBulks implements ILevelOneHandler {
 			return count;
 		}
 
+		@Override
+		public int getBlockAt(long position, byte[] buffer, int length) {
+			// record 'n' is filled with fillChars[n % 10]
+			int count = 0;
+			while (count < length && position < this.length) {
+				buffer[count++] = fillChars[(int)((position / this.lrecl) % 10)];
+				position++;
+			}
+			return count;
+		}
+
+		@Override
+		public long getLength() { return this.length; }
+
 		@Override
 		public int getAvailableCount() { return Math.min(2048, this.remainingBytes); }
 
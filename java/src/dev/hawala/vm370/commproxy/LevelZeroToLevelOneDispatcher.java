@@ -15,6 +15,11 @@
 package dev.hawala.vm370.commproxy;
 
 import java.util.HashMap;
+import java.util.Timer;
+import java.util.TimerTask;
+import java.util.concurrent.atomic.AtomicInteger;
+import java.util.concurrent.atomic.AtomicIntegerArray;
+import java.util.concurrent.atomic.AtomicReferenceArray;
 
 import dev.hawala.vm370.Log;
 import dev.hawala.vm370.ebcdic.EbcdicHandler;
@@ -41,23 +46,38 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 	// the direct commands to the base service
 	private final static int CMD_RESOLVE = 0; // resolve a service name to the service id
 	private final static int CMD_GETENVINFO = 1; // get information about the environment where NICOF runs
+	private final static int CMD_DISCOVER = 2; // get the environment information and all services with their ids
+	private final static int CMD_READMULTI = 3; // read the next block of several bulk sources (see MultiSourceReadHandler)
+	
+	// capabilities of the base service reported by CMD_DISCOVER
+	private final static int BASECAP_READAT = 0x0001; // positional reads on bulk sources (CMD_BULKSRC_READAT)
+	private final static int BASECAP_RECORDMODE = 0x0002; // record mode for text streams (CMD_BULKSRC_RECORDMODE, CMD_BULKSINK_RECORDMODE)
+	private final static int BASECAP_READMULTI = 0x0004; // reading several bulk sources with one request (CMD_READMULTI)
+	private final static int BASECAP_CAPABILITIES = BASECAP_READAT | BASECAP_RECORDMODE | BASECAP_READMULTI;
+	
+	// flags of the CMD_DISCOVER response
+	private final static int DISCOVER_TRUNCATED = 0x0001; // not all services fit into the response
 	
 	// commands for accessing bulk source streams
 	private final static int CMD_BULKSRC_CLOSE = 100; // close the stream
 	private final static int CMD_BULKSRC_READ = 101; // read the next block and wait if neccessary
 	private final static int CMD_BULKSRC_READNOWAIT = 102; // read the data available, not waiting for more data to get available
 	private final static int CMD_BULKSRC_GETCOUNTS = 103; // get the count information (immediately available and total remaining)
+	private final static int CMD_BULKSRC_READAT = 104; // read a block at a given position (IRandomAccessBulkSource only)
+	private final static int CMD_BULKSRC_RECORDMODE = 105; // deliver the text lines as EBCDIC records (see LevelOneRecordSource)
 	private final static int CMD_BULKSRC_LAST = 199; // (not a command)
 
 	// commands for accessing bulk sink streams
 	private final static int CMD_BULKSINK_CLOSE = 200; // close the stream
 	private final static int CMD_BULKSINK_WRITE = 201; // write a data block
+	private final static int CMD_BULKSINK_RECORDMODE = 202; // accept EBCDIC records for text lines (see LevelOneRecordSink)
 	private final static int CMD_BULKSINK_LAST = 299; // (not a command)
 	
 	// negative RCs are reserved for technical state transmission (positive RCs are for the services)
-	public final static int STATE_NEW_BULK_SOURCE = -32; // (result).controlData & 0xFFFF is the Stream-ID
+	public final static int STATE_NEW_BULK_SOURCE = -32; // (result).controlData is the Stream-ID
 	public final static int STATE_ERR_BULK_SOURCE_INVALID = -33; // the specified bulk source is not or no longer valid
-	public final static int STATE_NEW_BULK_SINK = -64; // (result).controlData & 0xFFFF is the Stream-ID
+	public final static int STATE_ERR_BULK_SOURCE_NOT_POSITIONAL = -34; // the specified bulk source does not support positional reads
+	public final static int STATE_NEW_BULK_SINK = -64; // (result).controlData is the Stream-ID
 	public final static int STATE_ERR_BULK_SINK_INVALID = -65; // the specified bulk sink is not or no longer valid
 	public final static int STATE_ERR_INVALID_SERVICE = -1024; // anything else in the response is unspecified
 	public final static int STATE_ERR_SVC_INVALIDRESULT = -1025; // anything else in the response is unspecified
@@ -80,62 +100,174 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 	private ILevelOneHandler sourceStreamsHandler = null; // internal Level-One handler to process commands for source bulks streams
 	private ILevelOneHandler sinkStreamsHandler = null; // internal Level-One handler to process commands for sink bulks streams
 	
+	// reaping of streams abandoned by the client
+	// (one timer thread shared by the dispatchers for all client VMs)
+	private static Timer reaperTimer = null;
+	private TimerTask reaperTask = null;
+	
+	private static synchronized Timer getReaperTimer() {
+		if (reaperTimer == null) { reaperTimer = new Timer("LevelOne-StreamReaper", true); }
+		return reaperTimer;
+	}
+	
+	// sequencer for the requests to a single stream
+	// -> the client may have several requests for a stream in flight (read-ahead, write-behind), which
+	//    arrive in the order they were sent by the client, but are processed by different threads
+	//    of the thread pool
+	// -> each request draws a ticket when it is dispatched (in arrival order by the receiving thread)
+	//    and the processing threads wait for their turn, so the stream operations are executed
+	//    in the original order 
+	private static class StreamSequencer {
+		private long nextTicket = 0;
+		private long currTicket = 0;
+		
+		public synchronized long drawTicket() {
+			return this.nextTicket++;
+		}
+		
+		public synchronized void awaitTurn(long ticket) {
+			while (ticket > this.currTicket) {
+				try { this.wait(); } catch (InterruptedException e) { return; }
+			}
+		}
+		
+		public synchronized void done() {
+			this.currTicket++;
+			this.notifyAll();
+		}
+	}
+	
 	// manager stream-id => stream-object
 	// -> creates the stream-id for a new stream to be used when communicating with the client implementation
 	// -> returns the stream for a given stream-id
-	// -> forgets a id => stream mapping when requested to
+	// -> forgets a id => stream mapping when requested to or when the stream was idle for too long
+	// the streams are held in a fixed size slot table modified only with compare-and-set operations,
+	// so the lookup for a request needs no lock; a stream-id combines the slot index, the stream
+	// kind (bit 0: 0 = source, 1 = sink) and a generation count of the slot, so the stale id of a
+	// closed stream is detected even if the slot was reused in the meantime.
 	private static class StreamManager {
-		private int lastBulkSourceId;
-		private int lastBulkSinkId;
-
-		private HashMap<Integer,IBulkSource> bulkSources = new HashMap<Integer,IBulkSource>();
-		private HashMap<Integer,IBulkSink> bulkSinks = new HashMap<Integer,IBulkSink>();
+		private final static int SLOT_BITS = 12;
+		private final static int SLOT_COUNT = 1 << SLOT_BITS; // max. number of open streams
+		private final static int SLOT_MASK = SLOT_COUNT - 1;
+		private final static int GEN_SHIFT = SLOT_BITS + 1;
+		private final static int GEN_MASK = 0x0003FFFF; // keep the stream-ids positive
+		
+		// a registered stream
+		// (users: number of requests currently processing the stream, -1 if the stream was reaped)
+		private static class StreamEntry {
+			private final int streamId;
+			private final StreamSequencer sequencer = new StreamSequencer();
+			private final AtomicInteger users = new AtomicInteger(0);
+			private volatile IBulkSource source;
+			private volatile IBulkSink sink;
+			private volatile long lastUsed = System.currentTimeMillis();
+			
+			private StreamEntry(int streamId, IBulkSource source, IBulkSink sink) {
+				this.streamId = streamId;
+				this.source = source;
+				this.sink = sink;
+			}
+		}
 		
+		private final AtomicReferenceArray<StreamEntry> slots = new AtomicReferenceArray<StreamEntry>(SLOT_COUNT);
+		private final AtomicIntegerArray generations = new AtomicIntegerArray(SLOT_COUNT);
+		private final AtomicInteger nextSlot;
+
 		public StreamManager() {
-			this.lastBulkSourceId = (int)(System.currentTimeMillis() & 0x0FFE);
-			this.lastBulkSinkId = this.lastBulkSourceId + 1;
+			// start with varying ids, so ids of a previous NICOF session are not valid by chance
+			int seed = (int)(System.currentTimeMillis() & GEN_MASK);
+			for (int i = 0; i < SLOT_COUNT; i++) { this.generations.set(i, seed); }
+			this.nextSlot = new AtomicInteger(seed & SLOT_MASK);
 		}
 		
-		public int addStream(IBulkSource stream) {
-			synchronized(this) {
-				this.lastBulkSourceId += 2;
-				this.bulkSources.put(this.lastBulkSourceId, stream);
-				return this.lastBulkSourceId;
+		// get a free slot for the stream and return the new stream-id or -1 if all slots are in use 
+		private int register(IBulkSource source, IBulkSink sink) {
+			int kind = (sink != null) ? 1 : 0;
+			for (int i = 0; i < SLOT_COUNT; i++) {
+				int slot = this.nextSlot.getAndIncrement() & SLOT_MASK;
+				if (this.slots.get(slot) != null) { continue; }
+				int gen = this.generations.incrementAndGet(slot) & GEN_MASK;
+				if (gen == 0) { gen = this.generations.incrementAndGet(slot) & GEN_MASK; }
+				StreamEntry e = new StreamEntry((gen << GEN_SHIFT) | (slot << 1) | kind, source, sink);
+				if (this.slots.compareAndSet(slot, null, e)) { return e.streamId; }
 			}
+			return -1;
+		}
+		
+		public int addStream(IBulkSource stream) {
+			return this.register(stream, null);
 		}
 		
 		public int addStream(IBulkSink stream) {
-			synchronized(this) {
-				this.lastBulkSinkId += 2;
-				this.bulkSinks.put(this.lastBulkSinkId, stream);
-				return this.lastBulkSinkId;
-			}
+			return this.register(null, stream);
 		}
 		
-		public void removeStream(int streamId) {
-			if ((streamId % 2) == 0) {
-				this.bulkSources.remove(streamId);
-			} else {
-				this.bulkSinks.remove(streamId);
-			}
+		private StreamEntry lookup(int streamId) {
+			StreamEntry e = this.slots.get((streamId >> 1) & SLOT_MASK);
+			return (e != null && e.streamId == streamId) ? e : null;
 		}
 		
-		public IBulkSource getSourceStream(int streamId) {
-			synchronized(this) {
-				if (this.bulkSources.containsKey(streamId)) {
-					return this.bulkSources.get(streamId);
-				} else { 
-					return null;
-				}
+		// get the stream for processing a request, to be released when done 
+		// (null if the stream-id is invalid or the stream was closed)
+		public StreamEntry acquire(int streamId) {
+			StreamEntry e = this.lookup(streamId);
+			if (e == null) { return null; }
+			while (true) {
+				int users = e.users.get();
+				if (users < 0) { return null; } // being reaped
+				if (e.users.compareAndSet(users, users + 1)) { break; }
 			}
+			e.lastUsed = System.currentTimeMillis();
+			return e;
 		}
-	
-		public IBulkSink getSinkStream(int streamId) {
-			synchronized(this) {
-				if (this.bulkSinks.containsKey(streamId)) {
-					return this.bulkSinks.get(streamId);
-				} else { 
-					return null;
+		
+		public void release(StreamEntry e) {
+			e.lastUsed = System.currentTimeMillis();
+			e.users.decrementAndGet();
+		}
+		
+		public void replaceStream(StreamEntry e, IBulkSource stream) {
+			e.source = stream;
+		}
+		
+		public void replaceStream(StreamEntry e, IBulkSink stream) {
+			e.sink = stream;
+		}
+		
+		public void removeStream(StreamEntry e) {
+			this.slots.compareAndSet((e.streamId >> 1) & SLOT_MASK, e, null);
+		}
+		
+		public StreamSequencer getSequencer(int streamId) {
+			StreamEntry e = this.lookup(streamId);
+			if (e == null) { return null; }
+			e.lastUsed = System.currentTimeMillis();
+			return e.sequencer;
+		}
+		
+		// close and forget the streams not used by the client for more than 'maxIdleMillis'
+		// (e.g. abandoned by a CMS program that was aborted before closing its streams)
+		public void reapIdleStreams(long maxIdleMillis) {
+			this.reap(System.currentTimeMillis() - maxIdleMillis);
+		}
+		
+		// close all streams not currently in use (when the client disconnects)
+		public void closeAll() {
+			this.reap(Long.MAX_VALUE);
+		}
+		
+		private void reap(long limit) {
+			for (int i = 0; i < SLOT_COUNT; i++) {
+				StreamEntry e = this.slots.get(i);
+				if (e == null || e.lastUsed > limit) { continue; }
+				if (!e.users.compareAndSet(0, -1)) { continue; } // currently in use
+				this.slots.compareAndSet(i, e, null);
+				logger.info("closing abandoned bulk stream, streamId: ", e.streamId);
+				try {
+					if (e.source != null) { e.source.close(); }
+					if (e.sink != null) { e.sink.close(); }
+				} catch (Exception exc) {
+					logger.warn("error closing abandoned bulk stream: ", exc.getMessage());
 				}
 			}
 		}
@@ -156,9 +288,25 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 		logger.info("New Level1 dispatcher, client-VM: ", clientVm);
 		logger.debug("Level1 dispatcher for client ", clientVm, " -- begin initializing");
 		
-		// create the handlers for bulk-streams
-		this.sourceStreamsHandler = new BulkSourceHandler(this.streamManager);
-		this.sinkStreamsHandler = new BulkSinkHandler(this.streamManager);
+		// create the handlers for bulk-streams, with the character set conversion for record mode
+		LevelOneRecordCodec recordCodec = new LevelOneRecordCodec(
+				configuration.getString("recordmode.codepage", null),
+				configuration.getString("recordmode.hostcharset", null));
+		this.sourceStreamsHandler = new BulkSourceHandler(this.streamManager, recordCodec);
+		this.sinkStreamsHandler = new BulkSinkHandler(this.streamManager, recordCodec);
+		
+		// start closing streams not used by the client for the configured time (0 = never)
+		int idleTimeout = configuration.getInt("streams.idletimeout", 600);
+		if (idleTimeout > 0) {
+			final long maxIdleMillis = idleTimeout * 1000L;
+			final StreamManager streams = this.streamManager;
+			this.reaperTask = new TimerTask() {
+				@Override
+				public void run() { streams.reapIdleStreams(maxIdleMillis); }
+			};
+			long period = Math.min(maxIdleMillis, 60000L);
+			getReaperTimer().schedule(this.reaperTask, period, period);
+		}
 		
 		// load the configured services and assign the service-ids
 		int svcId = (short)(System.currentTimeMillis() & 0x0FFF);
@@ -214,6 +362,11 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 	
 	@Override
 	public void deinitialize() {
+		if (this.reaperTask != null) {
+			this.reaperTask.cancel();
+			this.reaperTask = null;
+		}
+		this.streamManager.closeAll();
 		for (ILevelOneHandler h : this.svcIdToHandler.values()) {
 			h.deinitialize();
 		}
@@ -235,12 +388,50 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 		return new LevelOneBufferResult((short)0, this.svcNameToId.get(svcName).intValue(), 0);
 	}
 	
+	// get the environment information and the complete service table in one go, saving
+	// the client the round trips for CMD_GETENVINFO and CMD_RESOLVE for each service.
+	// response data:
+	//   capabilities of the base service (2 bytes, BASECAP_*)
+	//   flags (2 bytes, DISCOVER_*)
+	//   count of services (2 bytes)
+	//   for each service: service-id (2 bytes), name length (1 byte), name (ASCII, lowercase)
+	// controlData of the response: same as for CMD_GETENVINFO
+	private ILevelOneResult processService0CmdDiscover(byte[] responseBuffer) {
+		int flags = 0;
+		int count = 0;
+		int pos = 6;
+		for (String svcName : this.svcNameToId.keySet()) {
+			byte[] nameBytes = svcName.getBytes();
+			if (nameBytes.length > 255 || pos + 3 + nameBytes.length > responseBuffer.length) {
+				flags |= DISCOVER_TRUNCATED;
+				continue;
+			}
+			int svcId = this.svcNameToId.get(svcName).intValue();
+			responseBuffer[pos++] = (byte)((svcId >> 8) & 0xFF);
+			responseBuffer[pos++] = (byte)(svcId & 0xFF);
+			responseBuffer[pos++] = (byte)nameBytes.length;
+			System.arraycopy(nameBytes, 0, responseBuffer, pos, nameBytes.length);
+			pos += nameBytes.length;
+			count++;
+		}
+		responseBuffer[0] = (byte)((BASECAP_CAPABILITIES >> 8) & 0xFF);
+		responseBuffer[1] = (byte)(BASECAP_CAPABILITIES & 0xFF);
+		responseBuffer[2] = (byte)((flags >> 8) & 0xFF);
+		responseBuffer[3] = (byte)(flags & 0xFF);
+		responseBuffer[4] = (byte)((count >> 8) & 0xFF);
+		responseBuffer[5] = (byte)(count & 0xFF);
+		
+		return new LevelOneBufferResult(0, this.getEnvInfo(), pos);
+	}
+	
 	// the Level-One service implementing the bulk source stream operations
 	private static class BulkSourceHandler implements ILevelOneHandler {
 		private final StreamManager streamManager;
+		private final LevelOneRecordCodec recordCodec;
 		
-		public BulkSourceHandler(StreamManager streamManager) {
+		public BulkSourceHandler(StreamManager streamManager, LevelOneRecordCodec recordCodec) {
 			this.streamManager = streamManager;
+			this.recordCodec = recordCodec;
 		}
 
 		@Override
@@ -256,7 +447,24 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 				byte[] requestData, 
 				int requestDataLength, 
 				byte[] responseBuffer) {
-			IBulkSource src = this.streamManager.getSourceStream(controlData);
+			StreamManager.StreamEntry entry = this.streamManager.acquire(controlData);
+			if (entry == null) {
+				return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SOURCE_INVALID); 
+			}
+			try {
+				return this.processSourceRequest(cmd, entry, requestData, requestDataLength, responseBuffer);
+			} finally {
+				this.streamManager.release(entry);
+			}
+		}
+		
+		private ILevelOneResult processSourceRequest(
+				short cmd, 
+				StreamManager.StreamEntry entry,
+				byte[] requestData, 
+				int requestDataLength, 
+				byte[] responseBuffer) {
+			IBulkSource src = entry.source;
 			
 			if (src == null) {
 				return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SOURCE_INVALID); 
@@ -277,9 +485,48 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 				responseBuffer[6] = (byte)((available & 0x0000FF00) >> 8);
 				responseBuffer[7] = (byte)(available & 0x000000FF);
 				return new LevelOneBufferResult(0, src.getState(), 8);
+			} else if (cmd == CMD_BULKSRC_READAT) {
+				// request data: position (8 bytes), length (4 bytes)
+				// controlData of the response: state for this range (OK, ENDED, READ_ERROR)
+				if (!(src instanceof IRandomAccessBulkSource)) {
+					return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SOURCE_NOT_POSITIONAL);
+				}
+				if (requestDataLength < 12) {
+					return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BASESVC_INVCMD);
+				}
+				IRandomAccessBulkSource ras = (IRandomAccessBulkSource)src;
+				long position = 0;
+				for (int i = 0; i < 8; i++) {
+					position = (position << 8) | (requestData[i] & 0xFF);
+				}
+				int length = ((requestData[8] & 0xFF) << 24)
+						| ((requestData[9] & 0xFF) << 16)
+						| ((requestData[10] & 0xFF) << 8)
+						| (requestData[11] & 0xFF);
+				if (length < 0 || length > responseBuffer.length) { length = responseBuffer.length; }
+				int bytes = ras.getBlockAt(position, responseBuffer, length);
+				if (bytes < 0) {
+					return new LevelOneBufferResult(0, IBulkSource.STATE_READ_ERROR, 0);
+				}
+				int state = (bytes < length || position + bytes >= ras.getLength())
+						? IBulkSource.STATE_SOURCE_ENDED
+						: IBulkSource.STATE_OK;
+				return new LevelOneBufferResult(0, state, bytes);
+			} else if (cmd == CMD_BULKSRC_RECORDMODE) {
+				// request data: record length (2 bytes), flags (1 byte: 0x01 = pad records to record length)
+				if (requestDataLength < 3) {
+					return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BASESVC_INVCMD);
+				}
+				int lrecl = ((requestData[0] & 0xFF) << 8) | (requestData[1] & 0xFF);
+				boolean padRecords = ((requestData[2] & 0x01) != 0);
+				if (!(src instanceof LevelOneRecordSource)) {
+					src = new LevelOneRecordSource(src, this.recordCodec, lrecl, padRecords);
+					this.streamManager.replaceStream(entry, src);
+				}
+				return new LevelOneBufferResult(0, src.getState(), 0);
 			} else if (cmd == CMD_BULKSRC_CLOSE) {
 				src.close();
-				this.streamManager.removeStream(controlData);
+				this.streamManager.removeStream(entry);
 				return new LevelOneBufferResult(0, src.getState(), 0);
 			}			
 			
@@ -287,12 +534,111 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 		}
 	}
 	
+	// the Level-One service reading the next block for a list of bulk sources into one response
+	// (one instance per request, as the sequencer tickets for the streams must be drawn when
+	// the request is dispatched, see StreamSequencer)
+	// request data:
+	//   flags (1 byte: 0x01 = only the data immediately available, as CMD_BULKSRC_READNOWAIT)
+	//   count of streams (1 byte)
+	//   for each stream: stream-id (4 bytes), max. length (2 bytes)
+	// response data:
+	//   for each stream: state (2 bytes), length (2 bytes), data
+	private static class MultiSourceReadHandler implements ILevelOneHandler {
+		private final StreamManager streamManager;
+		private final int[] streamIds;
+		private final int[] lengths;
+		private final StreamSequencer[] sequencers;
+		private final long[] tickets;
+		private final boolean availableOnly;
+		
+		public MultiSourceReadHandler(StreamManager streamManager, byte[] requestData, int requestDataLength) {
+			this.streamManager = streamManager;
+			int count = (requestDataLength >= 2) ? (requestData[1] & 0xFF) : 0;
+			if (requestDataLength < 2 + (count * 6)) { count = 0; }
+			this.availableOnly = (count > 0 && (requestData[0] & 0x01) != 0);
+			this.streamIds = new int[count];
+			this.lengths = new int[count];
+			this.sequencers = new StreamSequencer[count];
+			this.tickets = new long[count];
+			int pos = 2;
+			for (int i = 0; i < count; i++) {
+				this.streamIds[i] = ((requestData[pos] & 0xFF) << 24)
+						| ((requestData[pos + 1] & 0xFF) << 16)
+						| ((requestData[pos + 2] & 0xFF) << 8)
+						| (requestData[pos + 3] & 0xFF);
+				this.lengths[i] = ((requestData[pos + 4] & 0xFF) << 8) | (requestData[pos + 5] & 0xFF);
+				pos += 6;
+				this.sequencers[i] = streamManager.getSequencer(this.streamIds[i]);
+				if (this.sequencers[i] != null) { this.tickets[i] = this.sequencers[i].drawTicket(); }
+			}
+		}
+
+		@Override
+		public void deinitialize() {}
+
+		@Override
+		public void initialize(String name, EbcdicHandler clientVm, PropertiesExt configuration) {}
+
+		@Override
+		public ILevelOneResult processRequest(
+				short cmd, 
+				int controlData,
+				byte[] requestData, 
+				int requestDataLength, 
+				byte[] responseBuffer) {
+			if (this.streamIds.length == 0) {
+				return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BASESVC_INVCMD);
+			}
+			
+			int pos = 0;
+			for (int i = 0; i < this.streamIds.length; i++) {
+				int state = LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SOURCE_INVALID;
+				int bytes = 0;
+				int length = Math.min(this.lengths[i], responseBuffer.length - pos - ((this.streamIds.length - i) * 4));
+				// the tickets for the streams were drawn in the order of the streams in all
+				// requests, so waiting for the streams one after the other cannot deadlock
+				if (this.sequencers[i] != null) { this.sequencers[i].awaitTurn(this.tickets[i]); }
+				try {
+					StreamManager.StreamEntry entry = this.streamManager.acquire(this.streamIds[i]);
+					if (entry != null) {
+						try {
+							IBulkSource src = entry.source;
+							if (src != null) {
+								if (length > 0) {
+									byte[] block = new byte[length];
+									bytes = src.getNextBlock(block, this.availableOnly);
+									System.arraycopy(block, 0, responseBuffer, pos + 4, bytes);
+								}
+								state = src.getState();
+							}
+						} finally {
+							this.streamManager.release(entry);
+						}
+					}
+				} finally {
+					if (this.sequencers[i] != null) { this.sequencers[i].done(); }
+				}
+				responseBuffer[pos] = (byte)((state >> 8) & 0xFF);
+				responseBuffer[pos + 1] = (byte)(state & 0xFF);
+				responseBuffer[pos + 2] = (byte)((bytes >> 8) & 0xFF);
+				responseBuffer[pos + 3] = (byte)(bytes & 0xFF);
+				pos += 4 + bytes;
+			}
+			
+			return new LevelOneBufferResult(0, 0, pos);
+		}
+	}
+	
 	// the Level-One service implementing the bulk sink stream operations
+	// (the client may have several writes in flight for a sink, so the requests
+	// must be processed in sequence, see StreamSequencer)
 	private static class BulkSinkHandler implements ILevelOneHandler {
 		private final StreamManager streamManager;
+		private final LevelOneRecordCodec recordCodec;
 		
-		public BulkSinkHandler(StreamManager streamManager) {
+		public BulkSinkHandler(StreamManager streamManager, LevelOneRecordCodec recordCodec) {
 			this.streamManager = streamManager;
+			this.recordCodec = recordCodec;
 		}
 
 		@Override
@@ -308,7 +654,23 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 				byte[] requestData, 
 				int requestDataLength, 
 				byte[] responseBuffer) {
-			IBulkSink snk = this.streamManager.getSinkStream(controlData);
+			StreamManager.StreamEntry entry = this.streamManager.acquire(controlData);
+			if (entry == null) {
+				return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SINK_INVALID); 
+			}
+			try {
+				return this.processSinkRequest(cmd, entry, requestData, requestDataLength);
+			} finally {
+				this.streamManager.release(entry);
+			}
+		}
+		
+		private ILevelOneResult processSinkRequest(
+				short cmd, 
+				StreamManager.StreamEntry entry,
+				byte[] requestData, 
+				int requestDataLength) {
+			IBulkSink snk = entry.sink;
 			
 			if (snk == null) {
 				return new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SINK_INVALID); 
@@ -317,9 +679,17 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 			if (cmd == CMD_BULKSINK_WRITE) {
 				snk.putBlock(requestData, requestDataLength);
 				return new LevelOneBufferResult(0, snk.getState(), 0);
+			} else if (cmd == CMD_BULKSINK_RECORDMODE) {
+				// request data: flags (1 byte: 0x01 = strip trailing blanks)
+				boolean stripBlanks = (requestDataLength > 0 && (requestData[0] & 0x01) != 0);
+				if (!(snk instanceof LevelOneRecordSink)) {
+					snk = new LevelOneRecordSink(snk, this.recordCodec, stripBlanks);
+					this.streamManager.replaceStream(entry, snk);
+				}
+				return new LevelOneBufferResult(0, snk.getState(), 0);
 			} else if (cmd == CMD_BULKSINK_CLOSE) {
 				snk.close();
-				this.streamManager.removeStream(controlData);
+				this.streamManager.removeStream(entry);
 				return new LevelOneBufferResult(0, snk.getState(), 0);
 			}
 			
@@ -341,6 +711,9 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 		private final IErrorSink errorSink;
 		private final StreamManager streams;
 		
+		private final StreamSequencer sequencer;
+		private final long ticket;
+		
 		public LevelOneRunnable(
 				IHostConnector hostConnection, 
 				IErrorSink errorSink,
@@ -348,6 +721,17 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 				ILevelOneHandler handler,
 				short cmd,
 				IRequestResponse request) {
+			this(hostConnection, errorSink, streams, handler, cmd, request, null);
+		}
+		
+		public LevelOneRunnable(
+				IHostConnector hostConnection, 
+				IErrorSink errorSink,
+				StreamManager streams,
+				ILevelOneHandler handler,
+				short cmd,
+				IRequestResponse request,
+				StreamSequencer sequencer) {
 			this.hostConnection = hostConnection;
 			this.errorSink = errorSink;
 			this.streams = streams;
@@ -357,6 +741,10 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 			this.request = request;
 			
 			this.result = null;
+			
+			// draw the ticket now, as we are still in the receiving thread
+			this.sequencer = sequencer;
+			this.ticket = (sequencer != null) ? sequencer.drawTicket() : 0;
 		}
 		
 		public LevelOneRunnable(
@@ -374,12 +762,16 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 
 			this.handler = null;
 			this.cmd = 0;
+			
+			this.sequencer = null;
+			this.ticket = 0;
 		}
 
 		@Override
 		public void run() {
 			ILevelOneResult r = this.result;
 			if (r == null) {
+				if (this.sequencer != null) { this.sequencer.awaitTurn(this.ticket); }
 				try {
 				r = this.handler.processRequest(
 						cmd, 
@@ -390,6 +782,8 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 				} catch(Exception exc) {
 					exc.printStackTrace();
 					r = new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_SVC_EXCEPTION);
+				} finally {
+					if (this.sequencer != null) { this.sequencer.done(); }
 				}
 			}
 			if (r instanceof LevelOneProtErrResult) {
@@ -402,13 +796,25 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 				this.request.setRespDataLen(((LevelOneBufferResult) r).getBufferLength());
 			} else if (r instanceof IBulkSource) {
 				int streamId = this.streams.addStream((IBulkSource)r);
-				this.request.setRespUserWord1(LevelZeroToLevelOneDispatcher.STATE_NEW_BULK_SOURCE);
-				this.request.setRespUserWord2(streamId);
+				if (streamId < 0) {
+					logger.error("no free slot for new bulk source, closing stream");
+					((IBulkSource)r).close();
+				}
+				this.request.setRespUserWord1((streamId < 0)
+						? LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SOURCE_INVALID
+						: LevelZeroToLevelOneDispatcher.STATE_NEW_BULK_SOURCE);
+				this.request.setRespUserWord2((streamId < 0) ? 0 : streamId);
 				this.request.setRespDataLen(0);
 			} else if (r instanceof IBulkSink) {
 				int streamId = this.streams.addStream((IBulkSink)r);
-				this.request.setRespUserWord1(LevelZeroToLevelOneDispatcher.STATE_NEW_BULK_SINK);
-				this.request.setRespUserWord2(streamId);
+				if (streamId < 0) {
+					logger.error("no free slot for new bulk sink, closing stream");
+					((IBulkSink)r).close();
+				}
+				this.request.setRespUserWord1((streamId < 0)
+						? LevelZeroToLevelOneDispatcher.STATE_ERR_BULK_SINK_INVALID
+						: LevelZeroToLevelOneDispatcher.STATE_NEW_BULK_SINK);
+				this.request.setRespUserWord2((streamId < 0) ? 0 : streamId);
 				this.request.setRespDataLen(0);
 			} else {
 				this.request.setRespUserWord1(LevelZeroToLevelOneDispatcher.STATE_ERR_SVC_INVALIDRESULT);
@@ -428,7 +834,12 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 	}
 	
 	// create the response for the "get environment information" request to the base service.
-	private ILevelOneResult createEnvInfo() {		
+	private ILevelOneResult createEnvInfo() {
+		return new LevelOneBufferResult(0, this.getEnvInfo(), 0); // rc = OK, controlData = result, length = 0
+	}
+	
+	// get the environment information word
+	private int getEnvInfo() {		
 		// lower 8 bits: service version
 		// bits 9-10: line-end convention on this platform
 		//   0x01: LF
@@ -447,7 +858,7 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 			result |= 0x0300;
 		}
 		
-		return new LevelOneBufferResult(0, result, 0); // rc = OK, controlData = result, length = 0
+		return result;
 	}
 	
 	@Override
@@ -464,10 +875,21 @@ public class LevelZeroToLevelOneDispatcher implements ILevelZeroHandler {
 		} else if (serviceId == 0 && serviceCmd == CMD_GETENVINFO) {
 			ILevelOneResult res =  this.createEnvInfo();
 			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, res, request);
+		} else if (serviceId == 0 && serviceCmd == CMD_READMULTI) {
+			ILevelOneHandler handler = new MultiSourceReadHandler(this.streamManager, request.getReqData(), request.getReqDataLen());
+			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, handler, serviceCmd, request);
+		} else if (serviceId == 0 && serviceCmd == CMD_DISCOVER) {
+			ILevelOneResult res =  this.processService0CmdDiscover(request.getRespData());
+			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, res, request);
 		} else if (serviceId == 0 && (serviceCmd >= CMD_BULKSRC_CLOSE && serviceCmd <= CMD_BULKSRC_LAST)) {
-			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, this.sourceStreamsHandler, serviceCmd, request);
+			// positional reads do not depend on the stream position, so they may run in parallel
+			StreamSequencer sequencer = (serviceCmd == CMD_BULKSRC_READAT)
+					? null
+					: this.streamManager.getSequencer(request.getReqUserWord2());
+			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, this.sourceStreamsHandler, serviceCmd, request, sequencer);
 		} else if (serviceId == 0 && (serviceCmd >= CMD_BULKSINK_CLOSE && serviceCmd <= CMD_BULKSINK_LAST)) {
-			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, this.sinkStreamsHandler, serviceCmd, request);
+			StreamSequencer sequencer = this.streamManager.getSequencer(request.getReqUserWord2());
+			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, this.sinkStreamsHandler, serviceCmd, request, sequencer);
 		} else if (serviceId == 0) {
 			ILevelOneResult res = new LevelOneProtErrResult(LevelZeroToLevelOneDispatcher.STATE_ERR_BASESVC_INVCMD);
 			return new LevelOneRunnable(this.hostConnection, this.errorSink, this.streamManager, res, request);
@@ -0,0 +1,86 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2014
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy.socketapi;
+
+import java.net.InetAddress;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Base Implementation of a INioSocketProxy for a "IPv4" type socket served by the
+ * NioSocketEngine, providing the management of the requests deferred until the
+ * socket is ready and of the readiness listener.
+ *
+ * The proxy instance is the lock for its state: the selector thread of the engine
+ * and the request processing threads synchronize on it, waiting on it resp. notifying
+ * it when the state changes.
+ *
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2014
+ *
+ */
+public abstract class AbstractNioInetV4Proxy extends AbstractInetV4Proxy
+		implements INioSocketProxy, NioSocketEngine.IChannelOwner {
+
+	protected final NioSocketEngine engine;
+
+	// the requests waiting for the socket to become ready (guarded by 'this')
+	private final List<Runnable> deferred = new ArrayList<Runnable>();
+
+	// the listener to inform about readiness changes (see ISocketProxy)
+	private volatile Runnable readinessListener = null;
+
+	protected AbstractNioInetV4Proxy(InetAddress defaultAddress, NioSocketEngine engine) {
+		super(defaultAddress);
+		this.engine = engine;
+	}
+
+	// remember the request 'action' to be run when the socket becomes ready
+	// (must be invoked with the lock held)
+	protected void defer(Runnable action) {
+		this.deferred.add(action);
+	}
+
+	// let the engine re-check the channel and the interest operations of this proxy
+	protected void interestChanged() {
+		this.engine.interestChanged(this);
+	}
+
+	// start the deferred requests if the socket became ready for them (or if 'release'
+	// is given, e.g. because the socket was closed) and inform the readiness listener
+	// (must be invoked without the lock held)
+	protected void readinessChanged(boolean release) {
+		List<Runnable> actions = null;
+		synchronized(this) {
+			if (!this.deferred.isEmpty()
+				&& (release || (this.getReadiness() & (READY_READ | READY_ACCEPT | READY_ERROR)) != 0)) {
+				actions = new ArrayList<Runnable>(this.deferred);
+				this.deferred.clear();
+			}
+		}
+		if (actions != null) {
+			// a request finding the socket not ready after all defers itself again
+			for (Runnable action : actions) { this.engine.execute(action); }
+		}
+
+		Runnable listener = this.readinessListener;
+		if (listener != null) { listener.run(); }
+	}
+
+	// setReadinessListener(listener)
+	@Override
+	public void setReadinessListener(Runnable listener) {
+		this.readinessListener = listener;
+	}
+}
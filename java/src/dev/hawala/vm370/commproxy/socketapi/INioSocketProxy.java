@@ -0,0 +1,40 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2014
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy.socketapi;
+
+/**
+ * Extension of the ISocketProxy interface for socket proxies served by the
+ * NioSocketEngine, allowing the Level-0 socket-API handler to hand over a
+ * request that would wait for the socket to the proxy instead of blocking
+ * a worker thread until the socket is ready.
+ *
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2014
+ *
+ */
+public interface INioSocketProxy extends ISocketProxy {
+
+	// deferred <- deferRecv(fromAddress, action)
+	// check if a recv() (fromAddress == false) resp. recvFrom() (fromAddress == true)
+	// would wait for data and if so remember 'action' to be run on a worker thread of
+	// the engine when data arrived or the socket is closed resp. failed
+	// returns: true if 'action' was deferred, false if the operation can be done now
+	public boolean deferRecv(boolean fromAddress, Runnable action);
+
+	// deferred <- deferAccept(action)
+	// check if an accept() would wait for a connection and if so remember 'action' to be
+	// run on a worker thread of the engine when a connection arrived or the socket is closed
+	// returns: true if 'action' was deferred, false if the operation can be done now
+	public boolean deferAccept(Runnable action);
+}
@@ -39,6 +39,13 @@ public interface ISocketProxy {
 	
 	public final int AF_INET  = 2;
 	
+	/* readiness flags of a socket for the select event channel */
+	
+	public final int READY_READ   = 0x01; // recv() will not wait (data, end of stream or error)
+	public final int READY_WRITE  = 0x02; // send() is possible (connected, out channel open)
+	public final int READY_ACCEPT = 0x04; // accept() will not wait (connection arrived)
+	public final int READY_ERROR  = 0x08; // the connection failed
+	
 
 	// rc <- bind(local_address) 
 	// buffer usage:
@@ -152,4 +159,14 @@ public interface ISocketProxy {
 	// rc:
 	// - ENOTCONN -- The socket is associated with a connection-oriented protocol and has not been connected.
 	public int close();
+	
+	// flags <- getReadiness()
+	// get the current readiness of the socket as combination of the READY_* flags,
+	// without waiting
+	public int getReadiness();
+	
+	// setReadinessListener(listener)
+	// register the listener to be invoked each time the readiness of the socket may
+	// have changed (the listener is invoked without any lock of the socket being held)
+	public void setReadinessListener(Runnable listener);
 }
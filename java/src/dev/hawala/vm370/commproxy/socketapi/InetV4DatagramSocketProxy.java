@@ -250,4 +250,19 @@ public class InetV4DatagramSocketProxy extends AbstractInetV4Proxy implements IS
 	public int getpeername(byte[] buffer) {
 		return ISocketError.EOPNOTSUPP;
 	}
+	
+	/*
+	 * select event channel: datagrams are not received in advance, so the CMS client
+	 * still waits for a recv()/recvfrom() request to watch a datagram socket for input
+	 */
+	
+	@Override
+	public int getReadiness() {
+		return READY_WRITE;
+	}
+	
+	@Override
+	public void setReadinessListener(Runnable listener) {
+		// readiness never changes
+	}
 }
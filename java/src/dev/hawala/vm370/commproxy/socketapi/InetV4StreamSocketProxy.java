@@ -21,6 +21,7 @@ import java.net.InetAddress;
 import java.net.InetSocketAddress;
 import java.net.ServerSocket;
 import java.net.Socket;
+import java.util.LinkedList;
 
 /**
  * Implementation of a ISocketProxy for a "IPv4 STREAM" type socket.
@@ -39,6 +40,218 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 	protected InputStream inStream = null; // remote -> local
 	protected OutputStream outStream = null; // local -> remote
 	
+	// size of the receive read-ahead buffer (8 packets of the max. recv size)
+	private static final int RECV_BUFFER_SIZE = 16384;
+	
+	// read-ahead for the data arriving on the connection
+	// -> a background thread reads from the input stream into a ring buffer as long as
+	//    there is space, so the data is already here when the CMS client asks for it
+	//    (instead of waiting in the kernel until the next CMD_RECV arrives)
+	// -> a recv() is answered from the buffered data, coalesced up to the requested size,
+	//    and waits only if nothing is buffered
+	// -> when the buffer is full, the reader thread stops reading, so the TCP flow control
+	//    still throttles the sender
+	// -> the readiness listener is informed each time data arrived or the stream ended
+	private class RecvBuffer implements Runnable {
+		private final InputStream in;
+		private final byte[] ring = new byte[RECV_BUFFER_SIZE];
+		private int head = 0; // position of the first buffered byte in 'ring'
+		private int count = 0; // number of bytes buffered
+		private boolean eof = false; // end of stream (or error) reached by the reader?
+		private boolean failed = false; // was the end of stream caused by an error?
+		private boolean closed = false; // stop reading?
+		
+		public RecvBuffer(InputStream in) {
+			this.in = in;
+			Thread t = new Thread(this);
+			t.setName("SocketProxy-RecvAhead");
+			t.setDaemon(true);
+			t.start();
+		}
+		
+		// the reader thread: fill the free space of the ring buffer
+		// (the free space is not accessed by read(), so reading into it needs no lock)
+		@Override
+		public void run() {
+			while(true) {
+				int pos;
+				int free;
+				synchronized(this) {
+					while (!this.closed && this.count == this.ring.length) {
+						try { this.wait(); } catch (InterruptedException e) { return; }
+					}
+					if (this.closed) { return; }
+					pos = (this.head + this.count) % this.ring.length;
+					free = Math.min(this.ring.length - this.count, this.ring.length - pos);
+				}
+				
+				int len;
+				boolean error = false;
+				try {
+					len = this.in.read(this.ring, pos, free);
+				} catch (IOException e) {
+					len = -1;
+					error = true;
+				}
+				
+				synchronized(this) {
+					if (len < 0) {
+						this.eof = true;
+						this.failed = error && !this.closed;
+					} else {
+						this.count += len;
+					}
+					this.notifyAll();
+				}
+				readinessChanged();
+				if (len < 0) { return; }
+			}
+		}
+		
+		// get the READY_READ resp. READY_ERROR flags for the buffer state
+		public synchronized int getReadiness() {
+			int flags = 0;
+			if (this.count > 0 || this.eof || this.closed) { flags |= READY_READ; }
+			if (this.failed) { flags |= READY_ERROR; }
+			return flags;
+		}
+		
+		// get up to 'maxCount' buffered bytes into 'buffer', waiting until data is available
+		// returns: the number of bytes transferred or -1 if at end of stream resp. closed
+		public synchronized int read(byte[] buffer, int maxCount) {
+			while (this.count == 0 && !this.eof && !this.closed) {
+				try { this.wait(); } catch (InterruptedException e) { return -1; }
+			}
+			if (this.count == 0) { return -1; }
+			
+			int len = Math.min(maxCount, this.count);
+			int first = Math.min(len, this.ring.length - this.head);
+			System.arraycopy(this.ring, this.head, buffer, 0, first);
+			if (first < len) {
+				System.arraycopy(this.ring, 0, buffer, first, len - first);
+			}
+			this.head = (this.head + len) % this.ring.length;
+			this.count -= len;
+			this.notifyAll(); // the reader may continue if it waits for space
+			return len;
+		}
+		
+		// stop reading (the input stream must be closed by the caller to end a pending read)
+		public synchronized void close() {
+			this.closed = true;
+			this.notifyAll();
+		}
+	}
+	
+	private RecvBuffer recvBuffer = null;
+	
+	private void closeRecvBuffer() {
+		if (this.recvBuffer != null) {
+			this.recvBuffer.close();
+			this.recvBuffer = null;
+		}
+	}
+	
+	// max. number of connections accepted in advance for a listening socket 
+	private static final int ACCEPT_AHEAD = 4;
+	
+	// accept-ahead for a listening socket
+	// -> a background thread accepts incoming connections as long as less than ACCEPT_AHEAD
+	//    connections are waiting, so the readiness for accept() is known without blocking
+	//    a request of the CMS client
+	// -> an accept() takes the oldest waiting connection, waiting only if none is there
+	private class AcceptQueue implements Runnable {
+		private final ServerSocket server;
+		private final LinkedList<Socket> accepted = new LinkedList<Socket>();
+		private boolean ended = false; // server socket closed or failed?
+		
+		public AcceptQueue(ServerSocket server) {
+			this.server = server;
+			Thread t = new Thread(this);
+			t.setName("SocketProxy-AcceptAhead");
+			t.setDaemon(true);
+			t.start();
+		}
+		
+		// the acceptor thread
+		@Override
+		public void run() {
+			while(true) {
+				synchronized(this) {
+					while (!this.ended && this.accepted.size() >= ACCEPT_AHEAD) {
+						try { this.wait(); } catch (InterruptedException e) { return; }
+					}
+					if (this.ended) { return; }
+				}
+				
+				Socket s = null;
+				try {
+					s = this.server.accept();
+					s.setTcpNoDelay(true);
+				} catch (IOException e) {
+					if (s != null) { try { s.close(); } catch (IOException e2) { } }
+					s = null;
+				}
+				
+				synchronized(this) {
+					if (s == null) {
+						this.ended = true;
+					} else if (this.ended) {
+						try { s.close(); } catch (IOException e) { }
+					} else {
+						this.accepted.add(s);
+					}
+					this.notifyAll();
+				}
+				readinessChanged();
+				if (s == null) { return; }
+			}
+		}
+		
+		// get the next accepted connection, waiting until one is available
+		// returns: the connection or null if the server socket is closed resp. failed
+		public synchronized Socket take() {
+			while (this.accepted.isEmpty() && !this.ended) {
+				try { this.wait(); } catch (InterruptedException e) { return null; }
+			}
+			if (this.accepted.isEmpty()) { return null; }
+			this.notifyAll(); // the acceptor may continue if it waits for space
+			return this.accepted.removeFirst();
+		}
+		
+		// get the READY_ACCEPT resp. READY_ERROR flags for the queue state
+		public synchronized int getReadiness() {
+			if (!this.accepted.isEmpty()) { return READY_ACCEPT; }
+			return (this.ended) ? READY_ACCEPT | READY_ERROR : 0;
+		}
+		
+		// stop accepting connections and drop the connections not taken
+		public void close() {
+			synchronized(this) {
+				this.ended = true;
+				for (Socket s : this.accepted) {
+					try { s.close(); } catch (IOException e) { }
+				}
+				this.accepted.clear();
+				this.notifyAll();
+			}
+			try { this.server.close(); } catch (IOException e) { }
+		}
+	}
+	
+	private AcceptQueue acceptQueue = null;
+	
+	// the listener to inform about readiness changes (see ISocketProxy)
+	private volatile Runnable readinessListener = null;
+	
+	// was the socket closed? (a closed socket is reported as failed)
+	private volatile boolean closed = false;
+	
+	private void readinessChanged() {
+		Runnable listener = this.readinessListener;
+		if (listener != null) { listener.run(); }
+	}
+	
 	public InetV4StreamSocketProxy(InetAddress defaultAddress) {
 		super(defaultAddress);
 	}
@@ -54,6 +267,7 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 		this.remoteAddress = ra;
 		this.inStream = is;
 		this.outStream = os;
+		this.recvBuffer = new RecvBuffer(is);
 	}
 	
 	// rc <- bind(local_address) 
@@ -105,6 +319,7 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 				this.clientSocket.close();
 			} catch (IOException e) {
 			}
+			this.closeRecvBuffer();
 			this.inStream = null;
 			this.outStream = null;
 			this.clientSocket = null;
@@ -113,6 +328,10 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 		
 		if (this.serverSocket != null)
 		{
+			if (this.acceptQueue != null) {
+				this.acceptQueue.close();
+				this.acceptQueue = null;
+			}
 			try {
 				this.serverSocket.close();
 			} catch (IOException e) {
@@ -120,6 +339,10 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 			this.serverSocket = null;
 		}
 		
+		// wake up a select waiting for this socket, which sees it as failed now
+		this.closed = true;
+		this.readinessChanged();
+		
 		return ISocketError.EOK;
 	}
 	
@@ -146,6 +369,7 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 			catch (IOException e) {
 				// ignored!
 			}
+			this.closeRecvBuffer();
 			this.inStream = null;
 		}
 		
@@ -203,6 +427,7 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 			this.remoteAddress = isa;
 			this.inStream = s.getInputStream();
 			this.outStream = s.getOutputStream();
+			this.recvBuffer = new RecvBuffer(this.inStream);
 		} catch (IOException e) {
 			return errCode;
 		}
@@ -232,6 +457,7 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 			s.bind(this.localAddress);
 			this.serverSocket = s;
 			this.localAddress = (InetSocketAddress) s.getLocalSocketAddress();
+			this.acceptQueue = new AcceptQueue(s);
 		} catch (IOException e) {
 			return ISocketError.EADDRINUSE;
 		}
@@ -241,6 +467,7 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 	
 	// {rc,proxy} <- accept(buffer)
 	// wait for incoming connection
+	// (taken from the accept-ahead queue, waiting only if no connection has arrived yet)
 	// buffer usage (OUT):
 	//   offset 0 -> 16 bytes :: src_addr (where the connection comes from)
 	// rc:
@@ -248,24 +475,26 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 	// - ECONNABORTED -- A connection has been aborted
 	// - EINTR -- interrupted by a signal that was caught before a valid connection arrived
 	public SocketProxyAcceptResult accept(byte[] buffer) {
-		if (this.serverSocket == null) { return new SocketProxyAcceptResult(ISocketError.EINVAL); }
+		AcceptQueue aq = this.acceptQueue;
+		if (this.serverSocket == null || aq == null) { return new SocketProxyAcceptResult(ISocketError.EINVAL); }
 		
+		Socket s = aq.take();
+		if (s == null) { return new SocketProxyAcceptResult(ISocketError.ECONNABORTED); }
 		try {
-			Socket s = this.serverSocket.accept();
-			s.setTcpNoDelay(true);
-			
 			InetSocketAddress sockAddr = (InetSocketAddress)s.getRemoteSocketAddress();			
 			this.putInetSocketAddress(sockAddr, buffer, 0);
 			
 			return new SocketProxyAcceptResult(
 						new InetV4StreamSocketProxy(this.defaultAddress, s, sockAddr, s.getInputStream(), s.getOutputStream()));
 		} catch (IOException e) {
+			try { s.close(); } catch (IOException e2) { }
 			return new SocketProxyAcceptResult(ISocketError.ECONNABORTED);
 		}
 	}
 
 	// {rc+len} <- recv(buffer, maxCount, flags)
 	// receive data-packet over stream connection
+	// (answered from the read-ahead buffer, waiting only if no data has arrived yet)
 	// buffer usage:
 	//   offset 0 -> 1..2048 bytes :: data received
 	// userWord: flags (currently unused)
@@ -275,18 +504,16 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 	// - others...?
 	@Override
 	public int recv(byte[] buffer, int maxCount, int userWord) {
-		if (this.clientSocket == null || this.inStream == null) {
+		RecvBuffer rb = this.recvBuffer;
+		if (this.clientSocket == null || this.inStream == null || rb == null) {
 			return ISocketError.ENOTCONN;
 		}
+		if (maxCount <= 0) { return ISocketError.EOK; }
 	
-		try {
-			int len = this.inStream.read(buffer, 0, Math.min(2048, maxCount));
-			if (len >= 0) {
-				return ISocketError.EOK + (len & 0x0FFF);
-			} else {
-				return ISocketError.ECONNABORTED;
-			}
-		} catch (IOException e) {
+		int len = rb.read(buffer, Math.min(2048, maxCount));
+		if (len >= 0) {
+			return ISocketError.EOK + (len & 0x0FFF);
+		} else {
 			return ISocketError.ECONNABORTED;
 		}
 	}
@@ -380,4 +607,25 @@ public class InetV4StreamSocketProxy extends AbstractInetV4Proxy implements ISoc
 		}
 		return ISocketError.EOK;
 	}
+	
+	// flags <- getReadiness()
+	@Override
+	public int getReadiness() {
+		if (this.closed) { return READY_ERROR; }
+		
+		AcceptQueue aq = this.acceptQueue;
+		if (aq != null) { return aq.getReadiness(); }
+		
+		int flags = 0;
+		RecvBuffer rb = this.recvBuffer;
+		if (rb != null) { flags |= rb.getReadiness(); }
+		if (this.clientSocket != null && this.outStream != null) { flags |= READY_WRITE; }
+		return flags;
+	}
+	
+	// setReadinessListener(listener)
+	@Override
+	public void setReadinessListener(Runnable listener) {
+		this.readinessListener = listener;
+	}
 }
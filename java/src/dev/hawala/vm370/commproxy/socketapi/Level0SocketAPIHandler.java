@@ -14,6 +14,7 @@
 
 package dev.hawala.vm370.commproxy.socketapi;
 
+import java.io.IOException;
 import java.net.InetAddress;
 import java.net.UnknownHostException;
 import java.util.ArrayList;
@@ -43,13 +44,22 @@ import dev.hawala.vm370.ebcdic.EbcdicHandler;
  * socket to which the operation is addressed, with the proxy instance identified by
  * the socket-fd as index in an internal table
  * 
+ * The request command CMD_SELECT is the event channel for select() on the CMS side:
+ * a single outstanding request returns the readiness of all sockets of the VM as
+ * soon as one of the sockets watched becomes ready.
+ * 
+ * With the configuration property 'niosockets = true', the sockets are implemented
+ * with the NIO based proxies served by the NioSocketEngine instead of the blocking
+ * socket proxies, so a recv() or accept() waiting for data resp. a connection does not
+ * occupy a thread.
+ * 
  * @author Dr. Hans-Walter Latz, Berlin (Germany), 2014
  *
  */
 public class Level0SocketAPIHandler implements ILevelZeroHandler {
 	
-	// must be in sync with the parameter in the CMS-side API
-	private static final int MAX_SOCKET_COUNT = 64;
+	// must be in sync with the parameter in the CMS-side API (FD_SETSIZE)
+	private static final int MAX_SOCKET_COUNT = 512;
 	
 	// commands for the CMS-API
 	private static final int CMD_GETHOSTBYNAME = 16;
@@ -68,6 +78,7 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 	private static final int CMD_RECVFROM = 49;
 	private static final int CMD_SEND = 50;
 	private static final int CMD_SENDTO = 51;
+	private static final int CMD_SELECT = 52;
 	
 	private static final ArrayList<String> cmdNames = new ArrayList<String>();
 	
@@ -90,6 +101,7 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 		cmdNames.set(CMD_RECVFROM, "CMD_RECVFROM");
 		cmdNames.set(CMD_SEND, "CMD_SEND");
 		cmdNames.set(CMD_SENDTO, "CMD_SENDTO");
+		cmdNames.set(CMD_SELECT, "CMD_SELECT");
 	}
 	
 	// our logger
@@ -105,6 +117,10 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 	private String vmFQN = null;
 	private InetAddress vmDefaultAddress = null;
 	
+	// the selector engine serving the sockets if the NIO based socket proxies are configured
+	// (else null, using the blocking socket proxies)
+	private NioSocketEngine nioEngine = null;
+	
 	private static class DummyReservedSocket implements ISocketProxy {
 		@Override
 		public SocketProxyAcceptResult accept(byte[] buffer) { return new SocketProxyAcceptResult(ISocketError.ENOTSOCK); }
@@ -140,7 +156,13 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 		public int sendTo(byte[] buffer, int bufferLength, int userWord) { return ISocketError.ENOTSOCK; }
 
 		@Override
-		public int shutdown(byte[] buffer, int bufferLength) { return ISocketError.ENOTSOCK; }		
+		public int shutdown(byte[] buffer, int bufferLength) { return ISocketError.ENOTSOCK; }
+		
+		@Override
+		public int getReadiness() { return 0; }
+		
+		@Override
+		public void setReadinessListener(Runnable listener) { }
 	}
 	
 	private final ISocketProxy reservingSocket = new DummyReservedSocket();
@@ -149,19 +171,66 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 	// (an unused socket-fd is null, of course)
 	private ISocketProxy[] sockets = new ISocketProxy[MAX_SOCKET_COUNT];
 	
+	// the free socket-fds as FIFO ring (guarded by 'sockets'), so allocating a socket-fd
+	// needs no scan of the socket table and a released socket-fd is reused as late as
+	// possible (a late request for a closed socket will not hit a new socket)
+	private final int[] freeFds = new int[MAX_SOCKET_COUNT];
+	private int freeFirst = 0;
+	private int freeCount = 0;
+	
+	{
+		for (int i = 0; i < MAX_SOCKET_COUNT; i++) { this.freeFds[i] = i; }
+		this.freeCount = MAX_SOCKET_COUNT;
+	}
+	
+	// sequencer for the send requests to a single socket
+	// -> the client may have several sends for a socket in flight (send window), which
+	//    arrive in the order they were issued by the client, but are processed by different
+	//    threads of the thread pool
+	// -> each send draws a ticket when it is dispatched (in arrival order by the receiving
+	//    thread) and the processing threads wait for their turn, so the data is written to
+	//    the connection in the original order
+	private static class SendSequencer {
+		private long nextTicket = 0;
+		private long currTicket = 0;
+		
+		public synchronized long drawTicket() {
+			return this.nextTicket++;
+		}
+		
+		// wait until all sends with a lower ticket are done; an interrupt does not
+		// end the wait, as sending out of ticket order would reorder the stream data
+		// (the interrupt status is restored for the caller)
+		public synchronized void awaitTurn(long ticket) {
+			boolean interrupted = false;
+			while (ticket > this.currTicket) {
+				try { this.wait(); } catch (InterruptedException e) { interrupted = true; }
+			}
+			if (interrupted) { Thread.currentThread().interrupt(); }
+		}
+		
+		public synchronized void done() {
+			this.currTicket++;
+			this.notifyAll();
+		}
+	}
+	
+	// the send sequencers of the open sockets, with index = socket-fd
+	// (guarded by 'sockets', a new sequencer is created for each new socket proxy)
+	private SendSequencer[] sendSequencers = new SendSequencer[MAX_SOCKET_COUNT];
+	
 	protected int getFreeSocket() {
 		synchronized(this.sockets) {
-			for(int i = 0; i < this.sockets.length; i++) {
-				if (this.sockets[i] == null) {
-					/*
-					System.out.printf("-- getFreeSocket() -> %d\n", i);
-					*/ 
-					this.sockets[i] = reservingSocket;
-					return i;
-				}
-			}
+			if (this.freeCount == 0) { return -1; }
+			int i = this.freeFds[this.freeFirst];
+			this.freeFirst = (this.freeFirst + 1) % MAX_SOCKET_COUNT;
+			this.freeCount--;
+			/*
+			System.out.printf("-- getFreeSocket() -> %d\n", i);
+			*/ 
+			this.sockets[i] = reservingSocket;
+			return i;
 		}
-		return -1;
 	}
 	
 	protected ISocketProxy getSocket(int fd) {
@@ -180,12 +249,26 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 			System.out.printf("-- setSocket(%d) -> in use\n", fd);
 		}
 		*/
+		if (sock != null) { sock.setReadinessListener(this.readinessListener); }
 		synchronized(this.sockets) {
+			if (sock == null && this.sockets[fd] != null) {
+				this.freeFds[(this.freeFirst + this.freeCount) % MAX_SOCKET_COUNT] = fd;
+				this.freeCount++;
+			}
 			this.sockets[fd] = sock;
+			this.sendSequencers[fd] = (sock != null) ? new SendSequencer() : null;
+		}
+	}
+	
+	private SendSequencer getSendSequencer(int fd) {
+		if (fd < 0 || fd >= this.sendSequencers.length) { return null; }
+		synchronized(this.sockets) {
+			return this.sendSequencers[fd];
 		}
 	}
 	
 	protected void dropSockets() {
+		this.cancelSelect();
 		for(int i = 0; i < MAX_SOCKET_COUNT; i++) {
 			ISocketProxy sock = this.sockets[i];
 			if (sock != null) { 
@@ -195,7 +278,7 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 					// ignore it
 				}
 			}
-			this.sockets[i] = null;
+			this.setSocket(i, null);
 		}
 	}
 	
@@ -219,6 +302,140 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 		}
 	}
 	
+	// the select event channel
+	// -> the socket proxies inform the 'readinessListener' when the readiness of a socket
+	//    may have changed, waking up the thread of the pending CMD_SELECT request
+	// -> there is at most one CMD_SELECT request pending per client VM, a new request
+	//    ends the previous request (answered with the readiness state at that time)
+	// response data: 4 bitmaps of FD_BYTES (64) bytes each, with the same layout as the
+	// fd_set of the CMS side (bit 0x80 of byte 0 is socket 0):
+	//   offset   0 :: readable (recv() will not wait)
+	//   offset  64 :: writable (send() is possible)
+	//   offset 128 :: acceptable (accept() will not wait)
+	//   offset 192 :: error (the connection failed)
+	// (only the sockets watched are checked when the readiness changes, so the effort
+	// depends on the number of sockets watched, not on MAX_SOCKET_COUNT)
+	
+	private static final int FD_BYTES = (MAX_SOCKET_COUNT + 7) / 8;
+	
+	private final Object readinessLock = new Object();
+	
+	private final Runnable readinessListener = new Runnable() {
+		@Override
+		public void run() {
+			synchronized(readinessLock) {
+				readinessLock.notifyAll();
+			}
+		}
+	};
+	
+	private SelectWaiter pendingSelect = null; // guarded by readinessLock
+	
+	private void cancelSelect() {
+		synchronized(this.readinessLock) {
+			if (this.pendingSelect != null) {
+				this.pendingSelect.cancelled = true;
+				this.pendingSelect = null;
+			}
+			this.readinessLock.notifyAll();
+		}
+	}
+	
+	private class SelectWaiter implements Runnable {
+		
+		private final IHostConnector connection;
+		private final IErrorSink errorSink;
+		private final IRequestResponse request;
+		private final int[] watchedFds = new int[MAX_SOCKET_COUNT]; // sockets watched
+		private final boolean[] watchedRd = new boolean[MAX_SOCKET_COUNT]; // watched for recv()/accept()
+		private final boolean[] watchedWr = new boolean[MAX_SOCKET_COUNT]; // watched for send()
+		private int watchedCount = 0;
+		
+		private boolean cancelled = false; // guarded by readinessLock
+		
+		public SelectWaiter(IHostConnector connection, IErrorSink errorSink, IRequestResponse request) {
+			this.connection = connection;
+			this.errorSink = errorSink;
+			this.request = request;
+			
+			// collect the sockets watched, skipping the empty bytes of the bitmaps
+			byte[] reqData = request.getReqData();
+			int reqLen = request.getReqDataLen();
+			for (int i = 0; i < FD_BYTES; i++) {
+				int rdBits = (i < reqLen) ? reqData[i] & 0xFF : 0;
+				int wrBits = ((i + FD_BYTES) < reqLen) ? reqData[i + FD_BYTES] & 0xFF : 0;
+				if ((rdBits | wrBits) == 0) { continue; }
+				for (int b = 0; b < 8; b++) {
+					int bit = 0x80 >> b;
+					if (((rdBits | wrBits) & bit) == 0) { continue; }
+					this.watchedFds[this.watchedCount] = (i << 3) + b;
+					this.watchedRd[this.watchedCount] = (rdBits & bit) != 0;
+					this.watchedWr[this.watchedCount] = (wrBits & bit) != 0;
+					this.watchedCount++;
+				}
+			}
+		}
+		
+		// put the readiness of the sockets watched into 'resp', returning if any is ready
+		private boolean collectReadiness(byte[] resp) {
+			boolean anyReady = false;
+			for (int i = 0; i < 4 * FD_BYTES; i++) { resp[i] = (byte)0; }
+			for (int w = 0; w < this.watchedCount; w++) {
+				int fd = this.watchedFds[w];
+				int idx = fd >> 3;
+				byte bit = (byte)(0x80 >> (fd & 0x07));
+				boolean rd = this.watchedRd[w];
+				boolean wr = this.watchedWr[w];
+				
+				ISocketProxy proxy = getSocket(fd);
+				int flags = (proxy != null) ? proxy.getReadiness() : ISocketProxy.READY_ERROR;
+				if (rd && (flags & ISocketProxy.READY_READ) != 0) {
+					resp[idx] |= bit;
+					anyReady = true;
+				}
+				if (wr && (flags & ISocketProxy.READY_WRITE) != 0) {
+					resp[idx + FD_BYTES] |= bit;
+					anyReady = true;
+				}
+				if (rd && (flags & ISocketProxy.READY_ACCEPT) != 0) {
+					resp[idx + 2 * FD_BYTES] |= bit;
+					anyReady = true;
+				}
+				if ((flags & ISocketProxy.READY_ERROR) != 0) {
+					resp[idx + 3 * FD_BYTES] |= bit;
+					anyReady = true;
+				}
+			}
+			return anyReady;
+		}
+		
+		public void run() {
+			try {
+				byte[] resp = this.request.getRespData();
+				synchronized(readinessLock) {
+					while (!this.collectReadiness(resp) && !this.cancelled) {
+						try {
+							readinessLock.wait();
+						} catch (InterruptedException e) {
+							break;
+						}
+					}
+					if (pendingSelect == this) { pendingSelect = null; }
+				}
+				
+				// send response
+				request.setRespUserWord1(ISocketError.EOK);
+				request.setRespDataLen(4 * FD_BYTES);	
+				connection.sendResponse(request);
+			} catch (CommProxyStateException exc) {
+				this.errorSink.consumeException(exc);
+			} catch (Throwable thr) {
+				thr.printStackTrace();
+				this.errorSink.consumeException(new CommProxyStateException("** Caught exception while processing request: " + thr.getMessage()));
+			}
+		}
+	}
+	
 	private InetAddress getFirstV4Address(String name) {
 		try {
 			InetAddress[] as = InetAddress.getAllByName(name);
@@ -243,6 +460,15 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 		
 		logger.info("New Level0 socket-API-handler initialized, client-VM: ", clientVm);
 		
+		this.nioEngine = null;
+		if (configuration.getBoolean("niosockets", false)) {
+			try {
+				this.nioEngine = NioSocketEngine.getInstance();
+			} catch (IOException exc) {
+				logger.info("** unable to start NIO socket engine, using blocking sockets: ", exc.getMessage());
+			}
+		}
+		
 		this.vmDefaultAddress = null;
 		this.hostBasename = configuration.getProperty("hostbasename", null);
 		if (this.hostBasename != null && this.hostBasename.length() > 0) {
@@ -456,6 +682,8 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 		private final int command;
 		private final SocketManager socketManager;
 		//private final int sockfd;
+		private final SendSequencer sequencer;
+		private final long ticket;
 		
 		public SocketProxyHandler(
 				IHostConnector connection,
@@ -464,7 +692,8 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 				ISocketProxy socket,
 				int command,
 				SocketManager socketManager,
-				int sockfd) {
+				int sockfd,
+				SendSequencer sequencer) {
 			this.connection = connection;
 			this.errorSink = errorSink;
 			this.request = request;
@@ -472,6 +701,10 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 			this.command = command;
 			this.socketManager = socketManager;
 			//this.sockfd = sockfd;
+			
+			// draw the ticket now, as we are still in the receiving thread
+			this.sequencer = sequencer;
+			this.ticket = (sequencer != null) ? sequencer.drawTicket() : 0;
 		}
 		
 		public int getRequestDataAsShort(int atOffset) {
@@ -484,10 +717,29 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 			return value;
 		}
 	
+		// hand over a request that would wait for a NIO socket to the socket, which runs
+		// this handler again when the socket is ready (instead of blocking this thread)
+		private boolean deferUntilReady() {
+			if (!(this.proxy instanceof INioSocketProxy)) { return false; }
+			INioSocketProxy nioProxy = (INioSocketProxy)this.proxy;
+			switch(this.command) {
+			case CMD_RECV:
+				return nioProxy.deferRecv(false, this);
+			case CMD_RECVFROM:
+				return nioProxy.deferRecv(true, this);
+			case CMD_ACCEPT:
+				return nioProxy.deferAccept(this);
+			default:
+				return false;
+			}
+		}
+	
 		public void run() {
 			int rc = ISocketError.EUNSPEC;
 			int respLen = 0;
 
+			if (this.deferUntilReady()) { return; }
+			if (this.sequencer != null) { this.sequencer.awaitTurn(this.ticket); }
 			try {
 				// interpret and handle command
 				switch(this.command) {
@@ -591,6 +843,8 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 			} catch (Throwable thr) {
 				thr.printStackTrace();
 				this.errorSink.consumeException(new CommProxyStateException("** Caught exception while processing request: " + thr.getMessage()));
+			} finally {
+				if (this.sequencer != null) { this.sequencer.done(); }
 			}
 		}
 	}
@@ -656,10 +910,14 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 			int ipproto =  (ruw2 & 0x0000FF00) >> 8;
 			ISocketProxy proxy = null;
 			if (socktype == 1 && ipproto == 6) {         // SOCK_STREAM && IPPROTO_TCP
-				proxy = new InetV4StreamSocketProxy(this.vmDefaultAddress);
+				proxy = (this.nioEngine != null)
+					? new NioStreamSocketProxy(this.vmDefaultAddress, this.nioEngine)
+					: new InetV4StreamSocketProxy(this.vmDefaultAddress);
 			} else if (socktype == 2 && ipproto == 17) { // SOCK_DGRAM && IPPROTO_UDP
 				try {
-					proxy = new InetV4DatagramSocketProxy(this.vmDefaultAddress);
+					proxy = (this.nioEngine != null)
+						? new NioDatagramSocketProxy(this.vmDefaultAddress, this.nioEngine)
+						: new InetV4DatagramSocketProxy(this.vmDefaultAddress);
 				} catch (Exception exc) {
 					this.setSocket(sockNo, null); // free socket fd
 					return new RcResponse(this.hostConnection, this.errorSink, request, ISocketError.EMFILE);
@@ -673,6 +931,14 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 			this.setSocket(sockNo, proxy);
 			int rc = ISocketError.EOK | (sockNo & 0x0000FFFF);
 			return new RcResponse(this.hostConnection, this.errorSink, request, rc);
+		} else if (command == CMD_SELECT) {
+			SelectWaiter waiter = new SelectWaiter(this.hostConnection, this.errorSink, request);
+			synchronized(this.readinessLock) {
+				if (this.pendingSelect != null) { this.pendingSelect.cancelled = true; }
+				this.pendingSelect = waiter;
+				this.readinessLock.notifyAll();
+			}
+			return waiter;
 		} else if (command == CMD_GETHOSTBYNAME && request.getReqDataLen() == 7
 				   && r[0] == Ebcdic._0 && r[2] == r[0] && r[4] == r[0] && r[6] == r[0]
 				   && r[1] == Ebcdic._Point && r[3] == r[1] && r[3] == r[1]) {
@@ -698,7 +964,12 @@ public class Level0SocketAPIHandler implements ILevelZeroHandler {
 				smanager = new SocketManager(sockNo, false);
 			}
 			
-			return new SocketProxyHandler(this.hostConnection, this.errorSink, request, proxy, command, smanager, sockNo);
+			// the sends of a socket must be written in the order they were issued
+			SendSequencer sequencer = (command == CMD_SEND || command == CMD_SENDTO)
+					? this.getSendSequencer(sockNo)
+					: null;
+			
+			return new SocketProxyHandler(this.hostConnection, this.errorSink, request, proxy, command, smanager, sockNo, sequencer);
 		}
 	}
 }
@@ -0,0 +1,368 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2014
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy.socketapi;
+
+import java.io.IOException;
+import java.net.InetAddress;
+import java.net.InetSocketAddress;
+import java.nio.ByteBuffer;
+import java.nio.channels.DatagramChannel;
+import java.nio.channels.SelectableChannel;
+import java.nio.channels.SelectionKey;
+
+/**
+ * Implementation of a ISocketProxy for a "IPv4 DATAGRAM" type socket based on
+ * a non-blocking channel served by the NioSocketEngine.
+ *
+ * The selector thread of the engine receives the next datagram in advance and
+ * holds it until the CMS client asks for it, so a recv()/recvfrom() waiting for a
+ * datagram is deferred and does not need a thread. As with a connected datagram
+ * socket in the C socket API, datagrams from other hosts than the one given with
+ * connect() are dropped.
+ *
+ * The CMS client does not watch datagram sockets through the select event channel
+ * but through its recv()/recvfrom() request (as for InetV4DatagramSocketProxy), so
+ * the readiness of this proxy only decides when the deferred requests are resumed.
+ *
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2014
+ *
+ */
+public class NioDatagramSocketProxy extends AbstractNioInetV4Proxy {
+
+	// max. size of a datagram kept for the CMS client (larger than any recv() request,
+	// the rest of a larger datagram is dropped as with InetV4DatagramSocketProxy)
+	private static final int DATAGRAM_BUFFER_SIZE = 4096;
+
+	// the current channel bound to a local address and socket with bind()
+	// (all fields are guarded by 'this')
+	private DatagramChannel channel = null;
+	private int sockPort = -1;
+	private InetAddress sockAddress = null;
+
+	// the remote computer to which this datagram socket is "connected" to after a connect() call
+	// (target for "send()", filter for received datagrams)
+	private int connPort = -1;
+	private InetAddress connAddress = null;
+
+	// the datagram received in advance (in "get" mode if 'pendingFrom' is not null)
+	private final ByteBuffer pending = ByteBuffer.allocate(DATAGRAM_BUFFER_SIZE);
+	private InetSocketAddress pendingFrom = null;
+	private boolean recvFailed = false; // the last receive failed?
+
+	public NioDatagramSocketProxy(InetAddress defaultAddress, NioSocketEngine engine) {
+		super(defaultAddress, engine);
+	}
+
+	// open a channel bound to 'isa' (null: any free port), returning null if not possible
+	private DatagramChannel openChannel(InetSocketAddress isa) {
+		DatagramChannel ch = null;
+		try {
+			ch = DatagramChannel.open();
+			ch.socket().bind(isa);
+			ch.configureBlocking(false);
+			return ch;
+		} catch (IOException e) {
+			if (ch != null) { try { ch.close(); } catch (IOException e2) { } }
+			return null;
+		}
+	}
+
+	// make sure there is a channel (must be invoked with the lock held)
+	private boolean noSocket() {
+		if (this.channel != null) { return false; }
+		this.channel = this.openChannel(null);
+		if (this.channel == null) { return true; }
+		this.interestChanged();
+		return false;
+	}
+
+	/*
+	 * NioSocketEngine.IChannelOwner
+	 */
+
+	@Override
+	public synchronized SelectableChannel getChannel() {
+		return this.channel;
+	}
+
+	@Override
+	public synchronized int getInterestOps() {
+		return (this.channel != null && this.pendingFrom == null && !this.recvFailed) ? SelectionKey.OP_READ : 0;
+	}
+
+	@Override
+	public void channelReady(int readyOps) {
+		synchronized(this) {
+			if ((readyOps & SelectionKey.OP_READ) != 0 && this.channel != null && this.pendingFrom == null) {
+				try {
+					this.pending.clear();
+					InetSocketAddress from = (InetSocketAddress)this.channel.receive(this.pending);
+					if (from != null && this.isFromConnHost(from)) {
+						this.pending.flip();
+						this.pendingFrom = from;
+					}
+				} catch (IOException e) {
+					this.recvFailed = true;
+				}
+			}
+			this.notifyAll();
+		}
+		this.interestChanged(); // a pending datagram stops receiving
+		this.readinessChanged(false);
+	}
+
+	// is the datagram from the "connected" remote computer (or is the socket un-connected)?
+	private boolean isFromConnHost(InetSocketAddress from) {
+		if (this.connPort < 0 || this.connAddress == null) { return true; }
+		return (from.getPort() == this.connPort && this.connAddress.equals(from.getAddress()));
+	}
+
+	/*
+	 * INioSocketProxy
+	 */
+
+	@Override
+	public synchronized boolean deferRecv(boolean fromAddress, Runnable action) {
+		if (this.noSocket()) { return false; }
+		if (this.pendingFrom != null || this.recvFailed) { return false; }
+		this.defer(action);
+		return true;
+	}
+
+	@Override
+	public boolean deferAccept(Runnable action) {
+		return false;
+	}
+
+	/*
+	 * ISocketProxy
+	 */
+
+	// rc <- bind(local_address)
+	// buffer usage:
+	//   offset 0 -> 16 bytes :: raw local address (sockaddr) to bind to
+	// rc:
+	// - EADDRINUSE -- The given address is already in use
+	// - EAFNOSUPPORT -- not AF_INET
+	// - EINVAL -- invalid argument (e.g. port not 0..65535)
+	@Override
+	public int bind(byte[] buffer, int bufferLength) {
+		int saFamily = this.getUShort(buffer, 0);
+		if (saFamily != ISocketProxy.AF_INET) { return ISocketError.EAFNOSUPPORT; }
+
+		int port = this.getUShort(buffer, 2);
+		InetAddress ia = this.getInetAddress(buffer, 4);
+
+		if (ia == null || port < 0) { return ISocketError.EINVAL; }
+		ia = this.mapAllInetAddress(ia);
+
+		synchronized(this) {
+			if (port == this.sockPort && this.sockAddress != null && this.sockAddress.equals(ia)) {
+				// the current socket is already bound to the same port/address
+				return ISocketError.EOK;
+			}
+
+			DatagramChannel ch = this.openChannel(new InetSocketAddress(ia, port));
+			if (ch == null) { return ISocketError.EADDRINUSE; }
+
+			if (this.channel != null) {
+				try { this.channel.close(); } catch (IOException e) { }
+			}
+			this.channel = ch;
+			this.sockPort = port;
+			this.sockAddress = ia;
+			this.pendingFrom = null;
+			this.recvFailed = false;
+		}
+		this.interestChanged();
+		return ISocketError.EOK;
+	}
+
+	@Override
+	public synchronized int getsockname(byte[] buffer) {
+		if (this.noSocket()) { return ISocketError.EUNSPEC; }
+		this.putInetSocketAddress((InetSocketAddress)this.channel.socket().getLocalSocketAddress(), buffer, 0);
+		return ISocketError.EOK;
+	}
+
+	// rc <- close()
+	// (requests waiting for a datagram are resumed and fail)
+	@Override
+	public int close() {
+		synchronized(this) {
+			if (this.channel != null) {
+				try { this.channel.close(); } catch (IOException e) { }
+				this.channel = null;
+			}
+			this.pendingFrom = null;
+			this.notifyAll();
+		}
+		this.interestChanged(); // let the selector drop the closed channel
+		this.readinessChanged(true);
+		return ISocketError.EOK;
+	}
+
+	// take the pending datagram into 'buffer' at 'offset', waiting until one is available
+	// (must be invoked with the lock held)
+	// returns: the datagram length or -1 if the socket failed resp. was closed
+	private int takeDatagram(byte[] buffer, int offset, int maxLen) {
+		while (this.pendingFrom == null && !this.recvFailed && this.channel != null) {
+			try { this.wait(); } catch (InterruptedException e) { return -1; }
+		}
+		if (this.pendingFrom == null) {
+			this.recvFailed = false;
+			return -1;
+		}
+		int len = Math.min(maxLen, this.pending.remaining());
+		this.pending.get(buffer, offset, len);
+		return len;
+	}
+
+	@Override
+	public int recvFrom(byte[] buffer, int maxCount, int userWord) {
+		int rc;
+		synchronized(this) {
+			if (this.noSocket()) { return ISocketError.EUNSPEC; }
+
+			int bufLen = Math.min(maxCount, buffer.length - 16);
+			if (bufLen < 1) { return ISocketError.EINVAL; }
+
+			int len = this.takeDatagram(buffer, 16, bufLen);
+			if (len < 0) { return ISocketError.ECONNRESET; }
+			this.putInetSocketAddress(this.pendingFrom, buffer, 0);
+			this.pendingFrom = null;
+			rc = ISocketError.EOK + ((len + 16) & 0x0FFF);
+		}
+		this.interestChanged(); // receive the next datagram
+		return rc;
+	}
+
+	@Override
+	public int recv(byte[] buffer, int maxCount, int userWord) {
+		int rc;
+		synchronized(this) {
+			if (this.noSocket()) { return ISocketError.EUNSPEC; }
+
+			int bufLen = Math.min(maxCount, buffer.length);
+			if (bufLen < 1) { return ISocketError.EINVAL; }
+
+			int len = this.takeDatagram(buffer, 0, bufLen);
+			if (len < 0) { return ISocketError.ECONNRESET; }
+			this.pendingFrom = null;
+			rc = ISocketError.EOK + (len & 0x0FFF);
+		}
+		this.interestChanged(); // receive the next datagram
+		return rc;
+	}
+
+	// send the datagram, a datagram not taken by a full socket send buffer is lost
+	// as if dropped on the way
+	private boolean sendDatagram(byte[] buffer, int offset, int len, InetAddress ia, int port) {
+		try {
+			this.channel.send(ByteBuffer.wrap(buffer, offset, len), new InetSocketAddress(ia, port));
+			return true;
+		} catch (IOException exc) {
+			return false;
+		}
+	}
+
+	@Override
+	public synchronized int sendTo(byte[] buffer, int bufferLength, int userWord) {
+		if (this.noSocket()) { return ISocketError.EUNSPEC; }
+
+		if (bufferLength < 17) { return ISocketError.EINVAL; }
+
+		int saFamily = this.getUShort(buffer, 0);
+		if (saFamily != ISocketProxy.AF_INET) { return ISocketError.EAFNOSUPPORT; }
+
+		int port = this.getUShort(buffer, 2);
+		InetAddress ia = this.getInetAddress(buffer, 4);
+		if (ia == null || port < 0) { return ISocketError.EINVAL; }
+
+		if (!this.sendDatagram(buffer, 16, bufferLength - 16, ia, port)) {
+			return ISocketError.ECONNRESET;
+		}
+		return ISocketError.EOK + ((bufferLength - 16) & 0x0FFF);
+	}
+
+	@Override
+	public synchronized int connect(byte[] buffer, int bufferLength) {
+		int saFamily = this.getUShort(buffer, 0);
+		if (saFamily != ISocketProxy.AF_INET) { return ISocketError.EAFNOSUPPORT; }
+
+		int port = this.getUShort(buffer, 2);
+		InetAddress ia = this.getInetAddress(buffer, 4);
+		if (ia == null || port < 0) { return ISocketError.EINVAL; }
+
+		this.connPort = port;
+		this.connAddress = ia;
+		if (this.pendingFrom != null && !this.isFromConnHost(this.pendingFrom)) {
+			this.pendingFrom = null;
+			this.interestChanged();
+		}
+		return ISocketError.EOK;
+	}
+
+	@Override
+	public synchronized int send(byte[] buffer, int bufferLength, int userWord) {
+		if (this.connPort < 0 || this.connAddress == null) {
+			return ISocketError.ENOTCONN; // where to send to if not "connected"?
+		}
+
+		if (this.noSocket()) { return ISocketError.EUNSPEC; }
+
+		if (!this.sendDatagram(buffer, 0, bufferLength, this.connAddress, this.connPort)) {
+			return ISocketError.ECONNRESET;
+		}
+		return ISocketError.EOK;
+	}
+
+	@Override
+	public int shutdown(byte[] buffer, int bufferLength) {
+		return ISocketError.EOK; // successfully ignored this operation
+	}
+
+	/*
+	 * unsupported operations on DatagramSockets
+	 */
+
+	@Override
+	public SocketProxyAcceptResult accept(byte[] buffer) {
+		return new SocketProxyAcceptResult(ISocketError.EOPNOTSUPP);
+	}
+
+	@Override
+	public int listen(byte[] buffer, int bufferLength) {
+		return ISocketError.EOPNOTSUPP;
+	}
+
+	@Override
+	public int getpeername(byte[] buffer) {
+		return ISocketError.EOPNOTSUPP;
+	}
+
+	/*
+	 * readiness for resuming the deferred requests: a datagram received in advance
+	 * makes the socket readable (datagram sockets are not watched by the CMS client
+	 * through the select event channel)
+	 */
+
+	@Override
+	public synchronized int getReadiness() {
+		int flags = READY_WRITE;
+		if (this.pendingFrom != null || this.recvFailed) { flags |= READY_READ; }
+		return flags;
+	}
+}
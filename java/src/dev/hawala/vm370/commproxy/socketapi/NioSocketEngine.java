@@ -0,0 +1,172 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2014
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy.socketapi;
+
+import java.io.IOException;
+import java.nio.channels.CancelledKeyException;
+import java.nio.channels.SelectableChannel;
+import java.nio.channels.SelectionKey;
+import java.nio.channels.Selector;
+import java.util.Iterator;
+import java.util.concurrent.ConcurrentLinkedQueue;
+import java.util.concurrent.ExecutorService;
+import java.util.concurrent.Executors;
+import java.util.concurrent.ThreadFactory;
+
+import dev.hawala.vm370.Log;
+
+/**
+ * Selector engine for the NIO based socket proxies, shared by the Level-0 socket-API
+ * handlers of all client VMs.
+ *
+ * A single selector thread watches the channels of all NIO socket proxies and informs
+ * the proxy owning a channel when the channel is ready, so the proxies can read ahead
+ * incoming data resp. accept incoming connections without having a thread per socket.
+ * Requests of the CMS client waiting for a socket to become ready (recv, accept) are
+ * deferred by the proxy and executed on the worker threads of the engine when the
+ * socket is ready, so an idle connection costs only memory, but no thread.
+ *
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2014
+ *
+ */
+public class NioSocketEngine implements Runnable {
+
+	private static Log logger = Log.getLogger();
+
+	/**
+	 * Interface of the proxies owning a channel watched by the engine.
+	 */
+	public interface IChannelOwner {
+
+		// the channel to watch (null if the proxy currently has no channel)
+		public SelectableChannel getChannel();
+
+		// the SelectionKey.OP_* operations to watch for the channel in the current state
+		// of the proxy (0 if none)
+		public int getInterestOps();
+
+		// invoked by the selector thread when the channel is ready for some of the
+		// operations watched (must not block)
+		public void channelReady(int readyOps);
+	}
+
+	private static NioSocketEngine instance = null;
+
+	/**
+	 * Get the engine, starting it on the first invocation.
+	 *
+	 * @return the engine shared by all NIO socket proxies.
+	 * @throws IOException if the selector cannot be opened.
+	 */
+	public static synchronized NioSocketEngine getInstance() throws IOException {
+		if (instance == null) { instance = new NioSocketEngine(); }
+		return instance;
+	}
+
+	private final Selector selector;
+
+	// the proxies whose interest operations may have changed since the last select
+	// (the selector thread updates the keys, as registering a channel from another
+	// thread would block while the selector thread waits in select())
+	private final ConcurrentLinkedQueue<IChannelOwner> changedOwners = new ConcurrentLinkedQueue<IChannelOwner>();
+
+	// the threads processing the deferred requests, which exist only as long as there is
+	// something to do for them
+	private final ExecutorService workers = Executors.newCachedThreadPool(new ThreadFactory() {
+		@Override
+		public Thread newThread(Runnable r) {
+			Thread t = new Thread(r);
+			t.setName("SocketProxy-NioWorker");
+			t.setDaemon(true);
+			return t;
+		}
+	});
+
+	private NioSocketEngine() throws IOException {
+		this.selector = Selector.open();
+		Thread t = new Thread(this);
+		t.setName("SocketProxy-NioSelector");
+		t.setDaemon(true);
+		t.start();
+	}
+
+	/**
+	 * Inform the engine that the channel or the interest operations of the proxy may
+	 * have changed.
+	 *
+	 * @param owner the proxy to re-check.
+	 */
+	public void interestChanged(IChannelOwner owner) {
+		this.changedOwners.add(owner);
+		this.selector.wakeup();
+	}
+
+	/**
+	 * Execute a deferred request on a worker thread of the engine.
+	 *
+	 * @param action the request processing to run.
+	 */
+	public void execute(Runnable action) {
+		this.workers.execute(action);
+	}
+
+	// update the key of the channel of 'owner' to the current interest operations
+	private void updateKey(IChannelOwner owner) {
+		SelectableChannel channel = owner.getChannel();
+		if (channel == null || !channel.isOpen()) { return; } // a closed channel is deregistered by the selector
+		int ops = owner.getInterestOps();
+		SelectionKey key = channel.keyFor(this.selector);
+		try {
+			if (key == null) {
+				if (ops != 0) { channel.register(this.selector, ops, owner); }
+			} else if (key.isValid()) {
+				key.interestOps(ops);
+			}
+		} catch (CancelledKeyException exc) {
+			// channel closed in the meantime
+		} catch (IOException exc) {
+			logger.info("NioSocketEngine: unable to register channel: ", exc.getMessage());
+		}
+	}
+
+	@Override
+	public void run() {
+		while(true) {
+			try {
+				IChannelOwner owner = this.changedOwners.poll();
+				while (owner != null) {
+					this.updateKey(owner);
+					owner = this.changedOwners.poll();
+				}
+
+				this.selector.select();
+
+				Iterator<SelectionKey> keys = this.selector.selectedKeys().iterator();
+				while (keys.hasNext()) {
+					SelectionKey key = keys.next();
+					keys.remove();
+					try {
+						int readyOps = key.readyOps();
+						((IChannelOwner)key.attachment()).channelReady(readyOps);
+					} catch (CancelledKeyException exc) {
+						// channel closed in the meantime
+					}
+				}
+			} catch (Throwable thr) {
+				logger.info("NioSocketEngine: caught exception in selector loop: ", thr.getMessage());
+			}
+		}
+	}
+}
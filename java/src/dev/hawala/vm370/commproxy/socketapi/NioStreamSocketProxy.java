@@ -0,0 +1,531 @@
+/*
+** This file is part of the external (outside) NICOF proxy implementation.
+** (NICOF :: Non-Invasive COmmunication Facility
+**           for VM/370 R6 SixPack 1.2)
+**
+** This software is provided "as is" in the hope that it will be useful, with
+** no promise, commitment or even warranty (explicit or implicit) to be
+** suited or usable for any particular purpose.
+** Using this software is at your own risk!
+**
+** Written by Dr. Hans-Walter Latz, Berlin (Germany), 2014
+** Released to the public domain.
+*/
+
+package dev.hawala.vm370.commproxy.socketapi;
+
+import java.io.IOException;
+import java.net.InetAddress;
+import java.net.InetSocketAddress;
+import java.net.Socket;
+import java.nio.ByteBuffer;
+import java.nio.channels.SelectableChannel;
+import java.nio.channels.SelectionKey;
+import java.nio.channels.ServerSocketChannel;
+import java.nio.channels.SocketChannel;
+import java.util.LinkedList;
+
+/**
+ * Implementation of a ISocketProxy for a "IPv4 STREAM" type socket based on
+ * non-blocking channels served by the NioSocketEngine.
+ *
+ * Incoming data resp. connections are read resp. accepted in advance by the selector
+ * thread of the engine (with the same buffer limits as InetV4StreamSocketProxy), so
+ * an idle connection or listening socket does not need a thread of its own. A recv()
+ * or accept() request of the CMS client finding nothing to return is deferred until
+ * the socket is ready (see INioSocketProxy).
+ *
+ * A send() still waits for the peer to take the data if the socket send buffer is
+ * full, and connect() still waits for the connection to be established.
+ *
+ * @author Dr. Hans-Walter Latz, Berlin (Germany), 2014
+ *
+ */
+public class NioStreamSocketProxy extends AbstractNioInetV4Proxy {
+
+	// size of the receive read-ahead buffer (8 packets of the max. recv size)
+	private static final int RECV_BUFFER_SIZE = 16384;
+
+	// max. number of connections accepted in advance for a listening socket
+	private static final int ACCEPT_AHEAD = 4;
+
+	private InetSocketAddress localAddress = null;
+	private InetSocketAddress remoteAddress = null;
+
+	// the channel of a connected socket resp. of a listening socket
+	// (all fields are guarded by 'this')
+	private SocketChannel channel = null;
+	private ServerSocketChannel server = null;
+
+	// read-ahead for the data arriving on the connection (in "put" mode)
+	// -> the selector thread reads as long as there is space, reading stops when the
+	//    buffer is full, so the TCP flow control still throttles the sender
+	private final ByteBuffer recvBuffer = ByteBuffer.allocate(RECV_BUFFER_SIZE);
+	private boolean eof = false; // end of stream (or error) reached?
+	private boolean failed = false; // was the end of stream caused by an error?
+	private boolean inShut = false; // in channel shut down?
+	private boolean outShut = false; // out channel shut down?
+	private boolean writeWaiting = false; // a send() waits for the channel to accept data?
+
+	// accept-ahead for a listening socket
+	private final LinkedList<SocketChannel> accepted = new LinkedList<SocketChannel>();
+	private boolean acceptEnded = false; // server channel failed?
+
+	public NioStreamSocketProxy(InetAddress defaultAddress, NioSocketEngine engine) {
+		super(defaultAddress, engine);
+	}
+
+	private NioStreamSocketProxy(
+			InetAddress defaultAddress,
+			NioSocketEngine engine,
+			SocketChannel ch,
+			InetSocketAddress ra) {
+		super(defaultAddress, engine);
+		this.channel = ch;
+		this.remoteAddress = ra;
+		this.interestChanged();
+	}
+
+	/*
+	 * NioSocketEngine.IChannelOwner
+	 */
+
+	@Override
+	public synchronized SelectableChannel getChannel() {
+		return (this.server != null) ? this.server : this.channel;
+	}
+
+	@Override
+	public synchronized int getInterestOps() {
+		if (this.server != null) {
+			return (!this.acceptEnded && this.accepted.size() < ACCEPT_AHEAD) ? SelectionKey.OP_ACCEPT : 0;
+		}
+		int ops = 0;
+		if (this.channel != null && !this.eof && !this.inShut && this.recvBuffer.hasRemaining()) {
+			ops |= SelectionKey.OP_READ;
+		}
+		if (this.writeWaiting) { ops |= SelectionKey.OP_WRITE; }
+		return ops;
+	}
+
+	@Override
+	public void channelReady(int readyOps) {
+		synchronized(this) {
+			if ((readyOps & SelectionKey.OP_ACCEPT) != 0 && this.server != null) {
+				try {
+					while (this.accepted.size() < ACCEPT_AHEAD) {
+						SocketChannel s = this.server.accept();
+						if (s == null) { break; }
+						try {
+							s.socket().setTcpNoDelay(true);
+							s.configureBlocking(false);
+							this.accepted.add(s);
+						} catch (IOException e) {
+							try { s.close(); } catch (IOException e2) { }
+						}
+					}
+				} catch (IOException e) {
+					this.acceptEnded = true;
+				}
+			}
+
+			if ((readyOps & SelectionKey.OP_READ) != 0 && this.channel != null && !this.eof) {
+				try {
+					if (this.channel.read(this.recvBuffer) < 0) { this.eof = true; }
+				} catch (IOException e) {
+					this.eof = true;
+					this.failed = true;
+				}
+			}
+
+			if ((readyOps & SelectionKey.OP_WRITE) != 0) {
+				this.writeWaiting = false;
+			}
+
+			this.notifyAll();
+		}
+		this.interestChanged(); // a full buffer resp. queue stops reading resp. accepting
+		this.readinessChanged(false);
+	}
+
+	/*
+	 * INioSocketProxy
+	 */
+
+	@Override
+	public synchronized boolean deferRecv(boolean fromAddress, Runnable action) {
+		if (fromAddress || this.channel == null || this.inShut) { return false; }
+		if ((this.getReadiness() & READY_READ) != 0) { return false; }
+		this.defer(action);
+		return true;
+	}
+
+	@Override
+	public synchronized boolean deferAccept(Runnable action) {
+		if (this.server == null) { return false; }
+		if ((this.getReadiness() & READY_ACCEPT) != 0) { return false; }
+		this.defer(action);
+		return true;
+	}
+
+	/*
+	 * ISocketProxy
+	 */
+
+	// rc <- bind(local_address)
+	// buffer usage:
+	//   offset 0 -> 16 bytes :: raw local address (sockaddr) to bind to
+	// rc:
+	// - EADDRINUSE -- The given address is already in use
+	// - EAFNOSUPPORT -- not AF_INET
+	// - EINVAL -- socket already bound to an address, invalid argument (e.g. port not 0..65535, not AF_INET)
+	@Override
+	public synchronized int bind(byte[] buffer, int bufferLength) {
+		if (this.channel != null || this.server != null) {
+			return ISocketError.EINVAL;
+		}
+
+		int saFamily = this.getUShort(buffer, 0);
+		if (saFamily != ISocketProxy.AF_INET) { return ISocketError.EAFNOSUPPORT; }
+
+		int port = this.getUShort(buffer, 2);
+		InetAddress ia = this.getInetAddress(buffer, 4);
+
+		if (ia == null || port < 0) { return ISocketError.EINVAL; }
+
+		InetSocketAddress isa = new InetSocketAddress(this.mapAllInetAddress(ia), port);
+
+		try {
+			Socket cs = new Socket();
+			cs.bind(isa);
+			cs.close();
+		} catch (IOException e) {
+			return ISocketError.EADDRINUSE;
+		}
+
+		this.localAddress = isa;
+		return ISocketError.EOK;
+	}
+
+	// rc <- close()
+	// (requests waiting for the socket are resumed and fail)
+	@Override
+	public int close() {
+		synchronized(this) {
+			if (this.channel != null) {
+				try { this.channel.close(); } catch (IOException e) { }
+				this.channel = null;
+				this.remoteAddress = null;
+			}
+			if (this.server != null) {
+				try { this.server.close(); } catch (IOException e) { }
+				this.server = null;
+				for (SocketChannel s : this.accepted) {
+					try { s.close(); } catch (IOException e) { }
+				}
+				this.accepted.clear();
+			}
+			this.eof = true;
+			this.writeWaiting = false;
+			this.notifyAll();
+		}
+		this.interestChanged(); // let the selector drop the closed channel
+		this.readinessChanged(true);
+		return ISocketError.EOK;
+	}
+
+	// rc <- shutdown(how)
+	// buffer usage:
+	//   offset 0 :: how (0 = in channel, 1 = out channel, 2 = both channels)
+	// rc:
+	// - ENOTCONN -- not a connected client socket
+	// - EINVAL -- missing argument 'how'
+	@Override
+	public int shutdown(byte[] buffer, int bufferLength) {
+		synchronized(this) {
+			if (this.channel == null) { return ISocketError.ENOTCONN; }
+			if (bufferLength < 1) { return ISocketError.EINVAL; }
+
+			byte how = buffer[0];
+
+			if ((how == 0 || how == 2) && !this.inShut) { // shutdown ingoing channel (or both channels)
+				try {
+					this.channel.socket().shutdownInput();
+				} catch (IOException e) {
+					// ignored!
+				}
+				this.inShut = true;
+				this.notifyAll();
+			}
+
+			if ((how == 1 || how == 2) && !this.outShut) { // shutdown outgoing channel (or both channels)
+				try {
+					this.channel.socket().shutdownOutput();
+				} catch (IOException e) {
+					// ignored!
+				}
+				this.outShut = true;
+			}
+		}
+		this.interestChanged();
+		this.readinessChanged(true);
+		return ISocketError.EOK;
+	}
+
+	// rc <- connect(remote_address)
+	// (waits until the connection is established, then switches the channel to non-blocking)
+	// buffer usage:
+	//   offset 0 -> 16 bytes :: raw remote address (sockaddr) to connect to
+	// rc:
+	// - EAFNOSUPPORT -- not AF_INET
+	// - EINVAL -- Invalid argument (e.g. port not 0..65535)
+	// - EISCONN -- socket is already connected
+	// - ECONNREFUSED -- no-one listering at remote address
+	// - EADDRINUSE -- local bind address already in use
+	@Override
+	public int connect(byte[] buffer, int bufferLength) {
+		InetSocketAddress bindAddress;
+		synchronized(this) {
+			if (this.channel != null || this.server != null) {
+				return ISocketError.EISCONN;
+			}
+			bindAddress = this.localAddress;
+		}
+
+		int saFamily = this.getUShort(buffer, 0);
+		if (saFamily != ISocketProxy.AF_INET) { return ISocketError.EAFNOSUPPORT; }
+
+		int port = this.getUShort(buffer, 2);
+		InetAddress ia = this.getInetAddress(buffer, 4);
+		if (ia == null || port < 0) { return ISocketError.EINVAL; }
+
+		InetSocketAddress isa = new InetSocketAddress(ia, port);
+
+		int errCode = ISocketError.EUNSPEC;
+		SocketChannel ch = null;
+		try {
+			ch = SocketChannel.open();
+			if (bindAddress != null) {
+				errCode = ISocketError.EADDRINUSE;
+				ch.socket().bind(bindAddress);
+			}
+			errCode = ISocketError.ECONNREFUSED;
+			ch.connect(isa);
+			ch.socket().setTcpNoDelay(true);
+			ch.configureBlocking(false);
+		} catch (IOException e) {
+			if (ch != null) { try { ch.close(); } catch (IOException e2) { } }
+			return errCode;
+		}
+
+		synchronized(this) {
+			this.channel = ch;
+			this.remoteAddress = isa;
+		}
+		this.interestChanged();
+		this.readinessChanged(false);
+		return ISocketError.EOK;
+	}
+
+	// rc <- listen(backlog)
+	// open listening socket
+	// buffer usage:
+	//   offset 0 -> 1 byte :: backlog (unsigned byte: 1..255)
+	// rc:
+	// - EINVAL -- Invalid argument, no valid bind()
+	// - EADDRINUSE -- The given address is already in use
+	// - EISCONN -- socket is already connected
+	@Override
+	public int listen(byte[] buffer, int bufferLength) {
+		synchronized(this) {
+			if (this.channel != null || this.server != null) {
+				return ISocketError.EISCONN;
+			}
+			if (this.localAddress == null) {
+				return ISocketError.EINVAL;
+			}
+
+			ServerSocketChannel s = null;
+			try {
+				s = ServerSocketChannel.open();
+				s.socket().bind(this.localAddress);
+				s.configureBlocking(false);
+				this.server = s;
+				this.localAddress = (InetSocketAddress)s.socket().getLocalSocketAddress();
+			} catch (IOException e) {
+				if (s != null) { try { s.close(); } catch (IOException e2) { } }
+				return ISocketError.EADDRINUSE;
+			}
+		}
+		this.interestChanged();
+		return ISocketError.EOK;
+	}
+
+	// {rc,proxy} <- accept(buffer)
+	// wait for incoming connection
+	// (taken from the accept-ahead queue, waiting only if no connection has arrived yet)
+	// buffer usage (OUT):
+	//   offset 0 -> 16 bytes :: src_addr (where the connection comes from)
+	// rc:
+	// - EINVAL -- Socket is not listening for connections
+	// - ECONNABORTED -- A connection has been aborted
+	@Override
+	public SocketProxyAcceptResult accept(byte[] buffer) {
+		SocketChannel s;
+		synchronized(this) {
+			if (this.server == null) { return new SocketProxyAcceptResult(ISocketError.EINVAL); }
+			while (this.accepted.isEmpty() && !this.acceptEnded && this.server != null) {
+				try { this.wait(); } catch (InterruptedException e) { break; }
+			}
+			if (this.accepted.isEmpty()) { return new SocketProxyAcceptResult(ISocketError.ECONNABORTED); }
+			s = this.accepted.removeFirst();
+		}
+		this.interestChanged(); // the queue has space again
+
+		InetSocketAddress sockAddr = (InetSocketAddress)s.socket().getRemoteSocketAddress();
+		if (sockAddr == null) {
+			try { s.close(); } catch (IOException e) { }
+			return new SocketProxyAcceptResult(ISocketError.ECONNABORTED);
+		}
+		this.putInetSocketAddress(sockAddr, buffer, 0);
+		return new SocketProxyAcceptResult(
+					new NioStreamSocketProxy(this.defaultAddress, this.engine, s, sockAddr));
+	}
+
+	// {rc+len} <- recv(buffer, maxCount, flags)
+	// receive data-packet over stream connection
+	// (answered from the read-ahead buffer, waiting only if no data has arrived yet)
+	// buffer usage:
+	//   offset 0 -> 1..2048 bytes :: data received
+	// userWord: flags (currently unused)
+	// len: byte count received (bytes in buffer used)
+	// rc:
+	// - ENOTCONN -- The socket is associated with a connection-oriented protocol and has not been connected.
+	// - ECONNABORTED -- end of stream resp. connection failed or closed
+	@Override
+	public int recv(byte[] buffer, int maxCount, int userWord) {
+		int len;
+		boolean wasFull;
+		synchronized(this) {
+			if (this.channel == null || this.inShut) { return ISocketError.ENOTCONN; }
+			if (maxCount <= 0) { return ISocketError.EOK; }
+
+			while (this.recvBuffer.position() == 0 && !this.eof && this.channel != null && !this.inShut) {
+				try { this.wait(); } catch (InterruptedException e) { break; }
+			}
+			if (this.recvBuffer.position() == 0) { return ISocketError.ECONNABORTED; }
+
+			wasFull = !this.recvBuffer.hasRemaining();
+			this.recvBuffer.flip();
+			len = Math.min(Math.min(2048, maxCount), this.recvBuffer.remaining());
+			this.recvBuffer.get(buffer, 0, len);
+			this.recvBuffer.compact();
+		}
+		if (wasFull) { this.interestChanged(); } // resume reading
+		return ISocketError.EOK + (len & 0x0FFF);
+	}
+
+	// {rc+len} <- recvfrom(buffer, maxCount, flags)
+	// rc:
+	// - EINVAL -- not supported (connected connection-oriented protocol)
+	@Override
+	public int recvFrom(byte[] buffer, int maxCount, int userWord) {
+		return ISocketError.EINVAL;
+	}
+
+	// (rc+sentLen) <- send(data, flags)
+	// send data-packet over stream connection
+	// (waits for the selector if the socket send buffer cannot take all data)
+	// buffer usage:
+	//   offset 0 -> 1..2048 bytes :: data to send
+	// userWord: flags (currently unused)
+	// rc:
+	// - ENOTCONN -- The socket is not connected.
+	// - ECONNABORTED  -- Connection reset by peer
+	@Override
+	public int send(byte[] buffer, int bufferLength, int userWord) {
+		synchronized(this) {
+			if (this.channel == null || this.outShut) {
+				return ISocketError.ENOTCONN;
+			}
+
+			ByteBuffer data = ByteBuffer.wrap(buffer, 0, bufferLength);
+			try {
+				while (true) {
+					SocketChannel ch = this.channel;
+					if (ch == null || this.outShut) { return ISocketError.ECONNABORTED; }
+					ch.write(data);
+					if (!data.hasRemaining()) { break; }
+
+					// let the selector tell when the channel can take more data
+					this.writeWaiting = true;
+					this.interestChanged();
+					while (this.writeWaiting && this.channel != null) {
+						try { this.wait(); } catch (InterruptedException e) { return ISocketError.ECONNABORTED; }
+					}
+				}
+				return ISocketError.EOK + (bufferLength & 0x0FFF);
+			} catch (IOException e) {
+				return ISocketError.ECONNABORTED;
+			}
+		}
+	}
+
+	// (rc+sentLen) <- sendTo(data, flags, dest_addr)
+	// rc:
+	// - EISCONN -- The socket is connected (connection-mode) but a recipient was specified
+	@Override
+	public int sendTo(byte[] buffer, int bufferLength, int userWord) {
+		return ISocketError.EISCONN;
+	}
+
+	// rc <- getpeername(buffer)
+	// get the address of the remote endpoint of the connected socket
+	// buffer usage (OUT):
+	//   offset 0 -> 16 bytes :: raw remote address (sockaddr)
+	// rc:
+	// - ENOTCONN -- The socket is not connected
+	@Override
+	public synchronized int getpeername(byte[] buffer) {
+		if (this.remoteAddress != null) {
+			this.putInetSocketAddress(this.remoteAddress, buffer, 0);
+			return ISocketError.EOK;
+		}
+		return ISocketError.ENOTCONN;
+	}
+
+	// rc <- getsockname(buffer)
+	// get the local address of the socket (resp. 0.0.0.0:0 if not connected and not bound)
+	// buffer usage (OUT):
+	//   offset 0 -> 16 bytes :: raw local (own) address (sockaddr)
+	@Override
+	public synchronized int getsockname(byte[] buffer) {
+		if (this.localAddress != null) {
+			this.putInetSocketAddress(this.localAddress, buffer, 0);
+		} else if (this.channel != null) {
+			this.putInetSocketAddress((InetSocketAddress)this.channel.socket().getLocalSocketAddress(), buffer, 0);
+		} else {
+			for(int i = 0; i < Math.min(buffer.length, 16); i++) {
+				buffer[i] = (byte)0;
+			}
+		}
+		return ISocketError.EOK;
+	}
+
+	// flags <- getReadiness()
+	@Override
+	public synchronized int getReadiness() {
+		if (this.server != null) {
+			if (!this.accepted.isEmpty()) { return READY_ACCEPT; }
+			return (this.acceptEnded) ? READY_ACCEPT | READY_ERROR : 0;
+		}
+
+		int flags = 0;
+		if (this.channel != null && !this.inShut) {
+			if (this.recvBuffer.position() > 0 || this.eof) { flags |= READY_READ; }
+			if (this.failed) { flags |= READY_ERROR; }
+		}
+		if (this.channel != null && !this.outShut) { flags |= READY_WRITE; }
+		return flags;
+	}
+}